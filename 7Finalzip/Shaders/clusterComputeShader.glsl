@@ -0,0 +1,110 @@
+#version 460 core
+
+// one invocation lists the lights of one froxel
+layout (local_size_x = 64) in;
+
+// must match LightClusters
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define MAX_CLUSTER_LIGHTS 63
+
+// must match LightClusters::LIGHT_DATA
+struct LightData
+{
+	vec4 position;			// w = radius, 0 = unlimited
+	vec4 ambientColor;		// w = focal strength
+	vec4 diffuseColor;		// w = specular intensity
+	vec4 specularColor;		// w = shadowed light index
+};
+
+layout (std430, binding = 6) readonly buffer LightBuffer
+{
+	LightData lights[];
+};
+
+// per froxel: the light count followed by the light indices
+layout (std430, binding = 7) writeonly buffer ClusterBuffer
+{
+	uint clusterLights[];
+};
+
+// camera of the frame, shared by every pass
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseProjection;
+	vec4 cameraPosition;
+	vec4 frustumPlanes[6];
+	vec4 viewport;			// width, height, near, far
+};
+
+uniform int lightCount;
+
+// view-space point of a window corner at a view depth
+vec3 CornerAtDepth(vec2 ndc, float depth)
+{
+	vec4 nearPoint = inverseProjection * vec4(ndc, -1.0f, 1.0f);
+	vec4 farPoint = inverseProjection * vec4(ndc, 1.0f, 1.0f);
+	vec3 nearView = nearPoint.xyz / nearPoint.w;
+	vec3 farView = farPoint.xyz / farPoint.w;
+	float t = (depth + nearView.z) / (nearView.z - farView.z);
+	return mix(nearView, farView, t);
+}
+
+void main()
+{
+	uint cluster = gl_GlobalInvocationID.x;
+	if (cluster >= CLUSTER_COUNT)
+		return;
+
+	uint x = cluster % CLUSTER_X;
+	uint y = (cluster / CLUSTER_X) % CLUSTER_Y;
+	uint z = cluster / (CLUSTER_X * CLUSTER_Y);
+
+	// view depths of the near and far planes
+	vec4 nearCenter = inverseProjection * vec4(0.0f, 0.0f, -1.0f, 1.0f);
+	vec4 farCenter = inverseProjection * vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	float nearDepth = max(-nearCenter.z / nearCenter.w, 0.01f);
+	float farDepth = max(-farCenter.z / farCenter.w, nearDepth * 2.0f);
+
+	// exponential depth slices
+	float sliceNear = nearDepth * pow(farDepth / nearDepth, float(z) / CLUSTER_Z);
+	float sliceFar = nearDepth * pow(farDepth / nearDepth, float(z + 1) / CLUSTER_Z);
+
+	vec2 tileMin = vec2(float(x) / CLUSTER_X, float(y) / CLUSTER_Y) * 2.0f - 1.0f;
+	vec2 tileMax = vec2(float(x + 1) / CLUSTER_X, float(y + 1) / CLUSTER_Y) * 2.0f - 1.0f;
+
+	// view-space bounding box of the froxel
+	vec3 boxMin = vec3(1e30f);
+	vec3 boxMax = vec3(-1e30f);
+	for (int i = 0; i < 8; i++)
+	{
+		vec2 ndc = vec2(((i & 1) != 0) ? tileMax.x : tileMin.x, ((i & 2) != 0) ? tileMax.y : tileMin.y);
+		vec3 corner = CornerAtDepth(ndc, ((i & 4) != 0) ? sliceFar : sliceNear);
+		boxMin = min(boxMin, corner);
+		boxMax = max(boxMax, corner);
+	}
+
+	uint base = cluster * (MAX_CLUSTER_LIGHTS + 1);
+	uint count = 0u;
+	for (int i = 0; (i < lightCount) && (count < MAX_CLUSTER_LIGHTS); i++)
+	{
+		float radius = lights[i].position.w;
+		if (radius > 0.0f)
+		{
+			// distance from the light to the closest point of the box
+			vec3 center = (view * vec4(lights[i].position.xyz, 1.0f)).xyz;
+			vec3 closest = clamp(center, boxMin, boxMax);
+			vec3 offset = center - closest;
+			if (dot(offset, offset) > radius * radius)
+				continue;
+		}
+		clusterLights[base + 1u + count] = uint(i);
+		count++;
+	}
+	clusterLights[base] = count;
+}
@@ -0,0 +1,88 @@
+#version 460 core
+
+// one invocation tests one object
+layout (local_size_x = 64) in;
+
+// must match GpuCuller::CULL_OBJECT
+struct CullObject
+{
+	vec4 sphere;			// world-space center and radius
+	uint firstIndex;
+	uint indexCount;
+	int baseVertex;
+	uint recordIndex;
+	uint batch;
+	uint padding0;
+	uint padding1;
+	uint padding2;
+};
+
+// must match MeshManager::DRAW_COMMAND
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 2) readonly buffer CullObjects
+{
+	CullObject objects[];
+};
+
+layout (std430, binding = 3) readonly buffer CullBatches
+{
+	uint batchFirstCommand[];
+};
+
+layout (std430, binding = 4) writeonly buffer CullCommands
+{
+	DrawCommand commands[];
+};
+
+layout (std430, binding = 5) buffer CullCounts
+{
+	uint drawCounts[];
+};
+
+// camera of the frame, shared by every pass, whose frustum
+// planes are (normal, distance) pointing inwards
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseProjection;
+	vec4 cameraPosition;
+	vec4 frustumPlanes[6];
+	vec4 viewport;			// width, height, near, far
+};
+
+uniform uint objectCount;
+
+void main()
+{
+	uint objectIndex = gl_GlobalInvocationID.x;
+	if (objectIndex >= objectCount)
+		return;
+
+	CullObject object = objects[objectIndex];
+	for (int i = 0; i < 6; i++)
+	{
+		if (dot(frustumPlanes[i].xyz, object.sphere.xyz) + frustumPlanes[i].w < -object.sphere.w)
+			return;
+	}
+
+	// append a command to the compacted range of the batch
+	uint slot = atomicAdd(drawCounts[object.batch], 1u);
+
+	DrawCommand command;
+	command.count = object.indexCount;
+	command.instanceCount = 1u;
+	command.firstIndex = object.firstIndex;
+	command.baseVertex = object.baseVertex;
+	command.baseInstance = object.recordIndex;
+	commands[batchFirstCommand[object.batch] + slot] = command;
+}
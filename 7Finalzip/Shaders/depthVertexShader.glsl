@@ -0,0 +1,53 @@
+#version 460 core
+
+// depth-only variant of vertexShader.glsl for the depth pre-pass,
+// where the position must be computed exactly as there, and with
+// SHADOW_PASS defined for the shadow maps
+layout (location = 0) in vec3 inVertexPosition;
+
+// per-draw record, must match DrawDataBuffer::DRAW_DATA
+struct DrawData
+{
+	mat4 model;
+	vec4 objectColor;
+	vec4 ambientColor;
+	vec4 diffuseColor;
+	vec4 specularColor;
+	vec2 UVscale;
+	float textureLayer;
+	uint flags;
+};
+
+layout (std430, binding = 1) readonly buffer DrawDataBuffer
+{
+	DrawData draws[];
+};
+
+#ifdef SHADOW_PASS
+uniform mat4 lightViewProjection;
+#else
+invariant gl_Position;
+
+// camera of the frame, shared by every pass
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseProjection;
+	vec4 cameraPosition;
+	vec4 frustumPlanes[6];
+	vec4 viewport;			// width, height, near, far
+};
+#endif
+
+void main()
+{
+	mat4 objectModel = draws[gl_BaseInstance + gl_InstanceID].model;
+	vec4 worldPosition = objectModel * vec4(inVertexPosition, 1.0f);
+#ifdef SHADOW_PASS
+	gl_Position = lightViewProjection * worldPosition;
+#else
+	gl_Position = viewProjection * worldPosition;
+#endif
+}
@@ -0,0 +1,217 @@
+#version 460 core
+
+// per-draw record, must match DrawDataBuffer::DRAW_DATA
+struct DrawData
+{
+	mat4 model;
+	vec4 objectColor;
+	vec4 ambientColor;		// w = ambient strength
+	vec4 diffuseColor;		// w = shininess
+	vec4 specularColor;
+	vec2 UVscale;
+	float textureLayer;
+	uint flags;
+};
+
+#define DRAW_USE_TEXTURE 1u
+
+// must match LightClusters::LIGHT_DATA
+struct LightData
+{
+	vec4 position;			// w = radius, 0 = unlimited
+	vec4 ambientColor;		// w = focal strength
+	vec4 diffuseColor;		// w = specular intensity
+	vec4 specularColor;		// w = shadowed light index
+};
+
+// froxel grid, must match LightClusters
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_CLUSTER_LIGHTS 63
+
+// shadow map layers, see ShadowMaps
+#define CASCADE_COUNT 3
+#define CASCADED_LIGHTS 2
+#define SHADOW_LAYERS 7
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+flat in int fragmentDrawIndex;
+in float fragmentViewDepth;
+
+out vec4 outFragmentColor;
+
+layout (std430, binding = 1) readonly buffer DrawDataBuffer
+{
+	DrawData draws[];
+};
+
+uniform bool bUseLighting = false;
+// textures live in array pools grouped by size and format, a
+// draw picks its image by layer
+uniform sampler2DArray objectTexture;
+
+// camera of the frame, shared by every pass
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseProjection;
+	vec4 cameraPosition;
+	vec4 frustumPlanes[6];
+	vec4 viewport;			// width, height, near, far
+};
+
+layout (std430, binding = 6) readonly buffer LightBuffer
+{
+	LightData lights[];
+};
+
+// per froxel: the light count followed by the light indices
+layout (std430, binding = 7) readonly buffer ClusterBuffer
+{
+	uint clusterLights[];
+};
+
+// without clusters every fragment shades with every light
+uniform bool bUseClusters = false;
+uniform int lightCount = 0;
+// view depths of the first and last depth slice
+uniform vec2 clusterDepthRange;
+
+uniform bool bUseShadows = false;
+uniform sampler2DArrayShadow shadowMaps;
+uniform mat4 shadowMatrices[SHADOW_LAYERS];
+// view-space distances where the cascades end
+uniform vec4 cascadeSplits;
+
+// fraction of a light reaching the fragment, filtered over 3x3
+// hardware compared taps
+float SampleShadow(int layer, vec3 shadowPosition)
+{
+	vec4 clip = shadowMatrices[layer] * vec4(shadowPosition, 1.0f);
+	vec3 coordinates = clip.xyz / clip.w * 0.5f + 0.5f;
+	if (coordinates.z >= 1.0f)
+		return 1.0f;
+
+	vec2 texelSize = 1.0f / vec2(textureSize(shadowMaps, 0).xy);
+	float lit = 0.0f;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			vec2 offset = vec2(x, y) * texelSize;
+			lit += texture(shadowMaps, vec4(coordinates.xy + offset, float(layer), coordinates.z));
+		}
+	}
+	return lit / 9.0f;
+}
+
+// shadow factor of one light, 1 for lights without a map
+float CalcShadow(int light, vec3 shadowPosition)
+{
+	if (!bUseShadows)
+		return 1.0f;
+
+	if (light < CASCADED_LIGHTS)
+	{
+		int cascade = 0;
+		while ((cascade < CASCADE_COUNT) && (fragmentViewDepth > cascadeSplits[cascade]))
+			cascade++;
+		if (cascade == CASCADE_COUNT)
+			return 1.0f;
+		return SampleShadow(light * CASCADE_COUNT + cascade, shadowPosition);
+	}
+	if (light == CASCADED_LIGHTS)
+		return SampleShadow(SHADOW_LAYERS - 1, shadowPosition);
+	return 1.0f;
+}
+
+// calculate the phong lighting contribution of one light source
+vec3 CalcLightSource(LightData light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+	vec3 ambient = light.ambientColor.rgb;
+
+	vec3 toLight = light.position.xyz - vertexPosition;
+	vec3 lightDirection = normalize(toLight);
+	float impact = max(dot(lightNormal, lightDirection), 0.0f);
+	vec3 diffuse = impact * light.diffuseColor.rgb;
+
+	vec3 reflectDirection = reflect(-lightDirection, lightNormal);
+	float specularComponent = pow(max(dot(viewDirection, reflectDirection), 0.0f), light.ambientColor.w);
+	vec3 specular = light.diffuseColor.w * specularComponent * light.specularColor.rgb;
+
+	// look up the shadow slightly off the surface against acne
+	float shadow = 1.0f;
+	if (light.specularColor.w >= 0.0f)
+		shadow = CalcShadow(int(light.specularColor.w), vertexPosition + lightNormal * 0.02f);
+
+	vec3 result = ambient + shadow * (diffuse + specular);
+
+	// lights with a range fade out smoothly towards it
+	float radius = light.position.w;
+	if (radius > 0.0f)
+	{
+		float distanceRatio = length(toLight) / radius;
+		float window = clamp(1.0f - distanceRatio * distanceRatio * distanceRatio * distanceRatio, 0.0f, 1.0f);
+		result *= window * window / (1.0f + dot(toLight, toLight));
+	}
+	return result;
+}
+
+// index of the first entry of the froxel holding the fragment
+uint FindCluster()
+{
+	vec2 tile = clamp(gl_FragCoord.xy / viewport.xy, 0.0f, 0.9999f) * vec2(CLUSTER_X, CLUSTER_Y);
+	float depthRatio = log(max(fragmentViewDepth, clusterDepthRange.x) / clusterDepthRange.x) /
+		log(clusterDepthRange.y / clusterDepthRange.x);
+	uint slice = uint(clamp(depthRatio * CLUSTER_Z, 0.0f, CLUSTER_Z - 1.0f));
+	uint cluster = (slice * CLUSTER_Y + uint(tile.y)) * CLUSTER_X + uint(tile.x);
+	return cluster * (MAX_CLUSTER_LIGHTS + 1u);
+}
+
+void main()
+{
+	DrawData draw = draws[fragmentDrawIndex];
+
+	vec4 surfaceColor = draw.objectColor;
+	if ((draw.flags & DRAW_USE_TEXTURE) != 0u)
+	{
+		surfaceColor = texture(objectTexture, vec3(fragmentTextureCoordinate * draw.UVscale, draw.textureLayer));
+		// the alpha of the color still scales the opacity
+		surfaceColor.a *= draw.objectColor.a;
+	}
+
+	if (!bUseLighting)
+	{
+		outFragmentColor = surfaceColor;
+		return;
+	}
+
+	vec3 lightNormal = normalize(fragmentVertexNormal);
+	vec3 viewDirection = normalize(cameraPosition.xyz - fragmentPosition);
+
+	vec3 phongResult = vec3(0.0f);
+	if (bUseClusters)
+	{
+		uint base = FindCluster();
+		uint count = clusterLights[base];
+		for (uint i = 0u; i < count; i++)
+		{
+			LightData light = lights[clusterLights[base + 1u + i]];
+			phongResult += CalcLightSource(light, lightNormal, fragmentPosition, viewDirection);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < lightCount; i++)
+		{
+			phongResult += CalcLightSource(lights[i], lightNormal, fragmentPosition, viewDirection);
+		}
+	}
+
+	outFragmentColor = vec4(phongResult * surfaceColor.rgb, surfaceColor.a);
+}
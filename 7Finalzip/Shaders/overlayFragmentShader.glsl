@@ -0,0 +1,15 @@
+#version 440 core
+
+in vec2 fragmentTextureCoordinate;
+in vec4 fragmentColor;
+
+out vec4 outFragmentColor;
+
+// single channel font coverage
+uniform sampler2D fontTexture;
+
+void main()
+{
+	float coverage = texture(fontTexture, fragmentTextureCoordinate).r;
+	outFragmentColor = vec4(fragmentColor.rgb, fragmentColor.a * coverage);
+}
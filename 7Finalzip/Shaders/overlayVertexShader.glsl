@@ -0,0 +1,20 @@
+#version 440 core
+
+// screen-space quads, in window pixels from the top left corner
+layout (location = 0) in vec2 inPosition;
+layout (location = 1) in vec2 inTextureCoordinate;
+layout (location = 2) in vec4 inColor;
+
+out vec2 fragmentTextureCoordinate;
+out vec4 fragmentColor;
+
+uniform vec2 viewportSize;
+
+void main()
+{
+	vec2 clipPosition = (inPosition / viewportSize) * 2.0f - 1.0f;
+	gl_Position = vec4(clipPosition.x, -clipPosition.y, 0.0f, 1.0f);
+
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentColor = inColor;
+}
@@ -0,0 +1,6 @@
+#version 460 core
+
+// only depth is written, by the shadow maps and the depth pre-pass
+void main()
+{
+}
@@ -0,0 +1,43 @@
+#version 440 core
+
+// window coordinates from 0 to 1
+in vec2 fragmentTextureCoordinate;
+
+out vec4 outFragmentColor;
+
+uniform sampler2D sourceTexture;
+// part of the texture the scene was rendered into
+uniform vec2 sourceScale;
+// size of one rendered pixel in texture coordinates
+uniform vec2 sourceTexelSize;
+// 0 filters only, 1 sharpens the most
+uniform float sharpness = 0.0f;
+
+// read the rendered part only, staying half a pixel inside it
+vec3 Fetch(vec2 uv)
+{
+	vec2 lastTexel = sourceScale - 0.5f * sourceTexelSize;
+	return texture(sourceTexture, clamp(uv, 0.5f * sourceTexelSize, lastTexel)).rgb;
+}
+
+void main()
+{
+	vec2 uv = fragmentTextureCoordinate * sourceScale;
+	vec3 center = Fetch(uv);
+	vec3 north = Fetch(uv + vec2(0.0f, sourceTexelSize.y));
+	vec3 south = Fetch(uv - vec2(0.0f, sourceTexelSize.y));
+	vec3 east = Fetch(uv + vec2(sourceTexelSize.x, 0.0f));
+	vec3 west = Fetch(uv - vec2(sourceTexelSize.x, 0.0f));
+
+	// contrast adaptive sharpening: the closer the neighborhood
+	// is to black or white, the less it is sharpened, and the
+	// result never leaves its range, so edges do not ring
+	vec3 minColor = min(center, min(min(north, south), min(east, west)));
+	vec3 maxColor = max(center, max(max(north, south), max(east, west)));
+	vec3 headroom = min(minColor, 1.0f - maxColor) / max(maxColor, vec3(0.0001f));
+	vec3 amount = sqrt(clamp(headroom, 0.0f, 1.0f)) * sharpness;
+
+	vec3 detail = 4.0f * center - (north + south + east + west);
+	vec3 color = clamp(center + 0.25f * amount * detail, minColor, maxColor);
+	outFragmentColor = vec4(color, 1.0f);
+}
@@ -0,0 +1,11 @@
+#version 440 core
+
+// one triangle covering the window, made from the vertex index
+out vec2 fragmentTextureCoordinate;
+
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	fragmentTextureCoordinate = corner;
+	gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,76 @@
+#version 460 core
+
+// per-vertex attributes; packed meshes give the normal as two
+// octahedral coordinates
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+
+// per-draw record, must match DrawDataBuffer::DRAW_DATA
+struct DrawData
+{
+	mat4 model;
+	vec4 objectColor;
+	vec4 ambientColor;		// w = ambient strength
+	vec4 diffuseColor;		// w = shininess
+	vec4 specularColor;
+	vec2 UVscale;
+	float textureLayer;
+	uint flags;
+};
+
+layout (std430, binding = 1) readonly buffer DrawDataBuffer
+{
+	DrawData draws[];
+};
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out int fragmentDrawIndex;
+out float fragmentViewDepth;
+
+// the depth pre-pass must produce the very same depth
+invariant gl_Position;
+
+// camera of the frame, shared by every pass
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseProjection;
+	vec4 cameraPosition;
+	vec4 frustumPlanes[6];
+	vec4 viewport;			// width, height, near, far
+};
+
+uniform bool bPackedNormals = false;
+
+// unfold an octahedral encoded normal back onto the sphere
+vec3 DecodeOctahedral(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0f);
+	normal.x += (normal.x >= 0.0f) ? -fold : fold;
+	normal.y += (normal.y >= 0.0f) ? -fold : fold;
+	return normalize(normal);
+}
+
+void main()
+{
+	// each instance of a draw reads its own record
+	int drawIndex = gl_BaseInstance + gl_InstanceID;
+	mat4 objectModel = draws[drawIndex].model;
+
+	// transform the vertex into world space and then clip space
+	vec4 worldPosition = objectModel * vec4(inVertexPosition, 1.0f);
+	gl_Position = viewProjection * worldPosition;
+
+	fragmentPosition = vec3(worldPosition);
+	vec3 normal = bPackedNormals ? DecodeOctahedral(inVertexNormal.xy) : inVertexNormal;
+	fragmentVertexNormal = mat3(transpose(inverse(objectModel))) * normal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentDrawIndex = drawIndex;
+	fragmentViewDepth = -(view * worldPosition).z;
+}
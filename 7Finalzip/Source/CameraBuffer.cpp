@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerabuffer.cpp
+// ============
+// uniform buffer holding the camera of the current frame, shared by
+// every pass
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraBuffer.h"
+
+/***********************************************************
+ *  CameraBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraBuffer::CameraBuffer()
+{
+	m_buffer = 0;
+}
+
+/***********************************************************
+ *  ~CameraBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+CameraBuffer::~CameraBuffer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  Replace the contents of the buffer. The buffer stays
+ *  bound to its binding point, since no other code uses it.
+ ***********************************************************/
+void CameraBuffer::Upload(const CAMERA_DATA& camera)
+{
+	if (0 == m_buffer)
+	{
+		glGenBuffers(1, &m_buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(CAMERA_DATA), &camera, GL_DYNAMIC_DRAW);
+	}
+	else
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CAMERA_DATA), &camera);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, m_buffer);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  Free the buffer
+ ***********************************************************/
+void CameraBuffer::Destroy()
+{
+	if (0 != m_buffer)
+	{
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+}
@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerabuffer.h
+// ============
+// uniform buffer holding the camera of the current frame, shared by
+// every pass
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  CameraBuffer
+ *
+ *  This class holds the CAMERA_DATA of a frame in a uniform
+ *  buffer bound to BINDING, laid out to match the std140
+ *  CameraBlock of the shaders. The scene, depth, cluster and
+ *  culling shaders all read the camera from it, so it is
+ *  uploaded once when the camera changes instead of being
+ *  set into every program.
+ ***********************************************************/
+class CameraBuffer
+{
+public:
+	// constructor
+	CameraBuffer();
+	// destructor
+	~CameraBuffer();
+
+	// uniform buffer binding point of the CameraBlock
+	static const GLuint BINDING = 0;
+
+	// std140 layout, 384 bytes
+	struct CAMERA_DATA
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::mat4 viewProjection;
+		glm::mat4 inverseProjection;
+		// world position of the camera in xyz
+		glm::vec4 position;
+		// frustum planes as in FrustumCuller, with the normals
+		// pointing inwards
+		glm::vec4 frustumPlanes[6];
+		// viewport width and height, near and far distance
+		glm::vec4 viewport;
+	};
+
+	// upload the camera, creating the buffer the first time,
+	// and bind it
+	void Upload(const CAMERA_DATA& camera);
+	// free the buffer
+	void Destroy();
+
+private:
+	GLuint m_buffer;
+};
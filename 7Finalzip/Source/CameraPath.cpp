@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ============
+// smooth camera paths through recorded keyframes, for repeatable
+// fly-throughs of the scene
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+// declaration of global variables
+namespace
+{
+	// uniform Catmull-Rom interpolation between p1 and p2
+	glm::vec3 CatmullRom(const glm::vec3& p0, const glm::vec3& p1,
+		const glm::vec3& p2, const glm::vec3& p3, float t)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return 0.5f * ((2.0f * p1) +
+			(p2 - p0) * t +
+			(2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+			(3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+	}
+}
+
+/***********************************************************
+ *  AddKeyframe()
+ *
+ *  Append a keyframe to the path
+ ***********************************************************/
+void CameraPath::AddKeyframe(const glm::vec3& position, const glm::vec3& target)
+{
+	CAMERA_KEYFRAME keyframe;
+	keyframe.position = position;
+	keyframe.target = target;
+	m_keyframes.push_back(keyframe);
+}
+
+/***********************************************************
+ *  LoadFromFile()
+ *
+ *  Replace the keyframes with those read from a path file
+ ***********************************************************/
+bool CameraPath::LoadFromFile(const std::string& path)
+{
+	std::ifstream file(path.c_str());
+	if (!file)
+		return false;
+
+	std::vector<CAMERA_KEYFRAME> keyframes;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || ('#' == line[0]))
+			continue;
+
+		std::istringstream values(line);
+		CAMERA_KEYFRAME keyframe;
+		if (values >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+			>> keyframe.target.x >> keyframe.target.y >> keyframe.target.z)
+		{
+			keyframes.push_back(keyframe);
+		}
+	}
+
+	if (keyframes.empty())
+		return false;
+
+	m_keyframes.swap(keyframes);
+	return true;
+}
+
+/***********************************************************
+ *  SaveToFile()
+ *
+ *  Write the keyframes in the path file format
+ ***********************************************************/
+bool CameraPath::SaveToFile(const std::string& path) const
+{
+	std::ofstream file(path.c_str());
+	if (!file)
+		return false;
+
+	file << "# positionX positionY positionZ targetX targetY targetZ\n";
+	for (size_t i = 0; i < m_keyframes.size(); i++)
+	{
+		const CAMERA_KEYFRAME& keyframe = m_keyframes[i];
+		file << keyframe.position.x << " " << keyframe.position.y << " " << keyframe.position.z << " "
+			<< keyframe.target.x << " " << keyframe.target.y << " " << keyframe.target.z << "\n";
+	}
+	return file.good();
+}
+
+/***********************************************************
+ *  CreateDefaultPath()
+ *
+ *  Circle the scene at changing heights, looking at its
+ *  center, and end where the loop started
+ ***********************************************************/
+void CameraPath::CreateDefaultPath()
+{
+	m_keyframes.clear();
+
+	const int steps = 8;
+	const glm::vec3 center(0.0f, 1.0f, 3.0f);
+	for (int i = 0; i <= steps; i++)
+	{
+		float angle = (float)i / steps * 6.2831853f;
+		float radius = (0 == (i % 2)) ? 12.0f : 8.0f;
+		glm::vec3 position(
+			center.x + radius * std::sin(angle),
+			(0 == (i % 2)) ? 4.0f : 2.0f,
+			center.z + radius * std::cos(angle));
+		AddKeyframe(position, center);
+	}
+}
+
+/***********************************************************
+ *  Evaluate()
+ *
+ *  Get the camera position and view direction at a point
+ *  along the path, from 0 (first keyframe) to 1 (last)
+ ***********************************************************/
+bool CameraPath::Evaluate(float t, glm::vec3& position, glm::vec3& front) const
+{
+	if (m_keyframes.empty())
+		return false;
+
+	int last = (int)m_keyframes.size() - 1;
+	float segmentPosition = std::min(std::max(t, 0.0f), 1.0f) * last;
+	int segment = std::min((int)segmentPosition, std::max(last - 1, 0));
+	float local = segmentPosition - segment;
+
+	// the end points are repeated so the spline reaches them
+	const CAMERA_KEYFRAME& k0 = m_keyframes[std::max(segment - 1, 0)];
+	const CAMERA_KEYFRAME& k1 = m_keyframes[segment];
+	const CAMERA_KEYFRAME& k2 = m_keyframes[std::min(segment + 1, last)];
+	const CAMERA_KEYFRAME& k3 = m_keyframes[std::min(segment + 2, last)];
+
+	position = CatmullRom(k0.position, k1.position, k2.position, k3.position, local);
+	glm::vec3 target = CatmullRom(k0.target, k1.target, k2.target, k3.target, local);
+
+	glm::vec3 direction = target - position;
+	float length = glm::length(direction);
+	front = (length > 1e-5f) ? direction / length : glm::vec3(0.0f, 0.0f, -1.0f);
+	return true;
+}
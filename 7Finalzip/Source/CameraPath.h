@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ============
+// smooth camera paths through recorded keyframes, for repeatable
+// fly-throughs of the scene
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  CameraPath
+ *
+ *  This class holds camera keyframes, each a position and a
+ *  point looked at, and evaluates a Catmull-Rom spline
+ *  through them. The path runs from the first to the last
+ *  keyframe as t goes from 0 to 1, spending the same time
+ *  between each pair of keyframes.
+ *
+ *  Path files hold one keyframe per line:
+ *    positionX positionY positionZ targetX targetY targetZ
+ *  Lines starting with '#' are comments.
+ ***********************************************************/
+class CameraPath
+{
+public:
+	struct CAMERA_KEYFRAME
+	{
+		glm::vec3 position;
+		glm::vec3 target;
+	};
+
+	// add a keyframe at the end of the path
+	void AddKeyframe(const glm::vec3& position, const glm::vec3& target);
+	// remove all keyframes
+	void Clear() { m_keyframes.clear(); }
+	size_t GetKeyframeCount() const { return m_keyframes.size(); }
+
+	// read and write keyframes in the path file format
+	bool LoadFromFile(const std::string& path);
+	bool SaveToFile(const std::string& path) const;
+	// replace the keyframes with a loop around the default scene
+	void CreateDefaultPath();
+
+	// get the camera position and unit view direction at t
+	bool Evaluate(float t, glm::vec3& position, glm::vec3& front) const;
+
+private:
+	std::vector<CAMERA_KEYFRAME> m_keyframes;
+};
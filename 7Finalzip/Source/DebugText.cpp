@@ -0,0 +1,368 @@
+///////////////////////////////////////////////////////////////////////////////
+// debugtext.cpp
+// ============
+// draw simple screen-space text and boxes with a built-in bitmap font,
+// for debug overlays
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DebugText.h"
+
+#include <cctype>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// each glyph is 5x7 pixels in a 6x8 cell, scaled up on screen
+	const int g_CellWidth = 6;
+	const int g_CellHeight = 8;
+	const float g_PixelScale = 2.0f;
+	const int g_FloatsPerVertex = 8;
+
+	struct FONT_GLYPH
+	{
+		char character;
+		// one row per byte, bit 4 is the leftmost pixel
+		unsigned char rows[7];
+	};
+
+	const FONT_GLYPH g_FontGlyphs[] =
+	{
+		{ '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+		{ '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+		{ '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+		{ '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+		{ '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+		{ '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+		{ '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+		{ '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+		{ '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+		{ '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+		{ 'A', { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+		{ 'B', { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E } },
+		{ 'C', { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E } },
+		{ 'D', { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C } },
+		{ 'E', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F } },
+		{ 'F', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 } },
+		{ 'G', { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F } },
+		{ 'H', { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+		{ 'I', { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+		{ 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C } },
+		{ 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+		{ 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F } },
+		{ 'M', { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+		{ 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+		{ 'O', { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+		{ 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+		{ 'Q', { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D } },
+		{ 'R', { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 } },
+		{ 'S', { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E } },
+		{ 'T', { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+		{ 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+		{ 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 } },
+		{ 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A } },
+		{ 'X', { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 } },
+		{ 'Y', { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 } },
+		{ 'Z', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F } },
+		{ '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+		{ ',', { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 } },
+		{ ':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+		{ '%', { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 } },
+		{ '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } },
+		{ '-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+		{ '+', { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 } },
+		{ '=', { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 } },
+		{ '_', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F } },
+		{ '(', { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 } },
+		{ ')', { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 } },
+		{ '[', { 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E } },
+		{ ']', { 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E } },
+		{ '?', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 } },
+	};
+}
+
+/***********************************************************
+ *  DebugText()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DebugText::DebugText()
+{
+	m_pLibrary = NULL;
+	m_variant = -1;
+	m_programID = 0;
+	m_viewportSizeLocation = -1;
+	m_fontTextureLocation = -1;
+	m_fontTexture = 0;
+	m_vao = 0;
+	m_vbo = 0;
+	m_glyphCount = 0;
+	for (int i = 0; i < 128; i++)
+	{
+		m_glyphIndex[i] = -1;
+	}
+}
+
+/***********************************************************
+ *  ~DebugText()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DebugText::~DebugText()
+{
+	if (0 != m_vbo)
+		glDeleteBuffers(1, &m_vbo);
+	if (0 != m_vao)
+		glDeleteVertexArrays(1, &m_vao);
+	if (0 != m_fontTexture)
+		glDeleteTextures(1, &m_fontTexture);
+	m_pLibrary = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  Start building the overlay shader program, pack the font
+ *  glyphs into a one row texture and create the vertex
+ *  buffer
+ ***********************************************************/
+bool DebugText::Initialize(ShaderLibrary* pLibrary)
+{
+	if (NULL != m_pLibrary)
+		return true;
+
+	// the overlay is off at first, so its program is left to
+	// build in the background
+	m_pLibrary = pLibrary;
+	m_variant = m_pLibrary->AddVariant(
+		"Shaders/overlayVertexShader.glsl",
+		"Shaders/overlayFragmentShader.glsl");
+	m_pLibrary->Request(m_variant);
+
+	// glyph columns follow the table, with one solid cell at the
+	// end used for filled boxes
+	const int tableSize = (int)(sizeof(g_FontGlyphs) / sizeof(g_FontGlyphs[0]));
+	m_glyphCount = tableSize + 1;
+	int atlasWidth = m_glyphCount * g_CellWidth;
+	std::vector<unsigned char> atlas((size_t)atlasWidth * g_CellHeight, 0);
+
+	for (int glyph = 0; glyph < tableSize; glyph++)
+	{
+		const FONT_GLYPH& font = g_FontGlyphs[glyph];
+		m_glyphIndex[(unsigned char)font.character] = glyph;
+		for (int row = 0; row < 7; row++)
+		{
+			for (int column = 0; column < 5; column++)
+			{
+				if (font.rows[row] & (0x10 >> column))
+					atlas[(size_t)row * atlasWidth + glyph * g_CellWidth + column] = 255;
+			}
+		}
+	}
+	for (int row = 0; row < g_CellHeight; row++)
+	{
+		memset(&atlas[(size_t)row * atlasWidth + tableSize * g_CellWidth], 255, g_CellWidth);
+	}
+
+	// the texture is stored top row first, which the vertex
+	// texture coordinates account for
+	glGenTextures(1, &m_fontTexture);
+	glBindTexture(GL_TEXTURE_2D, m_fontTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, g_CellHeight, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// vertex layout: position (2), texture coordinate (2), color (4)
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vbo);
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	GLsizei stride = g_FloatsPerVertex * sizeof(float);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  Remove all queued text and boxes
+ ***********************************************************/
+void DebugText::Clear()
+{
+	m_vertices.clear();
+}
+
+/***********************************************************
+ *  GetCharAdvance()
+ *
+ *  Get the advance of one character in window pixels
+ ***********************************************************/
+float DebugText::GetCharAdvance() const
+{
+	return g_CellWidth * g_PixelScale;
+}
+
+/***********************************************************
+ *  GetLineHeight()
+ *
+ *  Get the height of one line of text in window pixels
+ ***********************************************************/
+float DebugText::GetLineHeight() const
+{
+	return (g_CellHeight + 2) * g_PixelScale;
+}
+
+/***********************************************************
+ *  AddQuad()
+ *
+ *  Append two triangles covering a rectangle, sampling one
+ *  horizontal range of the font atlas
+ ***********************************************************/
+void DebugText::AddQuad(float x, float y, float width, float height,
+	float u0, float u1, const glm::vec4& color)
+{
+	const float corners[6][4] =
+	{
+		{ x, y, u0, 0.0f },
+		{ x + width, y, u1, 0.0f },
+		{ x + width, y + height, u1, 1.0f },
+		{ x, y, u0, 0.0f },
+		{ x + width, y + height, u1, 1.0f },
+		{ x, y + height, u0, 1.0f }
+	};
+
+	for (int i = 0; i < 6; i++)
+	{
+		m_vertices.push_back(corners[i][0]);
+		m_vertices.push_back(corners[i][1]);
+		m_vertices.push_back(corners[i][2]);
+		m_vertices.push_back(corners[i][3]);
+		m_vertices.push_back(color.x);
+		m_vertices.push_back(color.y);
+		m_vertices.push_back(color.z);
+		m_vertices.push_back(color.w);
+	}
+}
+
+/***********************************************************
+ *  AddText()
+ *
+ *  Queue one line of text, with its top left corner at the
+ *  given window position
+ ***********************************************************/
+void DebugText::AddText(float x, float y, const char* text, const glm::vec4& color)
+{
+	if (0 == m_glyphCount)
+		return;
+
+	float cellWidth = g_CellWidth * g_PixelScale;
+	float cellHeight = g_CellHeight * g_PixelScale;
+	float atlasWidth = (float)(m_glyphCount * g_CellWidth);
+
+	for (size_t i = 0; '\0' != text[i]; i++)
+	{
+		unsigned char character = (unsigned char)toupper((unsigned char)text[i]);
+		if ((character < 128) && (' ' != character))
+		{
+			int glyph = m_glyphIndex[character];
+			if (glyph < 0)
+				glyph = m_glyphIndex['?'];
+
+			float u0 = (glyph * g_CellWidth) / atlasWidth;
+			float u1 = ((glyph + 1) * g_CellWidth) / atlasWidth;
+			AddQuad(x, y, cellWidth, cellHeight, u0, u1, color);
+		}
+		x += cellWidth;
+	}
+}
+
+/***********************************************************
+ *  AddBox()
+ *
+ *  Queue a filled box, drawn with the solid font cell
+ ***********************************************************/
+void DebugText::AddBox(float x, float y, float width, float height, const glm::vec4& color)
+{
+	if (0 == m_glyphCount)
+		return;
+
+	// sample the middle of the solid cell only
+	float atlasWidth = (float)(m_glyphCount * g_CellWidth);
+	float u = ((m_glyphCount - 1) * g_CellWidth + g_CellWidth * 0.5f) / atlasWidth;
+	AddQuad(x, y, width, height, u, u, color);
+}
+
+/***********************************************************
+ *  ResolveProgram()
+ *
+ *  Look up the uniforms of the program the first time the
+ *  library has it
+ ***********************************************************/
+void DebugText::ResolveProgram()
+{
+	if ((0 != m_programID) || (NULL == m_pLibrary))
+		return;
+
+	m_programID = m_pLibrary->GetProgram(m_variant);
+	if (0 == m_programID)
+		return;
+
+	m_viewportSizeLocation = glGetUniformLocation(m_programID, "viewportSize");
+	m_fontTextureLocation = glGetUniformLocation(m_programID, "fontTexture");
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  Draw all queued quads with blending and no depth test,
+ *  then restore the state the scene rendering relies on
+ ***********************************************************/
+void DebugText::Draw(int viewportWidth, int viewportHeight)
+{
+	ResolveProgram();
+	if ((0 == m_programID) || m_vertices.empty())
+		return;
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLboolean bDepthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean bBlend = glIsEnabled(GL_BLEND);
+
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glUseProgram(m_programID);
+	glUniform2f(m_viewportSizeLocation, (float)viewportWidth, (float)viewportHeight);
+	glUniform1i(m_fontTextureLocation, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_fontTexture);
+
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(float), m_vertices.data(), GL_STREAM_DRAW);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(m_vertices.size() / g_FloatsPerVertex));
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram((GLuint)previousProgram);
+	if (bDepthTest)
+		glEnable(GL_DEPTH_TEST);
+	if (!bBlend)
+		glDisable(GL_BLEND);
+}
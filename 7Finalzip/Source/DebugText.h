@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// debugtext.h
+// ============
+// draw simple screen-space text and boxes with a built-in bitmap font,
+// for debug overlays
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderLibrary.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  DebugText
+ *
+ *  This class collects text and boxes in window pixels, with
+ *  the origin at the top left, and draws them all in one call
+ *  on top of the frame. The font is a 5x7 pixel bitmap font
+ *  covering digits, upper case letters and some punctuation;
+ *  lower case letters are drawn in upper case. Nothing is
+ *  drawn until the library has built the overlay program.
+ ***********************************************************/
+class DebugText
+{
+public:
+	// constructor
+	DebugText();
+	// destructor
+	~DebugText();
+
+	// start building the overlay shaders of a library, and
+	// build the font texture
+	bool Initialize(ShaderLibrary* pLibrary);
+
+	// remove all queued text and boxes
+	void Clear();
+	// queue a line of text at a pixel position
+	void AddText(float x, float y, const char* text, const glm::vec4& color);
+	// queue a filled box at a pixel position
+	void AddBox(float x, float y, float width, float height, const glm::vec4& color);
+	// draw everything queued over the current frame
+	void Draw(int viewportWidth, int viewportHeight);
+
+	// size of one character cell in window pixels
+	float GetCharAdvance() const;
+	float GetLineHeight() const;
+
+private:
+	// library building the overlay variant, and its program
+	// once it is built
+	ShaderLibrary* m_pLibrary;
+	int m_variant;
+	GLuint m_programID;
+	GLint m_viewportSizeLocation;
+	GLint m_fontTextureLocation;
+	GLuint m_fontTexture;
+	GLuint m_vao;
+	GLuint m_vbo;
+	// font atlas column of each ASCII character
+	int m_glyphIndex[128];
+	int m_glyphCount;
+	// queued quads, 8 floats per vertex
+	std::vector<float> m_vertices;
+
+	// take the program from the library once it is built
+	void ResolveProgram();
+	// append one textured quad to the vertex list
+	void AddQuad(float x, float y, float width, float height,
+		float u0, float u1, const glm::vec4& color);
+};
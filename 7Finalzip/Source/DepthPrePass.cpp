@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepass.cpp
+// ============
+// lay down the depth of the opaque scene before it is shaded
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DepthPrePass.h"
+
+/***********************************************************
+ *  DepthPrePass()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DepthPrePass::DepthPrePass()
+{
+	m_programID = 0;
+	m_savedProgram = 0;
+}
+
+/***********************************************************
+ *  ~DepthPrePass()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DepthPrePass::~DepthPrePass()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  Get the depth-only shader program, the variant of the
+ *  shadow shaders without SHADOW_PASS
+ ***********************************************************/
+bool DepthPrePass::Initialize(ShaderLibrary* pLibrary)
+{
+	if (0 != m_programID)
+		return true;
+
+	m_programID = pLibrary->WaitForProgram(pLibrary->AddVariant(
+		"Shaders/depthVertexShader.glsl",
+		"Shaders/shadowFragmentShader.glsl"));
+
+	if (0 == m_programID)
+	{
+		Destroy();
+		return false;
+	}
+	return true;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  Forget the shader program, which belongs to the shader
+ *  library
+ ***********************************************************/
+void DepthPrePass::Destroy()
+{
+	m_programID = 0;
+}
+
+/***********************************************************
+ *  BeginPass()
+ *
+ *  Save the program and start writing depth only
+ ***********************************************************/
+void DepthPrePass::BeginPass()
+{
+	glGetIntegerv(GL_CURRENT_PROGRAM, &m_savedProgram);
+	glUseProgram(m_programID);
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
+
+/***********************************************************
+ *  EndPass()
+ *
+ *  Restore the program and color writes. The depth buffer
+ *  already holds the nearest surfaces, so the shading pass
+ *  only has to test for equality and never writes depth.
+ ***********************************************************/
+void DepthPrePass::EndPass()
+{
+	glUseProgram((GLuint)m_savedProgram);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc(GL_EQUAL);
+	glDepthMask(GL_FALSE);
+}
@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepass.h
+// ============
+// lay down the depth of the opaque scene before it is shaded
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderLibrary.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  DepthPrePass
+ *
+ *  This class draws with a depth-only program that transforms
+ *  the vertices exactly like vertexShader.glsl. The opaque draws
+ *  are submitted twice: once between BeginPass() and
+ *  EndPass() with color writes off, then again with the
+ *  scene program and a GL_EQUAL depth test. The expensive
+ *  fragment shader then only runs for the nearest surface of
+ *  each pixel, whatever order the draws come in.
+ *
+ *  Both vertex shaders declare gl_Position invariant, so the
+ *  two passes produce bit-identical depth.
+ ***********************************************************/
+class DepthPrePass
+{
+public:
+	// constructor
+	DepthPrePass();
+	// destructor
+	~DepthPrePass();
+
+	// get the depth-only shaders from a library
+	bool Initialize(ShaderLibrary* pLibrary);
+	// let go of the shaders
+	void Destroy();
+	bool IsReady() const { return 0 != m_programID; }
+
+	// switch to the depth-only program with color writes off,
+	// saving the current program. The camera is read from the
+	// CameraBuffer.
+	void BeginPass();
+	// restore the program and color writes, and leave the depth
+	// test at GL_EQUAL without depth writes for the shading pass
+	void EndPass();
+
+private:
+	// program owned by the shader library
+	GLuint m_programID;
+	// program saved by BeginPass()
+	GLint m_savedProgram;
+};
@@ -0,0 +1,248 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawdatabuffer.cpp
+// ============
+// per-draw shader data written into a persistently mapped, fenced
+// ring of shader storage buffer regions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DrawDataBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// records a region holds at least
+	const size_t g_MinimumCapacity = 256;
+	// maximum time spent in one wait on a fence, in nanoseconds
+	const GLuint64 g_FenceTimeout = 1000000;
+}
+
+/***********************************************************
+ *  DrawDataBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DrawDataBuffer::DrawDataBuffer()
+{
+	m_buffer = 0;
+	m_pMapped = NULL;
+	m_bPersistent = false;
+	m_capacity = 0;
+	m_regionSize = 0;
+	m_region = 0;
+	m_count = 0;
+	for (int i = 0; i < REGION_COUNT; i++)
+	{
+		m_fences[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  ~DrawDataBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DrawDataBuffer::~DrawDataBuffer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  WaitFence()
+ *
+ *  Wait until the GPU has passed a fence
+ ***********************************************************/
+void DrawDataBuffer::WaitFence(GLsync& fence)
+{
+	if (0 == fence)
+		return;
+
+	for (;;)
+	{
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, g_FenceTimeout);
+		if ((GL_ALREADY_SIGNALED == result) || (GL_CONDITION_SATISFIED == result) ||
+			(GL_WAIT_FAILED == result))
+			break;
+	}
+	glDeleteSync(fence);
+	fence = 0;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  Allocate the regions and map them for the whole lifetime
+ *  of the buffer when persistent mapping is supported
+ ***********************************************************/
+bool DrawDataBuffer::Create(size_t capacity)
+{
+	Destroy();
+
+	GLint alignment = 16;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment = std::max(alignment, 16);
+
+	m_capacity = capacity;
+	m_regionSize = capacity * sizeof(DRAW_DATA);
+	m_regionSize = (m_regionSize + alignment - 1) / alignment * alignment;
+	GLsizeiptr totalSize = (GLsizeiptr)(m_regionSize * REGION_COUNT);
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+
+	m_bPersistent = (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage);
+	if (m_bPersistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_SHADER_STORAGE_BUFFER, totalSize, NULL, flags);
+		m_pMapped = (DRAW_DATA*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, totalSize, flags);
+		if (NULL == m_pMapped)
+		{
+			std::cout << "Could not map the draw data buffer" << std::endl;
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			Destroy();
+			return false;
+		}
+	}
+	else
+	{
+		glBufferData(GL_SHADER_STORAGE_BUFFER, totalSize, NULL, GL_DYNAMIC_DRAW);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_region = 0;
+	m_count = 0;
+	return true;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  Wait for every region to be released and free the buffer
+ ***********************************************************/
+void DrawDataBuffer::Destroy()
+{
+	for (int i = 0; i < REGION_COUNT; i++)
+	{
+		WaitFence(m_fences[i]);
+	}
+
+	if (0 != m_buffer)
+	{
+		if (NULL != m_pMapped)
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+			glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &m_buffer);
+	}
+
+	m_buffer = 0;
+	m_pMapped = NULL;
+	m_capacity = 0;
+	m_regionSize = 0;
+	m_count = 0;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  Move to the next region, wait for the GPU to finish with
+ *  it, and bind it as the DrawData array of the shaders.
+ *  The buffer is recreated when a frame needs more records
+ *  than a region holds.
+ ***********************************************************/
+bool DrawDataBuffer::BeginFrame(size_t drawCount)
+{
+	if ((0 == m_buffer) || (drawCount > m_capacity))
+	{
+		size_t capacity = std::max(std::max(drawCount, m_capacity * 2), g_MinimumCapacity);
+		if (!Create(capacity))
+			return false;
+	}
+	else
+	{
+		m_region = (m_region + 1) % REGION_COUNT;
+	}
+
+	WaitFence(m_fences[m_region]);
+	m_count = 0;
+
+	Bind();
+	return true;
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  Bind the current region as the DrawData array of the
+ *  shaders
+ ***********************************************************/
+void DrawDataBuffer::Bind() const
+{
+	if (0 == m_buffer)
+		return;
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, m_buffer,
+		(GLintptr)(m_region * m_regionSize), (GLsizeiptr)m_regionSize);
+}
+
+/***********************************************************
+ *  Append()
+ *
+ *  Copy records into the current region. When they do not
+ *  fit, the buffer is recreated larger and bound in the
+ *  middle of the frame; every draw reads its records right
+ *  after appending them, so the draws before keep the old
+ *  binding and never see the records move. Records are
+ *  only dropped when the larger buffer can not be made.
+ ***********************************************************/
+uint32_t DrawDataBuffer::Append(const DRAW_DATA* records, size_t count)
+{
+	if ((0 == m_buffer) || (m_count + count > m_capacity))
+	{
+		size_t capacity = std::max(std::max(count, m_capacity * 2), g_MinimumCapacity);
+		std::cout << "Draw data region is full, growing it to " << capacity << " records" << std::endl;
+		if (!Create(capacity))
+			return 0;
+		Bind();
+	}
+
+	uint32_t first = (uint32_t)m_count;
+	if (m_bPersistent)
+	{
+		DRAW_DATA* region = (DRAW_DATA*)((uint8_t*)m_pMapped + m_region * m_regionSize);
+		memcpy(region + m_count, records, count * sizeof(DRAW_DATA));
+	}
+	else
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+			(GLintptr)(m_region * m_regionSize + m_count * sizeof(DRAW_DATA)),
+			(GLsizeiptr)(count * sizeof(DRAW_DATA)), records);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	m_count += count;
+	return first;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  Place a fence after the draws that read the region
+ ***********************************************************/
+void DrawDataBuffer::EndFrame()
+{
+	if (0 == m_buffer)
+		return;
+
+	if (0 != m_fences[m_region])
+		glDeleteSync(m_fences[m_region]);
+	m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
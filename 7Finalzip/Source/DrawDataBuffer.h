@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawdatabuffer.h
+// ============
+// per-draw shader data written into a persistently mapped, fenced
+// ring of shader storage buffer regions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  DrawDataBuffer
+ *
+ *  This class holds one DRAW_DATA record per drawn object,
+ *  laid out to match the std430 DrawData struct of the
+ *  shaders. The buffer is split into REGION_COUNT regions
+ *  used in turn, one per frame, and a fence placed after
+ *  each frame's draws keeps the CPU from overwriting a
+ *  region the GPU is still reading.
+ *
+ *  A shader finds its record at gl_BaseInstance +
+ *  gl_InstanceID, so a draw only passes its first record as
+ *  the base instance.
+ *
+ *  Without ARB_buffer_storage the records are uploaded with
+ *  glBufferSubData instead of being written in place.
+ *
+ *  A frame that appends more records than its region holds
+ *  moves to a larger buffer right away. The draws already
+ *  submitted keep reading the old one, so the records of
+ *  the frame start over at the front of the new region.
+ ***********************************************************/
+class DrawDataBuffer
+{
+public:
+	// constructor
+	DrawDataBuffer();
+	// destructor
+	~DrawDataBuffer();
+
+	// shader storage binding point of the DrawData array
+	static const GLuint BINDING = 1;
+	// number of frames that may be in flight
+	static const int REGION_COUNT = 3;
+
+	// bits of DRAW_DATA::flags
+	enum DRAW_FLAGS
+	{
+		DRAW_USE_TEXTURE = 1
+	};
+
+	// std430 layout, 144 bytes
+	struct DRAW_DATA
+	{
+		glm::mat4 model;
+		glm::vec4 objectColor;
+		// material colors, with the ambient strength in the
+		// ambient w and the shininess in the diffuse w
+		glm::vec4 ambientColor;
+		glm::vec4 diffuseColor;
+		glm::vec4 specularColor;
+		glm::vec2 uvScale;
+		float textureLayer;
+		uint32_t flags;
+	};
+
+	// start writing the records of a frame, with room for at
+	// least drawCount of them, and bind the frame's region
+	bool BeginFrame(size_t drawCount);
+	// add records to the frame and return the index of the
+	// first one, to be used as the base instance
+	uint32_t Append(const DRAW_DATA* records, size_t count);
+	// bind the frame's region, again after another buffer took
+	// its binding point
+	void Bind() const;
+	// fence the frame's region once its draws are submitted
+	void EndFrame();
+	// free the buffer, waiting for the GPU to finish with it
+	void Destroy();
+
+	size_t GetCount() const { return m_count; }
+
+private:
+	GLuint m_buffer;
+	DRAW_DATA* m_pMapped;
+	bool m_bPersistent;
+	// records per region, and bytes per region after rounding
+	// up to the storage buffer offset alignment
+	size_t m_capacity;
+	size_t m_regionSize;
+	int m_region;
+	size_t m_count;
+	GLsync m_fences[REGION_COUNT];
+
+	// create the buffer with room for capacity records a region
+	bool Create(size_t capacity);
+	// block until a fence has been passed, then delete it
+	static void WaitFence(GLsync& fence);
+};
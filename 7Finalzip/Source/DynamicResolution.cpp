@@ -0,0 +1,232 @@
+///////////////////////////////////////////////////////////////////////////////
+// dynamicresolution.cpp
+// ============
+// render the scene at a resolution that follows the GPU time, and
+// sharpen it back up to the window size
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DynamicResolution.h"
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// range of the scale of each axis, and the step it moves in
+	// so that small changes of the GPU time leave it alone
+	const float g_MinScale = 0.5f;
+	const float g_MaxScale = 1.0f;
+	const float g_ScaleStep = 0.05f;
+	// largest change of the scale in one update
+	const float g_MaxScaleDrop = 0.15f;
+	const float g_MaxScaleRise = 0.05f;
+	// part of the budget a frame must stay under to scale up
+	const float g_Headroom = 0.85f;
+	// default budget of the scene pass, which leaves room in
+	// a 60 Hz frame for the upscale and the overlay
+	const float g_DefaultTargetTime = 14.0f;
+	// sharpening at the lowest scale, none at the window size
+	const float g_MaxSharpness = 0.8f;
+}
+
+/***********************************************************
+ *  DynamicResolution()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DynamicResolution::DynamicResolution()
+{
+	m_pLibrary = NULL;
+	m_variant = -1;
+	m_programID = 0;
+	m_sourceTextureLocation = -1;
+	m_sourceScaleLocation = -1;
+	m_sourceTexelSizeLocation = -1;
+	m_sharpnessLocation = -1;
+	m_vao = 0;
+	m_bEnabled = true;
+	m_targetTime = g_DefaultTargetTime;
+	m_scale = g_MaxScale;
+	m_settleFrames = 0;
+	m_outputWidth = 0;
+	m_outputHeight = 0;
+	m_renderWidth = 0;
+	m_renderHeight = 0;
+}
+
+/***********************************************************
+ *  ~DynamicResolution()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DynamicResolution::~DynamicResolution()
+{
+	if (0 != m_vao)
+		glDeleteVertexArrays(1, &m_vao);
+	m_target.Destroy();
+	m_pLibrary = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  Start building the upscale shader program, which the
+ *  first frames do without
+ ***********************************************************/
+bool DynamicResolution::Initialize(ShaderLibrary* pLibrary)
+{
+	if (NULL != m_pLibrary)
+		return true;
+
+	m_pLibrary = pLibrary;
+	m_variant = m_pLibrary->AddVariant(
+		"Shaders/upscaleVertexShader.glsl",
+		"Shaders/upscaleFragmentShader.glsl");
+	m_pLibrary->Request(m_variant);
+
+	glGenVertexArrays(1, &m_vao);
+	return 0 != m_vao;
+}
+
+/***********************************************************
+ *  ResolveProgram()
+ *
+ *  Look up the uniforms of the program the first time the
+ *  library has it
+ ***********************************************************/
+void DynamicResolution::ResolveProgram()
+{
+	if ((0 != m_programID) || (NULL == m_pLibrary))
+		return;
+
+	m_programID = m_pLibrary->GetProgram(m_variant);
+	if (0 == m_programID)
+		return;
+
+	m_sourceTextureLocation = glGetUniformLocation(m_programID, "sourceTexture");
+	m_sourceScaleLocation = glGetUniformLocation(m_programID, "sourceScale");
+	m_sourceTexelSizeLocation = glGetUniformLocation(m_programID, "sourceTexelSize");
+	m_sharpnessLocation = glGetUniformLocation(m_programID, "sharpness");
+}
+
+/***********************************************************
+ *  SetEnabled()
+ *
+ *  Turn the scaling on or off, starting again from the full
+ *  resolution either way
+ ***********************************************************/
+void DynamicResolution::SetEnabled(bool bEnable)
+{
+	m_bEnabled = bEnable;
+	m_scale = g_MaxScale;
+	m_settleFrames = FrameProfiler::GPU_LATENCY;
+	if (!m_bEnabled)
+		m_target.Destroy();
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  Move the scale towards the one that meets the budget
+ ***********************************************************/
+void DynamicResolution::Update(float gpuMilliseconds)
+{
+	ResolveProgram();
+	if (!IsEnabled() || (gpuMilliseconds <= 0.0f))
+		return;
+
+	// the measurement is of a frame drawn at the old scale
+	if (m_settleFrames > 0)
+	{
+		m_settleFrames--;
+		return;
+	}
+
+	float scale = m_scale;
+	float fitting = m_scale * std::sqrt(m_targetTime / gpuMilliseconds);
+	if (gpuMilliseconds > m_targetTime)
+		scale = std::max(fitting, m_scale - g_MaxScaleDrop);
+	else if (gpuMilliseconds < m_targetTime * g_Headroom)
+		scale = std::min(fitting, m_scale + g_MaxScaleRise);
+
+	// going down rounds down, so one step is enough to get
+	// under the budget
+	scale = (scale < m_scale) ?
+		std::floor(scale / g_ScaleStep) * g_ScaleStep :
+		std::floor(scale / g_ScaleStep + 0.5f) * g_ScaleStep;
+	scale = std::min(std::max(scale, g_MinScale), g_MaxScale);
+
+	if (std::abs(scale - m_scale) < 0.5f * g_ScaleStep)
+		return;
+
+	m_scale = scale;
+	m_settleFrames = FrameProfiler::GPU_LATENCY;
+}
+
+/***********************************************************
+ *  BeginScene()
+ *
+ *  Keep the target at the window size and set the viewport
+ *  to the scaled part of it
+ ***********************************************************/
+bool DynamicResolution::BeginScene(int outputWidth, int outputHeight)
+{
+	m_outputWidth = outputWidth;
+	m_outputHeight = outputHeight;
+	m_renderWidth = outputWidth;
+	m_renderHeight = outputHeight;
+	if (!IsEnabled() || (outputWidth <= 0) || (outputHeight <= 0))
+		return false;
+
+	if ((m_target.GetWidth() != outputWidth) || (m_target.GetHeight() != outputHeight))
+	{
+		if (!m_target.Create(outputWidth, outputHeight))
+			return false;
+	}
+
+	m_renderWidth = std::max((int)(outputWidth * m_scale + 0.5f), 1);
+	m_renderHeight = std::max((int)(outputHeight * m_scale + 0.5f), 1);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_target.GetFramebuffer());
+	glViewport(0, 0, m_renderWidth, m_renderHeight);
+	return true;
+}
+
+/***********************************************************
+ *  Present()
+ *
+ *  Draw one triangle over the window that samples the
+ *  rendered part of the target
+ ***********************************************************/
+void DynamicResolution::Present()
+{
+	RenderTarget::Unbind(m_outputWidth, m_outputHeight);
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(m_programID);
+
+	float sharpness = g_MaxSharpness * (g_MaxScale - m_scale) / (g_MaxScale - g_MinScale);
+	glUniform1i(m_sourceTextureLocation, 0);
+	glUniform2f(m_sourceScaleLocation,
+		(float)m_renderWidth / (float)m_outputWidth,
+		(float)m_renderHeight / (float)m_outputHeight);
+	glUniform2f(m_sourceTexelSizeLocation, 1.0f / (float)m_outputWidth, 1.0f / (float)m_outputHeight);
+	glUniform1f(m_sharpnessLocation, sharpness);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_target.GetColorTexture());
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	glBindVertexArray(m_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	glEnable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram((GLuint)previousProgram);
+}
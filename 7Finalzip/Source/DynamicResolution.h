@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////
+// dynamicresolution.h
+// ============
+// render the scene at a resolution that follows the GPU time, and
+// sharpen it back up to the window size
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderTarget.h"
+#include "ShaderLibrary.h"
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  DynamicResolution
+ *
+ *  This class renders the scene into the lower left part of
+ *  an offscreen target of the window size, and scales that
+ *  part up into the window with a contrast adaptive sharpen.
+ *  The target is only reallocated when the window resizes;
+ *  a new scale only changes the viewport.
+ *
+ *  Update() is given the GPU time of the scene pass. As that
+ *  time grows with the pixel count, the scale that meets the
+ *  time budget is the current one times the square root of
+ *  budget over time. The scale drops quickly when the frame
+ *  runs over and climbs back slowly when it has headroom,
+ *  and after each change the measurements that still belong
+ *  to the old scale are skipped.
+ *
+ *  The upscale program is built in the background, and the
+ *  scene renders at the window size until it is there.
+ ***********************************************************/
+class DynamicResolution
+{
+public:
+	// constructor
+	DynamicResolution();
+	// destructor
+	~DynamicResolution();
+
+	// start building the upscale shaders of a library
+	bool Initialize(ShaderLibrary* pLibrary);
+
+	// render at the window size again when turned off
+	void SetEnabled(bool bEnable);
+	bool IsEnabled() const { return m_bEnabled && (0 != m_programID); }
+	// GPU time in milliseconds that the scene pass is kept under
+	void SetTargetTime(float milliseconds) { m_targetTime = milliseconds; }
+
+	// pick the scale of the next frame from the latest GPU time
+	// of the scene pass, negative while there is none
+	void Update(float gpuMilliseconds);
+	// direct the scene into the target at the scale of the
+	// window size, returning false to render into the window
+	bool BeginScene(int outputWidth, int outputHeight);
+	// scale the rendered part into the default framebuffer
+	void Present();
+
+	float GetScale() const { return m_scale; }
+	int GetRenderWidth() const { return m_renderWidth; }
+	int GetRenderHeight() const { return m_renderHeight; }
+
+private:
+	// library building the upscale variant, and its program
+	// once it is built
+	ShaderLibrary* m_pLibrary;
+	int m_variant;
+	GLuint m_programID;
+	GLint m_sourceTextureLocation;
+	GLint m_sourceScaleLocation;
+	GLint m_sourceTexelSizeLocation;
+	GLint m_sharpnessLocation;
+	// the full screen triangle needs no vertex data, but core
+	// profiles need a vertex array to draw
+	GLuint m_vao;
+	RenderTarget m_target;
+
+	bool m_bEnabled;
+	float m_targetTime;
+	float m_scale;
+	// measurements left to skip after the scale changed
+	int m_settleFrames;
+	int m_outputWidth;
+	int m_outputHeight;
+	int m_renderWidth;
+	int m_renderHeight;
+
+	// take the program from the library once it is built
+	void ResolveProgram();
+
+	// a dynamic resolution can not be copied
+	DynamicResolution(const DynamicResolution&);
+	DynamicResolution& operator=(const DynamicResolution&);
+};
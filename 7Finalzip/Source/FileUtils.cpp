@@ -0,0 +1,231 @@
+///////////////////////////////////////////////////////////////////////////////
+// fileutils.cpp
+// ============
+// small file system helpers and read-only memory mapped files
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileUtils.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/***********************************************************
+ *  GetFileStamp()
+ *
+ *  Get the modification time and size of a file
+ ***********************************************************/
+bool FileUtils::GetFileStamp(const std::string& path, uint64_t& modified, uint64_t& size)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (0 != _stat64(path.c_str(), &info))
+		return false;
+#else
+	struct stat info;
+	if (0 != stat(path.c_str(), &info))
+		return false;
+#endif
+	modified = (uint64_t)info.st_mtime;
+	size = (uint64_t)info.st_size;
+	return true;
+}
+
+/***********************************************************
+ *  MakeDirectory()
+ *
+ *  Create a directory if it does not exist yet
+ ***********************************************************/
+bool FileUtils::MakeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	if (0 == _mkdir(path.c_str()))
+		return true;
+#else
+	if (0 == mkdir(path.c_str(), 0755))
+		return true;
+#endif
+	uint64_t modified = 0;
+	uint64_t size = 0;
+	return GetFileStamp(path, modified, size);
+}
+
+/***********************************************************
+ *  GetFileName()
+ *
+ *  Strip the directories from a path
+ ***********************************************************/
+std::string FileUtils::GetFileName(const std::string& path)
+{
+	size_t separator = path.find_last_of("/\\");
+	if (separator == std::string::npos)
+		return path;
+	return path.substr(separator + 1);
+}
+
+/***********************************************************
+ *  ReadTextFile()
+ *
+ *  Read the whole contents of a text file
+ ***********************************************************/
+bool FileUtils::ReadTextFile(const std::string& path, std::string& text)
+{
+	std::ifstream file(path.c_str());
+	if (!file)
+		return false;
+
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	text = contents.str();
+	return true;
+}
+
+/***********************************************************
+ *  Hash64()
+ *
+ *  FNV-1a hash of a block of memory, chainable through seed
+ ***********************************************************/
+uint64_t FileUtils::Hash64(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/***********************************************************
+ *  MappedFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MappedFile::MappedFile()
+{
+	m_pData = NULL;
+	m_size = 0;
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#endif
+}
+
+/***********************************************************
+ *  ~MappedFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  Map the whole file into memory for reading
+ ***********************************************************/
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || (0 == fileSize.QuadPart))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (NULL == mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (NULL == view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_hFile = file;
+	m_hMapping = mapping;
+	m_pData = (const uint8_t*)view;
+	m_size = (size_t)fileSize.QuadPart;
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info;
+	if ((0 != fstat(file, &info)) || (0 == info.st_size))
+	{
+		close(file);
+		return false;
+	}
+
+	void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	// the mapping stays valid after the descriptor is closed
+	close(file);
+	if (view == MAP_FAILED)
+		return false;
+
+	m_pData = (const uint8_t*)view;
+	m_size = (size_t)info.st_size;
+#endif
+
+	return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  Unmap the file
+ ***********************************************************/
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (NULL != m_pData)
+		UnmapViewOfFile(m_pData);
+	if (NULL != m_hMapping)
+		CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+	m_hMapping = NULL;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (NULL != m_pData)
+		munmap((void*)m_pData, m_size);
+#endif
+	m_pData = NULL;
+	m_size = 0;
+}
@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+// fileutils.h
+// ============
+// small file system helpers and read-only memory mapped files
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace FileUtils
+{
+	// get the modification time and size of a file, returning
+	// false when the file does not exist
+	bool GetFileStamp(const std::string& path, uint64_t& modified, uint64_t& size);
+	// create a directory, succeeding when it already exists
+	bool MakeDirectory(const std::string& path);
+	// get the file name part of a path
+	std::string GetFileName(const std::string& path);
+	// read a whole text file into a string
+	bool ReadTextFile(const std::string& path, std::string& text);
+	// FNV-1a hash of a block of memory
+	uint64_t Hash64(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+}
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class maps a whole file into memory for reading, so
+ *  that its contents can be used in place without parsing
+ *  or copying.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// map a file into memory, closing any mapped file first
+	bool Open(const std::string& path);
+	// unmap the file
+	void Close();
+
+	// access the mapped contents
+	const uint8_t* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+	bool IsOpen() const { return NULL != m_pData; }
+
+private:
+	const uint8_t* m_pData;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#endif
+
+	// a mapping can not be copied
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
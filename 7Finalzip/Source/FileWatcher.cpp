@@ -0,0 +1,157 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.cpp
+// ============
+// notice changes to asset files from a background thread, so that they
+// can be reloaded without restarting
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileWatcher.h"
+#include "FileUtils.h"
+
+#include <algorithm>
+#include <chrono>
+
+/***********************************************************
+ *  FileWatcher()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FileWatcher::FileWatcher()
+{
+	m_interval = 250;
+	m_bStopping = false;
+}
+
+/***********************************************************
+ *  ~FileWatcher()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  Start the thread that checks the watched files
+ ***********************************************************/
+void FileWatcher::Start(unsigned int intervalMilliseconds)
+{
+	if (m_thread.joinable())
+		return;
+
+	m_interval = std::max(intervalMilliseconds, 10u);
+	m_bStopping = false;
+	m_thread = std::thread(&FileWatcher::WatchThread, this);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  Stop the watching thread, keeping the list of files
+ ***********************************************************/
+void FileWatcher::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_wake.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+/***********************************************************
+ *  Watch()
+ *
+ *  Add a file to the watched list. Its stamp is read now, so
+ *  that only later changes are reported.
+ ***********************************************************/
+void FileWatcher::Watch(const std::string& path)
+{
+	WATCHED_FILE file;
+	file.path = path;
+	file.modified = 0;
+	file.size = 0;
+	file.bPending = false;
+	FileUtils::GetFileStamp(path, file.modified, file.size);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_files.size(); i++)
+	{
+		if (m_files[i].path == path)
+			return;
+	}
+	m_files.push_back(file);
+}
+
+/***********************************************************
+ *  PollChanges()
+ *
+ *  Hand the files that changed and settled to the caller
+ ***********************************************************/
+void FileWatcher::PollChanges(std::vector<std::string>& paths)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	paths.insert(paths.end(), m_changed.begin(), m_changed.end());
+	m_changed.clear();
+}
+
+/***********************************************************
+ *  WatchThread()
+ *
+ *  Compare the stamps of the watched files every interval.
+ *  The files are read without holding the lock, so that the
+ *  render thread never waits on the file system.
+ ***********************************************************/
+void FileWatcher::WatchThread()
+{
+	std::vector<std::string> paths;
+	std::vector<uint64_t> stamps;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_wake.wait_for(lock, std::chrono::milliseconds(m_interval), [this] { return m_bStopping; });
+		if (m_bStopping)
+			return;
+
+		paths.clear();
+		for (size_t i = 0; i < m_files.size(); i++)
+		{
+			paths.push_back(m_files[i].path);
+		}
+		lock.unlock();
+
+		// a missing file reads as an all zero stamp
+		stamps.assign(paths.size() * 2, 0);
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			FileUtils::GetFileStamp(paths[i], stamps[i * 2], stamps[i * 2 + 1]);
+		}
+
+		lock.lock();
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			WATCHED_FILE& file = m_files[i];
+			if ((file.modified != stamps[i * 2]) || (file.size != stamps[i * 2 + 1]))
+			{
+				file.modified = stamps[i * 2];
+				file.size = stamps[i * 2 + 1];
+				file.bPending = true;
+			}
+			else if (file.bPending)
+			{
+				// stable for an interval, and not deleted
+				file.bPending = false;
+				bool bExists = (0 != file.modified) || (0 != file.size);
+				if (bExists && (std::find(m_changed.begin(), m_changed.end(), file.path) == m_changed.end()))
+					m_changed.push_back(file.path);
+			}
+		}
+	}
+}
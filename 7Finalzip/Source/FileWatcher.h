@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.h
+// ============
+// notice changes to asset files from a background thread, so that they
+// can be reloaded without restarting
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  FileWatcher
+ *
+ *  This class owns a thread that checks the modification
+ *  time and size of every watched file a few times a second.
+ *  A change is only reported once the stamp has stayed the
+ *  same for a whole interval, so that a file an editor is
+ *  still writing is not read half saved. The thread using
+ *  the changed files collects them with PollChanges().
+ ***********************************************************/
+class FileWatcher
+{
+public:
+	// constructor
+	FileWatcher();
+	// destructor
+	~FileWatcher();
+
+	// start the watching thread
+	void Start(unsigned int intervalMilliseconds = 250);
+	// stop the watching thread
+	void Stop();
+
+	// watch a file, which does not have to exist yet
+	void Watch(const std::string& path);
+	// append the files that changed since the last call
+	void PollChanges(std::vector<std::string>& paths);
+
+private:
+	struct WATCHED_FILE
+	{
+		std::string path;
+		// last stamp seen, all zero while the file is missing
+		uint64_t modified;
+		uint64_t size;
+		// changed, but not yet stable for an interval
+		bool bPending;
+	};
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	// files are only ever appended, so indices stay valid
+	std::vector<WATCHED_FILE> m_files;
+	std::vector<std::string> m_changed;
+	unsigned int m_interval;
+	bool m_bStopping;
+
+	// check the watched files until the watcher is stopped
+	void WatchThread();
+};
@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.cpp
+// ============
+// bump allocator for the transient data of one frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// declaration of global variables
+namespace
+{
+	// overflow blocks kept track of without growing the list
+	const size_t g_ReservedOverflowBlocks = 64;
+
+	// round an address up to a power of two alignment
+	char* AlignPointer(char* pointer, size_t alignment)
+	{
+		uintptr_t address = (uintptr_t)pointer;
+		address = (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		return (char*)address;
+	}
+}
+
+/***********************************************************
+ *  FrameArena()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameArena::FrameArena(size_t capacity)
+{
+	m_capacity = std::max(capacity, (size_t)4096);
+	m_block = (char*)malloc(m_capacity);
+	if (NULL == m_block)
+		throw std::bad_alloc();
+	m_used = 0;
+	m_frameBytes = 0;
+	m_highWater = 0;
+	m_overflow.reserve(g_ReservedOverflowBlocks);
+}
+
+/***********************************************************
+ *  ~FrameArena()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameArena::~FrameArena()
+{
+	for (size_t i = 0; i < m_overflow.size(); i++)
+	{
+		free(m_overflow[i]);
+	}
+	m_overflow.clear();
+	free(m_block);
+	m_block = NULL;
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  Move the offset of the block past the aligned request,
+ *  or give a request that does not fit a heap block of its
+ *  own until the next Reset()
+ ***********************************************************/
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	alignment = std::max(alignment, (size_t)1);
+	size = std::max(size, (size_t)1);
+
+	char* start = AlignPointer(m_block + m_used, alignment);
+	size_t end = (size_t)(start - m_block) + size;
+	if (end <= m_capacity)
+	{
+		m_frameBytes += end - m_used;
+		m_used = end;
+		m_highWater = std::max(m_highWater, m_frameBytes);
+		return start;
+	}
+
+	char* block = (char*)malloc(size + alignment);
+	if (NULL == block)
+		throw std::bad_alloc();
+	m_overflow.push_back(block);
+	m_frameBytes += size + alignment;
+	m_highWater = std::max(m_highWater, m_frameBytes);
+	return AlignPointer(block, alignment);
+}
+
+/***********************************************************
+ *  Format()
+ *
+ *  Measure the formatted text first, then write it into an
+ *  allocation of exactly that length
+ ***********************************************************/
+const char* FrameArena::Format(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	va_list measureArgs;
+	va_copy(measureArgs, args);
+	int length = vsnprintf(NULL, 0, format, measureArgs);
+	va_end(measureArgs);
+
+	if (length < 0)
+	{
+		va_end(args);
+		return "";
+	}
+
+	char* text = (char*)Allocate((size_t)length + 1, 1);
+	vsnprintf(text, (size_t)length + 1, format, args);
+	va_end(args);
+	return text;
+}
+
+/***********************************************************
+ *  GetMarker()
+ *
+ *  Get the current allocation state
+ ***********************************************************/
+FrameArena::MARKER FrameArena::GetMarker() const
+{
+	MARKER marker;
+	marker.used = m_used;
+	marker.overflowCount = m_overflow.size();
+	marker.frameBytes = m_frameBytes;
+	return marker;
+}
+
+/***********************************************************
+ *  Rewind()
+ *
+ *  Go back to a marker, freeing the overflow blocks that
+ *  were allocated after it
+ ***********************************************************/
+void FrameArena::Rewind(const MARKER& marker)
+{
+	while (m_overflow.size() > marker.overflowCount)
+	{
+		free(m_overflow.back());
+		m_overflow.pop_back();
+	}
+	m_used = marker.used;
+	m_frameBytes = marker.frameBytes;
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  Take back every allocation, and when the frame did not
+ *  fit, grow the block to the most that a frame has used
+ ***********************************************************/
+void FrameArena::Reset()
+{
+	bool bOverflowed = !m_overflow.empty();
+	for (size_t i = 0; i < m_overflow.size(); i++)
+	{
+		free(m_overflow[i]);
+	}
+	m_overflow.clear();
+	m_used = 0;
+	m_frameBytes = 0;
+
+	if (bOverflowed && (m_highWater > m_capacity))
+	{
+		size_t capacity = m_capacity;
+		while (capacity < m_highWater)
+		{
+			capacity *= 2;
+		}
+
+		char* block = (char*)malloc(capacity);
+		if (NULL == block)
+			return;
+		free(m_block);
+		m_block = block;
+		m_capacity = capacity;
+	}
+}
@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.h
+// ============
+// bump allocator for the transient data of one frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/***********************************************************
+ *  FrameArena
+ *
+ *  This class hands out memory from one block by moving an
+ *  offset forward, and takes all of it back at once when the
+ *  frame ends. Nothing is freed or destroyed one by one, so
+ *  only types with trivial destructors may live in it.
+ *
+ *  A frame that needs more than the block holds gets extra
+ *  heap blocks. At the next Reset() they are freed and the
+ *  block grows to the most the frame used, so once the scene
+ *  settles every frame fits in the block and the frame does
+ *  no heap allocations.
+ *
+ *  The arena belongs to the render thread. Job workers write
+ *  through arrays allocated for them before a loop starts.
+ ***********************************************************/
+class FrameArena
+{
+public:
+	// constructor
+	FrameArena(size_t capacity = 1024 * 1024);
+	// destructor
+	~FrameArena();
+
+	// allocation state to rewind to
+	struct MARKER
+	{
+		size_t used;
+		size_t overflowCount;
+		size_t frameBytes;
+	};
+
+	// allocate bytes that stay valid until the arena is reset
+	void* Allocate(size_t size, size_t alignment = 16);
+	// allocate an uninitialized array
+	template <typename T>
+	T* AllocateArray(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+		return (T*)Allocate(count * sizeof(T), alignof(T));
+	}
+	// format text with printf rules into the arena
+	const char* Format(const char* format, ...);
+
+	// take back everything allocated after a marker, for data
+	// that is only needed by one pass of the frame
+	MARKER GetMarker() const;
+	void Rewind(const MARKER& marker);
+	// take back everything, at the end of a frame
+	void Reset();
+
+	// bytes in the block, and the most one frame asked for
+	size_t GetCapacity() const { return m_capacity; }
+	size_t GetHighWater() const { return m_highWater; }
+
+private:
+	char* m_block;
+	size_t m_capacity;
+	// bytes of the block handed out
+	size_t m_used;
+	// heap blocks of the allocations that did not fit
+	std::vector<char*> m_overflow;
+	// bytes in use this frame, counting the overflow, and the
+	// most any frame has used
+	size_t m_frameBytes;
+	size_t m_highWater;
+
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+};
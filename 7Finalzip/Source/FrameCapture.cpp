@@ -0,0 +1,336 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.cpp
+// ============
+// record the draws of rendered frames into a binary stream, and read
+// them back to replay them without the scene logic
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameCapture.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const uint32_t g_CaptureVersion = 1;
+
+	// the scene path is padded so that the frames stay aligned
+	size_t PadToFour(size_t size)
+	{
+		return (size + 3) & ~(size_t)3;
+	}
+}
+
+/***********************************************************
+ *  FrameCapture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameCapture::FrameCapture()
+{
+	m_bRecording = false;
+	m_bInFrame = false;
+	m_recordedFrames = 0;
+	m_frameHeader = FRAME_HEADER();
+	m_pHeader = NULL;
+	m_pTextureSlots = NULL;
+}
+
+/***********************************************************
+ *  ~FrameCapture()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameCapture::~FrameCapture()
+{
+	if (m_bRecording)
+		EndRecording();
+	Close();
+}
+
+/***********************************************************
+ *  BeginRecording()
+ *
+ *  Open the file under a temporary name and write everything
+ *  that comes before the frames
+ ***********************************************************/
+bool FrameCapture::BeginRecording(
+	const std::string& path,
+	const std::string& sceneFile,
+	uint32_t flags,
+	const std::vector<TEXTURE_SLOT>& textureSlots)
+{
+	if (m_bRecording)
+		EndRecording();
+
+	m_path = path;
+	m_file.open((path + ".tmp").c_str(), std::ios::binary | std::ios::trunc);
+	if (!m_file)
+		return false;
+
+	CAPTURE_HEADER header;
+	memcpy(header.magic, "FCP1", 4);
+	header.version = g_CaptureVersion;
+	header.frameCount = 0;
+	header.flags = flags;
+	header.textureCount = (uint32_t)textureSlots.size();
+	header.sceneLength = (uint32_t)sceneFile.size();
+	m_file.write((const char*)&header, sizeof(header));
+	if (!textureSlots.empty())
+		m_file.write((const char*)textureSlots.data(), textureSlots.size() * sizeof(TEXTURE_SLOT));
+
+	const char padding[4] = { 0, 0, 0, 0 };
+	m_file.write(sceneFile.data(), sceneFile.size());
+	m_file.write(padding, PadToFour(sceneFile.size()) - sceneFile.size());
+
+	m_bRecording = true;
+	m_bInFrame = false;
+	m_recordedFrames = 0;
+	return true;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  Keep the camera of the frame and drop the commands of the
+ *  frame before; the vectors keep their capacity
+ ***********************************************************/
+void FrameCapture::BeginFrame(const glm::vec3& position, const glm::vec3& front, float fov, bool bOrtho, int width, int height)
+{
+	if (!m_bRecording)
+		return;
+
+	m_frameHeader.position = position;
+	m_frameHeader.front = front;
+	m_frameHeader.fov = fov;
+	m_frameHeader.bOrtho = bOrtho ? 1 : 0;
+	m_frameHeader.width = (uint32_t)width;
+	m_frameHeader.height = (uint32_t)height;
+	m_commands.clear();
+	m_records.clear();
+	m_bInFrame = true;
+}
+
+/***********************************************************
+ *  AddPass()
+ *
+ *  Mark the start of a pass; the draws that follow belong to
+ *  it
+ ***********************************************************/
+void FrameCapture::AddPass(COMMAND_TYPE type, int layer)
+{
+	if (!m_bInFrame)
+		return;
+
+	CAPTURE_COMMAND command;
+	command.type = (uint32_t)type;
+	command.mesh = -1;
+	command.lod = layer;
+	command.pool = -1;
+	command.firstRecord = (uint32_t)m_records.size();
+	command.recordCount = 0;
+	m_commands.push_back(command);
+}
+
+/***********************************************************
+ *  AddDraw()
+ *
+ *  Add a draw with copies of the records it appended, as
+ *  they were when it was submitted
+ ***********************************************************/
+void FrameCapture::AddDraw(COMMAND_TYPE type, int mesh, int lod, int pool, const DrawDataBuffer::DRAW_DATA* records, size_t count)
+{
+	if (!m_bInFrame)
+		return;
+
+	CAPTURE_COMMAND command;
+	command.type = (uint32_t)type;
+	command.mesh = mesh;
+	command.lod = lod;
+	command.pool = pool;
+	command.firstRecord = (uint32_t)m_records.size();
+	command.recordCount = (uint32_t)count;
+	m_commands.push_back(command);
+	m_records.insert(m_records.end(), records, records + count);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  Write the frame header, its commands and its records
+ ***********************************************************/
+void FrameCapture::EndFrame()
+{
+	if (!m_bInFrame)
+		return;
+
+	m_frameHeader.commandCount = (uint32_t)m_commands.size();
+	m_frameHeader.recordCount = (uint32_t)m_records.size();
+	m_file.write((const char*)&m_frameHeader, sizeof(m_frameHeader));
+	if (!m_commands.empty())
+		m_file.write((const char*)m_commands.data(), m_commands.size() * sizeof(CAPTURE_COMMAND));
+	if (!m_records.empty())
+		m_file.write((const char*)m_records.data(), m_records.size() * sizeof(DrawDataBuffer::DRAW_DATA));
+
+	m_recordedFrames++;
+	m_bInFrame = false;
+}
+
+/***********************************************************
+ *  EndRecording()
+ *
+ *  Patch the frame count into the header and move the file
+ *  to its name, so that a reader never maps a half written
+ *  capture
+ ***********************************************************/
+bool FrameCapture::EndRecording()
+{
+	if (!m_bRecording)
+		return false;
+
+	m_bRecording = false;
+	m_bInFrame = false;
+
+	m_file.seekp((std::streamoff)offsetof(CAPTURE_HEADER, frameCount));
+	m_file.write((const char*)&m_recordedFrames, sizeof(m_recordedFrames));
+	bool bWritten = !m_file.fail();
+	m_file.close();
+
+	std::string temporaryPath = m_path + ".tmp";
+	if (!bWritten)
+	{
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	std::remove(m_path.c_str());
+	return 0 == std::rename(temporaryPath.c_str(), m_path.c_str());
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  Map a capture and find all of its frames, checking that
+ *  each one lies inside the file
+ ***********************************************************/
+bool FrameCapture::Open(const std::string& path)
+{
+	Close();
+	if (!m_mapping.Open(path))
+		return false;
+
+	const uint8_t* data = m_mapping.GetData();
+	size_t size = m_mapping.GetSize();
+	if (size < sizeof(CAPTURE_HEADER))
+	{
+		Close();
+		return false;
+	}
+
+	const CAPTURE_HEADER* header = (const CAPTURE_HEADER*)data;
+	size_t offset = sizeof(CAPTURE_HEADER) + (size_t)header->textureCount * sizeof(TEXTURE_SLOT);
+	bool bValid = (0 == memcmp(header->magic, "FCP1", 4)) &&
+		(header->version == g_CaptureVersion) &&
+		(offset + PadToFour(header->sceneLength) <= size);
+	if (!bValid)
+	{
+		Close();
+		return false;
+	}
+
+	m_pHeader = header;
+	m_pTextureSlots = (const TEXTURE_SLOT*)(data + sizeof(CAPTURE_HEADER));
+	m_sceneFile.assign((const char*)data + offset, header->sceneLength);
+	offset += PadToFour(header->sceneLength);
+
+	// the frame count comes from the file, so no more frames
+	// are reserved than the rest of it can hold
+	m_frames.reserve(std::min((size_t)header->frameCount, (size - offset) / sizeof(FRAME_HEADER)));
+	for (uint32_t i = 0; i < header->frameCount; i++)
+	{
+		if (offset + sizeof(FRAME_HEADER) > size)
+			break;
+
+		const FRAME_HEADER* frame = (const FRAME_HEADER*)(data + offset);
+		uint64_t frameSize = sizeof(FRAME_HEADER) +
+			(uint64_t)frame->commandCount * sizeof(CAPTURE_COMMAND) +
+			(uint64_t)frame->recordCount * sizeof(DrawDataBuffer::DRAW_DATA);
+		if (offset + frameSize > size)
+			break;
+
+		// a command that reads past the records of its frame
+		// would draw from another frame's data
+		const CAPTURE_COMMAND* commands = (const CAPTURE_COMMAND*)(frame + 1);
+		bool bCommandsValid = true;
+		for (uint32_t c = 0; c < frame->commandCount; c++)
+		{
+			if ((uint64_t)commands[c].firstRecord + commands[c].recordCount > frame->recordCount)
+				bCommandsValid = false;
+		}
+		if (!bCommandsValid)
+			break;
+
+		m_frames.push_back(offset);
+		offset += (size_t)frameSize;
+	}
+
+	if (m_frames.size() != header->frameCount)
+	{
+		std::cout << "Capture " << path << " is cut short after " << m_frames.size() << " frames" << std::endl;
+		if (m_frames.empty())
+		{
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  Unmap the capture
+ ***********************************************************/
+void FrameCapture::Close()
+{
+	m_mapping.Close();
+	m_pHeader = NULL;
+	m_pTextureSlots = NULL;
+	m_sceneFile.clear();
+	m_frames.clear();
+}
+
+/***********************************************************
+ *  GetFrame()
+ *
+ *  Get the header of a frame
+ ***********************************************************/
+const FrameCapture::FRAME_HEADER& FrameCapture::GetFrame(uint32_t frame) const
+{
+	return *(const FRAME_HEADER*)(m_mapping.GetData() + m_frames[frame]);
+}
+
+/***********************************************************
+ *  GetCommands()
+ *
+ *  Get the commands of a frame, right after its header
+ ***********************************************************/
+const FrameCapture::CAPTURE_COMMAND* FrameCapture::GetCommands(uint32_t frame) const
+{
+	return (const CAPTURE_COMMAND*)(&GetFrame(frame) + 1);
+}
+
+/***********************************************************
+ *  GetRecords()
+ *
+ *  Get the records of a frame, after its commands
+ ***********************************************************/
+const DrawDataBuffer::DRAW_DATA* FrameCapture::GetRecords(uint32_t frame) const
+{
+	return (const DrawDataBuffer::DRAW_DATA*)(GetCommands(frame) + GetFrame(frame).commandCount);
+}
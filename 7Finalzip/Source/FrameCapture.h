@@ -0,0 +1,180 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.h
+// ============
+// record the draws of rendered frames into a binary stream, and read
+// them back to replay them without the scene logic
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "DrawDataBuffer.h"
+#include "FileUtils.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  FrameCapture
+ *
+ *  Capture file layout (all little endian):
+ *    CAPTURE_HEADER
+ *    TEXTURE_SLOT, textureCount of them, by texture handle
+ *    scene file path, sceneLength bytes, padded to 4
+ *    then for every frame:
+ *      FRAME_HEADER
+ *      CAPTURE_COMMAND, commandCount of them
+ *      DrawDataBuffer::DRAW_DATA, recordCount of them
+ *
+ *  A frame is the camera it was drawn from and the commands
+ *  the SceneManager submitted, in order: pass markers, and
+ *  draws of a mesh or a static batch with the texture pool
+ *  they bound and the records they appended. Replaying a
+ *  frame feeds the same records to the same draw calls, so
+ *  culling, levels of detail and queue building are left out
+ *  of the measurement.
+ *
+ *  Texture layers depend on the order the images finished
+ *  loading in, so the slot of every texture at the time of
+ *  the capture is kept, and a replay maps them back to the
+ *  slots the textures have now.
+ *
+ *  Frames are written as they end, and the frame count in
+ *  the header is filled in when the recording is closed.
+ ***********************************************************/
+class FrameCapture
+{
+public:
+	// constructor
+	FrameCapture();
+	// destructor
+	~FrameCapture();
+
+	enum CAPTURE_FLAGS
+	{
+		CAPTURE_PACKED_VERTICES = 1,
+		CAPTURE_STATIC_BATCHING = 2,
+		CAPTURE_DEPTH_PREPASS = 4
+	};
+
+	enum COMMAND_TYPE
+	{
+		// pass markers, the layer of a shadow pass in lod
+		COMMAND_SHADOW_LAYER = 0,
+		COMMAND_DEPTH_PASS,
+		COMMAND_OPAQUE_PASS,
+		COMMAND_TRANSPARENT_PASS,
+		// instanced draw of a mesh at a level of detail
+		COMMAND_DRAW,
+		// draw of a static batch
+		COMMAND_STATIC_BATCH
+	};
+
+	struct CAPTURE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t frameCount;
+		uint32_t flags;
+		uint32_t textureCount;
+		uint32_t sceneLength;
+	};
+
+	struct TEXTURE_SLOT
+	{
+		int32_t pool;
+		int32_t layer;
+	};
+
+	struct FRAME_HEADER
+	{
+		// camera the frame was drawn from
+		glm::vec3 position;
+		glm::vec3 front;
+		float fov;
+		uint32_t bOrtho;
+		// viewport the scene was drawn at
+		uint32_t width;
+		uint32_t height;
+		uint32_t commandCount;
+		uint32_t recordCount;
+	};
+
+	struct CAPTURE_COMMAND
+	{
+		uint32_t type;
+		// mesh or static batch drawn
+		int32_t mesh;
+		// level of detail, or the layer of a shadow pass
+		int32_t lod;
+		// texture pool bound for the draw, -1 for none
+		int32_t pool;
+		// records of the draw, in the records of the frame
+		uint32_t firstRecord;
+		uint32_t recordCount;
+	};
+
+	// start writing a capture, replacing any file at the path
+	bool BeginRecording(
+		const std::string& path,
+		const std::string& sceneFile,
+		uint32_t flags,
+		const std::vector<TEXTURE_SLOT>& textureSlots);
+	// start the next frame of the recording
+	void BeginFrame(const glm::vec3& position, const glm::vec3& front, float fov, bool bOrtho, int width, int height);
+	// add a pass marker to the frame
+	void AddPass(COMMAND_TYPE type, int layer = 0);
+	// add a draw and a copy of its records to the frame
+	void AddDraw(COMMAND_TYPE type, int mesh, int lod, int pool, const DrawDataBuffer::DRAW_DATA* records, size_t count);
+	// write the frame out
+	void EndFrame();
+	// fill in the frame count and close the file, returning
+	// whether everything was written
+	bool EndRecording();
+	bool IsRecording() const { return m_bRecording; }
+	// frames written since BeginRecording()
+	uint32_t GetRecordedFrames() const { return m_recordedFrames; }
+
+	// map a capture file to replay, checking every frame
+	bool Open(const std::string& path);
+	void Close();
+
+	// what was captured
+	uint32_t GetFlags() const { return (NULL != m_pHeader) ? m_pHeader->flags : 0; }
+	const std::string& GetSceneFile() const { return m_sceneFile; }
+	uint32_t GetTextureCount() const { return (NULL != m_pHeader) ? m_pHeader->textureCount : 0; }
+	const TEXTURE_SLOT* GetTextureSlots() const { return m_pTextureSlots; }
+	uint32_t GetFrameCount() const { return (uint32_t)m_frames.size(); }
+
+	// access the frames of the mapped capture
+	const FRAME_HEADER& GetFrame(uint32_t frame) const;
+	const CAPTURE_COMMAND* GetCommands(uint32_t frame) const;
+	const DrawDataBuffer::DRAW_DATA* GetRecords(uint32_t frame) const;
+
+private:
+	// recording
+	std::ofstream m_file;
+	std::string m_path;
+	bool m_bRecording;
+	bool m_bInFrame;
+	uint32_t m_recordedFrames;
+	FRAME_HEADER m_frameHeader;
+	std::vector<CAPTURE_COMMAND> m_commands;
+	std::vector<DrawDataBuffer::DRAW_DATA> m_records;
+
+	// replay
+	MappedFile m_mapping;
+	const CAPTURE_HEADER* m_pHeader;
+	const TEXTURE_SLOT* m_pTextureSlots;
+	std::string m_sceneFile;
+	// offset of every frame header in the mapping
+	std::vector<size_t> m_frames;
+
+	// a capture can not be copied
+	FrameCapture(const FrameCapture&);
+	FrameCapture& operator=(const FrameCapture&);
+};
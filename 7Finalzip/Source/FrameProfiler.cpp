@@ -0,0 +1,389 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameprofiler.cpp
+// ============
+// measure where the time of a frame goes, with scoped CPU timers and
+// GPU timer queries, and report rolling percentiles and Chrome traces
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+// declaration of global variables
+namespace
+{
+	const char* g_FrameTimerName = "Frame";
+
+	// value below which the given fraction of samples falls
+	float GetPercentile(const float* sorted, size_t count, float fraction)
+	{
+		if (0 == count)
+			return 0.0f;
+		size_t index = (size_t)(fraction * (count - 1) + 0.5f);
+		return sorted[std::min(index, count - 1)];
+	}
+
+	// write a string as a JSON string literal
+	void WriteJsonString(std::ostream& output, const std::string& text)
+	{
+		output << '"';
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			if (('"' == text[i]) || ('\\' == text[i]))
+				output << '\\';
+			output << text[i];
+		}
+		output << '"';
+	}
+}
+
+/***********************************************************
+ *  FrameProfiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameProfiler::FrameProfiler()
+{
+	m_startTime = std::chrono::steady_clock::now();
+	m_frameStartMicroseconds = -1.0;
+	m_frameTimer = FindTimer(g_FrameTimerName, false);
+	m_gpuFrame = 0;
+	m_bGpuScopeOpen = false;
+	m_nextTraceEvent = 0;
+	for (int i = 0; i < GPU_LATENCY; i++)
+	{
+		m_gpuFrames[i].used = 0;
+	}
+}
+
+/***********************************************************
+ *  ~FrameProfiler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameProfiler::~FrameProfiler()
+{
+	for (int i = 0; i < GPU_LATENCY; i++)
+	{
+		for (size_t j = 0; j < m_gpuFrames[i].queries.size(); j++)
+		{
+			glDeleteQueries(1, &m_gpuFrames[i].queries[j].query);
+		}
+	}
+}
+
+/***********************************************************
+ *  GetMicroseconds()
+ *
+ *  Get the time since the profiler was created
+ ***********************************************************/
+double FrameProfiler::GetMicroseconds() const
+{
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - m_startTime;
+	return elapsed.count();
+}
+
+/***********************************************************
+ *  FindTimer()
+ *
+ *  Get the index of a named timer, creating it on first use.
+ *  There are only a few timers, and comparing against their
+ *  names needs no temporary string, so scopes never allocate
+ *  once their timer exists.
+ ***********************************************************/
+int FrameProfiler::FindTimer(const char* name, bool bGpu)
+{
+	// GPU timers are kept apart from CPU timers of the same name
+	for (size_t i = 0; i < m_timers.size(); i++)
+	{
+		if ((m_timers[i].bGpu == bGpu) && (m_timers[i].name == name))
+			return (int)i;
+	}
+
+	TIMER timer;
+	timer.name = name;
+	timer.bGpu = bGpu;
+	timer.sampleCount = 0;
+	timer.nextSample = 0;
+	m_timers.push_back(timer);
+	return (int)m_timers.size() - 1;
+}
+
+/***********************************************************
+ *  AddSample()
+ *
+ *  Add a measurement to the history of a timer and to the
+ *  trace event ring
+ ***********************************************************/
+void FrameProfiler::AddSample(int timer, double startMicroseconds, double durationMicroseconds)
+{
+	TIMER& history = m_timers[timer];
+	history.samples[history.nextSample] = (float)(durationMicroseconds / 1000.0);
+	history.nextSample = (history.nextSample + 1) % HISTORY_SIZE;
+	history.sampleCount = std::min(history.sampleCount + 1, (int)HISTORY_SIZE);
+
+	TRACE_EVENT event;
+	event.timer = timer;
+	event.startMicroseconds = startMicroseconds;
+	event.durationMicroseconds = durationMicroseconds;
+	if (m_traceEvents.size() < MAX_TRACE_EVENTS)
+	{
+		m_traceEvents.push_back(event);
+	}
+	else
+	{
+		m_traceEvents[m_nextTraceEvent] = event;
+	}
+	m_nextTraceEvent = (m_nextTraceEvent + 1) % MAX_TRACE_EVENTS;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  Start timing a frame, and read back the GPU queries that
+ *  were issued GPU_LATENCY frames ago
+ ***********************************************************/
+void FrameProfiler::BeginFrame()
+{
+	m_gpuFrame = (m_gpuFrame + 1) % GPU_LATENCY;
+	CollectGpuFrame(m_gpuFrames[m_gpuFrame]);
+
+	m_frameStartMicroseconds = GetMicroseconds();
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  Record the time since BeginFrame() as the frame time
+ ***********************************************************/
+void FrameProfiler::EndFrame()
+{
+	if (m_frameStartMicroseconds < 0.0)
+		return;
+
+	double now = GetMicroseconds();
+	AddSample(m_frameTimer, m_frameStartMicroseconds, now - m_frameStartMicroseconds);
+	m_frameStartMicroseconds = -1.0;
+}
+
+/***********************************************************
+ *  BeginCpuScope()
+ *
+ *  Start timing a named section of CPU work
+ ***********************************************************/
+void FrameProfiler::BeginCpuScope(const char* name)
+{
+	CPU_SCOPE scope;
+	scope.timer = FindTimer(name, false);
+	scope.startMicroseconds = GetMicroseconds();
+	m_cpuScopes.push_back(scope);
+}
+
+/***********************************************************
+ *  EndCpuScope()
+ *
+ *  Stop timing the innermost CPU scope
+ ***********************************************************/
+void FrameProfiler::EndCpuScope()
+{
+	if (m_cpuScopes.empty())
+		return;
+
+	CPU_SCOPE scope = m_cpuScopes.back();
+	m_cpuScopes.pop_back();
+	AddSample(scope.timer, scope.startMicroseconds, GetMicroseconds() - scope.startMicroseconds);
+}
+
+/***********************************************************
+ *  BeginGpuScope()
+ *
+ *  Start a GL_TIME_ELAPSED query for a named section of GPU
+ *  work, reusing the query objects of the ring frame
+ ***********************************************************/
+void FrameProfiler::BeginGpuScope(const char* name)
+{
+	if (m_bGpuScopeOpen)
+		EndGpuScope();
+
+	GPU_FRAME& frame = m_gpuFrames[m_gpuFrame];
+	if (frame.used == frame.queries.size())
+	{
+		GPU_QUERY query;
+		glGenQueries(1, &query.query);
+		frame.queries.push_back(query);
+	}
+
+	GPU_QUERY& query = frame.queries[frame.used++];
+	query.timer = FindTimer(name, true);
+	query.startMicroseconds = GetMicroseconds();
+	glBeginQuery(GL_TIME_ELAPSED, query.query);
+	m_bGpuScopeOpen = true;
+}
+
+/***********************************************************
+ *  EndGpuScope()
+ *
+ *  End the open GPU query
+ ***********************************************************/
+void FrameProfiler::EndGpuScope()
+{
+	if (!m_bGpuScopeOpen)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	m_bGpuScopeOpen = false;
+}
+
+/***********************************************************
+ *  CollectGpuFrame()
+ *
+ *  Read the results of a ring frame's queries. A result that
+ *  is still not available is dropped rather than waited for.
+ ***********************************************************/
+void FrameProfiler::CollectGpuFrame(GPU_FRAME& frame)
+{
+	for (size_t i = 0; i < frame.used; i++)
+	{
+		const GPU_QUERY& query = frame.queries[i];
+		GLint bAvailable = 0;
+		glGetQueryObjectiv(query.query, GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+		if (!bAvailable)
+			continue;
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query.query, GL_QUERY_RESULT, &nanoseconds);
+		AddSample(query.timer, query.startMicroseconds, nanoseconds / 1000.0);
+	}
+	frame.used = 0;
+}
+
+/***********************************************************
+ *  GetLastTime()
+ *
+ *  Look up a timer without creating it, and read its newest
+ *  sample
+ ***********************************************************/
+float FrameProfiler::GetLastTime(const char* name, bool bGpu) const
+{
+	for (size_t i = 0; i < m_timers.size(); i++)
+	{
+		const TIMER& timer = m_timers[i];
+		if ((timer.bGpu != bGpu) || (timer.name != name))
+			continue;
+		if (0 == timer.sampleCount)
+			return -1.0f;
+		return timer.samples[(timer.nextSample + HISTORY_SIZE - 1) % HISTORY_SIZE];
+	}
+	return -1.0f;
+}
+
+/***********************************************************
+ *  GetPercentiles()
+ *
+ *  Sort a copy of the sample history of a timer
+ ***********************************************************/
+void FrameProfiler::GetPercentiles(const TIMER& timer, float& p50, float& p95, float& p99) const
+{
+	float sorted[HISTORY_SIZE];
+	size_t count = (size_t)timer.sampleCount;
+	std::copy(timer.samples, timer.samples + count, sorted);
+	std::sort(sorted, sorted + count);
+
+	p50 = GetPercentile(sorted, count, 0.50f);
+	p95 = GetPercentile(sorted, count, 0.95f);
+	p99 = GetPercentile(sorted, count, 0.99f);
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  Compute the rolling percentiles of every timer
+ ***********************************************************/
+void FrameProfiler::GetStats(std::vector<TIMER_STATS>& stats) const
+{
+	stats.clear();
+
+	for (size_t i = 0; i < m_timers.size(); i++)
+	{
+		const TIMER& timer = m_timers[i];
+		if (0 == timer.sampleCount)
+			continue;
+
+		TIMER_STATS timerStats;
+		timerStats.name = timer.name;
+		timerStats.bGpu = timer.bGpu;
+		timerStats.last = timer.samples[(timer.nextSample + HISTORY_SIZE - 1) % HISTORY_SIZE];
+		GetPercentiles(timer, timerStats.p50, timerStats.p95, timerStats.p99);
+		stats.push_back(timerStats);
+	}
+}
+
+/***********************************************************
+ *  FormatStats()
+ *
+ *  Format a header and one line per timer, with times in
+ *  milliseconds, into text and a line array in the arena
+ ***********************************************************/
+const char* const* FrameProfiler::FormatStats(FrameArena& arena, size_t& lineCount) const
+{
+	const char** lines = arena.AllocateArray<const char*>(m_timers.size() + 1);
+	lineCount = 0;
+	lines[lineCount++] = arena.Format("%-16s%6s%8s%8s", "TIMER (MS)", "P50", "P95", "P99");
+
+	for (size_t i = 0; i < m_timers.size(); i++)
+	{
+		const TIMER& timer = m_timers[i];
+		if (0 == timer.sampleCount)
+			continue;
+
+		float p50 = 0.0f;
+		float p95 = 0.0f;
+		float p99 = 0.0f;
+		GetPercentiles(timer, p50, p95, p99);
+		lines[lineCount++] = arena.Format("%-4s%-12.11s%6.2f%8.2f%8.2f",
+			timer.bGpu ? "GPU" : "CPU", timer.name.c_str(), p50, p95, p99);
+	}
+	return lines;
+}
+
+/***********************************************************
+ *  ExportChromeTrace()
+ *
+ *  Write the event ring as complete ("X") events, with CPU
+ *  work on thread 0 and GPU work on thread 1. GPU events are
+ *  placed at the CPU time their scope was issued, since
+ *  elapsed-time queries do not carry timestamps.
+ ***********************************************************/
+bool FrameProfiler::ExportChromeTrace(const std::string& path) const
+{
+	std::ofstream output(path.c_str());
+	if (!output)
+		return false;
+
+	output << std::fixed << std::setprecision(3);
+	output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+	output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+	// oldest event first once the ring has wrapped
+	size_t count = m_traceEvents.size();
+	size_t first = (count < MAX_TRACE_EVENTS) ? 0 : m_nextTraceEvent;
+	for (size_t i = 0; i < count; i++)
+	{
+		const TRACE_EVENT& event = m_traceEvents[(first + i) % count];
+		const TIMER& timer = m_timers[event.timer];
+
+		output << ",\n{\"name\":";
+		WriteJsonString(output, timer.name);
+		output << ",\"cat\":\"" << (timer.bGpu ? "gpu" : "cpu") << "\""
+			<< ",\"ph\":\"X\",\"pid\":0,\"tid\":" << (timer.bGpu ? 1 : 0)
+			<< ",\"ts\":" << event.startMicroseconds
+			<< ",\"dur\":" << event.durationMicroseconds << "}";
+	}
+	output << "\n]}\n";
+
+	return output.good();
+}
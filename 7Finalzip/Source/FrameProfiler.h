@@ -0,0 +1,161 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameprofiler.h
+// ============
+// measure where the time of a frame goes, with scoped CPU timers and
+// GPU timer queries, and report rolling percentiles and Chrome traces
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FrameArena.h"
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  FrameProfiler
+ *
+ *  This class keeps a rolling history of named timings. CPU
+ *  scopes may nest and are measured with a steady clock. GPU
+ *  scopes are measured with GL_TIME_ELAPSED queries, which
+ *  can not nest, so one GPU scope must end before the next
+ *  begins. The queries of each frame go into a ring of
+ *  GPU_LATENCY frames, and are read back that many frames
+ *  later so that the CPU never waits on the GPU.
+ ***********************************************************/
+class FrameProfiler
+{
+public:
+	// constructor
+	FrameProfiler();
+	// destructor
+	~FrameProfiler();
+
+	// rolling statistics of one timer, in milliseconds
+	struct TIMER_STATS
+	{
+		std::string name;
+		bool bGpu;
+		float last;
+		float p50;
+		float p95;
+		float p99;
+	};
+
+	// times a CPU scope for as long as it is alive
+	class CpuScope
+	{
+	public:
+		CpuScope(FrameProfiler& profiler, const char* name) : m_profiler(profiler)
+		{
+			m_profiler.BeginCpuScope(name);
+		}
+		~CpuScope()
+		{
+			m_profiler.EndCpuScope();
+		}
+
+	private:
+		FrameProfiler& m_profiler;
+		CpuScope(const CpuScope&);
+		CpuScope& operator=(const CpuScope&);
+	};
+
+	// mark the start and end of a frame, the whole frame is
+	// recorded as the "Frame" timer
+	void BeginFrame();
+	void EndFrame();
+
+	// time a section of CPU work
+	void BeginCpuScope(const char* name);
+	void EndCpuScope();
+	// time a section of GPU work, such as a render pass
+	void BeginGpuScope(const char* name);
+	void EndGpuScope();
+
+	// get the statistics of every timer, in first use order
+	void GetStats(std::vector<TIMER_STATS>& stats) const;
+	// get the latest measurement of a timer in milliseconds, or
+	// a negative value before it has one. GPU timers trail the
+	// frame by GPU_LATENCY frames.
+	float GetLastTime(const char* name, bool bGpu) const;
+	// format the statistics as lines of text for an overlay,
+	// in the arena so that drawing it allocates nothing
+	const char* const* FormatStats(FrameArena& arena, size_t& lineCount) const;
+	// write the recorded events as a Chrome trace JSON file,
+	// which can be opened in chrome://tracing or Perfetto
+	bool ExportChromeTrace(const std::string& path) const;
+
+	// frames between a GPU scope and its measurement
+	static const int GPU_LATENCY = 4;
+
+private:
+	static const int HISTORY_SIZE = 256;
+	static const size_t MAX_TRACE_EVENTS = 16384;
+
+	struct TIMER
+	{
+		std::string name;
+		bool bGpu;
+		float samples[HISTORY_SIZE];
+		int sampleCount;
+		int nextSample;
+	};
+
+	struct CPU_SCOPE
+	{
+		int timer;
+		double startMicroseconds;
+	};
+
+	struct GPU_QUERY
+	{
+		GLuint query;
+		int timer;
+		// CPU time the scope was issued, used to place the GPU
+		// event in the trace
+		double startMicroseconds;
+	};
+
+	struct GPU_FRAME
+	{
+		std::vector<GPU_QUERY> queries;
+		size_t used;
+	};
+
+	struct TRACE_EVENT
+	{
+		int timer;
+		double startMicroseconds;
+		double durationMicroseconds;
+	};
+
+	std::chrono::steady_clock::time_point m_startTime;
+	std::vector<TIMER> m_timers;
+	std::vector<CPU_SCOPE> m_cpuScopes;
+	double m_frameStartMicroseconds;
+	int m_frameTimer;
+
+	GPU_FRAME m_gpuFrames[GPU_LATENCY];
+	int m_gpuFrame;
+	bool m_bGpuScopeOpen;
+
+	// ring buffer of the most recent events
+	std::vector<TRACE_EVENT> m_traceEvents;
+	size_t m_nextTraceEvent;
+
+	// microseconds since the profiler was created
+	double GetMicroseconds() const;
+	// find or create a timer by name
+	int FindTimer(const char* name, bool bGpu);
+	// record one measurement
+	void AddSample(int timer, double startMicroseconds, double durationMicroseconds);
+	// rolling percentiles of the samples of a timer
+	void GetPercentiles(const TIMER& timer, float& p50, float& p95, float& p99) const;
+	// read back the finished queries of the current ring frame
+	void CollectGpuFrame(GPU_FRAME& frame);
+};
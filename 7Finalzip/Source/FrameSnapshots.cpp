@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// framesnapshots.cpp
+// ============
+// hand the state of each fixed update tick from the update thread to
+// the render thread
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameSnapshots.h"
+
+/***********************************************************
+ *  FrameSnapshots()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameSnapshots::FrameSnapshots()
+{
+	m_slots[0] = FRAME_SNAPSHOT();
+	m_slots[1] = FRAME_SNAPSHOT();
+	m_front = 0;
+	m_bPublished = false;
+}
+
+/***********************************************************
+ *  Publish()
+ *
+ *  Fill the back slot and make it the front one. With a
+ *  single writer the back slot is never read, so only the
+ *  swap needs the lock.
+ ***********************************************************/
+void FrameSnapshots::Publish(const FRAME_SNAPSHOT& snapshot)
+{
+	int back = 1 - m_front;
+	m_slots[back] = snapshot;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_front = back;
+	m_bPublished = true;
+}
+
+/***********************************************************
+ *  Acquire()
+ *
+ *  Copy the front slot, holding the lock so that it can not
+ *  become the back slot while it is copied
+ ***********************************************************/
+bool FrameSnapshots::Acquire(FRAME_SNAPSHOT& snapshot)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_bPublished)
+		return false;
+
+	snapshot = m_slots[m_front];
+	return true;
+}
+
+/***********************************************************
+ *  Interpolate()
+ *
+ *  Blend the positions and fields of view linearly, and
+ *  renormalize the blended view direction
+ ***********************************************************/
+FrameSnapshots::CAMERA_STATE FrameSnapshots::Interpolate(const FRAME_SNAPSHOT& snapshot, float alpha)
+{
+	alpha = glm::clamp(alpha, 0.0f, 1.0f);
+	const CAMERA_STATE& from = snapshot.previousCamera;
+	const CAMERA_STATE& to = snapshot.camera;
+
+	CAMERA_STATE camera;
+	camera.position = glm::mix(from.position, to.position, alpha);
+	camera.fov = glm::mix(from.fov, to.fov, alpha);
+	camera.front = glm::mix(from.front, to.front, alpha);
+	if (glm::dot(camera.front, camera.front) > 1e-6f)
+		camera.front = glm::normalize(camera.front);
+	else
+		camera.front = to.front;
+	return camera;
+}
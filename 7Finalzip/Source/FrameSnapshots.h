@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// framesnapshots.h
+// ============
+// hand the state of each fixed update tick from the update thread to
+// the render thread
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <mutex>
+
+/***********************************************************
+ *  FrameSnapshots
+ *
+ *  This class double buffers the FRAME_SNAPSHOT published
+ *  by the update thread after each fixed time step. The
+ *  writer fills the back slot without holding the lock and
+ *  then only swaps the slots under it, and the reader copies
+ *  the front slot out, so a published snapshot never changes
+ *  while it is read. The render thread always takes the
+ *  latest tick and skips any it was too slow to see.
+ *
+ *  Each snapshot holds the camera of the tick and of the tick
+ *  before, so the renderer can blend between them by how far
+ *  time has moved past the tick, and motion stays smooth at
+ *  any frame rate.
+ ***********************************************************/
+class FrameSnapshots
+{
+public:
+	// constructor
+	FrameSnapshots();
+
+	struct CAMERA_STATE
+	{
+		glm::vec3 position;
+		// unit view direction
+		glm::vec3 front;
+		// vertical field of view in degrees
+		float fov;
+	};
+
+	struct FRAME_SNAPSHOT
+	{
+		// update tick and the time it was simulated up to
+		uint64_t tick;
+		double tickTime;
+		CAMERA_STATE previousCamera;
+		CAMERA_STATE camera;
+		bool bOrtho;
+		int framebufferWidth;
+		int framebufferHeight;
+		// render settings asked for by the keyboard
+		bool bShowProfiler;
+		bool bMultiDrawIndirect;
+		bool bDepthPrePass;
+		bool bDynamicResolution;
+		bool bStaticBatching;
+		// times a frame trace export was asked for
+		uint32_t traceRequests;
+		// times a frame capture was started or stopped
+		uint32_t captureRequests;
+		// times an object pick was asked for, and the normalized
+		// device coordinates of the latest click
+		uint32_t pickRequests;
+		glm::vec2 pickPoint;
+	};
+
+	// publish the state of a finished tick, from the update
+	// thread only
+	void Publish(const FRAME_SNAPSHOT& snapshot);
+	// copy the latest snapshot, returning false until the first
+	// one is published
+	bool Acquire(FRAME_SNAPSHOT& snapshot);
+
+	// blend the two cameras of a snapshot, alpha 0 giving the
+	// previous tick and 1 the latest
+	static CAMERA_STATE Interpolate(const FRAME_SNAPSHOT& snapshot, float alpha);
+
+private:
+	std::mutex m_mutex;
+	FRAME_SNAPSHOT m_slots[2];
+	// slot read by Acquire(), the other one is written
+	int m_front;
+	bool m_bPublished;
+};
@@ -0,0 +1,159 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.cpp
+// ============
+// test bounding volumes against the camera frustum
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define FRUSTUM_CULLER_SSE 1
+#include <xmmintrin.h>
+#endif
+
+/***********************************************************
+ *  FrustumCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrustumCuller::FrustumCuller()
+{
+	// with no view set, everything is visible
+	for (int i = 0; i < 6; i++)
+	{
+		m_planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+/***********************************************************
+ *  SetViewProjection()
+ *
+ *  Extract the frustum planes from the rows of the clip
+ *  matrix (Gribb/Hartmann) and normalize them so that the
+ *  plane equation gives a distance
+ ***********************************************************/
+void FrustumCuller::SetViewProjection(const glm::mat4& viewProjection)
+{
+	const glm::mat4& m = viewProjection;
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	m_planes[0] = row3 + row0; // left
+	m_planes[1] = row3 - row0; // right
+	m_planes[2] = row3 + row1; // bottom
+	m_planes[3] = row3 - row1; // top
+	m_planes[4] = row3 + row2; // near
+	m_planes[5] = row3 - row2; // far
+
+	for (int i = 0; i < 6; i++)
+	{
+		float length = glm::length(glm::vec3(m_planes[i]));
+		if (length > 0.0f)
+			m_planes[i] = m_planes[i] / length;
+	}
+}
+
+/***********************************************************
+ *  IsSphereVisible()
+ *
+ *  A sphere is outside when it lies fully behind any plane
+ ***********************************************************/
+bool FrustumCuller::IsSphereVisible(const glm::vec3& center, float radius) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const glm::vec4& plane = m_planes[i];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		if (distance < -radius)
+			return false;
+	}
+	return true;
+}
+
+/***********************************************************
+ *  TestBox()
+ *
+ *  Compare the distance of the box center to each plane with
+ *  the extent of the box along the plane normal
+ ***********************************************************/
+FrustumCuller::BOX_RESULT FrustumCuller::TestBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	glm::vec3 extents = (boxMax - boxMin) * 0.5f;
+
+	BOX_RESULT result = BOX_INSIDE;
+	for (int i = 0; i < 6; i++)
+	{
+		const glm::vec4& plane = m_planes[i];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float reach = std::abs(plane.x) * extents.x + std::abs(plane.y) * extents.y + std::abs(plane.z) * extents.z;
+		if (distance < -reach)
+			return BOX_OUTSIDE;
+		if (distance < reach)
+			result = BOX_INTERSECTS;
+	}
+	return result;
+}
+
+/***********************************************************
+ *  CullSpheres()
+ *
+ *  Test bounding spheres against all six planes, four
+ *  spheres per iteration when SSE is available
+ ***********************************************************/
+void FrustumCuller::CullSpheres(
+	const float* centerX,
+	const float* centerY,
+	const float* centerZ,
+	const float* radius,
+	size_t count,
+	uint8_t* visible) const
+{
+	size_t i = 0;
+
+#ifdef FRUSTUM_CULLER_SSE
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(m_planes[p].x);
+		planeY[p] = _mm_set1_ps(m_planes[p].y);
+		planeZ[p] = _mm_set1_ps(m_planes[p].z);
+		planeW[p] = _mm_set1_ps(m_planes[p].w);
+	}
+
+	for (; i < count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(centerX + i);
+		__m128 y = _mm_loadu_ps(centerY + i);
+		__m128 z = _mm_loadu_ps(centerZ + i);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+		// a lane stays set while its sphere is in front of
+		// (or crossing) every plane tested so far
+		__m128 inside = _mm_cmpeq_ps(x, x);
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])),
+				_mm_add_ps(_mm_mul_ps(z, planeZ[p]), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; (lane < 4) && (i + lane < count); lane++)
+		{
+			visible[i + lane] = (uint8_t)((mask >> lane) & 1);
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		visible[i] = IsSphereVisible(glm::vec3(centerX[i], centerY[i], centerZ[i]), radius[i]) ? 1 : 0;
+	}
+}
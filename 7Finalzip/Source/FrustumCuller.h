@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.h
+// ============
+// test bounding volumes against the camera frustum
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+/***********************************************************
+ *  FrustumCuller
+ *
+ *  This class holds the six planes of a view frustum, taken
+ *  from a view-projection matrix, and tests world-space
+ *  bounding spheres against them. Spheres are passed as
+ *  separate x, y, z and radius arrays so that four of them
+ *  can be tested at once with SSE.
+ ***********************************************************/
+class FrustumCuller
+{
+public:
+	// constructor
+	FrustumCuller();
+
+	enum BOX_RESULT
+	{
+		BOX_OUTSIDE = 0,
+		BOX_INTERSECTS = 1,
+		BOX_INSIDE = 2
+	};
+
+	// extract and normalize the frustum planes of a
+	// view-projection matrix
+	void SetViewProjection(const glm::mat4& viewProjection);
+
+	// get a plane as (normal, distance), pointing inwards
+	const glm::vec4& GetPlane(int index) const { return m_planes[index]; }
+
+	// test a single bounding sphere
+	bool IsSphereVisible(const glm::vec3& center, float radius) const;
+	// test an axis aligned box, telling apart the boxes that
+	// are fully inside from those crossing a plane
+	BOX_RESULT TestBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+	// test many bounding spheres, writing 1 into visible[i]
+	// when sphere i is at least partly inside the frustum.
+	// The arrays must hold count rounded up to a multiple of 4
+	// entries.
+	void CullSpheres(
+		const float* centerX,
+		const float* centerY,
+		const float* centerZ,
+		const float* radius,
+		size_t count,
+		uint8_t* visible) const;
+
+private:
+	// left, right, bottom, top, near and far planes
+	glm::vec4 m_planes[6];
+};
@@ -0,0 +1,247 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculler.cpp
+// ============
+// frustum cull scene objects in a compute shader and compact the
+// survivors into indirect draw commands
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuCuller.h"
+#include "ShaderUtils.h"
+
+// declaration of global variables
+namespace
+{
+	// must match local_size_x of the compute shader
+	const GLuint g_GroupSize = 64;
+
+	// storage buffer bindings of the compute shader
+	const GLuint g_ObjectBinding = 2;
+	const GLuint g_BatchBinding = 3;
+	const GLuint g_CommandBinding = 4;
+	const GLuint g_CountBinding = 5;
+}
+
+/***********************************************************
+ *  GpuCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GpuCuller::GpuCuller()
+{
+	m_program = 0;
+	m_objectCountLocation = -1;
+	m_objectBuffer = 0;
+	m_batchBuffer = 0;
+	m_commandBuffer = 0;
+	m_countBuffer = 0;
+	m_capacity = 0;
+	m_uploadedCount = 0;
+}
+
+/***********************************************************
+ *  ~GpuCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GpuCuller::~GpuCuller()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  The culling shader is GLSL 4.60, which also brings the
+ *  indirect draw count
+ ***********************************************************/
+bool GpuCuller::IsSupported()
+{
+	return GLEW_VERSION_4_6;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  Build the culling program and look up its uniforms
+ ***********************************************************/
+bool GpuCuller::Initialize(const char* computeShaderPath)
+{
+	if (0 != m_program)
+		return true;
+	if (!IsSupported())
+		return false;
+
+	m_program = ShaderUtils::CreateComputeProgram(computeShaderPath);
+	if (0 == m_program)
+		return false;
+
+	m_objectCountLocation = glGetUniformLocation(m_program, "objectCount");
+	return true;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  Free the program and every buffer
+ ***********************************************************/
+void GpuCuller::Destroy()
+{
+	if (0 != m_program)
+		glDeleteProgram(m_program);
+	m_program = 0;
+
+	GLuint buffers[4] = { m_objectBuffer, m_batchBuffer, m_commandBuffer, m_countBuffer };
+	for (int i = 0; i < 4; i++)
+	{
+		if (0 != buffers[i])
+			glDeleteBuffers(1, &buffers[i]);
+	}
+	m_objectBuffer = 0;
+	m_batchBuffer = 0;
+	m_commandBuffer = 0;
+	m_countBuffer = 0;
+	m_capacity = 0;
+	m_uploadedCount = 0;
+	Clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  Remove all objects and batches
+ ***********************************************************/
+void GpuCuller::Clear()
+{
+	m_objects.clear();
+	m_batchFirstCommand.clear();
+	m_batchObjectCount.clear();
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  Add an object to be culled, drawn with the index range
+ *  of the given command
+ ***********************************************************/
+void GpuCuller::AddObject(int batch, const glm::vec3& center, float radius,
+	const MeshManager::DRAW_COMMAND& command, GLuint recordIndex)
+{
+	if (batch < 0)
+		return;
+
+	CULL_OBJECT object;
+	object.sphere = glm::vec4(center, radius);
+	object.firstIndex = command.firstIndex;
+	object.indexCount = command.count;
+	object.baseVertex = command.baseVertex;
+	object.recordIndex = recordIndex;
+	object.batch = (GLuint)batch;
+	object.padding[0] = 0;
+	object.padding[1] = 0;
+	object.padding[2] = 0;
+	m_objects.push_back(object);
+
+	if ((size_t)batch >= m_batchObjectCount.size())
+		m_batchObjectCount.resize(batch + 1, 0);
+	m_batchObjectCount[batch]++;
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  Give every batch a command range as large as its object
+ *  count, and copy the objects and ranges to the GPU. The
+ *  buffers only grow.
+ ***********************************************************/
+bool GpuCuller::Upload()
+{
+	m_uploadedCount = 0;
+	if (m_objects.empty())
+		return false;
+
+	m_batchFirstCommand.resize(m_batchObjectCount.size());
+	GLuint firstCommand = 0;
+	for (size_t i = 0; i < m_batchObjectCount.size(); i++)
+	{
+		m_batchFirstCommand[i] = firstCommand;
+		firstCommand += m_batchObjectCount[i];
+	}
+
+	if (m_objects.size() > m_capacity)
+	{
+		const size_t capacity = m_objects.size();
+		if (0 == m_objectBuffer)
+		{
+			glGenBuffers(1, &m_objectBuffer);
+			glGenBuffers(1, &m_batchBuffer);
+			glGenBuffers(1, &m_commandBuffer);
+			glGenBuffers(1, &m_countBuffer);
+		}
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(CULL_OBJECT), NULL, GL_DYNAMIC_DRAW);
+		// there are never more batches than objects
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_batchBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(MeshManager::DRAW_COMMAND), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_countBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+		m_capacity = capacity;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_objects.size() * sizeof(CULL_OBJECT), m_objects.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_batchBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_batchFirstCommand.size() * sizeof(GLuint), m_batchFirstCommand.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_uploadedCount = (GLuint)m_objects.size();
+	return true;
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  Reset the batch counters and run the culling shader. The
+ *  barrier makes the written commands visible to the
+ *  following indirect draws.
+ ***********************************************************/
+void GpuCuller::Cull()
+{
+	if ((0 == m_program) || (0 == m_uploadedCount))
+		return;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_countBuffer);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(m_program);
+
+	glUniform1ui(m_objectCountLocation, m_uploadedCount);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_ObjectBinding, m_objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_BatchBinding, m_batchBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_CommandBinding, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_CountBinding, m_countBuffer);
+
+	glDispatchCompute((m_uploadedCount + g_GroupSize - 1) / g_GroupSize, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glUseProgram((GLuint)previousProgram);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  Bind the compacted commands as the indirect buffer and
+ *  the counters as the parameter buffer
+ ***********************************************************/
+void GpuCuller::Bind() const
+{
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBindBuffer(GL_PARAMETER_BUFFER, m_countBuffer);
+}
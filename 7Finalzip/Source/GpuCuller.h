@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculler.h
+// ============
+// frustum cull scene objects in a compute shader and compact the
+// survivors into indirect draw commands
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshManager.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  GpuCuller
+ *
+ *  This class keeps one CULL_OBJECT per scene object on the
+ *  GPU: its world-space bounding sphere, the index range of
+ *  its mesh and the record it is drawn with. Cull() runs a
+ *  compute shader over all of them. Each visible object
+ *  appends a single-instance command to the range of its
+ *  batch, counting with an atomic counter per batch. The
+ *  counters are then read by glMultiDrawElementsIndirectCount,
+ *  so the CPU never learns which objects survived.
+ *
+ *  Buffer bindings used by the compute shader:
+ *    storage 2 - objects
+ *    storage 3 - first command of each batch
+ *    storage 4 - compacted commands
+ *    storage 5 - draw count of each batch
+ ***********************************************************/
+class GpuCuller
+{
+public:
+	// constructor
+	GpuCuller();
+	// destructor
+	~GpuCuller();
+
+	// std430 layout, 48 bytes
+	struct CULL_OBJECT
+	{
+		glm::vec4 sphere;
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLint baseVertex;
+		GLuint recordIndex;
+		GLuint batch;
+		GLuint padding[3];
+	};
+
+	// true when compute shaders and indirect draw counts are
+	// available
+	static bool IsSupported();
+
+	// compile the culling compute shader
+	bool Initialize(const char* computeShaderPath);
+	// free the program and the buffers
+	void Destroy();
+
+	// remove all objects, keeping the allocated memory
+	void Clear();
+	// add an object drawn with the mesh range of a command and
+	// the given record, in a batch. Batches are numbered from 0.
+	void AddObject(int batch, const glm::vec3& center, float radius,
+		const MeshManager::DRAW_COMMAND& command, GLuint recordIndex);
+	// copy the objects into their GPU buffer and lay out the
+	// command ranges of the batches
+	bool Upload();
+
+	// cull every object against the frustum of the camera in
+	// the CameraBuffer, filling the command and count buffers
+	void Cull();
+	// bind the command and count buffers for drawing
+	void Bind() const;
+
+	// access the command range of a batch
+	size_t GetBatchCount() const { return m_batchFirstCommand.size(); }
+	GLuint GetBatchFirstCommand(size_t batch) const { return m_batchFirstCommand[batch]; }
+	GLuint GetBatchObjectCount(size_t batch) const { return m_batchObjectCount[batch]; }
+	bool IsReady() const { return 0 != m_program; }
+
+private:
+	GLuint m_program;
+	GLint m_objectCountLocation;
+
+	std::vector<CULL_OBJECT> m_objects;
+	std::vector<GLuint> m_batchFirstCommand;
+	std::vector<GLuint> m_batchObjectCount;
+
+	GLuint m_objectBuffer;
+	GLuint m_batchBuffer;
+	GLuint m_commandBuffer;
+	GLuint m_countBuffer;
+	// objects the command buffer has room for
+	size_t m_capacity;
+	// objects uploaded by the last Upload()
+	GLuint m_uploadedCount;
+};
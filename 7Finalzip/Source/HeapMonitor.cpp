@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// heapmonitor.cpp
+// ============
+// count the heap allocations that the render threads make within a frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HeapMonitor.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _DEBUG
+
+// declaration of global variables
+namespace
+{
+	thread_local bool t_bWatched = false;
+	std::atomic<bool> g_bFrameOpen(false);
+	std::atomic<uint32_t> g_FrameAllocations(0);
+
+	// allocate from the C heap, counting the allocation when a
+	// watched thread makes it during a frame
+	void* CountedAllocate(size_t size)
+	{
+		if (t_bWatched && g_bFrameOpen.load(std::memory_order_relaxed))
+			g_FrameAllocations.fetch_add(1, std::memory_order_relaxed);
+
+		void* memory = malloc((0 == size) ? 1 : size);
+		if (NULL == memory)
+			throw std::bad_alloc();
+		return memory;
+	}
+}
+
+void* operator new(size_t size) { return CountedAllocate(size); }
+void* operator new[](size_t size) { return CountedAllocate(size); }
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+
+/***********************************************************
+ *  IsEnabled()
+ *
+ *  Allocations are counted in debug builds
+ ***********************************************************/
+bool HeapMonitor::IsEnabled()
+{
+	return true;
+}
+
+/***********************************************************
+ *  WatchThread()
+ *
+ *  Count the allocations of the calling thread from now on
+ ***********************************************************/
+void HeapMonitor::WatchThread()
+{
+	t_bWatched = true;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  Start counting from zero
+ ***********************************************************/
+void HeapMonitor::BeginFrame()
+{
+	g_FrameAllocations = 0;
+	g_bFrameOpen = true;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  Stop counting, and get the count of the frame
+ ***********************************************************/
+uint32_t HeapMonitor::EndFrame()
+{
+	g_bFrameOpen = false;
+	return g_FrameAllocations.exchange(0);
+}
+
+#else
+
+bool HeapMonitor::IsEnabled() { return false; }
+void HeapMonitor::WatchThread() {}
+void HeapMonitor::BeginFrame() {}
+uint32_t HeapMonitor::EndFrame() { return 0; }
+
+#endif
@@ -0,0 +1,30 @@
+///////////////////////////////////////////////////////////////////////////////
+// heapmonitor.h
+// ============
+// count the heap allocations that the render threads make within a frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+
+/***********************************************************
+ *  HeapMonitor
+ *
+ *  Debug builds replace the global operator new with one that
+ *  counts the allocations of the watched threads while a
+ *  frame is open. Release builds keep the standard operator
+ *  new, and the counts are always 0.
+ ***********************************************************/
+namespace HeapMonitor
+{
+	// whether allocations are counted in this build
+	bool IsEnabled();
+	// count the allocations that the calling thread makes
+	void WatchThread();
+	// open a frame, and close it returning the allocations
+	// the watched threads made while it was open
+	void BeginFrame();
+	uint32_t EndFrame();
+}
@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+// indirectdrawlist.cpp
+// ============
+// a prebuilt list of indirect draw commands and their per-draw records
+// for submitting a whole static scene in a few calls
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "IndirectDrawList.h"
+
+/***********************************************************
+ *  IndirectDrawList()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+IndirectDrawList::IndirectDrawList()
+{
+	m_commandBuffer = 0;
+	m_recordBuffer = 0;
+	m_commandBufferSize = 0;
+	m_recordBufferSize = 0;
+}
+
+/***********************************************************
+ *  ~IndirectDrawList()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+IndirectDrawList::~IndirectDrawList()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  Remove all commands and records
+ ***********************************************************/
+void IndirectDrawList::Clear()
+{
+	m_commands.clear();
+	m_records.clear();
+	m_batches.clear();
+}
+
+/***********************************************************
+ *  AddDraw()
+ *
+ *  Append a command and its records, starting a new batch
+ *  whenever the texture pool changes
+ ***********************************************************/
+void IndirectDrawList::AddDraw(
+	int pool,
+	const MeshManager::DRAW_COMMAND& command,
+	const DrawDataBuffer::DRAW_DATA* records)
+{
+	if (0 == command.instanceCount)
+		return;
+
+	if (m_batches.empty() || (m_batches.back().pool != pool))
+	{
+		BATCH batch;
+		batch.pool = pool;
+		batch.firstCommand = (GLsizei)m_commands.size();
+		batch.commandCount = 0;
+		m_batches.push_back(batch);
+	}
+	m_batches.back().commandCount++;
+
+	m_commands.push_back(command);
+	m_commands.back().baseInstance = (GLuint)m_records.size();
+	m_records.insert(m_records.end(), records, records + command.instanceCount);
+}
+
+/***********************************************************
+ *  UploadBuffer()
+ *
+ *  Replace the contents of a buffer, reallocating it only
+ *  when the data no longer fits
+ ***********************************************************/
+void IndirectDrawList::UploadBuffer(GLenum target, GLuint& buffer, size_t& bufferSize,
+	const void* data, size_t size)
+{
+	if (0 == buffer)
+		glGenBuffers(1, &buffer);
+
+	glBindBuffer(target, buffer);
+	if (size > bufferSize)
+	{
+		glBufferData(target, (GLsizeiptr)size, data, GL_STATIC_DRAW);
+		bufferSize = size;
+	}
+	else
+	{
+		glBufferSubData(target, 0, (GLsizeiptr)size, data);
+	}
+	glBindBuffer(target, 0);
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  Copy the list into its GPU buffers
+ ***********************************************************/
+bool IndirectDrawList::Upload()
+{
+	if (m_commands.empty())
+		return false;
+
+	UploadBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer, m_commandBufferSize,
+		m_commands.data(), m_commands.size() * sizeof(MeshManager::DRAW_COMMAND));
+	UploadBuffer(GL_SHADER_STORAGE_BUFFER, m_recordBuffer, m_recordBufferSize,
+		m_records.data(), m_records.size() * sizeof(DrawDataBuffer::DRAW_DATA));
+	return true;
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  Bind the commands as the indirect buffer and the records
+ *  in place of the per-draw ring. The caller binds the ring
+ *  back with DrawDataBuffer::Bind() once the indirect draws
+ *  are submitted.
+ ***********************************************************/
+void IndirectDrawList::Bind() const
+{
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataBuffer::BINDING, m_recordBuffer);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  Free the GPU buffers
+ ***********************************************************/
+void IndirectDrawList::Destroy()
+{
+	if (0 != m_commandBuffer)
+		glDeleteBuffers(1, &m_commandBuffer);
+	if (0 != m_recordBuffer)
+		glDeleteBuffers(1, &m_recordBuffer);
+	m_commandBuffer = 0;
+	m_recordBuffer = 0;
+	m_commandBufferSize = 0;
+	m_recordBufferSize = 0;
+	Clear();
+}
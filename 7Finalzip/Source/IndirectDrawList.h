@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// indirectdrawlist.h
+// ============
+// a prebuilt list of indirect draw commands and their per-draw records
+// for submitting a whole static scene in a few calls
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "DrawDataBuffer.h"
+#include "MeshManager.h"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  IndirectDrawList
+ *
+ *  This class holds one indirect command per run of draws
+ *  sharing a mesh and render state, with the records of the
+ *  run's instances in a storage buffer of its own. Unlike
+ *  the DrawDataBuffer ring, the list is only uploaded when
+ *  it is rebuilt, so frames that do not change the scene
+ *  write nothing.
+ *
+ *  Commands are grouped into batches by texture pool, since
+ *  the pool's array texture has to be bound between calls.
+ *  Each batch is one glMultiDrawElementsIndirect call.
+ ***********************************************************/
+class IndirectDrawList
+{
+public:
+	// constructor
+	IndirectDrawList();
+	// destructor
+	~IndirectDrawList();
+
+	// a range of commands drawn with one texture pool bound
+	struct BATCH
+	{
+		int pool;
+		GLsizei firstCommand;
+		GLsizei commandCount;
+	};
+
+	// remove all commands, keeping the allocated memory
+	void Clear();
+	// add a command with the records of its instances, pointing
+	// its base instance at the first of the records. Commands
+	// have to be added sorted by pool.
+	void AddDraw(
+		int pool,
+		const MeshManager::DRAW_COMMAND& command,
+		const DrawDataBuffer::DRAW_DATA* records);
+	// copy the commands and records into their GPU buffers
+	bool Upload();
+	// bind the command buffer and the records for drawing; the
+	// records take the binding of the DrawDataBuffer ring until
+	// it is bound again
+	void Bind() const;
+	// free the GPU buffers
+	void Destroy();
+
+	// access the batches and commands
+	size_t GetBatchCount() const { return m_batches.size(); }
+	const BATCH& GetBatch(size_t index) const { return m_batches[index]; }
+	const MeshManager::DRAW_COMMAND* GetCommands() const { return m_commands.data(); }
+	size_t GetCommandCount() const { return m_commands.size(); }
+	size_t GetRecordCount() const { return m_records.size(); }
+
+private:
+	std::vector<MeshManager::DRAW_COMMAND> m_commands;
+	std::vector<DrawDataBuffer::DRAW_DATA> m_records;
+	std::vector<BATCH> m_batches;
+
+	// GPU copies and their allocated sizes in bytes
+	GLuint m_commandBuffer;
+	GLuint m_recordBuffer;
+	size_t m_commandBufferSize;
+	size_t m_recordBufferSize;
+
+	// upload data into a buffer, growing it when needed
+	static void UploadBuffer(GLenum target, GLuint& buffer, size_t& bufferSize,
+		const void* data, size_t size);
+};
@@ -0,0 +1,221 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.cpp
+// ============
+// split loops over many items across a pool of work-stealing threads
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JobSystem.h"
+#include "HeapMonitor.h"
+
+#include <algorithm>
+
+/***********************************************************
+ *  JobSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+JobSystem::JobSystem()
+{
+	m_queuedJobs = 0;
+	m_pendingJobs = 0;
+	m_bStopping = false;
+
+	// the calling thread always has a queue
+	m_queues.push_back(std::unique_ptr<WORKER_QUEUE>(new WORKER_QUEUE()));
+	m_queues.back()->front = 0;
+}
+
+/***********************************************************
+ *  ~JobSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+JobSystem::~JobSystem()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  Create a queue and a thread for every worker
+ ***********************************************************/
+void JobSystem::Start(unsigned int threadCount)
+{
+	if (!m_workers.empty())
+		return;
+
+	if (0 == threadCount)
+	{
+		// the calling thread is a worker too
+		unsigned int cores = std::thread::hardware_concurrency();
+		threadCount = std::min(std::max(cores, 2u) - 1, 31u);
+	}
+
+	m_bStopping = false;
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		m_queues.push_back(std::unique_ptr<WORKER_QUEUE>(new WORKER_QUEUE()));
+		m_queues.back()->front = 0;
+	}
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&JobSystem::WorkerThread, this, (int)i + 1));
+	}
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  Wake and join the worker threads. No loop may be running.
+ ***********************************************************/
+void JobSystem::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_bStopping = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+	m_queues.resize(1);
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  Deal the ranges out in contiguous blocks, one block per
+ *  queue, so that each worker starts on neighbouring items,
+ *  then work and steal on the calling thread until every
+ *  range has finished
+ ***********************************************************/
+void JobSystem::ParallelFor(size_t count, size_t rangeSize, RANGE_FUNCTION function, void* context)
+{
+	if (0 == count)
+		return;
+
+	rangeSize = std::max(rangeSize, (size_t)1);
+	if ((count <= rangeSize) || m_workers.empty())
+	{
+		function(context, 0, count, 0);
+		return;
+	}
+
+	const size_t rangeCount = (count + rangeSize - 1) / rangeSize;
+	const size_t queueCount = m_queues.size();
+	m_pendingJobs += rangeCount;
+	for (size_t q = 0; q < queueCount; q++)
+	{
+		size_t firstRange = rangeCount * q / queueCount;
+		size_t lastRange = rangeCount * (q + 1) / queueCount;
+		if (firstRange == lastRange)
+			continue;
+
+		std::lock_guard<std::mutex> lock(m_queues[q]->mutex);
+		for (size_t r = firstRange; r < lastRange; r++)
+		{
+			RANGE_JOB job;
+			job.function = function;
+			job.context = context;
+			job.first = r * rangeSize;
+			job.last = std::min(job.first + rangeSize, count);
+			m_queues[q]->jobs.push_back(job);
+		}
+		m_queuedJobs += lastRange - firstRange;
+	}
+
+	{
+		// taking the lock orders the wake after a worker that is
+		// about to wait has checked for jobs
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+	}
+	m_wake.notify_all();
+
+	while (m_pendingJobs > 0)
+	{
+		RANGE_JOB job;
+		if (TakeJob(0, job))
+			RunJob(job, 0);
+		else
+			std::this_thread::yield();
+	}
+}
+
+/***********************************************************
+ *  WorkerThread()
+ *
+ *  Run ranges while there are any, and sleep when every
+ *  queue is empty. The ranges run inside frames, so their
+ *  heap allocations are counted with the render thread's.
+ ***********************************************************/
+void JobSystem::WorkerThread(int worker)
+{
+	HeapMonitor::WatchThread();
+	for (;;)
+	{
+		RANGE_JOB job;
+		if (TakeJob(worker, job))
+		{
+			RunJob(job, worker);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		m_wake.wait(lock, [this] { return m_bStopping || (m_queuedJobs > 0); });
+		if (m_bStopping)
+			return;
+	}
+}
+
+/***********************************************************
+ *  TakeJob()
+ *
+ *  Pop the newest range of the worker's own queue, or else
+ *  steal the oldest range of the next queue that has one
+ ***********************************************************/
+bool JobSystem::TakeJob(int worker, RANGE_JOB& job)
+{
+	const size_t queueCount = m_queues.size();
+	for (size_t k = 0; k < queueCount; k++)
+	{
+		WORKER_QUEUE& queue = *m_queues[(worker + k) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.front == queue.jobs.size())
+			continue;
+
+		if (0 == k)
+		{
+			job = queue.jobs.back();
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			job = queue.jobs[queue.front++];
+		}
+		if (queue.front == queue.jobs.size())
+		{
+			queue.jobs.clear();
+			queue.front = 0;
+		}
+		m_queuedJobs--;
+		return true;
+	}
+	return false;
+}
+
+/***********************************************************
+ *  RunJob()
+ *
+ *  Run a range, then count it as done so that the waiting
+ *  caller sees everything it wrote
+ ***********************************************************/
+void JobSystem::RunJob(const RANGE_JOB& job, int worker)
+{
+	job.function(job.context, job.first, job.last, worker);
+	m_pendingJobs--;
+}
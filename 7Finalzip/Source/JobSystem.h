@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.h
+// ============
+// split loops over many items across a pool of work-stealing threads
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  JobSystem
+ *
+ *  This class owns one worker thread per spare core. The
+ *  ranges of a ParallelFor() are dealt out over one queue
+ *  per worker. Each worker takes its newest range first, and
+ *  a worker whose queue runs dry steals the oldest range of
+ *  another queue, so uneven ranges still keep every core
+ *  busy. The calling thread works on its own queue too, and
+ *  returns once every range has run.
+ *
+ *  Range functions get the index of the worker running them,
+ *  0 being the calling thread, so that they can write into
+ *  per-worker storage without locking. Loops of no more than
+ *  one range run directly on the calling thread.
+ *
+ *  ParallelFor() is meant to be called from one thread at a
+ *  time.
+ ***********************************************************/
+class JobSystem
+{
+public:
+	// constructor
+	JobSystem();
+	// destructor
+	~JobSystem();
+
+	// function run for the items first to last of a range
+	typedef void (*RANGE_FUNCTION)(void* context, size_t first, size_t last, int worker);
+
+	// start the worker threads, 0 picks a count from the CPU
+	void Start(unsigned int threadCount = 0);
+	// stop the worker threads
+	void Stop();
+	// number of workers, counting the calling thread
+	int GetWorkerCount() const { return (int)m_queues.size(); }
+
+	// run function over the items 0 to count in ranges of
+	// rangeSize items, and wait for all of them
+	void ParallelFor(size_t count, size_t rangeSize, RANGE_FUNCTION function, void* context);
+	// the same with any callable taking (first, last, worker)
+	template <typename FUNCTION>
+	void ParallelFor(size_t count, size_t rangeSize, const FUNCTION& function)
+	{
+		ParallelFor(count, rangeSize, &CallRange<FUNCTION>, (void*)&function);
+	}
+
+private:
+	struct RANGE_JOB
+	{
+		RANGE_FUNCTION function;
+		void* context;
+		size_t first;
+		size_t last;
+	};
+
+	// the ranges of a queue are jobs[front] to the end, kept in
+	// a vector that is emptied rather than freed, so dealing
+	// out a loop allocates nothing once the queues have grown
+	struct WORKER_QUEUE
+	{
+		std::mutex mutex;
+		std::vector<RANGE_JOB> jobs;
+		size_t front;
+	};
+
+	// one queue per worker, the first one for the calling thread
+	std::vector<std::unique_ptr<WORKER_QUEUE> > m_queues;
+	std::vector<std::thread> m_workers;
+	// ranges waiting in the queues, and ranges not yet finished
+	std::atomic<size_t> m_queuedJobs;
+	std::atomic<size_t> m_pendingJobs;
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wake;
+	bool m_bStopping;
+
+	// run ranges until the job system is stopped
+	void WorkerThread(int worker);
+	// take a range from a worker's own queue or steal one
+	bool TakeJob(int worker, RANGE_JOB& job);
+	// run a range and count it as finished
+	void RunJob(const RANGE_JOB& job, int worker);
+
+	template <typename FUNCTION>
+	static void CallRange(void* context, size_t first, size_t last, int worker)
+	{
+		(*(const FUNCTION*)context)(first, last, worker);
+	}
+};
@@ -0,0 +1,202 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.cpp
+// ============
+// scene lights in a storage buffer, binned into view-space clusters
+// by a compute pass for clustered forward shading
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightClusters.h"
+#include "ShaderUtils.h"
+
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// must match local_size_x of the compute shader
+	const GLuint g_GroupSize = 64;
+}
+
+/***********************************************************
+ *  LightClusters()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightClusters::LightClusters()
+{
+	m_program = 0;
+	m_lightCountLocation = -1;
+	m_bLightsDirty = true;
+	m_lightBuffer = 0;
+	m_lightBufferSize = 0;
+	m_clusterBuffer = 0;
+	m_depthRange = glm::vec2(0.1f, 100.0f);
+}
+
+/***********************************************************
+ *  ~LightClusters()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightClusters::~LightClusters()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  Build the binning program and allocate the froxel lists
+ ***********************************************************/
+bool LightClusters::Initialize(const char* computeShaderPath)
+{
+	if (0 != m_program)
+		return true;
+	// the binning shader is GLSL 4.60
+	if (!GLEW_VERSION_4_6)
+		return false;
+
+	m_program = ShaderUtils::CreateComputeProgram(computeShaderPath);
+	if (0 == m_program)
+		return false;
+
+	m_lightCountLocation = glGetUniformLocation(m_program, "lightCount");
+
+	glGenBuffers(1, &m_clusterBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER,
+		(GLsizeiptr)CLUSTER_COUNT * (MAX_CLUSTER_LIGHTS + 1) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return true;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  Free the program and the buffers
+ ***********************************************************/
+void LightClusters::Destroy()
+{
+	if (0 != m_program)
+		glDeleteProgram(m_program);
+	if (0 != m_lightBuffer)
+		glDeleteBuffers(1, &m_lightBuffer);
+	if (0 != m_clusterBuffer)
+		glDeleteBuffers(1, &m_clusterBuffer);
+	m_program = 0;
+	m_lightBuffer = 0;
+	m_lightBufferSize = 0;
+	m_clusterBuffer = 0;
+	m_bLightsDirty = true;
+}
+
+/***********************************************************
+ *  AddLight()
+ *
+ *  Add a light to the scene
+ ***********************************************************/
+int LightClusters::AddLight(const LIGHT_DATA& light)
+{
+	m_lights.push_back(light);
+	m_bLightsDirty = true;
+	return (int)m_lights.size() - 1;
+}
+
+/***********************************************************
+ *  RemoveAllLights()
+ *
+ *  Empty the light list, keeping the buffers for the lights
+ *  added next
+ ***********************************************************/
+void LightClusters::RemoveAllLights()
+{
+	m_lights.clear();
+	m_bLightsDirty = true;
+}
+
+/***********************************************************
+ *  SetLight()
+ *
+ *  Replace the values of a light
+ ***********************************************************/
+void LightClusters::SetLight(int handle, const LIGHT_DATA& light)
+{
+	if ((handle < 0) || (handle >= (int)m_lights.size()))
+		return;
+	m_lights[handle] = light;
+	m_bLightsDirty = true;
+}
+
+/***********************************************************
+ *  SetLightPosition()
+ *
+ *  Move a light, keeping its radius
+ ***********************************************************/
+void LightClusters::SetLightPosition(int handle, const glm::vec3& position)
+{
+	if ((handle < 0) || (handle >= (int)m_lights.size()))
+		return;
+	m_lights[handle].position = glm::vec4(position, m_lights[handle].position.w);
+	m_bLightsDirty = true;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  Upload changed lights and run the binning pass. The depth
+ *  range of the slices is the near and far plane distance
+ *  of the camera, whose matrices the pass reads from the
+ *  camera buffer.
+ ***********************************************************/
+void LightClusters::Update(float nearDepth, float farDepth)
+{
+	if (m_bLightsDirty && !m_lights.empty())
+	{
+		size_t size = m_lights.size() * sizeof(LIGHT_DATA);
+		if (0 == m_lightBuffer)
+			glGenBuffers(1, &m_lightBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightBuffer);
+		if (size > m_lightBufferSize)
+		{
+			glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)size, m_lights.data(), GL_DYNAMIC_DRAW);
+			m_lightBufferSize = size;
+		}
+		else
+		{
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)size, m_lights.data());
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		m_bLightsDirty = false;
+	}
+
+	// exponential slices need a positive near distance
+	nearDepth = std::max(nearDepth, 0.01f);
+	m_depthRange = glm::vec2(nearDepth, std::max(farDepth, nearDepth * 2.0f));
+
+	if ((0 == m_program) || (0 == m_lightBuffer))
+		return;
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(m_program);
+
+	glUniform1i(m_lightCountLocation, (GLint)m_lights.size());
+
+	Bind();
+	glDispatchCompute((CLUSTER_COUNT + g_GroupSize - 1) / g_GroupSize, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glUseProgram((GLuint)previousProgram);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  Bind the lights and the froxel lists
+ ***********************************************************/
+void LightClusters::Bind() const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, m_lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, m_clusterBuffer);
+}
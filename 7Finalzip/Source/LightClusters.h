@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.h
+// ============
+// scene lights in a storage buffer, binned into view-space clusters
+// by a compute pass for clustered forward shading
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  LightClusters
+ *
+ *  This class keeps every light of the scene in one storage
+ *  buffer. Each frame a compute shader splits the view
+ *  frustum into a CLUSTER_X x CLUSTER_Y x CLUSTER_Z grid of
+ *  froxels, with exponentially growing depth slices, and
+ *  lists for every froxel the lights whose range reaches
+ *  it. The fragment shader finds its froxel from its window
+ *  position and view depth, and only shades with the lights
+ *  listed there.
+ *
+ *  A light with a radius of 0 has no range limit, like the
+ *  original scene lights, and is listed in every froxel.
+ *
+ *  Storage buffer bindings:
+ *    6 - lights
+ *    7 - per froxel: light count, then up to
+ *        MAX_CLUSTER_LIGHTS light indices
+ ***********************************************************/
+class LightClusters
+{
+public:
+	// constructor
+	LightClusters();
+	// destructor
+	~LightClusters();
+
+	static const int CLUSTER_X = 16;
+	static const int CLUSTER_Y = 9;
+	static const int CLUSTER_Z = 24;
+	static const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+	static const int MAX_CLUSTER_LIGHTS = 63;
+	static const GLuint LIGHT_BINDING = 6;
+	static const GLuint CLUSTER_BINDING = 7;
+
+	// std430 layout, 64 bytes
+	struct LIGHT_DATA
+	{
+		// world position, with the radius in w
+		glm::vec4 position;
+		// colors, with the focal strength in the ambient w and
+		// the specular intensity in the diffuse w
+		glm::vec4 ambientColor;
+		glm::vec4 diffuseColor;
+		// specular color, with the shadowed light index in w,
+		// or -1 for a light without shadows
+		glm::vec4 specularColor;
+	};
+
+	// load the binning compute shader; without one every
+	// fragment shades with every light
+	bool Initialize(const char* computeShaderPath);
+	// free the program and the buffers
+	void Destroy();
+	bool IsClustered() const { return 0 != m_program; }
+
+	// add a light and return its handle
+	int AddLight(const LIGHT_DATA& light);
+	// remove every light, invalidating their handles
+	void RemoveAllLights();
+	// change a light
+	void SetLight(int handle, const LIGHT_DATA& light);
+	void SetLightPosition(int handle, const glm::vec3& position);
+	const LIGHT_DATA& GetLight(int handle) const { return m_lights[handle]; }
+	int GetLightCount() const { return (int)m_lights.size(); }
+
+	// upload the lights when they changed and bin them into the
+	// froxels of the camera in the CameraBuffer, whose near and
+	// far distances are given
+	void Update(float nearDepth, float farDepth);
+	// bind the light and cluster buffers for shading
+	void Bind() const;
+
+	// view-space depth range covered by the depth slices
+	const glm::vec2& GetDepthRange() const { return m_depthRange; }
+
+private:
+	GLuint m_program;
+	GLint m_lightCountLocation;
+
+	std::vector<LIGHT_DATA> m_lights;
+	bool m_bLightsDirty;
+	GLuint m_lightBuffer;
+	size_t m_lightBufferSize;
+	GLuint m_clusterBuffer;
+	glm::vec2 m_depthRange;
+};
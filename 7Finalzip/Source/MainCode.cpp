@@ -1,5 +1,16 @@
 #include <iostream>         // for cout/cerr
 #include <cstdlib>          // for EXIT_FAILURE
+#include <cstring>          // for strcmp
+#include <cmath>            // for the benchmark light grid
+#include <algorithm>        // for std::max, std::sort
+#include <atomic>
+#include <cassert>          // for the settled frame heap check
+#include <fstream>          // for the benchmark report
+#include <iomanip>          // for std::setprecision
+#include <sstream>
+#include <string>
+#include <thread>           // for the render thread
+#include <vector>
 
 #include <GL/glew.h>
 #include "GLFW/glfw3.h"
@@ -14,6 +25,22 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "ShaderLibrary.h"
+#include "UniformCache.h"
+#include "FrameProfiler.h"
+#include "DebugText.h"
+#include "CameraPath.h"
+#include "RenderTarget.h"
+#include "TextureCache.h"
+#include "SceneFile.h"
+#include "FileWatcher.h"
+#include "ShaderReloader.h"
+#include "FrameSnapshots.h"
+#include "FrameArena.h"
+#include "FrameCapture.h"
+#include "HeapMonitor.h"
+#include "DynamicResolution.h"
+#include "stb_image.h"
 
 // Globals
 namespace
@@ -24,7 +51,79 @@ namespace
 
     SceneManager* g_SceneManager = nullptr;
     ShaderManager* g_ShaderManager = nullptr;
+    UniformCache* g_UniformCache = nullptr;
+    // builds every vertex and fragment program, through the
+    // binary cache, and the variant of the scene program
+    ShaderLibrary* g_ShaderLibrary = nullptr;
+    int g_SceneVariant = -1;
     ViewManager* g_ViewManager = nullptr;
+
+    // frame timing and the overlay that shows it
+    FrameProfiler* g_FrameProfiler = nullptr;
+    DebugText* g_DebugText = nullptr;
+    const char* const TRACE_FILENAME = "frame_trace.json";
+    // the window scene renders below the window size when the
+    // GPU falls behind, and F5 turns that off
+    DynamicResolution* g_DynamicResolution = nullptr;
+    // K appends the current camera to this path file
+    const char* const CAMERA_PATH_FILENAME = "camera_path.txt";
+    CameraPath g_RecordedPath;
+
+    // edited shaders, textures and scenes are reloaded while
+    // the program runs
+    FileWatcher* g_FileWatcher = nullptr;
+    ShaderReloader* g_ShaderReloader = nullptr;
+    std::vector<std::string> g_ChangedFiles;
+
+    // the main thread reads input and moves the camera in fixed
+    // steps, and a render thread draws the snapshots it publishes
+    const double UPDATE_TIMESTEP = 1.0 / 120.0;
+    // ticks run at most in a row before the update gives up on
+    // catching up after a stall
+    const int MAX_UPDATE_STEPS = 8;
+    FrameSnapshots g_Snapshots;
+    std::atomic<bool> g_bRendering(false);
+    // transient data of the frame being rendered, reset after
+    // every swap
+    FrameArena* g_FrameArena = nullptr;
+    // frames in a row without heap allocations after which the
+    // render loop counts as settled, so that any allocation is
+    // a bug rather than a buffer growing to its working size
+    const int SETTLED_FRAMES = 120;
+    // render settings the keyboard asks for, applied by the
+    // render thread from the snapshots
+    bool g_bShowProfiler = false;
+    bool g_bMultiDrawIndirect = true;
+    bool g_bDepthPrePass = true;
+    bool g_bDynamicResolution = true;
+    bool g_bStaticBatching = false;
+    uint32_t g_TraceRequests = 0;
+    // F6 starts and stops recording the draws of every frame
+    // into this capture, which --bench --replay plays back
+    const char* const CAPTURE_FILENAME = "frame_capture.fcp";
+    FrameCapture* g_FrameCapture = nullptr;
+    uint32_t g_CaptureRequests = 0;
+
+    // settings of the --bench mode
+    struct BENCH_OPTIONS
+    {
+        int frames;
+        int warmupFrames;
+        int width;
+        int height;
+        std::string pathFile;
+        std::string outputFile;
+        std::string sceneFile;
+        bool bIndirect;
+        bool bDepthPrePass;
+        bool bLevelOfDetail;
+        bool bPackedVertices;
+        bool bSpatialIndex;
+        bool bStaticBatching;
+        int pointLights;
+        // capture played instead of the camera path
+        std::string replayFile;
+    };
 }
 
 // CAMERA GLOBALS
@@ -40,7 +139,6 @@ float lastY = 300.0f;
 bool firstMouse = true;
 
 float deltaTime = 0.0f;
-float lastFrame = 0.0f;
 
 float movementSpeed = 4.0f;
 float fov = 45.0f;
@@ -51,19 +149,52 @@ bool useOrtho = false;
 // Function declarations
 bool InitializeGLFW();
 bool InitializeGLEW();
+int BakeTextures(int argc, char* argv[]);
+int CompileScene(int argc, char* argv[]);
 void processInput(GLFWwindow* window);
+void DrawProfilerOverlay(int framebufferWidth, int framebufferHeight);
+void StartHotReload();
+bool UpdateHotReload();
+void RunInteractive();
+FrameSnapshots::CAMERA_STATE GetCameraState();
+void PublishSnapshot(uint64_t tick, double tickTime, const FrameSnapshots::CAMERA_STATE& previousCamera);
+void RenderThread();
+void RenderFrame(const FrameSnapshots::CAMERA_STATE& camera, bool bOrtho, int viewportWidth, int viewportHeight);
+void ReplayFrame(uint32_t frame);
+bool ParseBenchOptions(int argc, char* argv[], BENCH_OPTIONS& options);
+int RunBenchmark(const BENCH_OPTIONS& options);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 
-int main()
+int main(int argc, char* argv[])
 {
+    // offline mode: bake the listed images into the texture cache
+    if ((argc > 1) && (0 == strcmp(argv[1], "--bake-textures")))
+        return BakeTextures(argc - 2, argv + 2);
+    // offline mode: compile a text scene into its binary form
+    if ((argc > 1) && (0 == strcmp(argv[1], "--compile-scene")))
+        return CompileScene(argc - 2, argv + 2);
+
+    // benchmark mode: render a fixed camera path offscreen
+    bool bBenchmark = (argc > 1) && (0 == strcmp(argv[1], "--bench"));
+    BENCH_OPTIONS benchOptions;
+    // --replay maps its capture while the options are read
+    g_FrameCapture = new FrameCapture();
+    if (bBenchmark && !ParseBenchOptions(argc - 2, argv + 2, benchOptions))
+        return EXIT_FAILURE;
+
     if (!InitializeGLFW())
         return EXIT_FAILURE;
 
     g_ShaderManager = new ShaderManager();
-    g_ViewManager = new ViewManager(g_ShaderManager);
+    g_UniformCache = new UniformCache();
+    g_ViewManager = new ViewManager(g_ShaderManager, g_UniformCache);
 
+    if (bBenchmark)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
     g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+    if (bBenchmark)
+        glfwSwapInterval(0);
 
     // FPS mouse look
     glfwSetInputMode(g_Window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
@@ -73,73 +204,739 @@ int main()
     if (!InitializeGLEW())
         return EXIT_FAILURE;
 
-    g_ShaderManager->LoadShaders(
-        "../../Utilities/shaders/vertexShader.glsl",
-        "../../Utilities/shaders/fragmentShader.glsl");
+    // a program built at an earlier launch comes from the
+    // binary cache without compiling
+    g_ShaderLibrary = new ShaderLibrary();
+    g_SceneVariant = g_ShaderLibrary->AddVariant(
+        "Shaders/vertexShader.glsl",
+        "Shaders/fragmentShader.glsl");
+    g_ShaderManager->m_programID = g_ShaderLibrary->WaitForProgram(g_SceneVariant);
     g_ShaderManager->use();
 
-    g_SceneManager = new SceneManager(g_ShaderManager);
+    // resolve every uniform location of the linked program once
+    GLint programID = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &programID);
+    g_UniformCache->Attach((GLuint)programID);
+
+    g_FrameArena = new FrameArena();
+    g_SceneManager = new SceneManager(g_ShaderManager, g_ShaderLibrary, g_UniformCache, g_FrameArena);
+    // the vertex format is fixed once the meshes are loaded
+    if (bBenchmark)
+    {
+        g_SceneManager->SetPackedVertices(benchOptions.bPackedVertices);
+        if (!benchOptions.sceneFile.empty())
+            g_SceneManager->SetSceneFile(benchOptions.sceneFile);
+    }
     g_SceneManager->PrepareScene();
 
+    // F3 shows the frame timings, F4 writes them as a trace
+    g_FrameProfiler = new FrameProfiler();
+    g_DebugText = new DebugText();
+    if (!g_DebugText->Initialize(g_ShaderLibrary))
+        std::cerr << "Could not load the overlay shaders" << std::endl;
+    g_DynamicResolution = new DynamicResolution();
+    if (!bBenchmark && !g_DynamicResolution->Initialize(g_ShaderLibrary))
+        std::cerr << "Could not load the upscale shaders" << std::endl;
+
+    int exitCode = EXIT_SUCCESS;
+    if (bBenchmark)
+        exitCode = RunBenchmark(benchOptions);
+    else
+        RunInteractive();
+
+    if (g_FileWatcher) { delete g_FileWatcher; g_FileWatcher = nullptr; }
+    if (g_ShaderReloader) { delete g_ShaderReloader; g_ShaderReloader = nullptr; }
+    if (g_DynamicResolution) { delete g_DynamicResolution; g_DynamicResolution = nullptr; }
+    if (g_DebugText) { delete g_DebugText; g_DebugText = nullptr; }
+    if (g_FrameProfiler) { delete g_FrameProfiler; g_FrameProfiler = nullptr; }
+    if (g_SceneManager) { delete g_SceneManager; g_SceneManager = nullptr; }
+    if (g_FrameCapture) { delete g_FrameCapture; g_FrameCapture = nullptr; }
+    if (g_FrameArena) { delete g_FrameArena; g_FrameArena = nullptr; }
+    if (g_ShaderLibrary) { delete g_ShaderLibrary; g_ShaderLibrary = nullptr; }
+    if (g_ViewManager) { delete g_ViewManager; g_ViewManager = nullptr; }
+    if (g_UniformCache) { delete g_UniformCache; g_UniformCache = nullptr; }
+    if (g_ShaderManager) { delete g_ShaderManager; g_ShaderManager = nullptr; }
+
+    exit(exitCode);
+}
+
+// Watch the scene shaders, the scene file and its textures for edits
+void StartHotReload()
+{
+    g_FileWatcher = new FileWatcher();
+    g_ShaderReloader = new ShaderReloader(g_ShaderLibrary);
+    g_ShaderReloader->AddProgram(g_ShaderManager, g_SceneVariant, g_UniformCache);
+
+    std::vector<std::string> shaderFiles;
+    g_ShaderReloader->GetWatchedFiles(shaderFiles);
+    for (size_t i = 0; i < shaderFiles.size(); i++)
+    {
+        g_FileWatcher->Watch(shaderFiles[i]);
+    }
+    g_SceneManager->WatchFiles(g_FileWatcher);
+    g_FileWatcher->Start();
+}
+
+// Hand the files that changed to their owners, and swap in the
+// shader programs that finished compiling. Returns whether anything
+// was reloaded.
+bool UpdateHotReload()
+{
+    g_ChangedFiles.clear();
+    g_FileWatcher->PollChanges(g_ChangedFiles);
+    if (!g_ChangedFiles.empty())
+    {
+        g_ShaderReloader->OnFilesChanged(g_ChangedFiles);
+        g_SceneManager->OnFilesChanged(g_ChangedFiles);
+    }
+    bool bSwapped = g_ShaderReloader->Update();
+    return bSwapped || !g_ChangedFiles.empty();
+}
+
+// Run the fixed time step update on this thread, which GLFW requires
+// for events and input, while a render thread owns the context and
+// draws the latest published tick
+void RunInteractive()
+{
+    StartHotReload();
+    g_bMultiDrawIndirect = g_SceneManager->IsMultiDrawIndirect();
+    g_bDepthPrePass = g_SceneManager->IsDepthPrePass();
+
+    // the first frame needs a snapshot to draw
+    uint64_t tick = 0;
+    double tickTime = glfwGetTime();
+    FrameSnapshots::CAMERA_STATE previousCamera = GetCameraState();
+    PublishSnapshot(tick, tickTime, previousCamera);
+
+    // the context belongs to the render thread until it stops
+    glfwMakeContextCurrent(NULL);
+    g_bRendering = true;
+    std::thread renderThread(RenderThread);
+
     while (!glfwWindowShouldClose(g_Window))
     {
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        // sleep in the event wait until the next tick is due
+        double wait = tickTime + UPDATE_TIMESTEP - glfwGetTime();
+        if (wait > 0.0)
+            glfwWaitEventsTimeout(wait);
+        else
+            glfwPollEvents();
+
+        // every tick moves the camera by the same amount, however
+        // long the frames take
+        int steps = 0;
+        while ((glfwGetTime() >= tickTime + UPDATE_TIMESTEP) && (steps < MAX_UPDATE_STEPS))
+        {
+            deltaTime = (float)UPDATE_TIMESTEP;
+            processInput(g_Window);
+            tickTime += UPDATE_TIMESTEP;
+            PublishSnapshot(++tick, tickTime, previousCamera);
+            previousCamera = GetCameraState();
+            steps++;
+        }
+
+        // after a stall the missed ticks are dropped rather than
+        // run in a burst
+        if (glfwGetTime() >= tickTime + UPDATE_TIMESTEP)
+            tickTime = glfwGetTime();
+    }
+
+    g_bRendering = false;
+    renderThread.join();
+    glfwMakeContextCurrent(g_Window);
+}
+
+// Get the camera as the update thread last moved it
+FrameSnapshots::CAMERA_STATE GetCameraState()
+{
+    FrameSnapshots::CAMERA_STATE camera;
+    camera.position = cameraPos;
+    camera.front = cameraFront;
+    camera.fov = fov;
+    return camera;
+}
+
+// Publish the state of a finished tick for the render thread
+void PublishSnapshot(uint64_t tick, double tickTime, const FrameSnapshots::CAMERA_STATE& previousCamera)
+{
+    FrameSnapshots::FRAME_SNAPSHOT snapshot;
+    snapshot.tick = tick;
+    snapshot.tickTime = tickTime;
+    snapshot.previousCamera = previousCamera;
+    snapshot.camera = GetCameraState();
+    snapshot.bOrtho = useOrtho;
+    ViewManager::GetFramebufferSize(snapshot.framebufferWidth, snapshot.framebufferHeight);
+    snapshot.bShowProfiler = g_bShowProfiler;
+    snapshot.bMultiDrawIndirect = g_bMultiDrawIndirect;
+    snapshot.bDepthPrePass = g_bDepthPrePass;
+    snapshot.bDynamicResolution = g_bDynamicResolution;
+    snapshot.bStaticBatching = g_bStaticBatching;
+    snapshot.traceRequests = g_TraceRequests;
+    snapshot.captureRequests = g_CaptureRequests;
+    snapshot.pickRequests = ViewManager::GetPickRequest(snapshot.pickPoint);
+    g_Snapshots.Publish(snapshot);
+}
+
+// Draw the latest snapshot each frame, blending its two cameras by
+// how far the clock has moved past its tick. Only this thread makes
+// OpenGL calls while it runs.
+//
+// In debug builds the heap allocations of each frame are counted.
+// Once the frames have been allocation free for a while, a frame
+// that allocates asserts, unless a setting, a reload or a texture
+// upload explains it.
+//
+// A click picks the scene node under the cursor, from the camera
+// the frame was drawn with.
+//
+// The scene is drawn at the scale that the GPU time of the frames
+// before allows, and then scaled up into the window.
+void RenderThread()
+{
+    glfwMakeContextCurrent(g_Window);
+    HeapMonitor::WatchThread();
+
+    bool bMultiDrawIndirect = g_SceneManager->IsMultiDrawIndirect();
+    bool bDepthPrePass = g_SceneManager->IsDepthPrePass();
+    bool bShowProfiler = false;
+    uint32_t traceRequests = 0;
+    uint32_t captureRequests = 0;
+    uint32_t pickRequests = 0;
+    bool bDynamicResolution = true;
+    bool bStaticBatching = g_SceneManager->IsStaticBatching();
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+    int cleanFrames = 0;
+    FrameSnapshots::FRAME_SNAPSHOT snapshot;
+
+    while (g_bRendering && g_Snapshots.Acquire(snapshot))
+    {
+        HeapMonitor::BeginFrame();
+        g_FrameProfiler->BeginFrame();
+
+        // a change of settings grows buffers to their new sizes
+        bool bExpectAllocations = g_SceneManager->IsLoadingTextures() ||
+            (snapshot.bMultiDrawIndirect != bMultiDrawIndirect) ||
+            (snapshot.bDepthPrePass != bDepthPrePass) ||
+            (snapshot.bShowProfiler != bShowProfiler) ||
+            (snapshot.traceRequests != traceRequests) ||
+            (snapshot.captureRequests != captureRequests) ||
+            g_SceneManager->IsCapturing() ||
+            (snapshot.pickRequests != pickRequests) ||
+            (snapshot.bDynamicResolution != bDynamicResolution) ||
+            (snapshot.bStaticBatching != bStaticBatching) ||
+            (snapshot.framebufferWidth != framebufferWidth) ||
+            (snapshot.framebufferHeight != framebufferHeight);
+        bShowProfiler = snapshot.bShowProfiler;
+        framebufferWidth = snapshot.framebufferWidth;
+        framebufferHeight = snapshot.framebufferHeight;
+
+        // settings are compared rather than toggled, since the
+        // render thread does not see every tick
+        if (snapshot.bMultiDrawIndirect != bMultiDrawIndirect)
+        {
+            bMultiDrawIndirect = snapshot.bMultiDrawIndirect;
+            bool bIndirect = g_SceneManager->SetMultiDrawIndirect(bMultiDrawIndirect);
+            std::cout << (bIndirect ? "Switched to multi-draw-indirect submission\n" : "Switched to instanced submission\n");
+        }
+        if (snapshot.bDepthPrePass != bDepthPrePass)
+        {
+            bDepthPrePass = snapshot.bDepthPrePass;
+            bool bEnabled = g_SceneManager->SetDepthPrePass(bDepthPrePass);
+            std::cout << (bEnabled ? "Depth pre-pass enabled\n" : "Depth pre-pass disabled\n");
+        }
+        if (snapshot.bDynamicResolution != bDynamicResolution)
+        {
+            bDynamicResolution = snapshot.bDynamicResolution;
+            g_DynamicResolution->SetEnabled(bDynamicResolution);
+            std::cout << (bDynamicResolution ? "Dynamic resolution enabled\n" : "Dynamic resolution disabled\n");
+        }
+        if (snapshot.bStaticBatching != bStaticBatching)
+        {
+            bStaticBatching = snapshot.bStaticBatching;
+            g_SceneManager->SetStaticBatching(bStaticBatching);
+            std::cout << (bStaticBatching ? "Static batching enabled\n" : "Static batching disabled\n");
+        }
+        if (snapshot.traceRequests != traceRequests)
+        {
+            traceRequests = snapshot.traceRequests;
+            if (g_FrameProfiler->ExportChromeTrace(TRACE_FILENAME))
+                std::cout << "Wrote frame trace to " << TRACE_FILENAME << "\n";
+            else
+                std::cerr << "Could not write frame trace to " << TRACE_FILENAME << "\n";
+        }
+        if (snapshot.captureRequests != captureRequests)
+        {
+            captureRequests = snapshot.captureRequests;
+            if (g_SceneManager->IsCapturing())
+            {
+                uint32_t frames = g_FrameCapture->GetRecordedFrames();
+                if (g_SceneManager->EndCapture())
+                    std::cout << "Wrote " << frames << " captured frames to " << CAPTURE_FILENAME << "\n";
+                else
+                    std::cerr << "Could not write frame capture to " << CAPTURE_FILENAME << "\n";
+            }
+            else if (g_SceneManager->BeginCapture(g_FrameCapture, CAPTURE_FILENAME))
+                std::cout << "Capturing frames to " << CAPTURE_FILENAME << "\n";
+            else
+                std::cerr << "Could not start a frame capture while textures are loading\n";
+        }
+
+        {
+            FrameProfiler::CpuScope scope(*g_FrameProfiler, "HotReload");
+            if (UpdateHotReload())
+                bExpectAllocations = true;
+        }
+
+        float alpha = (float)((glfwGetTime() - snapshot.tickTime) / UPDATE_TIMESTEP);
+        FrameSnapshots::CAMERA_STATE camera = FrameSnapshots::Interpolate(snapshot, alpha);
+        g_DynamicResolution->Update(g_FrameProfiler->GetLastTime("Scene", true));
+        bool bScaled = g_DynamicResolution->BeginScene(framebufferWidth, framebufferHeight);
+        RenderFrame(camera, snapshot.bOrtho, g_DynamicResolution->GetRenderWidth(), g_DynamicResolution->GetRenderHeight());
+        if (bScaled)
+        {
+            g_FrameProfiler->BeginGpuScope("Upscale");
+            g_DynamicResolution->Present();
+            g_FrameProfiler->EndGpuScope();
+        }
+
+        if (snapshot.pickRequests != pickRequests)
+        {
+            pickRequests = snapshot.pickRequests;
+            const CameraBuffer::CAMERA_DATA& frameCamera = g_ViewManager->GetCamera();
+
+            glm::vec3 rayOrigin;
+            glm::vec3 rayDirection;
+            ViewManager::GetPickRay(snapshot.pickPoint, frameCamera.view, frameCamera.projection, rayOrigin, rayDirection);
+            float distance = 0.0f;
+            int node = g_SceneManager->PickNode(rayOrigin, rayDirection, distance);
+            if (node >= 0)
+                std::cout << "Picked node " << node << " at distance " << distance << "\n";
+            else
+                std::cout << "Picked nothing\n";
+        }
+
+        if (snapshot.bShowProfiler)
+        {
+            g_FrameProfiler->BeginGpuScope("Overlay");
+            DrawProfilerOverlay(snapshot.framebufferWidth, snapshot.framebufferHeight);
+            g_FrameProfiler->EndGpuScope();
+        }
+
+        {
+            FrameProfiler::CpuScope scope(*g_FrameProfiler, "Swap");
+            glfwSwapBuffers(g_Window);
+        }
+
+        g_FrameProfiler->EndFrame();
+        uint32_t allocations = HeapMonitor::EndFrame();
+        g_FrameArena->Reset();
+
+        if ((0 != allocations) && !bExpectAllocations && (cleanFrames >= SETTLED_FRAMES))
+        {
+            std::cerr << "Settled frame made " << allocations << " heap allocations\n";
+            assert(!"heap allocation in a settled frame");
+        }
+        if ((0 != allocations) || bExpectAllocations)
+            cleanFrames = 0;
+        else
+            cleanFrames++;
+    }
+
+    // a capture still recording at exit is kept
+    if (g_SceneManager->IsCapturing() && g_SceneManager->EndCapture())
+        std::cout << "Wrote frame capture to " << CAPTURE_FILENAME << "\n";
+
+    glfwMakeContextCurrent(NULL);
+}
+
+// Clear the bound framebuffer and draw the scene from a camera. The
+// view manager only rebuilds and uploads the camera when it changed,
+// and the scene culls with the frustum it built.
+void RenderFrame(const FrameSnapshots::CAMERA_STATE& camera, bool bOrtho, int viewportWidth, int viewportHeight)
+{
+    g_FrameProfiler->BeginGpuScope("Scene");
+
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    {
+        FrameProfiler::CpuScope scope(*g_FrameProfiler, "SceneView");
+        g_ViewManager->SetCamera(camera.position, camera.front, cameraUp, camera.fov, bOrtho, viewportWidth, viewportHeight);
+        g_ViewManager->PrepareSceneView();
+    }
+
+    // skip scene objects outside the camera frustum, and fit
+    // the shadow cascades to it
+    g_SceneManager->SetCamera(g_ViewManager->GetCamera(), g_ViewManager->GetFrustum());
+
+    // a recording keeps the camera next to the frame's draws
+    bool bCapturing = g_SceneManager->IsCapturing();
+    if (bCapturing)
+        g_FrameCapture->BeginFrame(camera.position, camera.front, camera.fov, bOrtho, viewportWidth, viewportHeight);
+
+    {
+        FrameProfiler::CpuScope scope(*g_FrameProfiler, "RenderScene");
+        g_SceneManager->RenderScene();
+    }
+
+    if (bCapturing)
+        g_FrameCapture->EndFrame();
+
+    g_FrameProfiler->EndGpuScope();
+}
+
+// Draw a frame of the replayed capture from the camera it was
+// recorded with. The scene only submits the captured draws, so the
+// GPU timings and draw counts are those of that frame alone.
+void ReplayFrame(uint32_t frame)
+{
+    const FrameCapture::FRAME_HEADER& header = g_FrameCapture->GetFrame(frame);
 
-        processInput(g_Window);
+    g_FrameProfiler->BeginGpuScope("Scene");
 
-        glEnable(GL_DEPTH_TEST);
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    {
+        FrameProfiler::CpuScope scope(*g_FrameProfiler, "SceneView");
+        g_ViewManager->SetCamera(header.position, header.front, cameraUp, header.fov, 0 != header.bOrtho,
+            (int)header.width, (int)header.height);
         g_ViewManager->PrepareSceneView();
+    }
+    g_SceneManager->SetCamera(g_ViewManager->GetCamera(), g_ViewManager->GetFrustum());
+
+    {
+        FrameProfiler::CpuScope scope(*g_FrameProfiler, "ReplayScene");
+        g_SceneManager->ReplayFrame(*g_FrameCapture, frame);
+    }
 
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glm::mat4 projection;
+    g_FrameProfiler->EndGpuScope();
+}
+
+// Read the options that follow --bench:
+//   --frames N  --warmup N  --size WxH  --path file  --out file  --scene file
+//   --lights N  --no-indirect  --no-prepass  --no-lod  --no-packed  --no-bvh
+//   --static-batches  --replay file
+//
+// A replay takes the scene, the vertex format, the passes and the
+// frames from the capture, and renders at the largest viewport of
+// its frames.
+bool ParseBenchOptions(int argc, char* argv[], BENCH_OPTIONS& options)
+{
+    options.frames = 1000;
+    options.warmupFrames = 60;
+    options.width = 1280;
+    options.height = 960;
+    options.outputFile = "bench_results.json";
+    options.bIndirect = true;
+    options.bDepthPrePass = true;
+    options.bLevelOfDetail = true;
+    options.bPackedVertices = true;
+    options.bSpatialIndex = true;
+    options.bStaticBatching = false;
+    options.pointLights = 0;
 
-        if (useOrtho)
+    for (int i = 0; i < argc; i++)
+    {
+        bool bHasValue = (i + 1 < argc);
+        if (bHasValue && (0 == strcmp(argv[i], "--frames")))
+            options.frames = atoi(argv[++i]);
+        else if (bHasValue && (0 == strcmp(argv[i], "--warmup")))
+            options.warmupFrames = atoi(argv[++i]);
+        else if (bHasValue && (0 == strcmp(argv[i], "--size")))
         {
-            // Orthographic projection
-            float aspect = 800.0f / 600.0f;
-            float orthoSize = 10.0f;
-            projection = glm::ortho(-orthoSize * aspect, orthoSize * aspect, -orthoSize, orthoSize, 0.1f, 100.0f);
+            std::string size = argv[++i];
+            size_t separator = size.find('x');
+            if (separator != std::string::npos)
+            {
+                options.width = atoi(size.substr(0, separator).c_str());
+                options.height = atoi(size.substr(separator + 1).c_str());
+            }
         }
+        else if (bHasValue && (0 == strcmp(argv[i], "--path")))
+            options.pathFile = argv[++i];
+        else if (bHasValue && (0 == strcmp(argv[i], "--out")))
+            options.outputFile = argv[++i];
+        else if (bHasValue && (0 == strcmp(argv[i], "--scene")))
+            options.sceneFile = argv[++i];
+        else if (bHasValue && (0 == strcmp(argv[i], "--lights")))
+            options.pointLights = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "--no-indirect"))
+            options.bIndirect = false;
+        else if (0 == strcmp(argv[i], "--no-prepass"))
+            options.bDepthPrePass = false;
+        else if (0 == strcmp(argv[i], "--no-lod"))
+            options.bLevelOfDetail = false;
+        else if (0 == strcmp(argv[i], "--no-packed"))
+            options.bPackedVertices = false;
+        else if (0 == strcmp(argv[i], "--no-bvh"))
+            options.bSpatialIndex = false;
+        else if (0 == strcmp(argv[i], "--static-batches"))
+            options.bStaticBatching = true;
+        else if (bHasValue && (0 == strcmp(argv[i], "--replay")))
+            options.replayFile = argv[++i];
         else
         {
-            // Perspective projection
-            projection = glm::perspective(glm::radians(fov), 800.0f / 600.0f, 0.1f, 100.0f);
+            std::cerr << "Unknown benchmark option: " << argv[i] << "\n"
+                << "usage: --bench [--frames N] [--warmup N] [--size WxH] [--path file] [--out file] [--scene file] [--lights N] [--no-indirect] [--no-prepass] [--no-lod] [--no-packed] [--no-bvh] [--static-batches] [--replay file]" << std::endl;
+            return false;
         }
+    }
 
-        g_ShaderManager->setMat4Value("view", view);
-        g_ShaderManager->setMat4Value("projection", projection);
+    if ((options.frames < 2) || (options.warmupFrames < 0) || (options.pointLights < 0) ||
+        (options.width <= 0) || (options.height <= 0))
+    {
+        std::cerr << "Invalid benchmark options" << std::endl;
+        return false;
+    }
 
-        g_SceneManager->RenderScene();
+    if (!options.replayFile.empty())
+    {
+        if (!g_FrameCapture->Open(options.replayFile) || (g_FrameCapture->GetFrameCount() < 2))
+        {
+            std::cerr << "Could not load frame capture " << options.replayFile << std::endl;
+            return false;
+        }
+
+        uint32_t flags = g_FrameCapture->GetFlags();
+        options.sceneFile = g_FrameCapture->GetSceneFile();
+        options.bPackedVertices = 0 != (flags & FrameCapture::CAPTURE_PACKED_VERTICES);
+        options.bStaticBatching = 0 != (flags & FrameCapture::CAPTURE_STATIC_BATCHING);
+        options.bDepthPrePass = 0 != (flags & FrameCapture::CAPTURE_DEPTH_PREPASS);
+        options.bIndirect = false;
+        options.frames = (int)g_FrameCapture->GetFrameCount();
+        options.width = 0;
+        options.height = 0;
+        for (uint32_t i = 0; i < g_FrameCapture->GetFrameCount(); i++)
+        {
+            options.width = std::max(options.width, (int)g_FrameCapture->GetFrame(i).width);
+            options.height = std::max(options.height, (int)g_FrameCapture->GetFrame(i).height);
+        }
+        if ((options.width <= 0) || (options.height <= 0))
+        {
+            std::cerr << "Frame capture " << options.replayFile << " has no viewport" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Render the camera path, or the frames of a capture, into an
+// offscreen target with a fixed time step and report the throughput
+// as JSON
+int RunBenchmark(const BENCH_OPTIONS& options)
+{
+    bool bReplay = !options.replayFile.empty();
+    CameraPath path;
+    if (options.pathFile.empty())
+        path.CreateDefaultPath();
+    else if (!path.LoadFromFile(options.pathFile))
+    {
+        std::cerr << "Could not load camera path " << options.pathFile << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // compare against the per-run instanced draws when asked
+    bool bIndirect = g_SceneManager->SetMultiDrawIndirect(options.bIndirect);
+    bool bDepthPrePass = g_SceneManager->SetDepthPrePass(options.bDepthPrePass);
+    g_SceneManager->SetLevelOfDetail(options.bLevelOfDetail);
+    g_SceneManager->SetSpatialIndex(options.bSpatialIndex);
+    g_SceneManager->SetStaticBatching(options.bStaticBatching);
+
+    // scatter colored point lights over the floor in a grid
+    int gridSize = (int)ceil(sqrt((double)options.pointLights));
+    for (int i = 0; i < options.pointLights; i++)
+    {
+        float x = -9.0f + 18.0f * ((i % gridSize) + 0.5f) / gridSize;
+        float z = -9.0f + 18.0f * ((i / gridSize) + 0.5f) / gridSize;
+        glm::vec3 color(0.5f + 0.5f * sinf(i * 1.7f), 0.5f + 0.5f * sinf(i * 2.3f + 2.0f), 0.5f + 0.5f * sinf(i * 2.9f + 4.0f));
+        g_SceneManager->AddPointLight(glm::vec3(x, 0.5f, z), color * 2.0f, 2.5f);
+    }
+
+    RenderTarget target;
+    if (!target.Create(options.width, options.height))
+        return EXIT_FAILURE;
 
+    // the camera only depends on the frame number, so every run
+    // is identical
+    FrameSnapshots::CAMERA_STATE camera = GetCameraState();
+    path.Evaluate(0.0f, camera.position, camera.front);
+
+    // let every texture finish streaming in, then warm up
+    target.Bind();
+    int warmupFrames = 0;
+    while (g_SceneManager->IsLoadingTextures() || (warmupFrames < options.warmupFrames))
+    {
+        g_FrameProfiler->BeginFrame();
+        if (bReplay)
+            ReplayFrame(0);
+        else
+            RenderFrame(camera, false, options.width, options.height);
         glfwSwapBuffers(g_Window);
+        g_FrameArena->Reset();
         glfwPollEvents();
+        g_FrameProfiler->EndFrame();
+        warmupFrames++;
     }
+    glFinish();
 
-    if (g_SceneManager) { delete g_SceneManager; g_SceneManager = nullptr; }
-    if (g_ViewManager) { delete g_ViewManager; g_ViewManager = nullptr; }
-    if (g_ShaderManager) { delete g_ShaderManager; g_ShaderManager = nullptr; }
+    std::vector<double> frameTimes;
+    frameTimes.reserve(options.frames);
+    uint64_t drawCalls = 0;
+    uint64_t triangles = 0;
 
-    exit(EXIT_SUCCESS);
+    double startTime = glfwGetTime();
+    double frameStart = startTime;
+    for (int i = 0; i < options.frames; i++)
+    {
+        g_FrameProfiler->BeginFrame();
+        if (bReplay)
+        {
+            ReplayFrame((uint32_t)i);
+        }
+        else
+        {
+            path.Evaluate((float)i / (options.frames - 1), camera.position, camera.front);
+            RenderFrame(camera, false, options.width, options.height);
+        }
+
+        const MeshManager::DRAW_STATS& stats = g_SceneManager->GetDrawStats();
+        drawCalls += stats.drawCalls;
+        triangles += stats.triangles;
+
+        glfwSwapBuffers(g_Window);
+        g_FrameArena->Reset();
+        glfwPollEvents();
+        g_FrameProfiler->EndFrame();
+
+        double frameEnd = glfwGetTime();
+        frameTimes.push_back((frameEnd - frameStart) * 1000.0);
+        frameStart = frameEnd;
+    }
+    glFinish();
+    double totalSeconds = glfwGetTime() - startTime;
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+    glfwGetFramebufferSize(g_Window, &framebufferWidth, &framebufferHeight);
+    RenderTarget::Unbind(framebufferWidth, framebufferHeight);
+
+    // frame time percentiles over the whole run
+    std::vector<double> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        sum += sorted[i];
+    }
+    size_t lastIndex = sorted.size() - 1;
+
+    std::vector<FrameProfiler::TIMER_STATS> timers;
+    g_FrameProfiler->GetStats(timers);
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(3);
+    report << "{\n"
+        << "  \"frames\": " << options.frames << ",\n"
+        << "  \"width\": " << options.width << ",\n"
+        << "  \"height\": " << options.height << ",\n"
+        << "  \"seconds\": " << totalSeconds << ",\n"
+        << "  \"fps\": " << options.frames / totalSeconds << ",\n"
+        << "  \"multiDrawIndirect\": " << (bIndirect ? "true" : "false") << ",\n"
+        << "  \"depthPrePass\": " << (bDepthPrePass ? "true" : "false") << ",\n"
+        << "  \"levelOfDetail\": " << (options.bLevelOfDetail ? "true" : "false") << ",\n"
+        << "  \"packedVertices\": " << (options.bPackedVertices ? "true" : "false") << ",\n"
+        << "  \"spatialIndex\": " << (options.bSpatialIndex ? "true" : "false") << ",\n"
+        << "  \"staticBatching\": " << (options.bStaticBatching ? "true" : "false") << ",\n"
+        << "  \"scene\": \"" << (options.sceneFile.empty() ? "default" : options.sceneFile) << "\",\n"
+        << "  \"pointLights\": " << options.pointLights << ",\n"
+        << "  \"replay\": \"" << (bReplay ? options.replayFile : std::string("none")) << "\",\n"
+        << "  \"frameTimeMs\": {"
+        << "\"mean\": " << sum / sorted.size()
+        << ", \"min\": " << sorted[0]
+        << ", \"p50\": " << sorted[(size_t)(lastIndex * 0.50)]
+        << ", \"p95\": " << sorted[(size_t)(lastIndex * 0.95)]
+        << ", \"p99\": " << sorted[(size_t)(lastIndex * 0.99)]
+        << ", \"max\": " << sorted[lastIndex] << "},\n"
+        << "  \"drawCallsPerFrame\": " << (double)drawCalls / options.frames << ",\n"
+        << "  \"trianglesPerFrame\": " << (double)triangles / options.frames << ",\n"
+        << "  \"timers\": [";
+    for (size_t i = 0; i < timers.size(); i++)
+    {
+        report << (i ? "," : "") << "\n    {\"name\": \"" << timers[i].name << "\""
+            << ", \"gpu\": " << (timers[i].bGpu ? "true" : "false")
+            << ", \"p50\": " << timers[i].p50
+            << ", \"p95\": " << timers[i].p95
+            << ", \"p99\": " << timers[i].p99 << "}";
+    }
+    report << "\n  ]\n}\n";
+
+    std::cout << report.str();
+    std::ofstream output(options.outputFile.c_str());
+    output << report.str();
+    if (!output)
+    {
+        std::cerr << "Could not write " << options.outputFile << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Bake each listed image into the texture cache, without opening a window
+int BakeTextures(int argc, char* argv[])
+{
+    // flip like the runtime loader, so baked and decoded images match
+    stbi_set_flip_vertically_on_load(true);
+
+    int failed = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        std::string cachePath = TextureCache::GetCachePath(argv[i]);
+        if (TextureCache::Bake(argv[i], cachePath))
+        {
+            std::cout << "Baked " << argv[i] << " into " << cachePath << std::endl;
+        }
+        else
+        {
+            std::cerr << "Could not bake " << argv[i] << std::endl;
+            failed++;
+        }
+    }
+    return (0 == failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Compile a text scene into its binary form, next to it unless an
+// output path is given
+int CompileScene(int argc, char* argv[])
+{
+    if ((argc < 1) || (argc > 2))
+    {
+        std::cerr << "usage: --compile-scene file.scene [output]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string binaryPath = (argc > 1) ? argv[1] : SceneFile::GetBinaryPath(argv[0]);
+    if (!SceneFile::Compile(argv[0], binaryPath))
+    {
+        std::cerr << "Could not compile " << argv[0] << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Compiled " << argv[0] << " into " << binaryPath << std::endl;
+    return EXIT_SUCCESS;
 }
 
 bool InitializeGLFW()
 {
     if (!glfwInit()) return false;
 
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#else
+    // the scene shaders read their per-draw records through
+    // gl_BaseInstance, so OpenGL 4.6 is the minimum; macOS stops
+    // at 4.1 and is not supported
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#endif
 
     return true;
 }
@@ -152,6 +949,11 @@ bool InitializeGLEW()
         std::cerr << "GLEW Error: " << glewGetErrorString(err) << std::endl;
         return false;
     }
+    if (!GLEW_VERSION_4_6)
+    {
+        std::cerr << "OpenGL 4.6 is required, the driver gives " << glGetString(GL_VERSION) << std::endl;
+        return false;
+    }
 
     std::cout << "INFO: OpenGL Successfully Initialized\n";
     std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n" << std::endl;
@@ -189,10 +991,142 @@ void processInput(GLFWwindow* window)
     {
         pKeyPressed = false;
     }
+
+    // Toggle the frame timing overlay
+    static bool f3KeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS && !f3KeyPressed)
+    {
+        g_bShowProfiler = !g_bShowProfiler;
+        f3KeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_RELEASE)
+    {
+        f3KeyPressed = false;
+    }
+
+    // Export the recorded frame timings as a Chrome trace
+    static bool f4KeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS && !f4KeyPressed)
+    {
+        f4KeyPressed = true;
+        g_TraceRequests++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_RELEASE)
+    {
+        f4KeyPressed = false;
+    }
+
+    // Toggle the multi-draw-indirect submission of the scene
+    static bool mKeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS && !mKeyPressed)
+    {
+        mKeyPressed = true;
+        g_bMultiDrawIndirect = !g_bMultiDrawIndirect;
+    }
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_RELEASE)
+    {
+        mKeyPressed = false;
+    }
+
+    // Toggle the depth pre-pass of the opaque scene
+    static bool zKeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS && !zKeyPressed)
+    {
+        zKeyPressed = true;
+        g_bDepthPrePass = !g_bDepthPrePass;
+    }
+    if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_RELEASE)
+    {
+        zKeyPressed = false;
+    }
+
+    // Toggle the dynamic resolution of the scene
+    static bool f5KeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS && !f5KeyPressed)
+    {
+        f5KeyPressed = true;
+        g_bDynamicResolution = !g_bDynamicResolution;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_RELEASE)
+    {
+        f5KeyPressed = false;
+    }
+
+    // Toggle the baked batches of the static scene nodes
+    static bool bKeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !bKeyPressed)
+    {
+        bKeyPressed = true;
+        g_bStaticBatching = !g_bStaticBatching;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
+    {
+        bKeyPressed = false;
+    }
+
+    // Start or stop capturing the draws of every frame
+    static bool f6KeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS && !f6KeyPressed)
+    {
+        f6KeyPressed = true;
+        g_CaptureRequests++;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F6) == GLFW_RELEASE)
+    {
+        f6KeyPressed = false;
+    }
+
+    // Record the camera as a keyframe of a benchmark path
+    static bool kKeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && !kKeyPressed)
+    {
+        kKeyPressed = true;
+        g_RecordedPath.AddKeyframe(cameraPos, cameraPos + cameraFront);
+        if (g_RecordedPath.SaveToFile(CAMERA_PATH_FILENAME))
+            std::cout << "Recorded keyframe " << g_RecordedPath.GetKeyframeCount() << " to " << CAMERA_PATH_FILENAME << "\n";
+    }
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_RELEASE)
+    {
+        kKeyPressed = false;
+    }
+}
+
+// Draw the rolling frame timings in the top left corner
+void DrawProfilerOverlay(int framebufferWidth, int framebufferHeight)
+{
+    // the text lives in the frame arena until the swap
+    size_t statCount = 0;
+    const char* const* stats = g_FrameProfiler->FormatStats(*g_FrameArena, statCount);
+
+    // the resolution scale follows the timings
+    size_t lineCount = statCount + 1;
+    const char** lines = g_FrameArena->AllocateArray<const char*>(lineCount);
+    std::copy(stats, stats + statCount, lines);
+    lines[statCount] = g_FrameArena->Format("Resolution %3d%%", (int)(g_DynamicResolution->GetScale() * 100.0f + 0.5f));
+
+    float lineHeight = g_DebugText->GetLineHeight();
+    float boxWidth = 0.0f;
+    for (size_t i = 0; i < lineCount; i++)
+    {
+        boxWidth = std::max(boxWidth, strlen(lines[i]) * g_DebugText->GetCharAdvance());
+    }
+
+    g_DebugText->Clear();
+    g_DebugText->AddBox(4.0f, 4.0f, boxWidth + 8.0f, lineCount * lineHeight + 8.0f,
+        glm::vec4(0.0f, 0.0f, 0.0f, 0.6f));
+    for (size_t i = 0; i < lineCount; i++)
+    {
+        g_DebugText->AddText(8.0f, 8.0f + i * lineHeight, lines[i], glm::vec4(1.0f, 1.0f, 0.6f, 1.0f));
+    }
+
+    g_DebugText->Draw(framebufferWidth, framebufferHeight);
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
+    // the view manager keeps the cursor for picking
+    ViewManager::Mouse_Position_Callback(window, xpos, ypos);
+
     if (firstMouse) { lastX = xpos; lastY = ypos; firstMouse = false; }
 
     float xoffset = xpos - lastX;
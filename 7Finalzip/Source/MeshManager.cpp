@@ -0,0 +1,847 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshmanager.cpp
+// ============
+// generate, store and draw the primitive meshes used by the 3D scene
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshManager.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	const GLuint g_FloatsPerVertex = MeshManager::FLOATS_PER_VERTEX;
+	// entries of the simulated post-transform vertex cache the
+	// index order is optimized for
+	const int g_VertexCacheSize = 16;
+	// tessellation of each level of detail, finest first
+	const int g_ConeSegments[MeshManager::LOD_COUNT] = { 36, 18, 10, 6 };
+	const int g_TorusMainSegments[MeshManager::LOD_COUNT] = { 48, 24, 12, 8 };
+	const int g_TorusTubeSegments[MeshManager::LOD_COUNT] = { 16, 10, 6, 4 };
+	// screen height fraction below which each coarser level is
+	// used, and how far past it the size has to go to switch
+	const float g_LodScreenSizes[MeshManager::LOD_COUNT - 1] = { 0.25f, 0.10f, 0.04f };
+	const float g_LodHysteresis = 0.15f;
+	const float g_TorusMainRadius = 1.0f;
+	const float g_TorusTubeRadius = 0.1f;
+	const float g_Pi = 3.14159265358979f;
+
+	// append one vertex to a generated vertex list
+	void AddVertex(
+		std::vector<GLfloat>& vertices,
+		float px, float py, float pz,
+		float nx, float ny, float nz,
+		float u, float v)
+	{
+		GLfloat vertex[g_FloatsPerVertex] = { px, py, pz, nx, ny, nz, u, v };
+		vertices.insert(vertices.end(), vertex, vertex + g_FloatsPerVertex);
+	}
+
+	// get the index that the next added vertex will have
+	GLuint NextIndex(const std::vector<GLfloat>& vertices)
+	{
+		return (GLuint)(vertices.size() / g_FloatsPerVertex);
+	}
+
+	// packed vertex, 16 bytes
+	struct PACKED_VERTEX
+	{
+		// half floats, the fourth is padding
+		uint16_t position[4];
+		// octahedral encoded unit normal, snorm16
+		int16_t normal[2];
+		// unorm16
+		uint16_t uv[2];
+	};
+
+	// convert a float to the nearest half float, flushing values
+	// too small for a normal half to zero
+	uint16_t FloatToHalf(float value)
+	{
+		uint32_t bits = 0;
+		memcpy(&bits, &value, sizeof(bits));
+		uint32_t sign = (bits >> 16) & 0x8000;
+		int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+		uint32_t mantissa = bits & 0x7FFFFF;
+
+		if (exponent <= 0)
+			return (uint16_t)sign;
+		if (exponent >= 31)
+			return (uint16_t)(sign | 0x7BFF);
+
+		// round to nearest, carrying into the exponent if needed
+		uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+		if (mantissa & 0x1000)
+			half++;
+		return (uint16_t)half;
+	}
+
+	// quantize a value in [-1, 1] to snorm16
+	int16_t ToSnorm16(float value)
+	{
+		float clamped = std::min(std::max(value, -1.0f), 1.0f);
+		return (int16_t)floorf(clamped * 32767.0f + 0.5f);
+	}
+
+	// quantize a value in [0, 1] to unorm16
+	uint16_t ToUnorm16(float value)
+	{
+		float clamped = std::min(std::max(value, 0.0f), 1.0f);
+		return (uint16_t)floorf(clamped * 65535.0f + 0.5f);
+	}
+
+	// project a unit normal onto the octahedron and unfold the
+	// lower half over the corners, giving two values in [-1, 1]
+	void EncodeOctahedral(float x, float y, float z, int16_t encoded[2])
+	{
+		float sum = fabsf(x) + fabsf(y) + fabsf(z);
+		float u = x / sum;
+		float v = y / sum;
+		if (z < 0.0f)
+		{
+			float foldedU = (1.0f - fabsf(v)) * ((u >= 0.0f) ? 1.0f : -1.0f);
+			float foldedV = (1.0f - fabsf(u)) * ((v >= 0.0f) ? 1.0f : -1.0f);
+			u = foldedU;
+			v = foldedV;
+		}
+		encoded[0] = ToSnorm16(u);
+		encoded[1] = ToSnorm16(v);
+	}
+
+	// upload generated vertices into the bound GL_ARRAY_BUFFER,
+	// packing them first when asked
+	void UploadVertices(const std::vector<GLfloat>& vertices, bool bPacked)
+	{
+		if (!bPacked)
+		{
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+			return;
+		}
+
+		size_t vertexCount = vertices.size() / g_FloatsPerVertex;
+		std::vector<PACKED_VERTEX> packed(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			const GLfloat* vertex = &vertices[i * g_FloatsPerVertex];
+			PACKED_VERTEX& target = packed[i];
+			target.position[0] = FloatToHalf(vertex[0]);
+			target.position[1] = FloatToHalf(vertex[1]);
+			target.position[2] = FloatToHalf(vertex[2]);
+			target.position[3] = FloatToHalf(1.0f);
+			EncodeOctahedral(vertex[3], vertex[4], vertex[5], target.normal);
+			target.uv[0] = ToUnorm16(vertex[6]);
+			target.uv[1] = ToUnorm16(vertex[7]);
+		}
+		glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PACKED_VERTEX), packed.data(), GL_STATIC_DRAW);
+	}
+
+	// point the position, normal and texture coordinate
+	// attributes of the bound vertex array at the bound buffer
+	void SetVertexLayout(bool bPacked)
+	{
+		if (bPacked)
+		{
+			const GLsizei stride = sizeof(PACKED_VERTEX);
+			glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PACKED_VERTEX, position));
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(PACKED_VERTEX, normal));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(PACKED_VERTEX, uv));
+			glEnableVertexAttribArray(2);
+			return;
+		}
+
+		const GLsizei stride = sizeof(GLfloat) * g_FloatsPerVertex;
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * 3));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * 6));
+		glEnableVertexAttribArray(2);
+	}
+}
+
+/***********************************************************
+ *  MeshManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshManager::MeshManager()
+{
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		for (int lod = 0; lod < LOD_COUNT; lod++)
+		{
+			GLMesh& mesh = m_meshes[i][lod];
+			mesh.vao = 0;
+			mesh.vbo = 0;
+			mesh.ibo = 0;
+			mesh.nIndices = 0;
+			mesh.firstIndex = 0;
+			mesh.baseVertex = 0;
+			mesh.bounds.center = glm::vec3(0.0f);
+			mesh.bounds.extents = glm::vec3(0.0f);
+			mesh.bounds.radius = 0.0f;
+		}
+		m_lodCounts[i] = 0;
+	}
+	m_mergedVAO = 0;
+	m_mergedVBO = 0;
+	m_mergedIBO = 0;
+	m_bPackedVertices = true;
+	ResetDrawStats();
+}
+
+/***********************************************************
+ *  ~MeshManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MeshManager::~MeshManager()
+{
+	DestroyMeshes();
+}
+
+/***********************************************************
+ *  SetPackedVertices()
+ *
+ *  Choose the vertex format of the meshes loaded afterwards
+ ***********************************************************/
+void MeshManager::SetPackedVertices(bool bPacked)
+{
+	m_bPackedVertices = bPacked;
+}
+
+/***********************************************************
+ *  CreateMesh()
+ *
+ *  Reorder generated vertex and index data of one level of
+ *  detail for the vertex cache, then upload it into a new
+ *  vertex array object. The data is kept so that the mesh
+ *  can be merged later.
+ ***********************************************************/
+void MeshManager::CreateMesh(
+	int meshID,
+	int lod,
+	const std::vector<GLfloat>& vertices,
+	const std::vector<GLuint>& indices)
+{
+	GLMesh& mesh = m_meshes[meshID][lod];
+	if (0 != mesh.vao)
+		return; // already loaded
+	m_lodCounts[meshID] = std::max(m_lodCounts[meshID], lod + 1);
+
+	mesh.vertices = vertices;
+	mesh.indices = indices;
+	MeshOptimizer::OptimizeIndices(mesh.vertices, g_FloatsPerVertex, mesh.indices, g_VertexCacheSize);
+	MeshOptimizer::OptimizeVertexFetch(mesh.vertices, g_FloatsPerVertex, mesh.indices);
+
+	glGenVertexArrays(1, &mesh.vao);
+	glBindVertexArray(mesh.vao);
+
+	glGenBuffers(1, &mesh.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	UploadVertices(mesh.vertices, m_bPackedVertices);
+
+	glGenBuffers(1, &mesh.ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(GLuint), mesh.indices.data(), GL_STATIC_DRAW);
+
+	SetVertexLayout(m_bPackedVertices);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	mesh.nIndices = (GLsizei)mesh.indices.size();
+	mesh.firstIndex = 0;
+	mesh.baseVertex = 0;
+
+	// bounding box of the positions, and the sphere around
+	// its center enclosing every position
+	size_t vertexCount = vertices.size() / g_FloatsPerVertex;
+	glm::vec3 minimum(vertices[0], vertices[1], vertices[2]);
+	glm::vec3 maximum = minimum;
+	for (size_t i = 1; i < vertexCount; i++)
+	{
+		const GLfloat* position = &vertices[i * g_FloatsPerVertex];
+		glm::vec3 point(position[0], position[1], position[2]);
+		minimum = glm::min(minimum, point);
+		maximum = glm::max(maximum, point);
+	}
+	mesh.bounds.center = (minimum + maximum) * 0.5f;
+	mesh.bounds.extents = (maximum - minimum) * 0.5f;
+
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const GLfloat* position = &vertices[i * g_FloatsPerVertex];
+		glm::vec3 offset = glm::vec3(position[0], position[1], position[2]) - mesh.bounds.center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	mesh.bounds.radius = sqrtf(radiusSquared);
+
+	// half float positions may round outward by up to half a
+	// unit in the last place of their 11 significant bits
+	if (m_bPackedVertices)
+	{
+		float largest = std::max(glm::length(minimum), glm::length(maximum));
+		mesh.bounds.extents += glm::vec3(largest / 2048.0f);
+		mesh.bounds.radius += largest / 2048.0f;
+	}
+}
+
+/***********************************************************
+ *  BuildMergedGeometry()
+ *
+ *  Append the data of every loaded mesh into one vertex and
+ *  index buffer, then free the buffers of the single meshes
+ *  and the data of their coarser levels.
+ *  The indices stay relative to their mesh, and each draw
+ *  adds the mesh's base vertex.
+ ***********************************************************/
+bool MeshManager::BuildMergedGeometry()
+{
+	if (IsMerged())
+		return true;
+
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		for (int lod = 0; lod < m_lodCounts[i]; lod++)
+		{
+			const GLMesh& mesh = m_meshes[i][lod];
+			vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+			indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+		}
+	}
+	if (indices.empty())
+		return false;
+
+	glGenVertexArrays(1, &m_mergedVAO);
+	glBindVertexArray(m_mergedVAO);
+
+	glGenBuffers(1, &m_mergedVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_mergedVBO);
+	UploadVertices(vertices, m_bPackedVertices);
+
+	glGenBuffers(1, &m_mergedIBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_mergedIBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+	SetVertexLayout(m_bPackedVertices);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the meshes now draw from their range of the shared buffers
+	GLuint firstIndex = 0;
+	GLint baseVertex = 0;
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		for (int lod = 0; lod < m_lodCounts[i]; lod++)
+		{
+			GLMesh& mesh = m_meshes[i][lod];
+			if (0 == mesh.vao)
+				continue;
+
+			glDeleteVertexArrays(1, &mesh.vao);
+			glDeleteBuffers(1, &mesh.vbo);
+			glDeleteBuffers(1, &mesh.ibo);
+			mesh.vao = m_mergedVAO;
+			mesh.vbo = 0;
+			mesh.ibo = 0;
+			mesh.firstIndex = firstIndex;
+			mesh.baseVertex = baseVertex;
+
+			firstIndex += (GLuint)mesh.indices.size();
+			baseVertex += (GLint)(mesh.vertices.size() / g_FloatsPerVertex);
+			if (lod > 0)
+			{
+				std::vector<GLfloat>().swap(mesh.vertices);
+				std::vector<GLuint>().swap(mesh.indices);
+			}
+		}
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  FindMesh()
+ *
+ *  Get a loaded level of a mesh, clamping the level to those
+ *  that were generated, or NULL when the mesh is not loaded
+ ***********************************************************/
+const MeshManager::GLMesh* MeshManager::FindMesh(int meshID, int lod) const
+{
+	if ((meshID < 0) || (meshID >= MESH_COUNT) || (0 == m_lodCounts[meshID]))
+		return NULL;
+
+	lod = std::min(std::max(lod, 0), m_lodCounts[meshID] - 1);
+	const GLMesh* pMesh = &m_meshes[meshID][lod];
+	if (0 == pMesh->vao)
+		return NULL;
+	return pMesh;
+}
+
+/***********************************************************
+ *  GetDrawCommand()
+ *
+ *  Fill the indirect command drawing count copies of a
+ *  level of a merged mesh, whose records start at
+ *  baseInstance
+ ***********************************************************/
+bool MeshManager::GetDrawCommand(int meshID, GLuint count, GLuint baseInstance, DRAW_COMMAND& command, int lod) const
+{
+	const GLMesh* pMesh = FindMesh(meshID, lod);
+	if (!IsMerged() || (NULL == pMesh) || (pMesh->vao != m_mergedVAO))
+		return false;
+
+	command.count = (GLuint)pMesh->nIndices;
+	command.instanceCount = count;
+	command.firstIndex = pMesh->firstIndex;
+	command.baseVertex = pMesh->baseVertex;
+	command.baseInstance = baseInstance;
+	return true;
+}
+
+/***********************************************************
+ *  MultiDrawIndirect()
+ *
+ *  Issue a list of indirect commands over the merged meshes
+ *  in one call
+ ***********************************************************/
+void MeshManager::MultiDrawIndirect(const DRAW_COMMAND* commands, GLsizei commandCount, size_t offset)
+{
+	if (!IsMerged() || (commandCount <= 0))
+		return;
+
+	glBindVertexArray(m_mergedVAO);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)offset, commandCount, 0);
+	glBindVertexArray(0);
+
+	m_drawStats.drawCalls++;
+	for (GLsizei i = 0; i < commandCount; i++)
+	{
+		m_drawStats.instances += commands[i].instanceCount;
+		m_drawStats.triangles += (uint64_t)(commands[i].count / 3) * commands[i].instanceCount;
+	}
+}
+
+/***********************************************************
+ *  MultiDrawIndirectCount()
+ *
+ *  Issue the indirect commands written by the GPU, reading
+ *  their number from the parameter buffer
+ ***********************************************************/
+void MeshManager::MultiDrawIndirectCount(size_t offset, size_t countOffset, GLsizei maxCount)
+{
+	if (!IsMerged() || (maxCount <= 0))
+		return;
+
+	glBindVertexArray(m_mergedVAO);
+	glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)offset,
+		(GLintptr)countOffset, maxCount, 0);
+	glBindVertexArray(0);
+
+	m_drawStats.drawCalls++;
+}
+
+/***********************************************************
+ *  GetMeshBounds()
+ *
+ *  Get the local-space bounding volume of a mesh
+ ***********************************************************/
+const MeshManager::MESH_BOUNDS& MeshManager::GetMeshBounds(int meshID) const
+{
+	static const MESH_BOUNDS empty = { glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+	if ((meshID < 0) || (meshID >= MESH_COUNT))
+		return empty;
+	return m_meshes[meshID][0].bounds;
+}
+
+/***********************************************************
+ *  GetLodCount()
+ *
+ *  Get the number of levels of detail of a loaded mesh
+ ***********************************************************/
+int MeshManager::GetLodCount(int meshID) const
+{
+	if ((meshID < 0) || (meshID >= MESH_COUNT))
+		return 0;
+	return m_lodCounts[meshID];
+}
+
+/***********************************************************
+ *  SelectLod()
+ *
+ *  Move from the current level towards the level matching
+ *  the screen size, one threshold at a time. Moving to a
+ *  coarser level needs the size to drop below the threshold
+ *  by the hysteresis fraction, moving to a finer one needs
+ *  it to rise above it by the same fraction.
+ ***********************************************************/
+int MeshManager::SelectLod(int currentLod, float screenSize)
+{
+	int lod = std::min(std::max(currentLod, 0), LOD_COUNT - 1);
+	while ((lod < LOD_COUNT - 1) && (screenSize < g_LodScreenSizes[lod] * (1.0f - g_LodHysteresis)))
+	{
+		lod++;
+	}
+	while ((lod > 0) && (screenSize > g_LodScreenSizes[lod - 1] * (1.0f + g_LodHysteresis)))
+	{
+		lod--;
+	}
+	return lod;
+}
+
+/***********************************************************
+ *  DestroyMeshes()
+ *
+ *  Free the GPU memory of every generated mesh
+ ***********************************************************/
+void MeshManager::DestroyMeshes()
+{
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		for (int lod = 0; lod < LOD_COUNT; lod++)
+		{
+			GLMesh& mesh = m_meshes[i][lod];
+			if ((0 != mesh.vao) && (mesh.vao != m_mergedVAO))
+			{
+				glDeleteVertexArrays(1, &mesh.vao);
+				glDeleteBuffers(1, &mesh.vbo);
+				glDeleteBuffers(1, &mesh.ibo);
+			}
+			mesh.vao = 0;
+			mesh.vbo = 0;
+			mesh.ibo = 0;
+			mesh.nIndices = 0;
+			mesh.firstIndex = 0;
+			mesh.baseVertex = 0;
+		}
+		m_lodCounts[i] = 0;
+	}
+
+	if (0 != m_mergedVAO)
+	{
+		glDeleteVertexArrays(1, &m_mergedVAO);
+		glDeleteBuffers(1, &m_mergedVBO);
+		glDeleteBuffers(1, &m_mergedIBO);
+	}
+	m_mergedVAO = 0;
+	m_mergedVBO = 0;
+	m_mergedIBO = 0;
+
+	DestroyStaticBatches();
+}
+
+/***********************************************************
+ *  CreateStaticBatch()
+ *
+ *  Upload baked vertices and indices into buffers of their
+ *  own, always in the float layout, since world positions
+ *  need more precision than half floats give
+ ***********************************************************/
+int MeshManager::CreateStaticBatch(const std::vector<GLfloat>& vertices, const std::vector<GLuint>& indices)
+{
+	if (indices.empty())
+		return -1;
+
+	STATIC_BATCH batch;
+	glGenVertexArrays(1, &batch.vao);
+	glBindVertexArray(batch.vao);
+
+	glGenBuffers(1, &batch.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+	UploadVertices(vertices, false);
+
+	glGenBuffers(1, &batch.ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+	SetVertexLayout(false);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	batch.nIndices = (GLsizei)indices.size();
+	m_staticBatches.push_back(batch);
+	return (int)m_staticBatches.size() - 1;
+}
+
+/***********************************************************
+ *  DrawStaticBatch()
+ *
+ *  Draw a whole static batch in one call
+ ***********************************************************/
+void MeshManager::DrawStaticBatch(int batch, GLuint baseInstance)
+{
+	if ((batch < 0) || (batch >= (int)m_staticBatches.size()))
+		return;
+
+	const STATIC_BATCH& staticBatch = m_staticBatches[batch];
+	glBindVertexArray(staticBatch.vao);
+	glDrawElementsInstancedBaseInstance(GL_TRIANGLES, staticBatch.nIndices, GL_UNSIGNED_INT,
+		(void*)0, 1, baseInstance);
+	glBindVertexArray(0);
+
+	m_drawStats.drawCalls++;
+	m_drawStats.instances++;
+	m_drawStats.triangles += staticBatch.nIndices / 3;
+}
+
+/***********************************************************
+ *  DestroyStaticBatches()
+ *
+ *  Free the buffers of every static batch
+ ***********************************************************/
+void MeshManager::DestroyStaticBatches()
+{
+	for (size_t i = 0; i < m_staticBatches.size(); i++)
+	{
+		glDeleteVertexArrays(1, &m_staticBatches[i].vao);
+		glDeleteBuffers(1, &m_staticBatches[i].vbo);
+		glDeleteBuffers(1, &m_staticBatches[i].ibo);
+	}
+	m_staticBatches.clear();
+}
+
+/***********************************************************
+ *  LoadPlaneMesh()
+ *
+ *  Generate a flat plane on the XZ axes, 2 units wide and
+ *  deep, facing up
+ ***********************************************************/
+void MeshManager::LoadPlaneMesh()
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices = { 0, 1, 2, 0, 2, 3 };
+
+	AddVertex(vertices, -1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f);
+	AddVertex(vertices, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f);
+	AddVertex(vertices, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f);
+	AddVertex(vertices, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f);
+
+	CreateMesh(MESH_PLANE, 0, vertices, indices);
+}
+
+/***********************************************************
+ *  LoadBoxMesh()
+ *
+ *  Generate a unit box centered on the origin, with its own
+ *  normals and texture coordinates on each face
+ ***********************************************************/
+void MeshManager::LoadBoxMesh()
+{
+	// face normal, then the two axes spanning the face
+	const float faces[6][9] =
+	{
+		{ 0, 0, 1,   1, 0, 0,   0, 1, 0 },
+		{ 0, 0, -1, -1, 0, 0,   0, 1, 0 },
+		{ 1, 0, 0,   0, 0, -1,  0, 1, 0 },
+		{ -1, 0, 0,  0, 0, 1,   0, 1, 0 },
+		{ 0, 1, 0,   1, 0, 0,   0, 0, -1 },
+		{ 0, -1, 0,  1, 0, 0,   0, 0, 1 }
+	};
+	const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+
+	for (int face = 0; face < 6; face++)
+	{
+		const float* n = faces[face];
+		const float* s = faces[face] + 3;
+		const float* t = faces[face] + 6;
+		GLuint first = NextIndex(vertices);
+
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float a = corners[corner][0] * 0.5f;
+			float b = corners[corner][1] * 0.5f;
+			AddVertex(vertices,
+				n[0] * 0.5f + s[0] * a + t[0] * b,
+				n[1] * 0.5f + s[1] * a + t[1] * b,
+				n[2] * 0.5f + s[2] * a + t[2] * b,
+				n[0], n[1], n[2],
+				a + 0.5f, b + 0.5f);
+		}
+
+		GLuint quad[6] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+		indices.insert(indices.end(), quad, quad + 6);
+	}
+
+	CreateMesh(MESH_BOX, 0, vertices, indices);
+}
+
+/***********************************************************
+ *  LoadConeMesh()
+ *
+ *  Generate a cone with a base radius of 1 on the XZ axes
+ *  and its tip 1 unit up the Y axis, including the base, at
+ *  every level of detail
+ ***********************************************************/
+void MeshManager::LoadConeMesh()
+{
+	for (int lod = 0; lod < LOD_COUNT; lod++)
+	{
+		const int segments = g_ConeSegments[lod];
+		std::vector<GLfloat> vertices;
+		std::vector<GLuint> indices;
+
+		// side of the cone, with a separate tip vertex per segment
+		// so that every face gets a smooth normal
+		for (int i = 0; i <= segments; i++)
+		{
+			float u = (float)i / segments;
+			float angle = u * 2.0f * g_Pi;
+			float x = cosf(angle);
+			float z = sinf(angle);
+			float length = sqrtf(x * x + 1.0f + z * z);
+
+			AddVertex(vertices, x, 0.0f, z, x / length, 1.0f / length, z / length, u, 0.0f);
+			AddVertex(vertices, 0.0f, 1.0f, 0.0f, x / length, 1.0f / length, z / length, u, 1.0f);
+		}
+		for (int i = 0; i < segments; i++)
+		{
+			GLuint base = i * 2;
+			GLuint triangle[3] = { base, base + 1, base + 2 };
+			indices.insert(indices.end(), triangle, triangle + 3);
+		}
+
+		// base of the cone, facing down
+		GLuint center = NextIndex(vertices);
+		AddVertex(vertices, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.5f, 0.5f);
+		for (int i = 0; i <= segments; i++)
+		{
+			float angle = (float)i / segments * 2.0f * g_Pi;
+			float x = cosf(angle);
+			float z = sinf(angle);
+			AddVertex(vertices, x, 0.0f, z, 0.0f, -1.0f, 0.0f, 0.5f + x * 0.5f, 0.5f + z * 0.5f);
+		}
+		for (int i = 0; i < segments; i++)
+		{
+			GLuint triangle[3] = { center, center + 2 + i, center + 1 + i };
+			indices.insert(indices.end(), triangle, triangle + 3);
+		}
+
+		CreateMesh(MESH_CONE, lod, vertices, indices);
+	}
+}
+
+/***********************************************************
+ *  LoadTorusMesh()
+ *
+ *  Generate a torus around the Z axis with a main radius of
+ *  1 and a thin tube, at every level of detail
+ ***********************************************************/
+void MeshManager::LoadTorusMesh()
+{
+	for (int lod = 0; lod < LOD_COUNT; lod++)
+	{
+		const int mainSegments = g_TorusMainSegments[lod];
+		const int tubeSegments = g_TorusTubeSegments[lod];
+		std::vector<GLfloat> vertices;
+		std::vector<GLuint> indices;
+
+		for (int i = 0; i <= mainSegments; i++)
+		{
+			float u = (float)i / mainSegments;
+			float mainAngle = u * 2.0f * g_Pi;
+
+			for (int j = 0; j <= tubeSegments; j++)
+			{
+				float v = (float)j / tubeSegments;
+				float tubeAngle = v * 2.0f * g_Pi;
+
+				float nx = cosf(tubeAngle) * cosf(mainAngle);
+				float ny = cosf(tubeAngle) * sinf(mainAngle);
+				float nz = sinf(tubeAngle);
+				float ring = g_TorusMainRadius + g_TorusTubeRadius * cosf(tubeAngle);
+
+				AddVertex(vertices,
+					ring * cosf(mainAngle), ring * sinf(mainAngle), g_TorusTubeRadius * nz,
+					nx, ny, nz,
+					u, v);
+			}
+		}
+
+		const GLuint rowLength = tubeSegments + 1;
+		for (int i = 0; i < mainSegments; i++)
+		{
+			for (int j = 0; j < tubeSegments; j++)
+			{
+				GLuint a = i * rowLength + j;
+				GLuint b = a + rowLength;
+				GLuint quad[6] = { a, b, b + 1, a, b + 1, a + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+
+		CreateMesh(MESH_TORUS, lod, vertices, indices);
+	}
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  Draw one copy of a level of a loaded mesh, reading the
+ *  first record of the bound per-draw data
+ ***********************************************************/
+void MeshManager::DrawMesh(int meshID, int lod)
+{
+	const GLMesh* pMesh = FindMesh(meshID, lod);
+	if (NULL == pMesh)
+		return;
+
+	glBindVertexArray(pMesh->vao);
+	glDrawElementsBaseVertex(GL_TRIANGLES, pMesh->nIndices, GL_UNSIGNED_INT,
+		(void*)(pMesh->firstIndex * sizeof(GLuint)), pMesh->baseVertex);
+	glBindVertexArray(0);
+
+	m_drawStats.drawCalls++;
+	m_drawStats.instances++;
+	m_drawStats.triangles += pMesh->nIndices / 3;
+}
+
+/***********************************************************
+ *  DrawMeshInstanced()
+ *
+ *  Draw count copies of a level of the mesh in a single
+ *  call. The base instance tells the shader where the
+ *  per-draw records of the copies start.
+ ***********************************************************/
+void MeshManager::DrawMeshInstanced(int meshID, GLsizei count, GLuint baseInstance, int lod)
+{
+	const GLMesh* pMesh = FindMesh(meshID, lod);
+	if ((NULL == pMesh) || (count <= 0))
+		return;
+
+	glBindVertexArray(pMesh->vao);
+	glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, pMesh->nIndices, GL_UNSIGNED_INT,
+		(void*)(pMesh->firstIndex * sizeof(GLuint)), count, pMesh->baseVertex, baseInstance);
+	glBindVertexArray(0);
+
+	m_drawStats.drawCalls++;
+	m_drawStats.instances += count;
+	m_drawStats.triangles += (uint64_t)(pMesh->nIndices / 3) * count;
+}
+
+/***********************************************************
+ *  ResetDrawStats()
+ *
+ *  Set the draw call and triangle counters back to zero
+ ***********************************************************/
+void MeshManager::ResetDrawStats()
+{
+	m_drawStats.drawCalls = 0;
+	m_drawStats.instances = 0;
+	m_drawStats.triangles = 0;
+}
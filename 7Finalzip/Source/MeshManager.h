@@ -0,0 +1,244 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshmanager.h
+// ============
+// generate, store and draw the primitive meshes used by the 3D scene
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  MeshManager
+ *
+ *  This class generates the basic 3D shapes as indexed
+ *  meshes with a known vertex layout, so that they can be
+ *  drawn one at a time or as many instances in one call.
+ *
+ *  Meshes are generated with 8 floats per vertex. They are
+ *  uploaded either like that:
+ *    location 0 - position (x, y, z)
+ *    location 1 - normal   (x, y, z)
+ *    location 2 - texture coordinate (u, v)
+ *  or, by default, packed into 16 bytes per vertex:
+ *    location 0 - position as 3 half floats, plus padding
+ *    location 1 - octahedral encoded normal as 2 snorm16,
+ *                 decoded by the vertex shader
+ *    location 2 - texture coordinate as 2 unorm16, so the
+ *                 generated coordinates must stay in [0, 1]
+ *  Per-instance data is not part of the meshes; the shaders
+ *  read it from the DrawDataBuffer at gl_BaseInstance +
+ *  gl_InstanceID.
+ *
+ *  Every loaded mesh also has a local-space bounding box and
+ *  bounding sphere, used for culling.
+ *
+ *  Before upload the triangles are reordered for the vertex
+ *  cache and for overdraw, and the vertices for fetching, by
+ *  MeshOptimizer.
+ *
+ *  Each mesh starts out in buffers of its own. Once all the
+ *  meshes are loaded, BuildMergedGeometry() moves them into
+ *  one shared vertex and index buffer, where each mesh is a
+ *  range found by its first index and base vertex. A whole
+ *  list of draws over the merged meshes can then be issued
+ *  as one indirect multi-draw.
+ *
+ *  The curved primitives are generated at LOD_COUNT levels
+ *  of detail, level 0 being the finest. SelectLod() picks a
+ *  level from the size an object covers on screen. Meshes
+ *  with a single level, like the plane and the box, draw
+ *  that level whatever level is asked for.
+ *
+ *  Static batches are meshes baked from many transformed
+ *  copies of the primitives, in the float vertex layout
+ *  whatever the format of the other meshes. Each one has
+ *  buffers of its own and is drawn in a single call.
+ ***********************************************************/
+class MeshManager
+{
+public:
+	// constructor
+	MeshManager();
+	// destructor
+	~MeshManager();
+
+	// identifiers of the generated meshes
+	enum MESH_ID
+	{
+		MESH_PLANE = 0,
+		MESH_BOX,
+		MESH_CONE,
+		MESH_TORUS,
+		MESH_COUNT
+	};
+
+	// number of levels of detail of the curved primitives
+	static const int LOD_COUNT = 4;
+	// floats of a generated vertex: position, normal and
+	// texture coordinate
+	static const int FLOATS_PER_VERTEX = 8;
+
+	// local-space bounding volume of a mesh
+	struct MESH_BOUNDS
+	{
+		// axis aligned box, as center and half size
+		glm::vec3 center;
+		glm::vec3 extents;
+		// sphere around the same center enclosing every vertex
+		float radius;
+	};
+
+	// layout of one glMultiDrawElementsIndirect command
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// counts of the work submitted since the last reset
+	struct DRAW_STATS
+	{
+		uint32_t drawCalls;
+		uint64_t instances;
+		uint64_t triangles;
+	};
+
+	// choose between the packed and the float vertex format;
+	// only meshes loaded afterwards are affected
+	void SetPackedVertices(bool bPacked);
+	bool IsPackedVertices() const { return m_bPackedVertices; }
+
+	// generate the meshes into GPU memory
+	void LoadPlaneMesh();
+	void LoadBoxMesh();
+	void LoadConeMesh();
+	void LoadTorusMesh();
+
+	// move every loaded mesh into one shared vertex and index
+	// buffer, after which the meshes can be drawn indirectly
+	bool BuildMergedGeometry();
+	bool IsMerged() const { return 0 != m_mergedVAO; }
+
+	// draw a single copy of a mesh at a level of detail
+	void DrawMesh(int meshID, int lod = 0);
+	void DrawPlaneMesh(int lod = 0) { DrawMesh(MESH_PLANE, lod); }
+	void DrawBoxMesh(int lod = 0) { DrawMesh(MESH_BOX, lod); }
+	void DrawConeMesh(int lod = 0) { DrawMesh(MESH_CONE, lod); }
+	void DrawTorusMesh(int lod = 0) { DrawMesh(MESH_TORUS, lod); }
+
+	// draw count copies of a mesh in one draw call, whose
+	// per-draw records start at baseInstance
+	void DrawMeshInstanced(int meshID, GLsizei count, GLuint baseInstance, int lod = 0);
+	void DrawPlaneMeshInstanced(GLsizei count, GLuint baseInstance, int lod = 0) { DrawMeshInstanced(MESH_PLANE, count, baseInstance, lod); }
+	void DrawBoxMeshInstanced(GLsizei count, GLuint baseInstance, int lod = 0) { DrawMeshInstanced(MESH_BOX, count, baseInstance, lod); }
+	void DrawConeMeshInstanced(GLsizei count, GLuint baseInstance, int lod = 0) { DrawMeshInstanced(MESH_CONE, count, baseInstance, lod); }
+	void DrawTorusMeshInstanced(GLsizei count, GLuint baseInstance, int lod = 0) { DrawMeshInstanced(MESH_TORUS, count, baseInstance, lod); }
+
+	// fill the indirect command that draws count copies of a
+	// merged mesh, returning false when it is not merged
+	bool GetDrawCommand(int meshID, GLuint count, GLuint baseInstance, DRAW_COMMAND& command, int lod = 0) const;
+	// draw the commands of the bound GL_DRAW_INDIRECT_BUFFER,
+	// starting at byte offset, over the merged meshes. The
+	// CPU copy of the commands is only used for the counters.
+	void MultiDrawIndirect(const DRAW_COMMAND* commands, GLsizei commandCount, size_t offset);
+	// draw as many commands of the bound GL_DRAW_INDIRECT_BUFFER
+	// as the bound GL_PARAMETER_BUFFER holds at countOffset, at
+	// most maxCount. Only the call is counted, since the number
+	// of commands is only known to the GPU.
+	void MultiDrawIndirectCount(size_t offset, size_t countOffset, GLsizei maxCount);
+
+	// generated geometry of the finest level of a mesh, with
+	// FLOATS_PER_VERTEX floats per vertex
+	const std::vector<GLfloat>& GetMeshVertices(int meshID) const { return m_meshes[meshID][0].vertices; }
+	const std::vector<GLuint>& GetMeshIndices(int meshID) const { return m_meshes[meshID][0].indices; }
+
+	// upload geometry baked into world space as a static batch,
+	// returning its index, or -1 when there is nothing to draw
+	int CreateStaticBatch(const std::vector<GLfloat>& vertices, const std::vector<GLuint>& indices);
+	// draw a static batch with the per-draw record at
+	// baseInstance
+	void DrawStaticBatch(int batch, GLuint baseInstance);
+	// free every static batch
+	void DestroyStaticBatches();
+
+	// get the local-space bounds of a loaded mesh, those of
+	// its finest level
+	const MESH_BOUNDS& GetMeshBounds(int meshID) const;
+	// number of levels of detail a mesh was generated with
+	int GetLodCount(int meshID) const;
+	// pick the level of detail of an object covering screenSize
+	// of the screen height, starting from the level it had.
+	// A level only changes once the size is well past the
+	// threshold, so objects near one do not flicker between
+	// levels.
+	static int SelectLod(int currentLod, float screenSize);
+
+	// draw call and triangle counters
+	void ResetDrawStats();
+	const DRAW_STATS& GetDrawStats() const { return m_drawStats; }
+
+private:
+	struct GLMesh
+	{
+		GLuint vao;
+		GLuint vbo;
+		GLuint ibo;
+		GLsizei nIndices;
+		// range of the mesh within its index and vertex buffer,
+		// both 0 until the mesh is merged
+		GLuint firstIndex;
+		GLint baseVertex;
+		MESH_BOUNDS bounds;
+		// generated data, kept until the mesh is merged, and
+		// for good at the finest level, which static batches
+		// are baked from
+		std::vector<GLfloat> vertices;
+		std::vector<GLuint> indices;
+	};
+
+	// generated meshes indexed by MESH_ID and level of detail
+	GLMesh m_meshes[MESH_COUNT][LOD_COUNT];
+	// levels generated for each mesh
+	int m_lodCounts[MESH_COUNT];
+	struct STATIC_BATCH
+	{
+		GLuint vao;
+		GLuint vbo;
+		GLuint ibo;
+		GLsizei nIndices;
+	};
+
+	// baked static batches
+	std::vector<STATIC_BATCH> m_staticBatches;
+	// shared buffers of the merged meshes
+	GLuint m_mergedVAO;
+	GLuint m_mergedVBO;
+	GLuint m_mergedIBO;
+	// vertex format of the uploaded meshes
+	bool m_bPackedVertices;
+	// work submitted since ResetDrawStats()
+	DRAW_STATS m_drawStats;
+
+	// upload generated geometry into the buffers of one level
+	// of a mesh
+	void CreateMesh(
+		int meshID,
+		int lod,
+		const std::vector<GLfloat>& vertices,
+		const std::vector<GLuint>& indices);
+	// find a loaded level of a mesh, using the coarsest level
+	// when fewer were generated
+	const GLMesh* FindMesh(int meshID, int lod) const;
+	// free the buffers of all generated meshes
+	void DestroyMeshes();
+};
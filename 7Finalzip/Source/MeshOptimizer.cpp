@@ -0,0 +1,251 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.cpp
+// ============
+// reorder generated meshes for the post-transform vertex cache, for
+// overdraw and for vertex fetch
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// a run of triangles of the Tipsify order, and how likely it
+	// is to hide the rest of the mesh
+	struct CLUSTER
+	{
+		size_t firstTriangle;
+		size_t triangleCount;
+		float occlusion;
+	};
+
+	// get the position of a vertex
+	glm::vec3 GetPosition(const std::vector<GLfloat>& vertices, size_t floatsPerVertex, GLuint index)
+	{
+		const GLfloat* position = &vertices[index * floatsPerVertex];
+		return glm::vec3(position[0], position[1], position[2]);
+	}
+
+	// find the next fanning vertex after a dead end: the most
+	// recent emitted vertex that still has triangles left, or the
+	// next such vertex in input order
+	int SkipDeadEnd(
+		std::vector<GLuint>& deadEnds,
+		const std::vector<int>& liveCounts,
+		size_t& cursor)
+	{
+		while (!deadEnds.empty())
+		{
+			GLuint vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveCounts[vertex] > 0)
+				return (int)vertex;
+		}
+		while (cursor < liveCounts.size())
+		{
+			size_t vertex = cursor++;
+			if (liveCounts[vertex] > 0)
+				return (int)vertex;
+		}
+		return -1;
+	}
+}
+
+/***********************************************************
+ *  OptimizeIndices()
+ *
+ *  Emit the triangles in Tipsify order, then sort the
+ *  clusters it produced by how far their surface faces away
+ *  from the center of the mesh
+ ***********************************************************/
+void MeshOptimizer::OptimizeIndices(
+	const std::vector<GLfloat>& vertices,
+	size_t floatsPerVertex,
+	std::vector<GLuint>& indices,
+	int cacheSize)
+{
+	const size_t vertexCount = vertices.size() / floatsPerVertex;
+	const size_t triangleCount = indices.size() / 3;
+	if ((0 == vertexCount) || (triangleCount < 2))
+		return;
+
+	// triangles using each vertex, as offsets into one list
+	std::vector<int> liveCounts(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		liveCounts[indices[i]]++;
+	}
+	std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyStart[v + 1] = adjacencyStart[v] + liveCounts[v];
+	}
+	std::vector<GLuint> adjacency(adjacencyStart[vertexCount]);
+	std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			adjacency[fill[indices[t * 3 + corner]]++] = (GLuint)t;
+		}
+	}
+
+	// time stamps of the vertices in the simulated cache
+	std::vector<int> cacheTimes(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<GLuint> deadEnds;
+	std::vector<GLuint> candidates;
+	std::vector<GLuint> output;
+	output.reserve(triangleCount * 3);
+	std::vector<size_t> clusterStarts;
+
+	int time = cacheSize + 1;
+	size_t cursor = 1;
+	int fanVertex = 0;
+	clusterStarts.push_back(0);
+
+	while (fanVertex >= 0)
+	{
+		// emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (size_t a = adjacencyStart[fanVertex]; a < adjacencyStart[fanVertex + 1]; a++)
+		{
+			GLuint triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				GLuint vertex = indices[triangle * 3 + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveCounts[vertex]--;
+				if (time - cacheTimes[vertex] > cacheSize)
+					cacheTimes[vertex] = time++;
+			}
+			emitted[triangle] = true;
+		}
+
+		// continue with the candidate that stays in the cache the
+		// longest while its remaining triangles are emitted
+		int nextVertex = -1;
+		int bestPriority = -1;
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			GLuint vertex = candidates[c];
+			if (liveCounts[vertex] <= 0)
+				continue;
+
+			int priority = 0;
+			if (time - cacheTimes[vertex] + 2 * liveCounts[vertex] <= cacheSize)
+				priority = time - cacheTimes[vertex];
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				nextVertex = (int)vertex;
+			}
+		}
+
+		if (nextVertex < 0)
+		{
+			nextVertex = SkipDeadEnd(deadEnds, liveCounts, cursor);
+			// restarting outside the cache starts a new cluster
+			if ((nextVertex >= 0) && (time - cacheTimes[nextVertex] > cacheSize))
+				clusterStarts.push_back(output.size() / 3);
+		}
+		fanVertex = nextVertex;
+	}
+
+	// measure how much each cluster faces away from the mesh
+	// center, from its area weighted normal and centroid
+	glm::vec3 meshCenter(0.0f);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		meshCenter += GetPosition(vertices, floatsPerVertex, (GLuint)v);
+	}
+	meshCenter /= (float)vertexCount;
+
+	std::vector<CLUSTER> clusters(clusterStarts.size());
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		CLUSTER& cluster = clusters[c];
+		cluster.firstTriangle = clusterStarts[c];
+		size_t end = (c + 1 < clusterStarts.size()) ? clusterStarts[c + 1] : output.size() / 3;
+		cluster.triangleCount = end - cluster.firstTriangle;
+
+		glm::vec3 normal(0.0f);
+		glm::vec3 centroid(0.0f);
+		float area = 0.0f;
+		for (size_t t = cluster.firstTriangle; t < end; t++)
+		{
+			glm::vec3 p0 = GetPosition(vertices, floatsPerVertex, output[t * 3]);
+			glm::vec3 p1 = GetPosition(vertices, floatsPerVertex, output[t * 3 + 1]);
+			glm::vec3 p2 = GetPosition(vertices, floatsPerVertex, output[t * 3 + 2]);
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(cross);
+			normal += cross;
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			area += triangleArea;
+		}
+
+		cluster.occlusion = 0.0f;
+		if ((area > 0.0f) && (glm::length(normal) > 0.0f))
+		{
+			centroid /= area;
+			cluster.occlusion = glm::dot(centroid - meshCenter, glm::normalize(normal));
+		}
+	}
+
+	// stable, so that equal clusters keep their cache order
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const CLUSTER& a, const CLUSTER& b) { return a.occlusion > b.occlusion; });
+
+	indices.clear();
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const CLUSTER& cluster = clusters[c];
+		indices.insert(indices.end(),
+			output.begin() + cluster.firstTriangle * 3,
+			output.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3);
+	}
+}
+
+/***********************************************************
+ *  OptimizeVertexFetch()
+ *
+ *  Move the vertices into the order the index list first
+ *  references them, dropping vertices that are never used
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexFetch(
+	std::vector<GLfloat>& vertices,
+	size_t floatsPerVertex,
+	std::vector<GLuint>& indices)
+{
+	const size_t vertexCount = vertices.size() / floatsPerVertex;
+	const GLuint unused = (GLuint)-1;
+	std::vector<GLuint> remap(vertexCount, unused);
+	std::vector<GLfloat> reordered;
+	reordered.reserve(vertices.size());
+
+	GLuint nextIndex = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		GLuint& index = indices[i];
+		if (unused == remap[index])
+		{
+			remap[index] = nextIndex++;
+			reordered.insert(reordered.end(),
+				vertices.begin() + index * floatsPerVertex,
+				vertices.begin() + (index + 1) * floatsPerVertex);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.h
+// ============
+// reorder generated meshes for the post-transform vertex cache, for
+// overdraw and for vertex fetch
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  MeshOptimizer
+ *
+ *  OptimizeIndices() reorders the triangles of an indexed
+ *  triangle list with Tipsify (Sander, Nehab and Barczak,
+ *  "Fast Triangle Reordering for Vertex Locality and Reduced
+ *  Overdraw", 2007). Triangles are emitted as fans around
+ *  vertices that are still in a simulated FIFO cache of
+ *  cacheSize entries. Wherever the fanning has to restart
+ *  from a vertex outside the cache, a new cluster begins,
+ *  and the clusters are then ordered so that those facing
+ *  out from the middle of the mesh, which tend to hide the
+ *  others, are drawn first.
+ *
+ *  OptimizeVertexFetch() then renumbers the vertices in the
+ *  order the triangles first use them, so the vertex buffer
+ *  is read nearly sequentially.
+ *
+ *  Vertices are lists of floats starting with the position.
+ ***********************************************************/
+namespace MeshOptimizer
+{
+	// reorder the triangles for vertex cache hits and overdraw
+	void OptimizeIndices(
+		const std::vector<GLfloat>& vertices,
+		size_t floatsPerVertex,
+		std::vector<GLuint>& indices,
+		int cacheSize);
+	// renumber the vertices in their order of first use
+	void OptimizeVertexFetch(
+		std::vector<GLfloat>& vertices,
+		size_t floatsPerVertex,
+		std::vector<GLuint>& indices);
+}
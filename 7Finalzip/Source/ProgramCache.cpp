@@ -0,0 +1,169 @@
+///////////////////////////////////////////////////////////////////////////////
+// programcache.cpp
+// ============
+// keep linked shader programs on disk as driver binaries, so that a
+// program that was built before loads without compiling
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ProgramCache.h"
+#include "FileUtils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// declaration of global variables
+namespace
+{
+	const char* g_CacheDirectory = "ShaderCache";
+	const uint32_t g_CacheVersion = 1;
+
+	// chain a driver string into a hash, leaving it as it is
+	// when the driver gives none
+	uint64_t HashDriverString(GLenum name, uint64_t hash)
+	{
+		const char* text = (const char*)glGetString(name);
+		if (NULL == text)
+			return hash;
+		return FileUtils::Hash64(text, strlen(text), hash);
+	}
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  Some drivers expose the binary entry points but no format
+ *  to save programs in
+ ***********************************************************/
+bool ProgramCache::IsSupported()
+{
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return formatCount > 0;
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  Hash both sources, with a separator so that moving text
+ *  from one to the other changes the key, then the driver
+ ***********************************************************/
+uint64_t ProgramCache::MakeKey(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	const char separator = 0;
+	uint64_t hash = FileUtils::Hash64(vertexSource.data(), vertexSource.size());
+	hash = FileUtils::Hash64(&separator, 1, hash);
+	hash = FileUtils::Hash64(fragmentSource.data(), fragmentSource.size(), hash);
+	hash = HashDriverString(GL_VENDOR, hash);
+	hash = HashDriverString(GL_RENDERER, hash);
+	hash = HashDriverString(GL_VERSION, hash);
+	return hash;
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  Cached programs are kept in one directory, named after
+ *  their key
+ ***********************************************************/
+std::string ProgramCache::GetCachePath(uint64_t key)
+{
+	char keyText[17];
+	for (int i = 0; i < 16; i++)
+	{
+		keyText[i] = "0123456789abcdef"[(key >> (60 - i * 4)) & 0xF];
+	}
+	keyText[16] = 0;
+
+	return std::string(g_CacheDirectory) + "/" + keyText + ".glb";
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  Map the cached file of a key, check its header and hand
+ *  the binary to the driver. The link status tells whether
+ *  the driver took it.
+ ***********************************************************/
+GLuint ProgramCache::Load(uint64_t key)
+{
+	MappedFile file;
+	if (!file.Open(GetCachePath(key)))
+		return 0;
+
+	const uint8_t* data = file.GetData();
+	size_t size = file.GetSize();
+	if (size < sizeof(CACHE_HEADER))
+		return 0;
+
+	const CACHE_HEADER* header = (const CACHE_HEADER*)data;
+	bool bValid = (0 == memcmp(header->magic, "GLB1", 4)) &&
+		(header->version == g_CacheVersion) &&
+		(header->key == key) &&
+		(header->binarySize > 0) &&
+		(sizeof(CACHE_HEADER) + (uint64_t)header->binarySize <= size);
+	if (!bValid)
+		return 0;
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header->binaryFormat, data + sizeof(CACHE_HEADER), (GLsizei)header->binarySize);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (GL_TRUE != status)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+/***********************************************************
+ *  Store()
+ *
+ *  Read the binary of a linked program back from the driver
+ *  and write it under its key
+ ***********************************************************/
+bool ProgramCache::Store(uint64_t key, GLuint program)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return false;
+
+	std::vector<uint8_t> binary((size_t)length);
+	GLenum binaryFormat = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &binaryFormat, binary.data());
+	if (written <= 0)
+		return false;
+
+	CACHE_HEADER header;
+	memcpy(header.magic, "GLB1", 4);
+	header.version = g_CacheVersion;
+	header.binaryFormat = (uint32_t)binaryFormat;
+	header.binarySize = (uint32_t)written;
+	header.key = key;
+
+	FileUtils::MakeDirectory(g_CacheDirectory);
+
+	// write to a temporary name first, so that a reader never
+	// maps a half written file
+	std::string cachePath = GetCachePath(key);
+	std::string temporaryPath = cachePath + ".tmp";
+	{
+		std::ofstream file(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)binary.data(), written);
+		if (!file)
+			return false;
+	}
+
+	std::remove(cachePath.c_str());
+	return 0 == std::rename(temporaryPath.c_str(), cachePath.c_str());
+}
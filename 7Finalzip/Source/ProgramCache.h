@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+// programcache.h
+// ============
+// keep linked shader programs on disk as driver binaries, so that a
+// program that was built before loads without compiling
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  ProgramCache
+ *
+ *  Cached program file layout (all little endian):
+ *    CACHE_HEADER
+ *    program binary, binarySize bytes
+ *
+ *  A file is named after its key, which hashes the final
+ *  sources of the program together with the vendor, renderer
+ *  and version strings of the driver. Editing a shader or
+ *  updating the driver so gives a new key, and the old file
+ *  is simply never read again. A binary that the driver turns
+ *  down anyway counts as a miss.
+ ***********************************************************/
+namespace ProgramCache
+{
+	struct CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t binaryFormat;
+		uint32_t binarySize;
+		// key the file was written for
+		uint64_t key;
+	};
+
+	// true when the driver can hand out program binaries
+	bool IsSupported();
+	// get the key of a program built from two sources
+	uint64_t MakeKey(const std::string& vertexSource, const std::string& fragmentSource);
+	// get the path of the cached file for a key
+	std::string GetCachePath(uint64_t key);
+	// create a program from the cached binary of a key,
+	// returning 0 when there is none or the driver rejects it
+	GLuint Load(uint64_t key);
+	// write the binary of a linked program under a key
+	bool Store(uint64_t key, GLuint program);
+}
@@ -0,0 +1,209 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.cpp
+// ============
+// collect the draws of a frame and order them to minimize state changes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// map a view distance in [0, 1] to an unsigned integer
+	// with the given number of bits
+	uint64_t QuantizeDepth(float depth, int bits)
+	{
+		uint64_t maximum = ((uint64_t)1 << bits) - 1;
+		float clamped = std::min(std::max(depth, 0.0f), 1.0f);
+		return (uint64_t)(clamped * (float)maximum);
+	}
+}
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderQueue::RenderQueue()
+{
+	m_packets = NULL;
+	m_count = 0;
+	m_capacity = 0;
+	m_sortBuffer = NULL;
+}
+
+/***********************************************************
+ *  ~RenderQueue()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderQueue::~RenderQueue()
+{
+}
+
+/***********************************************************
+ *  MakeSortKey()
+ *
+ *  Pack the render state and the view distance of an opaque
+ *  draw into a 64-bit sort key
+ ***********************************************************/
+uint64_t RenderQueue::MakeSortKey(
+	int program,
+	int textureHandle,
+	int materialHandle,
+	int meshID,
+	float depth)
+{
+	// handles are stored one higher so that -1 becomes 0
+	uint64_t key = ((uint64_t)BUCKET_OPAQUE) << 62;
+	key |= ((uint64_t)(program & 0x3F)) << 56;
+	key |= ((uint64_t)((textureHandle + 1) & 0xFFFF)) << 40;
+	key |= ((uint64_t)((materialHandle + 1) & 0xFFFF)) << 24;
+	key |= ((uint64_t)(meshID & 0xFFFF)) << 8;
+	key |= QuantizeDepth(depth, 8);
+	return key;
+}
+
+/***********************************************************
+ *  MakeTransparentKey()
+ *
+ *  Pack the view distance of a transparent draw into a sort
+ *  key, inverted so that far draws come first
+ ***********************************************************/
+uint64_t RenderQueue::MakeTransparentKey(int meshID, float depth)
+{
+	const uint64_t depthMask = ((uint64_t)1 << 24) - 1;
+	uint64_t key = ((uint64_t)BUCKET_TRANSPARENT) << 62;
+	key |= (depthMask - QuantizeDepth(depth, 24)) << 38;
+	key |= ((uint64_t)(meshID & 0xFFFF)) << 8;
+	return key;
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  Take the packet list and the sort buffer of the pass from
+ *  the arena
+ ***********************************************************/
+void RenderQueue::Reset(FrameArena& arena, size_t capacity)
+{
+	m_packets = arena.AllocateArray<DRAW_PACKET>(capacity);
+	m_sortBuffer = arena.AllocateArray<DRAW_PACKET>(capacity);
+	m_count = 0;
+	m_capacity = capacity;
+}
+
+/***********************************************************
+ *  Push()
+ *
+ *  Add a draw packet to the queue
+ ***********************************************************/
+void RenderQueue::Push(uint64_t sortKey, uint32_t nodeIndex)
+{
+	if (m_count == m_capacity)
+		return;
+
+	m_packets[m_count].sortKey = sortKey;
+	m_packets[m_count].nodeIndex = nodeIndex;
+	m_count++;
+}
+
+/***********************************************************
+ *  Append()
+ *
+ *  Copy a list of packets to the end of the queue
+ ***********************************************************/
+void RenderQueue::Append(const DRAW_PACKET* packets, size_t count)
+{
+	count = std::min(count, m_capacity - m_count);
+	memcpy(m_packets + m_count, packets, count * sizeof(DRAW_PACKET));
+	m_count += count;
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  Least significant digit radix sort over the 8 bytes of
+ *  the sort key. The histograms of all bytes are built in a
+ *  single pass, and bytes that are equal in every key are
+ *  skipped, which is the common case for most fields.
+ ***********************************************************/
+void RenderQueue::Sort()
+{
+	const size_t count = m_count;
+	if (count < 2)
+		return;
+
+	uint32_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key = m_packets[i].sortKey;
+		for (int digit = 0; digit < 8; digit++)
+		{
+			histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+		}
+	}
+
+	DRAW_PACKET* source = m_packets;
+	DRAW_PACKET* target = m_sortBuffer;
+
+	for (int digit = 0; digit < 8; digit++)
+	{
+		uint32_t* histogram = histograms[digit];
+
+		// a pass is not needed when every key has the same byte
+		uint32_t firstByte = (uint32_t)((source[0].sortKey >> (digit * 8)) & 0xFF);
+		if (histogram[firstByte] == count)
+			continue;
+
+		// turn the counts into starting offsets
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			uint32_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t bucket = (uint32_t)((source[i].sortKey >> (digit * 8)) & 0xFF);
+			target[histogram[bucket]++] = source[i];
+		}
+
+		DRAW_PACKET* swap = source;
+		source = target;
+		target = swap;
+	}
+
+	// make sure the sorted result ends up in the packet list
+	if (source != m_packets)
+		memcpy(m_packets, source, count * sizeof(DRAW_PACKET));
+}
+
+/***********************************************************
+ *  FindBucket()
+ *
+ *  Binary search the sorted packets for the first one in a
+ *  bucket
+ ***********************************************************/
+size_t RenderQueue::FindBucket(int bucket) const
+{
+	size_t low = 0;
+	size_t high = m_count;
+	while (low < high)
+	{
+		size_t middle = (low + high) / 2;
+		if (GetBucket(m_packets[middle].sortKey) < bucket)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
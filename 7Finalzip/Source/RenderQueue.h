@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.h
+// ============
+// collect the draws of a frame and order them to minimize state changes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FrameArena.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/***********************************************************
+ *  RenderQueue
+ *
+ *  This class holds the draw packets of one frame. Each
+ *  packet carries a 64-bit sort key. The top bits pick the
+ *  bucket, so that every opaque draw comes before every
+ *  transparent one.
+ *
+ *  Opaque keys are built from the render state a draw needs,
+ *  so that after sorting, draws sharing a shader program,
+ *  texture, material and mesh are adjacent and state only
+ *  has to change between runs. Within a run the draws are
+ *  ordered front to back by their view distance, so nearer
+ *  surfaces fill the depth buffer first.
+ *
+ *  Opaque key layout (most significant first):
+ *    bits 62-63  bucket (0)
+ *    bits 56-61  shader program
+ *    bits 40-55  texture slot
+ *    bits 24-39  material
+ *    bits  8-23  mesh
+ *    bits  0-7   view distance, near first
+ *
+ *  Transparent draws have to blend in back to front order,
+ *  so their key is ordered by distance before any state:
+ *    bits 62-63  bucket (1)
+ *    bits 38-61  view distance, far first
+ *    bits  8-23  mesh
+ *
+ *  The packets and the sort buffer are taken from the frame
+ *  arena, sized for the most packets a pass can queue.
+ ***********************************************************/
+class RenderQueue
+{
+public:
+	// constructor
+	RenderQueue();
+	// destructor
+	~RenderQueue();
+
+	struct DRAW_PACKET
+	{
+		uint64_t sortKey;
+		uint32_t nodeIndex;
+	};
+
+	enum BUCKET
+	{
+		BUCKET_OPAQUE = 0,
+		BUCKET_TRANSPARENT = 1
+	};
+
+	// build the key of an opaque draw; negative handles (no
+	// texture or no material) sort before every valid handle.
+	// depth is the view distance divided by the far distance.
+	static uint64_t MakeSortKey(
+		int program,
+		int textureHandle,
+		int materialHandle,
+		int meshID,
+		float depth);
+	// build the key of a transparent draw
+	static uint64_t MakeTransparentKey(int meshID, float depth);
+	// extract the fields of a sort key; the state fields are
+	// only meaningful in opaque keys
+	static int GetBucket(uint64_t sortKey) { return (int)(sortKey >> 62); }
+	static int GetProgram(uint64_t sortKey) { return (int)((sortKey >> 56) & 0x3F); }
+	static int GetTextureHandle(uint64_t sortKey) { return (int)((sortKey >> 40) & 0xFFFF) - 1; }
+	static int GetMaterialHandle(uint64_t sortKey) { return (int)((sortKey >> 24) & 0xFFFF) - 1; }
+	static int GetMeshID(uint64_t sortKey) { return (int)((sortKey >> 8) & 0xFFFF); }
+
+	// start an empty queue with room for capacity packets,
+	// valid until the arena is reset or rewound
+	void Reset(FrameArena& arena, size_t capacity);
+	// add a draw packet to the queue, dropping it when full
+	void Push(uint64_t sortKey, uint32_t nodeIndex);
+	// add packets that were built elsewhere
+	void Append(const DRAW_PACKET* packets, size_t count);
+	// radix sort the packets by key, keeping the submission
+	// order of packets with equal keys
+	void Sort();
+
+	// access the packets
+	size_t GetCount() const { return m_count; }
+	// index of the first packet of a bucket in the sorted queue,
+	// or the packet count when the bucket is empty
+	size_t FindBucket(int bucket) const;
+	const DRAW_PACKET& GetPacket(size_t index) const { return m_packets[index]; }
+
+private:
+	// draw packets of the current pass
+	DRAW_PACKET* m_packets;
+	size_t m_count;
+	size_t m_capacity;
+	// scratch buffer for the radix sort passes
+	DRAW_PACKET* m_sortBuffer;
+};
@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendertarget.h
+// ============
+// offscreen framebuffer with a color texture and a depth buffer
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  RenderTarget
+ *
+ *  This class owns a framebuffer object with an RGBA8 color
+ *  texture and a 24-bit depth / 8-bit stencil renderbuffer,
+ *  so that frames can be rendered without a visible window.
+ ***********************************************************/
+class RenderTarget
+{
+public:
+	// constructor
+	RenderTarget();
+	// destructor
+	~RenderTarget();
+
+	// create the framebuffer at a size, replacing any previous one
+	bool Create(int width, int height);
+	// free the framebuffer
+	void Destroy();
+
+	// render into the target, setting the viewport to its size
+	void Bind() const;
+	// render into the default framebuffer again
+	static void Unbind(int viewportWidth, int viewportHeight);
+
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+	GLuint GetColorTexture() const { return m_colorTexture; }
+	GLuint GetFramebuffer() const { return m_framebuffer; }
+
+private:
+	GLuint m_framebuffer;
+	GLuint m_colorTexture;
+	GLuint m_depthBuffer;
+	int m_width;
+	int m_height;
+
+	// a render target can not be copied
+	RenderTarget(const RenderTarget&);
+	RenderTarget& operator=(const RenderTarget&);
+};
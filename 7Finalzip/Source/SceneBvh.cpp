@@ -0,0 +1,538 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.cpp
+// ============
+// dynamic bounding volume hierarchy over the boxes of scene objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBvh.h"
+
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// part of its size, and a least distance, that an object
+	// that moved gets around its box
+	const float g_MoveMarginScale = 0.1f;
+	const float g_MinMoveMargin = 0.05f;
+
+	// surface area of a box, the cost of visiting it
+	float GetArea(const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		glm::vec3 size = boxMax - boxMin;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	// whether box A holds all of box B
+	bool ContainsBox(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+	{
+		return (minA.x <= minB.x) && (minA.y <= minB.y) && (minA.z <= minB.z) &&
+			(maxB.x <= maxA.x) && (maxB.y <= maxA.y) && (maxB.z <= maxA.z);
+	}
+
+	// area of the box around two boxes
+	float GetUnionArea(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+	{
+		return GetArea(glm::min(minA, minB), glm::max(maxA, maxB));
+	}
+
+	// test a ray against a box with the slab method, giving the
+	// distance where it enters the box
+	bool IntersectRayBox(
+		const glm::vec3& origin,
+		const glm::vec3& inverseDirection,
+		const glm::vec3& boxMin,
+		const glm::vec3& boxMax,
+		float maxDistance,
+		float& entry)
+	{
+		glm::vec3 t0 = (boxMin - origin) * inverseDirection;
+		glm::vec3 t1 = (boxMax - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		entry = enter;
+		return enter <= exit;
+	}
+}
+
+/***********************************************************
+ *  SceneBvh()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneBvh::SceneBvh()
+{
+	m_root = -1;
+	m_freeList = -1;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  Drop every node while keeping the memory
+ ***********************************************************/
+void SceneBvh::Clear()
+{
+	m_nodes.clear();
+	m_objectLeaves.clear();
+	m_root = -1;
+	m_freeList = -1;
+}
+
+/***********************************************************
+ *  SetObject()
+ *
+ *  Insert a new object with its exact box. An object that is
+ *  already in the tree stays where it is while its new box
+ *  fits in its leaf, and is inserted again with a margin
+ *  once it does not.
+ ***********************************************************/
+void SceneBvh::SetObject(uint32_t object, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	if (object >= m_objectLeaves.size())
+		m_objectLeaves.resize((size_t)object + 1, -1);
+
+	int leaf = m_objectLeaves[object];
+	if (leaf >= 0)
+	{
+		const TREE_NODE& node = m_nodes[leaf];
+		if (ContainsBox(node.boxMin, node.boxMax, boxMin, boxMax))
+			return;
+
+		RemoveLeaf(leaf);
+		glm::vec3 margin = glm::max((boxMax - boxMin) * g_MoveMarginScale, glm::vec3(g_MinMoveMargin));
+		m_nodes[leaf].boxMin = boxMin - margin;
+		m_nodes[leaf].boxMax = boxMax + margin;
+		InsertLeaf(leaf);
+		return;
+	}
+
+	leaf = AllocateNode();
+	TREE_NODE& node = m_nodes[leaf];
+	node.boxMin = boxMin;
+	node.boxMax = boxMax;
+	node.object = object;
+	InsertLeaf(leaf);
+	m_objectLeaves[object] = leaf;
+}
+
+/***********************************************************
+ *  RemoveObject()
+ *
+ *  Unlink the leaf of an object and free it
+ ***********************************************************/
+void SceneBvh::RemoveObject(uint32_t object)
+{
+	if ((object >= m_objectLeaves.size()) || (m_objectLeaves[object] < 0))
+		return;
+
+	int leaf = m_objectLeaves[object];
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	m_objectLeaves[object] = -1;
+}
+
+/***********************************************************
+ *  QueryFrustum()
+ *
+ *  Walk the branches whose boxes touch the frustum. Below a
+ *  box that is fully inside, no more planes are tested.
+ ***********************************************************/
+size_t SceneBvh::QueryFrustum(const FrustumCuller& frustum, uint32_t* objects, size_t maxObjects) const
+{
+	if (m_root < 0)
+		return 0;
+
+	struct STACK_ENTRY
+	{
+		int node;
+		bool bInside;
+	};
+	STACK_ENTRY stack[MAX_STACK];
+	int stackSize = 0;
+	stack[stackSize].node = m_root;
+	stack[stackSize].bInside = false;
+	stackSize++;
+
+	size_t count = 0;
+	while (stackSize > 0)
+	{
+		STACK_ENTRY entry = stack[--stackSize];
+		const TREE_NODE& node = m_nodes[entry.node];
+		if (!entry.bInside)
+		{
+			FrustumCuller::BOX_RESULT result = frustum.TestBox(node.boxMin, node.boxMax);
+			if (FrustumCuller::BOX_OUTSIDE == result)
+				continue;
+			entry.bInside = (FrustumCuller::BOX_INSIDE == result);
+		}
+
+		if (node.child0 < 0)
+		{
+			if (count < maxObjects)
+				objects[count] = node.object;
+			count++;
+		}
+		else if (stackSize + 2 <= MAX_STACK)
+		{
+			stack[stackSize].node = node.child0;
+			stack[stackSize].bInside = entry.bInside;
+			stackSize++;
+			stack[stackSize].node = node.child1;
+			stack[stackSize].bInside = entry.bInside;
+			stackSize++;
+		}
+	}
+	return count;
+}
+
+/***********************************************************
+ *  QuerySphere()
+ *
+ *  Walk the branches whose boxes lie within radius of the
+ *  center
+ ***********************************************************/
+size_t SceneBvh::QuerySphere(const glm::vec3& center, float radius, uint32_t* objects, size_t maxObjects) const
+{
+	if (m_root < 0)
+		return 0;
+
+	int stack[MAX_STACK];
+	int stackSize = 0;
+	stack[stackSize++] = m_root;
+
+	const float radiusSquared = radius * radius;
+	size_t count = 0;
+	while (stackSize > 0)
+	{
+		const TREE_NODE& node = m_nodes[stack[--stackSize]];
+		glm::vec3 offset = center - glm::min(glm::max(center, node.boxMin), node.boxMax);
+		if (glm::dot(offset, offset) > radiusSquared)
+			continue;
+
+		if (node.child0 < 0)
+		{
+			if (count < maxObjects)
+				objects[count] = node.object;
+			count++;
+		}
+		else if (stackSize + 2 <= MAX_STACK)
+		{
+			stack[stackSize++] = node.child0;
+			stack[stackSize++] = node.child1;
+		}
+	}
+	return count;
+}
+
+/***********************************************************
+ *  CastRay()
+ *
+ *  Walk the boxes the ray enters, nearer child first, and
+ *  skip every box that starts beyond the nearest hit found
+ *  so far
+ ***********************************************************/
+int SceneBvh::CastRay(
+	const glm::vec3& origin,
+	const glm::vec3& direction,
+	float maxDistance,
+	RAY_TEST test,
+	void* context,
+	float& distance) const
+{
+	distance = maxDistance;
+	if (m_root < 0)
+		return -1;
+
+	// a zero component still divides into a huge slab distance
+	glm::vec3 inverseDirection;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float component = direction[axis];
+		if (std::abs(component) < 1e-20f)
+			component = (component < 0.0f) ? -1e-20f : 1e-20f;
+		inverseDirection[axis] = 1.0f / component;
+	}
+
+	int stack[MAX_STACK];
+	int stackSize = 0;
+	stack[stackSize++] = m_root;
+
+	int hit = -1;
+	while (stackSize > 0)
+	{
+		const TREE_NODE& node = m_nodes[stack[--stackSize]];
+		float entry = 0.0f;
+		if (!IntersectRayBox(origin, inverseDirection, node.boxMin, node.boxMax, distance, entry))
+			continue;
+
+		if (node.child0 < 0)
+		{
+			float t = test(context, node.object, origin, direction);
+			if ((t >= 0.0f) && (t < distance))
+			{
+				distance = t;
+				hit = (int)node.object;
+			}
+			continue;
+		}
+
+		if (stackSize + 2 > MAX_STACK)
+			continue;
+
+		// the child pushed last is visited first
+		const TREE_NODE& child0 = m_nodes[node.child0];
+		const TREE_NODE& child1 = m_nodes[node.child1];
+		float entry0 = 0.0f;
+		float entry1 = 0.0f;
+		bool bHit0 = IntersectRayBox(origin, inverseDirection, child0.boxMin, child0.boxMax, distance, entry0);
+		bool bHit1 = IntersectRayBox(origin, inverseDirection, child1.boxMin, child1.boxMax, distance, entry1);
+		if (bHit0 && bHit1)
+		{
+			stack[stackSize++] = (entry0 < entry1) ? node.child1 : node.child0;
+			stack[stackSize++] = (entry0 < entry1) ? node.child0 : node.child1;
+		}
+		else if (bHit0)
+		{
+			stack[stackSize++] = node.child0;
+		}
+		else if (bHit1)
+		{
+			stack[stackSize++] = node.child1;
+		}
+	}
+	return hit;
+}
+
+/***********************************************************
+ *  AllocateNode()
+ *
+ *  Reuse a freed node, or add one
+ ***********************************************************/
+int SceneBvh::AllocateNode()
+{
+	int node = m_freeList;
+	if (node >= 0)
+	{
+		m_freeList = m_nodes[node].nextFree;
+	}
+	else
+	{
+		node = (int)m_nodes.size();
+		m_nodes.push_back(TREE_NODE());
+	}
+
+	TREE_NODE& created = m_nodes[node];
+	created.boxMin = glm::vec3(0.0f);
+	created.boxMax = glm::vec3(0.0f);
+	created.parent = -1;
+	created.child0 = -1;
+	created.child1 = -1;
+	created.height = 0;
+	created.object = 0;
+	created.nextFree = -1;
+	return node;
+}
+
+/***********************************************************
+ *  FreeNode()
+ *
+ *  Put a node on the free list
+ ***********************************************************/
+void SceneBvh::FreeNode(int node)
+{
+	m_nodes[node].nextFree = m_freeList;
+	m_nodes[node].height = -1;
+	m_freeList = node;
+}
+
+/***********************************************************
+ *  InsertLeaf()
+ *
+ *  Walk down to the sibling that costs the least surface
+ *  area to pair the leaf with, join them under a new inner
+ *  node, then refit and rebalance up to the root
+ ***********************************************************/
+void SceneBvh::InsertLeaf(int leaf)
+{
+	if (m_root < 0)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = -1;
+		return;
+	}
+
+	const glm::vec3 leafMin = m_nodes[leaf].boxMin;
+	const glm::vec3 leafMax = m_nodes[leaf].boxMax;
+	int sibling = m_root;
+	while (m_nodes[sibling].child0 >= 0)
+	{
+		const TREE_NODE& node = m_nodes[sibling];
+		float area = GetArea(node.boxMin, node.boxMax);
+		float combinedArea = GetUnionArea(node.boxMin, node.boxMax, leafMin, leafMax);
+
+		// pairing with this node, or pushing the leaf further
+		// down, which grows this node's box either way
+		float cost = 2.0f * combinedArea;
+		float inheritedCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		int children[2] = { node.child0, node.child1 };
+		for (int c = 0; c < 2; c++)
+		{
+			const TREE_NODE& child = m_nodes[children[c]];
+			float unionArea = GetUnionArea(child.boxMin, child.boxMax, leafMin, leafMax);
+			if (child.child0 < 0)
+				childCost[c] = unionArea + inheritedCost;
+			else
+				childCost[c] = unionArea - GetArea(child.boxMin, child.boxMax) + inheritedCost;
+		}
+
+		if ((cost < childCost[0]) && (cost < childCost[1]))
+			break;
+		sibling = (childCost[0] < childCost[1]) ? children[0] : children[1];
+	}
+
+	int oldParent = m_nodes[sibling].parent;
+	int newParent = AllocateNode();
+	TREE_NODE& parent = m_nodes[newParent];
+	parent.parent = oldParent;
+	parent.child0 = sibling;
+	parent.child1 = leaf;
+	parent.boxMin = glm::min(leafMin, m_nodes[sibling].boxMin);
+	parent.boxMax = glm::max(leafMax, m_nodes[sibling].boxMax);
+	parent.height = m_nodes[sibling].height + 1;
+
+	if (oldParent >= 0)
+	{
+		if (m_nodes[oldParent].child0 == sibling)
+			m_nodes[oldParent].child0 = newParent;
+		else
+			m_nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		m_root = newParent;
+	}
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	for (int node = m_nodes[leaf].parent; node >= 0; node = m_nodes[node].parent)
+	{
+		node = Balance(node);
+		Refit(node);
+	}
+}
+
+/***********************************************************
+ *  RemoveLeaf()
+ *
+ *  Replace the parent of a leaf with the leaf's sibling,
+ *  then refit and rebalance up to the root
+ ***********************************************************/
+void SceneBvh::RemoveLeaf(int leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = -1;
+		return;
+	}
+
+	int parent = m_nodes[leaf].parent;
+	int grandParent = m_nodes[parent].parent;
+	int sibling = (m_nodes[parent].child0 == leaf) ? m_nodes[parent].child1 : m_nodes[parent].child0;
+
+	if (grandParent >= 0)
+	{
+		if (m_nodes[grandParent].child0 == parent)
+			m_nodes[grandParent].child0 = sibling;
+		else
+			m_nodes[grandParent].child1 = sibling;
+		m_nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+
+		for (int node = grandParent; node >= 0; node = m_nodes[node].parent)
+		{
+			node = Balance(node);
+			Refit(node);
+		}
+	}
+	else
+	{
+		m_root = sibling;
+		m_nodes[sibling].parent = -1;
+		FreeNode(parent);
+	}
+	m_nodes[leaf].parent = -1;
+}
+
+/***********************************************************
+ *  Balance()
+ *
+ *  Rotate the taller grandchild pair of an unbalanced node
+ *  up one level, as in an AVL tree
+ ***********************************************************/
+int SceneBvh::Balance(int a)
+{
+	if ((m_nodes[a].child0 < 0) || (m_nodes[a].height < 2))
+		return a;
+
+	int b = m_nodes[a].child0;
+	int c = m_nodes[a].child1;
+	int balance = m_nodes[c].height - m_nodes[b].height;
+	if ((balance >= -1) && (balance <= 1))
+		return a;
+
+	// the taller child takes the place of a, and a keeps the
+	// shorter child and the shorter of the taller one's children
+	bool bRaiseC = (balance > 1);
+	int up = bRaiseC ? c : b;
+	int kept = bRaiseC ? b : c;
+	int f = m_nodes[up].child0;
+	int g = m_nodes[up].child1;
+
+	m_nodes[up].child0 = a;
+	m_nodes[up].parent = m_nodes[a].parent;
+	m_nodes[a].parent = up;
+	if (m_nodes[up].parent >= 0)
+	{
+		TREE_NODE& upParent = m_nodes[m_nodes[up].parent];
+		if (upParent.child0 == a)
+			upParent.child0 = up;
+		else
+			upParent.child1 = up;
+	}
+	else
+	{
+		m_root = up;
+	}
+
+	int taller = (m_nodes[f].height > m_nodes[g].height) ? f : g;
+	int shorter = (taller == f) ? g : f;
+	m_nodes[up].child1 = taller;
+	m_nodes[a].child0 = kept;
+	m_nodes[a].child1 = shorter;
+	m_nodes[shorter].parent = a;
+
+	Refit(a);
+	Refit(up);
+	return up;
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  Fit the box of an inner node around its children
+ ***********************************************************/
+void SceneBvh::Refit(int node)
+{
+	TREE_NODE& inner = m_nodes[node];
+	const TREE_NODE& child0 = m_nodes[inner.child0];
+	const TREE_NODE& child1 = m_nodes[inner.child1];
+	inner.boxMin = glm::min(child0.boxMin, child1.boxMin);
+	inner.boxMax = glm::max(child0.boxMax, child1.boxMax);
+	inner.height = 1 + std::max(child0.height, child1.height);
+}
@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.h
+// ============
+// dynamic bounding volume hierarchy over the boxes of scene objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FrustumCuller.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  SceneBvh
+ *
+ *  This class keeps the world-space boxes of the objects of
+ *  a scene in a binary tree of boxes, so that frustum, ray
+ *  and proximity queries only visit the branches they touch.
+ *
+ *  Objects are inserted one by one, each next to the branch
+ *  that grows the least in surface area, and the tree is
+ *  rebalanced with rotations on the way up, so it stays of
+ *  logarithmic height whatever the insertion order. When an
+ *  object moves out of its box, its leaf is taken out and
+ *  inserted again with a margin, so an object that keeps
+ *  moving a little only touches the tree now and then.
+ *
+ *  Queries never allocate: they walk the tree with a stack
+ *  on the call stack, and write into arrays of the caller.
+ ***********************************************************/
+class SceneBvh
+{
+public:
+	// constructor
+	SceneBvh();
+
+	// test an object against a ray, returning the distance
+	// along the direction where it is hit, or a negative value
+	// when it is missed
+	typedef float (*RAY_TEST)(void* context, uint32_t object, const glm::vec3& origin, const glm::vec3& direction);
+
+	// remove every object
+	void Clear();
+	// insert an object, or move it to a new box
+	void SetObject(uint32_t object, const glm::vec3& boxMin, const glm::vec3& boxMax);
+	// take an object out of the tree
+	void RemoveObject(uint32_t object);
+
+	// write the objects whose boxes touch the frustum, up to
+	// maxObjects of them, and return how many there were
+	size_t QueryFrustum(const FrustumCuller& frustum, uint32_t* objects, size_t maxObjects) const;
+	// write the objects whose boxes touch a sphere
+	size_t QuerySphere(const glm::vec3& center, float radius, uint32_t* objects, size_t maxObjects) const;
+	// find the nearest object that the ray test hits within
+	// maxDistance, returning -1 when there is none
+	int CastRay(
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		RAY_TEST test,
+		void* context,
+		float& distance) const;
+	// the same with any callable taking (object, origin,
+	// direction)
+	template <typename FUNCTION>
+	int CastRay(
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		const FUNCTION& test,
+		float& distance) const
+	{
+		return CastRay(origin, direction, maxDistance, &CallRayTest<FUNCTION>, (void*)&test, distance);
+	}
+
+	// height of the tree, 0 when it is empty
+	int GetHeight() const { return (m_root < 0) ? 0 : m_nodes[m_root].height + 1; }
+
+private:
+	// deepest stack a query needs; a balanced tree of this
+	// height holds far more objects than any scene
+	static const int MAX_STACK = 128;
+
+	struct TREE_NODE
+	{
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+		int parent;
+		// children of an inner node, -1 in a leaf
+		int child0;
+		int child1;
+		// leaf height is 0
+		int height;
+		// object of a leaf, or the next free node when unused
+		uint32_t object;
+		int nextFree;
+	};
+
+	std::vector<TREE_NODE> m_nodes;
+	int m_root;
+	int m_freeList;
+	// leaf of each object, -1 when it is not in the tree
+	std::vector<int> m_objectLeaves;
+
+	// take a node from the free list, and give one back
+	int AllocateNode();
+	void FreeNode(int node);
+	// link a leaf into the tree, and unlink it
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	// rotate the subtree at node when its children differ in
+	// height by more than one, returning its new root
+	int Balance(int node);
+	// recompute the box and height of an inner node
+	void Refit(int node);
+
+	template <typename FUNCTION>
+	static float CallRayTest(void* context, uint32_t object, const glm::vec3& origin, const glm::vec3& direction)
+	{
+		return (*(const FUNCTION*)context)(object, origin, direction);
+	}
+};
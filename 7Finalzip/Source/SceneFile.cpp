@@ -0,0 +1,394 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.cpp
+// ============
+// scene descriptions authored as text and compiled into a flat binary
+// form that is memory mapped and used in place
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+#include "MeshManager.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// declaration of global variables
+namespace
+{
+	const uint32_t g_SceneVersion = 1;
+
+	// mesh names used by node lines, indexed by MESH_ID
+	const char* g_MeshNames[MeshManager::MESH_COUNT] = { "plane", "box", "cone", "torus" };
+
+	// round an offset up to the table alignment
+	uint32_t AlignOffset(size_t offset)
+	{
+		return (uint32_t)((offset + 15) & ~(size_t)15);
+	}
+
+	// find a tag in a list, returning -1 when it is missing
+	int FindTag(const std::vector<std::string>& tags, const std::string& tag)
+	{
+		for (size_t i = 0; i < tags.size(); i++)
+		{
+			if (tags[i] == tag)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	// read count floats from a line
+	bool ReadFloats(std::istringstream& values, float* target, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (!(values >> target[i]))
+				return false;
+		}
+		return true;
+	}
+
+	// append a string to the string table, returning its offset
+	uint32_t AddString(std::vector<char>& strings, const std::string& text)
+	{
+		uint32_t offset = (uint32_t)strings.size();
+		strings.insert(strings.end(), text.begin(), text.end());
+		strings.push_back('\0');
+		return offset;
+	}
+
+	// copy a table into the compiled buffer at its offset
+	template <typename T>
+	void WriteTable(std::vector<uint8_t>& compiled, const SceneFile::SCENE_TABLE& table, const std::vector<T>& records)
+	{
+		if (!records.empty())
+			memcpy(compiled.data() + table.offset, records.data(), records.size() * sizeof(T));
+	}
+}
+
+/***********************************************************
+ *  SceneFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneFile::SceneFile()
+{
+	m_pData = NULL;
+	m_pHeader = NULL;
+}
+
+/***********************************************************
+ *  GetBinaryPath()
+ *
+ *  Get the path of the compiled binary of a text scene
+ ***********************************************************/
+std::string SceneFile::GetBinaryPath(const std::string& textPath)
+{
+	return textPath + "b";
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  Map the compiled binary when it matches the text file,
+ *  otherwise parse the text and compile it for next time
+ ***********************************************************/
+bool SceneFile::Load(const std::string& textPath)
+{
+	Close();
+
+	std::string binaryPath = GetBinaryPath(textPath);
+	uint64_t modified = 0;
+	uint64_t size = 0;
+	bool bHasText = FileUtils::GetFileStamp(textPath, modified, size);
+
+	if (m_file.Open(binaryPath))
+	{
+		if (Attach(m_file.GetData(), m_file.GetSize()) &&
+			(!bHasText || ((m_pHeader->sourceModified == modified) && (m_pHeader->sourceSize == size))))
+		{
+			return true;
+		}
+		Close();
+	}
+
+	if (!bHasText)
+	{
+		std::cerr << "Could not open scene " << textPath << std::endl;
+		return false;
+	}
+
+	if (!ParseText(textPath, m_buffer) || !Attach(m_buffer.data(), m_buffer.size()))
+	{
+		Close();
+		return false;
+	}
+
+	// a failed write only costs the parse on the next run
+	std::string temporaryPath = binaryPath + ".tmp";
+	{
+		std::ofstream file(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (file)
+			file.write((const char*)m_buffer.data(), m_buffer.size());
+		if (!file)
+			return true;
+	}
+	std::remove(binaryPath.c_str());
+	std::rename(temporaryPath.c_str(), binaryPath.c_str());
+	return true;
+}
+
+/***********************************************************
+ *  Compile()
+ *
+ *  Parse a text scene and write it as a compiled binary
+ ***********************************************************/
+bool SceneFile::Compile(const std::string& textPath, const std::string& binaryPath)
+{
+	std::vector<uint8_t> compiled;
+	if (!ParseText(textPath, compiled))
+		return false;
+
+	std::ofstream file(binaryPath.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+	file.write((const char*)compiled.data(), compiled.size());
+	return (bool)file;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  Unmap or free the scene tables
+ ***********************************************************/
+void SceneFile::Close()
+{
+	m_file.Close();
+	std::vector<uint8_t>().swap(m_buffer);
+	m_pData = NULL;
+	m_pHeader = NULL;
+}
+
+/***********************************************************
+ *  Attach()
+ *
+ *  Check that every table and reference of a compiled scene
+ *  stays inside it, then use it in place
+ ***********************************************************/
+bool SceneFile::Attach(const uint8_t* data, size_t size)
+{
+	if (size < sizeof(SCENE_HEADER))
+		return false;
+
+	const SCENE_HEADER* header = (const SCENE_HEADER*)data;
+	if ((0 != memcmp(header->magic, "SCN1", 4)) || (header->version != g_SceneVersion))
+		return false;
+
+	const SCENE_TABLE* tables[4] = { &header->textures, &header->materials, &header->lights, &header->nodes };
+	const size_t recordSizes[4] = { sizeof(SCENE_TEXTURE), sizeof(SCENE_MATERIAL), sizeof(SCENE_LIGHT), sizeof(SCENE_NODE_RECORD) };
+	for (int i = 0; i < 4; i++)
+	{
+		if ((0 != (tables[i]->offset & 15)) ||
+			((uint64_t)tables[i]->offset + (uint64_t)tables[i]->count * recordSizes[i] > size))
+		{
+			return false;
+		}
+	}
+
+	// a string table ending in NUL keeps every string inside it
+	if ((0 == header->stringsSize) ||
+		((uint64_t)header->stringsOffset + header->stringsSize > size) ||
+		(0 != data[header->stringsOffset + header->stringsSize - 1]))
+	{
+		return false;
+	}
+
+	const SCENE_TEXTURE* textures = (const SCENE_TEXTURE*)(data + header->textures.offset);
+	for (uint32_t i = 0; i < header->textures.count; i++)
+	{
+		if ((textures[i].tag >= header->stringsSize) || (textures[i].path >= header->stringsSize))
+			return false;
+	}
+	const SCENE_MATERIAL* materials = (const SCENE_MATERIAL*)(data + header->materials.offset);
+	for (uint32_t i = 0; i < header->materials.count; i++)
+	{
+		if (materials[i].tag >= header->stringsSize)
+			return false;
+	}
+	const SCENE_NODE_RECORD* nodes = (const SCENE_NODE_RECORD*)(data + header->nodes.offset);
+	for (uint32_t i = 0; i < header->nodes.count; i++)
+	{
+		if ((nodes[i].mesh >= MeshManager::MESH_COUNT) ||
+			(nodes[i].texture < -1) || (nodes[i].texture >= (int32_t)header->textures.count) ||
+			(nodes[i].material < -1) || (nodes[i].material >= (int32_t)header->materials.count))
+		{
+			return false;
+		}
+	}
+
+	m_pData = data;
+	m_pHeader = header;
+	return true;
+}
+
+/***********************************************************
+ *  ParseText()
+ *
+ *  Read the lines of a text scene and lay out the compiled
+ *  tables. Textures and materials have to be declared before
+ *  the nodes that use them.
+ ***********************************************************/
+bool SceneFile::ParseText(const std::string& textPath, std::vector<uint8_t>& compiled)
+{
+	std::ifstream file(textPath.c_str());
+	if (!file)
+	{
+		std::cerr << "Could not open scene " << textPath << std::endl;
+		return false;
+	}
+
+	std::vector<SCENE_TEXTURE> textures;
+	std::vector<SCENE_MATERIAL> materials;
+	std::vector<SCENE_LIGHT> lights;
+	std::vector<SCENE_NODE_RECORD> nodes;
+	std::vector<std::string> textureTags;
+	std::vector<std::string> materialTags;
+	std::vector<char> strings;
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		std::istringstream values(line);
+		std::string keyword;
+		if (!(values >> keyword) || ('#' == keyword[0]))
+			continue;
+
+		bool bValid = false;
+		if (keyword == "texture")
+		{
+			// texture <tag> <path>
+			std::string tag;
+			std::string path;
+			if ((values >> tag >> path) && (FindTag(textureTags, tag) < 0))
+			{
+				SCENE_TEXTURE texture;
+				texture.tag = AddString(strings, tag);
+				texture.path = AddString(strings, path);
+				textures.push_back(texture);
+				textureTags.push_back(tag);
+				bValid = true;
+			}
+		}
+		else if (keyword == "material")
+		{
+			// material <tag> <ambient rgb> <strength> <diffuse rgb>
+			//          <specular rgb> <shininess>
+			std::string tag;
+			SCENE_MATERIAL material;
+			if ((values >> tag) && (FindTag(materialTags, tag) < 0) &&
+				ReadFloats(values, material.ambientColor, 3) &&
+				ReadFloats(values, &material.ambientStrength, 1) &&
+				ReadFloats(values, material.diffuseColor, 3) &&
+				ReadFloats(values, material.specularColor, 3) &&
+				ReadFloats(values, &material.shininess, 1))
+			{
+				material.tag = AddString(strings, tag);
+				materials.push_back(material);
+				materialTags.push_back(tag);
+				bValid = true;
+			}
+		}
+		else if (keyword == "light")
+		{
+			// light <position xyz> <radius> <ambient rgb> <focal>
+			//       <diffuse rgb> <intensity> <specular rgb> <shadow>
+			SCENE_LIGHT light;
+			if (ReadFloats(values, light.position, 4) &&
+				ReadFloats(values, light.ambientColor, 4) &&
+				ReadFloats(values, light.diffuseColor, 4) &&
+				ReadFloats(values, light.specularColor, 4))
+			{
+				lights.push_back(light);
+				bValid = true;
+			}
+		}
+		else if (keyword == "node")
+		{
+			// node <mesh> <texture|-> <material|-> <uv scale>
+			//      <scale xyz> <rotation xyz> <position xyz> [opacity]
+			std::string mesh;
+			std::string texture;
+			std::string material;
+			SCENE_NODE_RECORD node;
+			if ((values >> mesh >> texture >> material) &&
+				ReadFloats(values, node.uvScale, 2) &&
+				ReadFloats(values, node.scale, 3) &&
+				ReadFloats(values, node.rotationDegrees, 3) &&
+				ReadFloats(values, node.position, 3))
+			{
+				if (!(values >> node.opacity))
+					node.opacity = 1.0f;
+
+				node.mesh = MeshManager::MESH_COUNT;
+				for (uint32_t i = 0; i < MeshManager::MESH_COUNT; i++)
+				{
+					if (mesh == g_MeshNames[i])
+						node.mesh = i;
+				}
+				node.texture = (texture == "-") ? -1 : FindTag(textureTags, texture);
+				node.material = (material == "-") ? -1 : FindTag(materialTags, material);
+
+				bValid = (node.mesh < MeshManager::MESH_COUNT) &&
+					((texture == "-") || (node.texture >= 0)) &&
+					((material == "-") || (node.material >= 0));
+				if (bValid)
+					nodes.push_back(node);
+			}
+		}
+
+		if (!bValid)
+		{
+			std::cerr << textPath << ":" << lineNumber << ": invalid line: " << line << std::endl;
+			return false;
+		}
+	}
+
+	// an empty string table still holds one NUL
+	if (strings.empty())
+		strings.push_back('\0');
+
+	uint64_t modified = 0;
+	uint64_t size = 0;
+	FileUtils::GetFileStamp(textPath, modified, size);
+
+	SCENE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "SCN1", 4);
+	header.version = g_SceneVersion;
+	header.sourceModified = modified;
+	header.sourceSize = size;
+	header.textures.offset = AlignOffset(sizeof(SCENE_HEADER));
+	header.textures.count = (uint32_t)textures.size();
+	header.materials.offset = AlignOffset(header.textures.offset + textures.size() * sizeof(SCENE_TEXTURE));
+	header.materials.count = (uint32_t)materials.size();
+	header.lights.offset = AlignOffset(header.materials.offset + materials.size() * sizeof(SCENE_MATERIAL));
+	header.lights.count = (uint32_t)lights.size();
+	header.nodes.offset = AlignOffset(header.lights.offset + lights.size() * sizeof(SCENE_LIGHT));
+	header.nodes.count = (uint32_t)nodes.size();
+	header.stringsOffset = AlignOffset(header.nodes.offset + nodes.size() * sizeof(SCENE_NODE_RECORD));
+	header.stringsSize = (uint32_t)strings.size();
+
+	compiled.assign(header.stringsOffset + strings.size(), 0);
+	memcpy(compiled.data(), &header, sizeof(header));
+	WriteTable(compiled, header.textures, textures);
+	WriteTable(compiled, header.materials, materials);
+	WriteTable(compiled, header.lights, lights);
+	WriteTable(compiled, header.nodes, nodes);
+	memcpy(compiled.data() + header.stringsOffset, strings.data(), strings.size());
+	return true;
+}
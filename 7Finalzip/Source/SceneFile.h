@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.h
+// ============
+// scene descriptions authored as text and compiled into a flat binary
+// form that is memory mapped and used in place
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FileUtils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  A scene is a list of textures, materials, lights and
+ *  nodes. It is authored as text (see Scenes/default.scene
+ *  for the syntax) and compiled into a binary file of the
+ *  same name with a "b" appended, laid out as:
+ *    SCENE_HEADER
+ *    SCENE_TEXTURE[textures.count]
+ *    SCENE_MATERIAL[materials.count]
+ *    SCENE_LIGHT[lights.count]
+ *    SCENE_NODE_RECORD[nodes.count]
+ *    string table of NUL terminated tags and paths
+ *  Every table starts 16-byte aligned at the offset given
+ *  in the header, and every string is an offset into the
+ *  string table.
+ *
+ *  Load() maps the binary file when it exists and was
+ *  compiled from the current text file, so the tables are
+ *  read straight from the mapping with no parsing. Otherwise
+ *  the text is parsed into the same layout in memory and the
+ *  binary file is written for the next run. A scene shipped
+ *  without its text file loads from the binary alone.
+ ***********************************************************/
+class SceneFile
+{
+public:
+	// constructor
+	SceneFile();
+
+	struct SCENE_TABLE
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	struct SCENE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		// stamp of the text file the binary was compiled from
+		uint64_t sourceModified;
+		uint64_t sourceSize;
+		SCENE_TABLE textures;
+		SCENE_TABLE materials;
+		SCENE_TABLE lights;
+		SCENE_TABLE nodes;
+		uint32_t stringsOffset;
+		uint32_t stringsSize;
+	};
+
+	struct SCENE_TEXTURE
+	{
+		uint32_t tag;
+		uint32_t path;
+	};
+
+	struct SCENE_MATERIAL
+	{
+		float ambientColor[3];
+		float ambientStrength;
+		float diffuseColor[3];
+		float specularColor[3];
+		float shininess;
+		uint32_t tag;
+	};
+
+	// same layout as LightClusters::LIGHT_DATA
+	struct SCENE_LIGHT
+	{
+		// position and radius, 0 for unlimited
+		float position[4];
+		// ambient color and focal strength
+		float ambientColor[4];
+		// diffuse color and specular intensity
+		float diffuseColor[4];
+		// specular color and shadowed light index, or -1
+		float specularColor[4];
+	};
+
+	struct SCENE_NODE_RECORD
+	{
+		// MeshManager::MESH_ID
+		uint32_t mesh;
+		// index into the texture and material tables, or -1
+		int32_t texture;
+		int32_t material;
+		float uvScale[2];
+		float scale[3];
+		float rotationDegrees[3];
+		float position[3];
+		float opacity;
+	};
+
+	// load a scene, from its compiled binary when that is up to
+	// date, printing what is wrong when it fails
+	bool Load(const std::string& textPath);
+	// parse a text scene and write its compiled binary
+	static bool Compile(const std::string& textPath, const std::string& binaryPath);
+	// get the path of the compiled binary of a text scene
+	static std::string GetBinaryPath(const std::string& textPath);
+	// release the scene
+	void Close();
+
+	// access the tables, valid until the scene is closed
+	uint32_t GetTextureCount() const { return m_pHeader->textures.count; }
+	const SCENE_TEXTURE* GetTextures() const { return (const SCENE_TEXTURE*)(m_pData + m_pHeader->textures.offset); }
+	uint32_t GetMaterialCount() const { return m_pHeader->materials.count; }
+	const SCENE_MATERIAL* GetMaterials() const { return (const SCENE_MATERIAL*)(m_pData + m_pHeader->materials.offset); }
+	uint32_t GetLightCount() const { return m_pHeader->lights.count; }
+	const SCENE_LIGHT* GetLights() const { return (const SCENE_LIGHT*)(m_pData + m_pHeader->lights.offset); }
+	uint32_t GetNodeCount() const { return m_pHeader->nodes.count; }
+	const SCENE_NODE_RECORD* GetNodes() const { return (const SCENE_NODE_RECORD*)(m_pData + m_pHeader->nodes.offset); }
+	const char* GetString(uint32_t offset) const { return (const char*)(m_pData + m_pHeader->stringsOffset + offset); }
+	bool IsLoaded() const { return NULL != m_pHeader; }
+	// true when the tables are read from a mapped binary file
+	bool IsMapped() const { return m_file.IsOpen(); }
+
+private:
+	MappedFile m_file;
+	// compiled tables of a parsed text scene
+	std::vector<uint8_t> m_buffer;
+	const uint8_t* m_pData;
+	const SCENE_HEADER* m_pHeader;
+
+	// use a compiled scene in place after checking its tables
+	bool Attach(const uint8_t* data, size_t size);
+	// parse a text scene into the compiled layout
+	static bool ParseText(const std::string& textPath, std::vector<uint8_t>& compiled);
+};
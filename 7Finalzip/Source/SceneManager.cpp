@@ -16,14 +16,51 @@
 
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
 // declaration of global variables
 namespace
 {
-	const char* g_ModelName = "model";
-	const char* g_ColorValueName = "objectColor";
 	const char* g_TextureValueName = "objectTexture";
-	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_ShadowMapsName = "shadowMaps";
+	const char* g_ShadowMatrixNames[ShadowMaps::LAYER_COUNT] =
+	{
+		"shadowMatrices[0]", "shadowMatrices[1]", "shadowMatrices[2]", "shadowMatrices[3]",
+		"shadowMatrices[4]", "shadowMatrices[5]", "shadowMatrices[6]"
+	};
+	// width and height of each shadow map
+	const int g_ShadowResolution = 2048;
+	// scene loaded unless another one is set
+	const char* g_DefaultScenePath = "Scenes/default.scene";
+	// scene nodes and draw records handed to a worker at once; a
+	// multiple of four for the four-wide culling, and large
+	// enough that small scenes stay on the calling thread
+	const size_t g_NodesPerJob = 256;
+	const size_t g_RecordsPerJob = 256;
+
+	// the mesh of a node's sort key, which tells its levels of
+	// detail apart
+	int GetMeshSortID(const SceneManager::SCENE_NODE& node)
+	{
+		return node.meshID * MeshManager::LOD_COUNT + node.lod;
+	}
+
+	// order of nodes that are baked into the same static batch
+	// when they share a texture, material and UV scale
+	bool IsBatchedBefore(const SceneManager::SCENE_NODE& a, const SceneManager::SCENE_NODE& b)
+	{
+		if (a.textureHandle != b.textureHandle)
+			return a.textureHandle < b.textureHandle;
+		if (a.materialHandle != b.materialHandle)
+			return a.materialHandle < b.materialHandle;
+		if (a.uvScale.x != b.uvScale.x)
+			return a.uvScale.x < b.uvScale.x;
+		return a.uvScale.y < b.uvScale.y;
+	}
 }
 
 /***********************************************************
@@ -31,10 +68,44 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager* pShaderManager)
+SceneManager::SceneManager(ShaderManager* pShaderManager, ShaderLibrary* pShaderLibrary, UniformCache* pUniforms, FrameArena* pFrameArena)
 {
 	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
+	m_pShaderLibrary = pShaderLibrary;
+	m_pUniforms = pUniforms;
+	m_pFrameArena = pFrameArena;
+	m_drawRecords = NULL;
+	m_basicMeshes = new MeshManager();
+	m_placeholderSlot.pool = -1;
+	m_placeholderSlot.layer = 0;
+	m_boundTextureArray = 0;
+	m_bFrustumCulling = true;
+	m_bIndirectSupported = false;
+	m_bMultiDrawIndirect = false;
+	m_bIndirectDirty = true;
+	m_bShadowCastersDirty = true;
+	m_sceneMin = glm::vec3(0.0f);
+	m_sceneMax = glm::vec3(0.0f);
+	m_cameraView = glm::mat4(1.0f);
+	m_cameraProjection = glm::mat4(1.0f);
+	m_cameraNear = 0.1f;
+	m_cameraFar = 100.0f;
+	m_bDepthPrePass = false;
+	m_bLevelOfDetail = true;
+	m_bSpatialIndex = true;
+	m_bStaticBatching = false;
+	m_bStaticBatchesDirty = true;
+	m_pCapture = NULL;
+	m_bCaptureIndirect = false;
+	m_scenePath = g_DefaultScenePath;
+	m_pFileWatcher = NULL;
+	m_workerOutputs.resize(m_jobs.GetWorkerCount());
+
+	// white, untextured, unscaled and without a material
+	m_drawState = DrawDataBuffer::DRAW_DATA();
+	m_drawState.model = glm::mat4(1.0f);
+	m_drawState.objectColor = glm::vec4(1.0f);
+	m_drawState.uvScale = glm::vec2(1.0f, 1.0f);
 }
 
 /***********************************************************
@@ -45,6 +116,9 @@ SceneManager::SceneManager(ShaderManager* pShaderManager)
 SceneManager::~SceneManager()
 {
 	m_pShaderManager = NULL;
+	m_pShaderLibrary = NULL;
+	m_pUniforms = NULL;
+	m_pFrameArena = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
 }
@@ -52,79 +126,107 @@ SceneManager::~SceneManager()
 /***********************************************************
  *  CreateGLTexture()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  This method is used for loading textures from image files
+ *  and registering them under a new texture handle. There is
+ *  no fixed limit on the number of textures, since they are
+ *  packed into array textures instead of texture units. A
+ *  texture shows a placeholder image until its file has been
+ *  decoded in the background and uploaded into an array
+ *  layer matching its size and format.
  ***********************************************************/
-bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
+bool SceneManager::CreateGLTexture(const char* filename, const std::string& tag)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// I always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
-
-	unsigned char* image = stbi_load(filename, &width, &height, &colorChannels, 0);
-
-	if (image)
+	if (m_textureHandles.find(tag) != m_textureHandles.end())
 	{
-		std::cout << "Successfully loaded image:" << filename
-			<< ", width:" << width << ", height:" << height
-			<< ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// set texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		std::cout << "Texture tag is already in use:" << tag << std::endl;
+		return false;
+	}
 
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
+	// the placeholder layer is shared by all loading textures
+	if (m_placeholderSlot.pool < 0)
+	{
+		// grey checker shown until the real image arrives
+		const unsigned char placeholder[16] =
 		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			stbi_image_free(image);
-			return false;
-		}
+			160, 160, 160, 255,   96, 96, 96, 255,
+			96, 96, 96, 255,   160, 160, 160, 255
+		};
 
-		glGenerateMipmap(GL_TEXTURE_2D);
+		if (!m_textureArrays.Allocate(2, 2, GL_RGBA8, 1, m_placeholderSlot))
+			return false;
 
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // unbind the texture
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureArrays.GetTexture(m_placeholderSlot.pool));
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, m_placeholderSlot.layer, 2, 2, 1,
+			GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		m_boundTextureArray = 0;
+	}
 
-		// register texture and associate it with tag
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+	// register texture and associate it with tag
+	TEXTURE_INFO texture;
+	texture.tag = tag;
+	texture.filename = filename;
+	texture.slot = m_placeholderSlot;
+	int textureHandle = (int)m_textures.size();
+	m_textures.push_back(texture);
+	m_textureHandles[tag] = textureHandle;
+
+	// decode the image on a worker thread
+	m_textureLoader.Request(filename, textureHandle);
+	if (NULL != m_pFileWatcher)
+		m_pFileWatcher->Watch(filename);
+
+	return true;
+}
 
-		return true;
-	}
+/***********************************************************
+ *  ReloadGLTexture()
+ *
+ *  Decode a texture again. It keeps showing its old image
+ *  until the new one has been uploaded.
+ ***********************************************************/
+void SceneManager::ReloadGLTexture(int textureHandle, const std::string& filename)
+{
+	if ((textureHandle < 0) || (textureHandle >= (int)m_textures.size()))
+		return;
 
-	std::cout << "Could not load image:" << filename << std::endl;
-	return false;
+	m_textures[textureHandle].filename = filename;
+	m_textureLoader.Request(filename, textureHandle);
+	if (NULL != m_pFileWatcher)
+		m_pFileWatcher->Watch(filename);
 }
 
 /***********************************************************
- *  BindGLTextures()
+ *  ProcessTextureUploads()
  *
- *  This method binds the loaded textures to OpenGL memory slots
+ *  Upload a few of the textures that finished decoding and
+ *  point their handles at the array layers they landed in
  ***********************************************************/
-void SceneManager::BindGLTextures()
+void SceneManager::ProcessTextureUploads()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	m_uploadedTextures.clear();
+	if (0 == m_textureLoader.ProcessUploads(2, m_uploadedTextures))
+		return;
+
+	for (size_t i = 0; i < m_uploadedTextures.size(); i++)
 	{
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		const TextureLoader::UPLOADED_TEXTURE& uploaded = m_uploadedTextures[i];
+		if ((uploaded.textureHandle < 0) || (uploaded.textureHandle >= (int)m_textures.size()))
+			continue;
+
+		// a reloaded texture frees the layer of its old image
+		TextureArrays::ARRAY_SLOT& slot = m_textures[uploaded.textureHandle].slot;
+		if ((slot.pool != m_placeholderSlot.pool) || (slot.layer != m_placeholderSlot.layer))
+			m_textureArrays.Release(slot);
+		slot = uploaded.slot;
 	}
+
+	// the records of the nodes using them have new layers
+	m_bIndirectDirty = true;
+
+	// the uploads change the array binding, and a growing pool
+	// replaces its array texture
+	m_boundTextureArray = 0;
 }
 
 /***********************************************************
@@ -135,41 +237,63 @@ void SceneManager::BindGLTextures()
  ***********************************************************/
 void SceneManager::DestroyGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		glDeleteTextures(1, &m_textureIDs[i].ID);
-	}
-	m_loadedTextures = 0;
+	m_textureArrays.Destroy();
+	m_textures.clear();
+	m_textureHandles.clear();
+	m_placeholderSlot.pool = -1;
+	m_boundTextureArray = 0;
 }
 
 /***********************************************************
  *  FindTextureID()
  *
- *  Get the OpenGL texture ID for the tag
+ *  Get the OpenGL array texture ID holding the tagged texture
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+int SceneManager::FindTextureID(const std::string& tag) const
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		if (m_textureIDs[i].tag == tag)
-			return m_textureIDs[i].ID;
-	}
-	return -1;
+	int textureHandle = FindTextureSlot(tag);
+	if (textureHandle < 0)
+		return -1;
+	return m_textureArrays.GetTexture(m_textures[textureHandle].slot.pool);
 }
 
 /***********************************************************
  *  FindTextureSlot()
  *
- *  Get the texture unit index for the tag
+ *  Get the texture handle for the tag
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+int SceneManager::FindTextureSlot(const std::string& tag) const
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		if (m_textureIDs[i].tag == tag)
-			return i;
-	}
-	return -1;
+	auto found = m_textureHandles.find(tag);
+	if (found == m_textureHandles.end())
+		return -1;
+	return found->second;
+}
+
+/***********************************************************
+ *  DefineMaterial()
+ *
+ *  Register a material and return its handle
+ ***********************************************************/
+int SceneManager::DefineMaterial(const OBJECT_MATERIAL& material)
+{
+	int handle = (int)m_objectMaterials.size();
+	m_objectMaterials.push_back(material);
+	m_materialHandles[material.tag] = handle;
+	return handle;
+}
+
+/***********************************************************
+ *  FindMaterialHandle()
+ *
+ *  Get the handle of the material associated with a tag
+ ***********************************************************/
+int SceneManager::FindMaterialHandle(const std::string& tag) const
+{
+	auto found = m_materialHandles.find(tag);
+	if (found == m_materialHandles.end())
+		return -1;
+	return found->second;
 }
 
 /***********************************************************
@@ -177,336 +301,1701 @@ int SceneManager::FindTextureSlot(std::string tag)
  *
  *  Get a material associated with a tag
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+bool SceneManager::FindMaterial(const std::string& tag, OBJECT_MATERIAL& material) const
 {
-	if (m_objectMaterials.empty())
+	int handle = FindMaterialHandle(tag);
+	if (handle < 0)
 		return false;
 
-	for (auto& mat : m_objectMaterials)
-	{
-		if (mat.tag == tag)
-		{
-			material = mat;
-			return true;
-		}
-	}
-	return false;
+	material = m_objectMaterials[handle];
+	return true;
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  BuildModelMatrix()
  *
- *  Set transform buffer using scale, rotation, translation
+ *  Build a model matrix using scale, rotation, translation
  ***********************************************************/
-void SceneManager::SetTransformations(
+glm::mat4 SceneManager::BuildModelMatrix(
 	glm::vec3 scaleXYZ,
 	float XrotationDegrees,
 	float YrotationDegrees,
 	float ZrotationDegrees,
 	glm::vec3 positionXYZ)
 {
-	glm::mat4 modelView = glm::translate(positionXYZ) *
+	return glm::translate(positionXYZ) *
 		glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1, 0, 0)) *
 		glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0, 1, 0)) *
 		glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0, 0, 1)) *
 		glm::scale(scaleXYZ);
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  Set the model matrix of the draw state using scale,
+ *  rotation, translation
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	m_drawState.model = BuildModelMatrix(
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ);
+}
 
-	if (m_pShaderManager)
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+/***********************************************************
+ *  AddSceneNode()
+ *
+ *  Add an object to the retained scene description
+ ***********************************************************/
+int SceneManager::AddSceneNode(
+	int meshID,
+	int textureHandle,
+	int materialHandle,
+	glm::vec2 uvScale,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	SCENE_NODE node;
+	node.meshID = meshID;
+	node.textureHandle = textureHandle;
+	node.materialHandle = materialHandle;
+	node.uvScale = uvScale;
+	node.scaleXYZ = scaleXYZ;
+	node.rotationDegrees = rotationDegrees;
+	node.positionXYZ = positionXYZ;
+	node.opacity = 1.0f;
+	node.lod = 0;
+	node.world = glm::mat4(1.0f);
+	node.bDirty = true;
+	node.bStatic = true;
+	node.staticBatch = -1;
+
+	m_sceneNodes.push_back(node);
+	m_dirtyNodes.push_back((uint32_t)(m_sceneNodes.size() - 1));
+
+	// keep the bounds arrays padded for the four-wide culling
+	size_t paddedCount = (m_sceneNodes.size() + 3) & ~(size_t)3;
+	m_boundsX.resize(paddedCount, 0.0f);
+	m_boundsY.resize(paddedCount, 0.0f);
+	m_boundsZ.resize(paddedCount, 0.0f);
+	m_boundsRadius.resize(paddedCount, 0.0f);
+
+	return (int)m_sceneNodes.size() - 1;
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  SetNodeTransform()
  *
- *  Set the color into the shader for the next draw
+ *  Change the transform of a node, so that its world matrix
+ *  is rebuilt before the next draw. A moved node is no longer
+ *  static, and leaves its static batch.
  ***********************************************************/
-void SceneManager::SetShaderColor(float r, float g, float b, float a)
+void SceneManager::SetNodeTransform(
+	int nodeIndex,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegrees,
+	glm::vec3 positionXYZ)
 {
-	glm::vec4 color(r, g, b, a);
+	if ((nodeIndex < 0) || (nodeIndex >= (int)m_sceneNodes.size()))
+		return;
+
+	SCENE_NODE& node = m_sceneNodes[nodeIndex];
+	node.scaleXYZ = scaleXYZ;
+	node.rotationDegrees = rotationDegrees;
+	node.positionXYZ = positionXYZ;
+	if (!node.bDirty)
+		m_dirtyNodes.push_back((uint32_t)nodeIndex);
+	node.bDirty = true;
+	node.bStatic = false;
+	if (node.staticBatch >= 0)
+		m_bStaticBatchesDirty = true;
+}
+
+/***********************************************************
+ *  SetNodeOpacity()
+ *
+ *  Change the opacity of a node. A node with an opacity
+ *  below 1 moves to the transparent bucket, and is blended
+ *  over the opaque scene back to front.
+ ***********************************************************/
+void SceneManager::SetNodeOpacity(int nodeIndex, float opacity)
+{
+	if ((nodeIndex < 0) || (nodeIndex >= (int)m_sceneNodes.size()))
+		return;
+
+	m_sceneNodes[nodeIndex].opacity = glm::clamp(opacity, 0.0f, 1.0f);
+	m_bIndirectDirty = true;
+	m_bStaticBatchesDirty = true;
+}
+
+/***********************************************************
+ *  UpdateWorldMatrices()
+ *
+ *  Rebuild the cached world matrix and world-space bounding
+ *  sphere of every dirty node, then move the boxes of those
+ *  nodes in the hierarchy. Only the nodes that changed are
+ *  visited.
+ ***********************************************************/
+void SceneManager::UpdateWorldMatrices()
+{
+	if (m_dirtyNodes.empty())
+		return;
+
+	m_jobs.ParallelFor(m_dirtyNodes.size(), g_NodesPerJob, [this](size_t first, size_t last, int worker)
+	{
+		for (size_t k = first; k < last; k++)
+		{
+			uint32_t i = m_dirtyNodes[k];
+			SCENE_NODE& node = m_sceneNodes[i];
+			node.world = BuildModelMatrix(
+				node.scaleXYZ,
+				node.rotationDegrees.x,
+				node.rotationDegrees.y,
+				node.rotationDegrees.z,
+				node.positionXYZ);
+			node.bDirty = false;
+
+			// move the mesh bounds into world space, growing the
+			// radius by the largest axis scale
+			const MeshManager::MESH_BOUNDS& bounds = m_basicMeshes->GetMeshBounds(node.meshID);
+			glm::vec4 center = node.world * glm::vec4(bounds.center, 1.0f);
+			float maxScale = glm::max(
+				glm::length(glm::vec3(node.world[0])),
+				glm::max(glm::length(glm::vec3(node.world[1])), glm::length(glm::vec3(node.world[2]))));
+
+			m_boundsX[i] = center.x;
+			m_boundsY[i] = center.y;
+			m_boundsZ[i] = center.z;
+			m_boundsRadius[i] = bounds.radius * maxScale;
+		}
+	});
 
-	if (m_pShaderManager)
+	// the hierarchy is changed from this thread only
+	for (size_t k = 0; k < m_dirtyNodes.size(); k++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, color);
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+		GetNodeBox(m_dirtyNodes[k], boxMin, boxMax);
+		m_bvh.SetObject(m_dirtyNodes[k], boxMin, boxMax);
 	}
+
+	m_dirtyNodes.clear();
+	m_bIndirectDirty = true;
+	m_bShadowCastersDirty = true;
 }
 
 /***********************************************************
- *  SetShaderTexture()
+ *  GetNodeBox()
  *
- *  Set the texture for the shader
+ *  Transform the mesh box of a node, taking the extent along
+ *  each world axis from the absolute values of the matrix
  ***********************************************************/
-void SceneManager::SetShaderTexture(std::string textureTag)
+void SceneManager::GetNodeBox(size_t nodeIndex, glm::vec3& boxMin, glm::vec3& boxMax) const
 {
-	if (m_pShaderManager)
+	const SCENE_NODE& node = m_sceneNodes[nodeIndex];
+	const MeshManager::MESH_BOUNDS& bounds = m_basicMeshes->GetMeshBounds(node.meshID);
+	glm::vec3 center = glm::vec3(node.world * glm::vec4(bounds.center, 1.0f));
+
+	glm::vec3 extents;
+	for (int axis = 0; axis < 3; axis++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
-		int slot = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, slot);
+		extents[axis] =
+			std::abs(node.world[0][axis]) * bounds.extents.x +
+			std::abs(node.world[1][axis]) * bounds.extents.y +
+			std::abs(node.world[2][axis]) * bounds.extents.z;
 	}
+
+	boxMin = center - extents;
+	boxMax = center + extents;
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  CollectVisibleNodes()
  *
- *  Set the UV scale for the shader
+ *  Query the hierarchy for the nodes inside a frustum, or
+ *  test the bounding spheres of all nodes four at a time
+ *  when it is turned off
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+size_t SceneManager::CollectVisibleNodes(const FrustumCuller& frustum, uint32_t* nodes)
 {
-	if (m_pShaderManager)
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+	const size_t nodeCount = m_sceneNodes.size();
+	if (m_bSpatialIndex)
+		return m_bvh.QueryFrustum(frustum, nodes, nodeCount);
+
+	uint8_t* visible = m_pFrameArena->AllocateArray<uint8_t>(m_boundsX.size());
+	m_jobs.ParallelFor(nodeCount, g_NodesPerJob, [&](size_t first, size_t last, int worker)
+	{
+		frustum.CullSpheres(
+			m_boundsX.data() + first,
+			m_boundsY.data() + first,
+			m_boundsZ.data() + first,
+			m_boundsRadius.data() + first,
+			last - first,
+			visible + first);
+	});
+
+	size_t count = 0;
+	for (size_t i = 0; i < nodeCount; i++)
+	{
+		if (visible[i])
+			nodes[count++] = (uint32_t)i;
+	}
+	return count;
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  PickNode()
  *
- *  Pass material values into the shader
+ *  Cast the ray through the hierarchy, and test each node it
+ *  reaches against the box of its mesh in the node's own
+ *  space, which fits rotated nodes more closely than their
+ *  world box
  ***********************************************************/
-void SceneManager::SetShaderMaterial(std::string materialTag)
+int SceneManager::PickNode(const glm::vec3& origin, const glm::vec3& direction, float& distance) const
 {
-	if (!m_objectMaterials.empty())
+	const float maxDistance = 1e30f;
+	int node = m_bvh.CastRay(origin, direction, maxDistance,
+		[this, maxDistance](uint32_t nodeIndex, const glm::vec3& rayOrigin, const glm::vec3& rayDirection) -> float
 	{
-		OBJECT_MATERIAL material;
-		if (FindMaterial(materialTag, material))
+		const SCENE_NODE& node = m_sceneNodes[nodeIndex];
+		const MeshManager::MESH_BOUNDS& bounds = m_basicMeshes->GetMeshBounds(node.meshID);
+		glm::mat4 toLocal = glm::inverse(node.world);
+		glm::vec3 localOrigin = glm::vec3(toLocal * glm::vec4(rayOrigin, 1.0f));
+		glm::vec3 localDirection = glm::vec3(toLocal * glm::vec4(rayDirection, 0.0f));
+
+		// slab test, in which the distance along the ray is the
+		// same as in world space
+		float enter = 0.0f;
+		float exit = maxDistance;
+		for (int axis = 0; axis < 3; axis++)
 		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			float boxMin = bounds.center[axis] - bounds.extents[axis];
+			float boxMax = bounds.center[axis] + bounds.extents[axis];
+			if (std::abs(localDirection[axis]) < 1e-12f)
+			{
+				if ((localOrigin[axis] < boxMin) || (localOrigin[axis] > boxMax))
+					return -1.0f;
+				continue;
+			}
+
+			float t0 = (boxMin - localOrigin[axis]) / localDirection[axis];
+			float t1 = (boxMax - localOrigin[axis]) / localDirection[axis];
+			enter = std::max(enter, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
 		}
+		return (enter <= exit) ? enter : -1.0f;
+	}, distance);
+	return node;
+}
+
+/***********************************************************
+ *  ClearWorkerChanges()
+ *
+ *  Reset the flags the workers set when they change a node
+ ***********************************************************/
+void SceneManager::ClearWorkerChanges()
+{
+	for (size_t i = 0; i < m_workerOutputs.size(); i++)
+	{
+		m_workerOutputs[i].bChanged = false;
 	}
 }
 
 /***********************************************************
-// STUDENTS CAN MODIFY BELOW METHODS FOR SCENE RENDERING
-***********************************************************/
+ *  HasWorkerChanges()
+ *
+ *  Tell whether any worker changed a node since the flags
+ *  were cleared
+ ***********************************************************/
+bool SceneManager::HasWorkerChanges() const
+{
+	for (size_t i = 0; i < m_workerOutputs.size(); i++)
+	{
+		if (m_workerOutputs[i].bChanged)
+			return true;
+	}
+	return false;
+}
 
 /***********************************************************
- *  PrepareScene()
+ *  SetCamera()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene
- *  rendering
+ *  Set the camera of the current frame, from which the
+ *  culling frustum, the shadow cascades and the distance
+ *  range of the draw order are taken
  ***********************************************************/
-void SceneManager::PrepareScene()
+void SceneManager::SetCamera(const CameraBuffer::CAMERA_DATA& camera, const FrustumCuller& frustum)
+{
+	m_cameraView = camera.view;
+	m_cameraProjection = camera.projection;
+	m_frustum = frustum;
+	m_cameraNear = camera.viewport.z;
+	m_cameraFar = std::max(camera.viewport.w, 0.01f);
+}
+
+/***********************************************************
+ *  GetSortDepth()
+ *
+ *  Get the view distance of a node's bounding sphere center
+ *  as a fraction of the far distance
+ ***********************************************************/
+float SceneManager::GetSortDepth(size_t nodeIndex) const
 {
+	glm::vec4 center(m_boundsX[nodeIndex], m_boundsY[nodeIndex], m_boundsZ[nodeIndex], 1.0f);
+	return -(m_cameraView * center).z / m_cameraFar;
+}
+
+/***********************************************************
+ *  UpdateLevelsOfDetail()
+ *
+ *  Pick the level of detail of every node from the fraction
+ *  of the screen height its bounding sphere covers. A node
+ *  changing level rebuilds the indirect commands and the
+ *  shadow maps, which the hysteresis of the selection keeps
+ *  rare.
+ ***********************************************************/
+void SceneManager::UpdateLevelsOfDetail()
+{
+	// a perspective projection divides by the view distance,
+	// an orthographic one does not
+	const bool bPerspective = (0.0f != m_cameraProjection[2][3]);
+	const float projectionScale = m_cameraProjection[1][1];
 
+	ClearWorkerChanges();
+	m_jobs.ParallelFor(m_sceneNodes.size(), g_NodesPerJob, [&](size_t first, size_t last, int worker)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			SCENE_NODE& node = m_sceneNodes[i];
+			// baked nodes are always drawn at the finest level
+			int lod = 0;
+			if (m_bLevelOfDetail && (node.staticBatch < 0))
+			{
+				float screenSize = m_boundsRadius[i] * projectionScale;
+				if (bPerspective)
+				{
+					glm::vec4 center(m_boundsX[i], m_boundsY[i], m_boundsZ[i], 1.0f);
+					screenSize /= std::max(-(m_cameraView * center).z, 0.01f);
+				}
+				lod = MeshManager::SelectLod(node.lod, screenSize);
+			}
+			lod = std::min(lod, std::max(m_basicMeshes->GetLodCount(node.meshID) - 1, 0));
+
+			if (lod != node.lod)
+			{
+				node.lod = lod;
+				m_workerOutputs[worker].bChanged = true;
+			}
+		}
+	});
 
+	if (HasWorkerChanges())
 	{
-		OBJECT_MATERIAL goldMaterial;
-		goldMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.1f);
-		goldMaterial.ambientStrength = 0.4f;
-		goldMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.2f);
-		goldMaterial.specularColor = glm::vec3(0.6f, 0.5f, 0.4f);
-		goldMaterial.shininess = 22.0;
-		goldMaterial.tag = "gold";
-		m_objectMaterials.push_back(goldMaterial);
-
-		OBJECT_MATERIAL cementMaterial;
-		cementMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.2f);
-		cementMaterial.ambientStrength = 0.2f;
-		cementMaterial.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);
-		cementMaterial.specularColor = glm::vec3(0.4f, 0.4f, 0.4f);
-		cementMaterial.shininess = 0.5;
-		cementMaterial.tag = "cement";
-		m_objectMaterials.push_back(cementMaterial);
-
-		OBJECT_MATERIAL woodMaterial;
-		woodMaterial.ambientColor = glm::vec3(0.4f, 0.3f, 0.1f);
-		woodMaterial.ambientStrength = 0.2f;
-		woodMaterial.diffuseColor = glm::vec3(0.3f, 0.2f, 0.1f);
-		woodMaterial.specularColor = glm::vec3(0.1f, 0.1f, 0.1f);
-		woodMaterial.shininess = 0.3;
-		woodMaterial.tag = "wood";
-		m_objectMaterials.push_back(woodMaterial);
-
-		OBJECT_MATERIAL tileMaterial;
-		tileMaterial.ambientColor = glm::vec3(0.2f, 0.3f, 0.4f);
-		tileMaterial.ambientStrength = 0.3f;
-		tileMaterial.diffuseColor = glm::vec3(0.3f, 0.2f, 0.1f);
-		tileMaterial.specularColor = glm::vec3(0.4f, 0.5f, 0.6f);
-		tileMaterial.shininess = 25.0;
-		tileMaterial.tag = "tile";
-		m_objectMaterials.push_back(tileMaterial);
-
-		OBJECT_MATERIAL glassMaterial;
-		glassMaterial.ambientColor = glm::vec3(0.4f, 0.4f, 0.4f);
-		glassMaterial.ambientStrength = 0.3f;
-		glassMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.3f);
-		glassMaterial.specularColor = glm::vec3(0.6f, 0.6f, 0.6f);
-		glassMaterial.shininess = 85.0;
-		glassMaterial.tag = "glass";
-		m_objectMaterials.push_back(glassMaterial);
-
-		OBJECT_MATERIAL clayMaterial;
-		clayMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.3f);
-		clayMaterial.ambientStrength = 0.3f;
-		clayMaterial.diffuseColor = glm::vec3(0.4f, 0.4f, 0.5f);
-		clayMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.4f);
-		clayMaterial.shininess = 0.5;
-		clayMaterial.tag = "clay";
-		m_objectMaterials.push_back(clayMaterial);
-	}
-
-
-	
-
-	{
-		// Light 0
-		m_pShaderManager->setVec3Value("lightSources[0].position", 3.0f, 14.0f, 0.0f);
-		m_pShaderManager->setVec3Value("lightSources[0].ambientColor", 0.1f, 0.1f, 0.1f);  
-		m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", 0.6f, 0.6f, 0.6f);  
-
-		m_pShaderManager->setVec3Value("lightSources[0].specularColor", 0.0f, 0.0f, 0.0f);
-		m_pShaderManager->setFloatValue("lightSources[0].focalStrength", 32.0f);
-		m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 0.05f);
-
-		// Light 1
-		m_pShaderManager->setVec3Value("lightSources[1].position", -3.0f, 14.0f, 0.0f);
-		m_pShaderManager->setVec3Value("lightSources[1].ambientColor", 0.1f, 0.1f, 0.1f);
-		m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", 0.6f, 0.6f, 0.6f);
-		m_pShaderManager->setVec3Value("lightSources[1].specularColor", 0.0f, 0.0f, 0.0f);
-		m_pShaderManager->setFloatValue("lightSources[1].focalStrength", 32.0f);
-		m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.05f);
-
-		// Light 2
-		m_pShaderManager->setVec3Value("lightSources[2].position", 0.6f, 5.0f, 6.0f);
-		m_pShaderManager->setVec3Value("lightSources[2].ambientColor", 0.1f, 0.1f, 0.1f);
-		m_pShaderManager->setVec3Value("lightSources[2].diffuseColor", 0.6f, 0.6f, 0.6f);
-		m_pShaderManager->setVec3Value("lightSources[2].specularColor", 0.3f, 0.3f, 0.3f);
-		m_pShaderManager->setFloatValue("lightSources[2].focalStrength", 12.0f);
-		m_pShaderManager->setFloatValue("lightSources[2].specularIntensity", 0.5f);
-
-		// Enable lighting
-		m_pShaderManager->setBoolValue("bUseLighting", true);
+		m_bIndirectDirty = true;
+		m_bShadowCastersDirty = true;
 	}
+}
 
-	// only one instance of a particular mesh needs to be
-	// loaded in memory no matter how many times it is drawn
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadConeMesh();   // for all cones
-	m_basicMeshes->LoadTorusMesh();  // for torus around center cone
-	m_basicMeshes->LoadBoxMesh();    // for the box on left
+/***********************************************************
+ *  BuildRenderQueue()
+ *
+ *  Build one draw packet per visible scene node. Opaque
+ *  nodes are keyed on the render state they need and then
+ *  on their distance, transparent nodes on their distance
+ *  alone. The opaque nodes are left out when bOpaque is
+ *  false, since the indirect commands already hold them.
+ ***********************************************************/
+void SceneManager::BuildRenderQueue(bool bOpaque)
+{
+	const size_t nodeCount = m_sceneNodes.size();
+	uint32_t* candidates = m_pFrameArena->AllocateArray<uint32_t>(nodeCount);
+	size_t candidateCount = nodeCount;
+	if (m_bFrustumCulling)
+	{
+		candidateCount = CollectVisibleNodes(m_frustum, candidates);
+	}
+	else
+	{
+		for (size_t i = 0; i < nodeCount; i++)
+		{
+			candidates[i] = (uint32_t)i;
+		}
+	}
 
-	// ===========================
-	// Load textures into memory
-	// ===========================
-	bool bReturn = false;
+	// each range of visible nodes is queued by one worker, into
+	// the packet slots of that range
+	const size_t rangeCount = (candidateCount + g_NodesPerJob - 1) / g_NodesPerJob;
+	m_renderQueue.Reset(*m_pFrameArena, candidateCount);
+	RenderQueue::DRAW_PACKET* packets = m_pFrameArena->AllocateArray<RenderQueue::DRAW_PACKET>(candidateCount);
+	size_t* rangeCounts = m_pFrameArena->AllocateArray<size_t>(rangeCount);
+	std::fill(rangeCounts, rangeCounts + rangeCount, (size_t)0);
+
+	m_jobs.ParallelFor(candidateCount, g_NodesPerJob, [&](size_t first, size_t last, int worker)
+	{
+		size_t count = 0;
+		for (size_t k = first; k < last; k++)
+		{
+			uint32_t i = candidates[k];
+			const SCENE_NODE& node = m_sceneNodes[i];
+			RenderQueue::DRAW_PACKET& packet = packets[first + count];
+			packet.nodeIndex = i;
+			if (node.opacity < 1.0f)
+			{
+				packet.sortKey = RenderQueue::MakeTransparentKey(GetMeshSortID(node), GetSortDepth(i));
+			}
+			else if (bOpaque && (node.staticBatch < 0))
+			{
+				packet.sortKey = RenderQueue::MakeSortKey(
+					0,
+					GetTexturePool(node.textureHandle),
+					node.materialHandle,
+					GetMeshSortID(node),
+					GetSortDepth(i));
+			}
+			else
+			{
+				continue;
+			}
+			count++;
+		}
+		rangeCounts[first / g_NodesPerJob] = count;
+	});
+
+	// merge in candidate order, so that equal keys sort the same
+	// way whichever worker ran a range
+	for (size_t r = 0; r < rangeCount; r++)
+	{
+		m_renderQueue.Append(packets + r * g_NodesPerJob, rangeCounts[r]);
+	}
+}
 
-	// Floor plane texture
-	bReturn = CreateGLTexture("../../Utilities/textures/brick.jpg", "floor");
+/***********************************************************
+ *  MakeDrawRecord()
+ *
+ *  Fill the per-draw record of a scene node. Anything the
+ *  node does not set is taken from the current draw state.
+ ***********************************************************/
+void SceneManager::MakeDrawRecord(const SCENE_NODE& node, DrawDataBuffer::DRAW_DATA& record) const
+{
+	record = m_drawState;
+	record.model = node.world;
+	record.uvScale = node.uvScale;
+	record.objectColor.w *= node.opacity;
 
-	// Cones texture
-	bReturn = CreateGLTexture("../../Utilities/textures/breadcrust.jpg", "cone");
+	if ((node.textureHandle >= 0) && (node.textureHandle < (int)m_textures.size()))
+	{
+		record.flags |= DrawDataBuffer::DRAW_USE_TEXTURE;
+		record.textureLayer = (float)m_textures[node.textureHandle].slot.layer;
+	}
 
-	// Box texture
-	bReturn = CreateGLTexture("../../Utilities/textures/gold-seamless-texture.jpg", "box");
+	if ((node.materialHandle >= 0) && (node.materialHandle < (int)m_objectMaterials.size()))
+	{
+		const OBJECT_MATERIAL& material = m_objectMaterials[node.materialHandle];
+		record.ambientColor = glm::vec4(material.ambientColor, material.ambientStrength);
+		record.diffuseColor = glm::vec4(material.diffuseColor, material.shininess);
+		record.specularColor = glm::vec4(material.specularColor, 0.0f);
+	}
+}
 
-	// After loading textures, bind them to OpenGL slots
-	BindGLTextures();
+/***********************************************************
+ *  RecordQueue()
+ *
+ *  Fill the records of every packet of the sorted queue. The
+ *  workers write straight into the packets' slots, so the
+ *  records need no merging.
+ ***********************************************************/
+void SceneManager::RecordQueue()
+{
+	const size_t packetCount = m_renderQueue.GetCount();
+	m_drawRecords = m_pFrameArena->AllocateArray<DrawDataBuffer::DRAW_DATA>(packetCount);
+	m_jobs.ParallelFor(packetCount, g_RecordsPerJob, [this](size_t first, size_t last, int worker)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			MakeDrawRecord(m_sceneNodes[m_renderQueue.GetPacket(i).nodeIndex], m_drawRecords[i]);
+		}
+	});
 }
 
 /***********************************************************
- *  RenderScene()
+ *  FindRunEnd()
  *
- *  This method is used for rendering the 3D scene by
- *  transforming and drawing the basic 3D shapes
+ *  Find the end of the run of queued packets starting at
+ *  first, that is the packets before last drawing the same
+ *  level of the same mesh from the same texture pool.
+ *  Materials, textures within a pool and UV scales may
+ *  differ inside a run, since they are per-draw records.
+ *  Depth-only passes do not sample textures, so their runs
+ *  only compare meshes.
  ***********************************************************/
-void SceneManager::RenderScene()
+size_t SceneManager::FindRunEnd(size_t first, size_t last, bool bDepthOnly) const
+{
+	const SCENE_NODE& node = m_sceneNodes[m_renderQueue.GetPacket(first).nodeIndex];
+	int pool = GetTexturePool(node.textureHandle);
+
+	size_t end = first + 1;
+	while (end < last)
+	{
+		const SCENE_NODE& next = m_sceneNodes[m_renderQueue.GetPacket(end).nodeIndex];
+		if ((next.meshID != node.meshID) || (next.lod != node.lod) ||
+			(!bDepthOnly && (GetTexturePool(next.textureHandle) != pool)))
+		{
+			break;
+		}
+		end++;
+	}
+	return end;
+}
+
+/***********************************************************
+ *  SubmitRenderQueue()
+ *
+ *  Draw the sorted packets first to last. The texture pool
+ *  is only bound when it changes, and each run of packets
+ *  is one instanced draw. Depth-only passes bind no texture.
+ ***********************************************************/
+void SceneManager::SubmitRenderQueue(size_t first, size_t last, bool bDepthOnly)
+{
+	int currentPool = -2;
+	while (first < last)
+	{
+		// find the run of packets that can share one draw call
+		size_t runEnd = FindRunEnd(first, last, bDepthOnly);
+		const SCENE_NODE& node = m_sceneNodes[m_renderQueue.GetPacket(first).nodeIndex];
+
+		// change state only at run boundaries
+		int pool = GetTexturePool(node.textureHandle);
+		if (!bDepthOnly && (pool != currentPool) && (pool >= 0))
+		{
+			BindTexturePool(pool);
+			currentPool = pool;
+		}
+
+		uint32_t firstRecord = m_drawData.Append(m_drawRecords + first, runEnd - first);
+		m_basicMeshes->DrawMeshInstanced(node.meshID, (GLsizei)(runEnd - first), firstRecord, node.lod);
+		if (NULL != m_pCapture)
+		{
+			m_pCapture->AddDraw(FrameCapture::COMMAND_DRAW, node.meshID, node.lod, bDepthOnly ? -1 : pool,
+				m_drawRecords + first, runEnd - first);
+		}
+
+		first = runEnd;
+	}
+}
+
+/***********************************************************
+ *  BuildIndirectDraws()
+ *
+ *  Sort every opaque scene node by render state and turn
+ *  each run of nodes into one indirect command. The commands
+ *  do not depend on the camera, so they are not ordered by
+ *  distance. Nodes of static batches are left out. Only
+ *  called when a node changed or a texture arrived.
+ ***********************************************************/
+void SceneManager::BuildIndirectDraws()
+{
+	// the list keeps copies of the records, so the packets and
+	// records are given back to the arena at the end
+	FrameArena::MARKER marker = m_pFrameArena->GetMarker();
+	m_renderQueue.Reset(*m_pFrameArena, m_sceneNodes.size());
+	for (size_t i = 0; i < m_sceneNodes.size(); i++)
+	{
+		const SCENE_NODE& node = m_sceneNodes[i];
+		if ((node.opacity < 1.0f) || (node.staticBatch >= 0))
+			continue;
+
+		uint64_t sortKey = RenderQueue::MakeSortKey(
+			0,
+			GetTexturePool(node.textureHandle),
+			node.materialHandle,
+			GetMeshSortID(node),
+			0.0f);
+		m_renderQueue.Push(sortKey, (uint32_t)i);
+	}
+	m_renderQueue.Sort();
+	RecordQueue();
+
+	m_indirectDraws.Clear();
+	m_gpuCuller.Clear();
+	const size_t packetCount = m_renderQueue.GetCount();
+	size_t first = 0;
+	while (first < packetCount)
+	{
+		size_t last = FindRunEnd(first, packetCount, false);
+		const SCENE_NODE& node = m_sceneNodes[m_renderQueue.GetPacket(first).nodeIndex];
+
+		MeshManager::DRAW_COMMAND command;
+		if (m_basicMeshes->GetDrawCommand(node.meshID, (GLuint)(last - first), 0, command, node.lod))
+		{
+			m_indirectDraws.AddDraw(GetTexturePool(node.textureHandle), command, m_drawRecords + first);
+
+			// the GPU culls each node of the run on its own, drawing
+			// it with the record the run gave it
+			int batch = (int)m_indirectDraws.GetBatchCount() - 1;
+			GLuint firstRecord = m_indirectDraws.GetCommands()[m_indirectDraws.GetCommandCount() - 1].baseInstance;
+			for (size_t i = first; i < last; i++)
+			{
+				uint32_t nodeIndex = m_renderQueue.GetPacket(i).nodeIndex;
+				m_gpuCuller.AddObject(batch,
+					glm::vec3(m_boundsX[nodeIndex], m_boundsY[nodeIndex], m_boundsZ[nodeIndex]),
+					m_boundsRadius[nodeIndex], command, firstRecord + (GLuint)(i - first));
+			}
+		}
+
+		first = last;
+	}
+
+	m_indirectDraws.Upload();
+	if (m_gpuCuller.IsReady())
+		m_gpuCuller.Upload();
+	m_bIndirectDirty = false;
+	m_pFrameArena->Rewind(marker);
+}
+
+/***********************************************************
+ *  SubmitIndirectDraws()
+ *
+ *  Draw the opaque scene from the indirect commands, binding
+ *  the texture pool of each batch before its call unless the
+ *  pass only writes depth
+ ***********************************************************/
+void SceneManager::SubmitIndirectDraws(bool bDepthOnly)
+{
+	if (0 == m_indirectDraws.GetCommandCount())
+		return;
+
+	m_indirectDraws.Bind();
+	for (size_t i = 0; i < m_indirectDraws.GetBatchCount(); i++)
+	{
+		const IndirectDrawList::BATCH& batch = m_indirectDraws.GetBatch(i);
+		if (!bDepthOnly && (batch.pool >= 0))
+			BindTexturePool(batch.pool);
+
+		m_basicMeshes->MultiDrawIndirect(
+			m_indirectDraws.GetCommands() + batch.firstCommand,
+			batch.commandCount,
+			batch.firstCommand * sizeof(MeshManager::DRAW_COMMAND));
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	// the draws that follow read their records from the ring
+	m_drawData.Bind();
+}
+
+/***********************************************************
+ *  SubmitCulledIndirectDraws()
+ *
+ *  Draw each batch with the commands and the count written
+ *  by the culling pass, which has to run first
+ ***********************************************************/
+void SceneManager::SubmitCulledIndirectDraws(bool bDepthOnly)
 {
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	glm::mat4 scale;
-	glm::mat4 rotation;
-	glm::mat4 rotation2;
-	glm::mat4 translation;
-	glm::mat4 model;
-
-	/******************************************************************/
-	/*** PLANE — floor with brick texture ***/
-	scaleXYZ = glm::vec3(20.0f, 1.0f, 20.0f);
-	positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-
-	SetShaderTexture("floor");       // apply brick texture to plane
-	SetTextureUVScale(4.0f, 4.0f);   // repeat texture 4x in U and V
-	m_basicMeshes->DrawPlaneMesh();
-
-	/******************************************************************/
-	/*** CENTER CONE — abstract texture ***/
-	scaleXYZ = glm::vec3(1.0f, 2.0f, 1.0f);
-	positionXYZ = glm::vec3(0.0f, 1.0f, 3.0f); // centered
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
-	SetShaderTexture("cone"); // abstract texture
-	m_basicMeshes->DrawConeMesh();
-
-	/*** Torus around center cone — abstract texture ***/
-	scaleXYZ = glm::vec3(1.6f, 1.6f, 1.6f);
-	positionXYZ = glm::vec3(0.0f, 1.0f, 3.0f);
-	SetTransformations(scaleXYZ, 90.0f, 0, 0, positionXYZ);
-	SetShaderTexture("cone"); // same abstract texture for torus
-	m_basicMeshes->DrawTorusMesh();
-
-	/******************************************************************/
-	/*** FRONT ROW — LARGE CONES (LEFT & RIGHT) — abstract texture ***/
-	scaleXYZ = glm::vec3(1.6f, 2.0f, 1.6f);
-
-	// Left
-	positionXYZ = glm::vec3(-6.0f, 0.5f, 8.0f);
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
-	SetShaderTexture("cone");
-	m_basicMeshes->DrawConeMesh();
-
-	// Right
-	positionXYZ = glm::vec3(6.0f, 0.5f, 8.0f);
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
-	SetShaderTexture("cone");
-	m_basicMeshes->DrawConeMesh();
-
-	/******************************************************************/
-	/*** SECOND ROW — MEDIUM CONES (LEFT & RIGHT) — abstract texture ***/
-	scaleXYZ = glm::vec3(1.2f, 2.0f, 1.2f);
-
-	// Left
-	positionXYZ = glm::vec3(-4.0f, 0.5f, 5.0f);
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
-	SetShaderTexture("cone");
-	m_basicMeshes->DrawConeMesh();
-
-	// Right
-	positionXYZ = glm::vec3(4.0f, 0.5f, 5.0f);
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
-	SetShaderTexture("cone");
-	m_basicMeshes->DrawConeMesh();
-
-	/******************************************************************/
-	/*** THIRD ROW — SMALL CONES (LEFT & RIGHT) — abstract texture ***/
-	scaleXYZ = glm::vec3(0.9f, 2.0f, 0.9f);
-
-	// Left
-	positionXYZ = glm::vec3(-2.0f, 0.5f, -3.0f);
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
-	SetShaderTexture("cone");
-	m_basicMeshes->DrawConeMesh();
-
-	// Right
-	positionXYZ = glm::vec3(2.0f, 0.5f, -3.0f);
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
-	SetShaderTexture("cone");
-	m_basicMeshes->DrawConeMesh();
-
-	/******************************************************************/
-	/*** BOX — gold-seamless-texture ***/
-	scaleXYZ = glm::vec3(0.3f, 2.0f, 3.5f);
-	positionXYZ = glm::vec3(-5.0f, 0.6f, 6.5f);
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);
-	SetShaderTexture("box");
-	m_basicMeshes->DrawBoxMesh();
+	if (0 == m_indirectDraws.GetCommandCount())
+		return;
+
+	// the records stay those of the indirect list, only the
+	// commands come from the culling pass
+	m_indirectDraws.Bind();
+	m_gpuCuller.Bind();
+	for (size_t i = 0; i < m_indirectDraws.GetBatchCount(); i++)
+	{
+		const IndirectDrawList::BATCH& batch = m_indirectDraws.GetBatch(i);
+		if (!bDepthOnly && (batch.pool >= 0))
+			BindTexturePool(batch.pool);
+
+		m_basicMeshes->MultiDrawIndirectCount(
+			m_gpuCuller.GetBatchFirstCommand(i) * sizeof(MeshManager::DRAW_COMMAND),
+			i * sizeof(GLuint),
+			(GLsizei)m_gpuCuller.GetBatchObjectCount(i));
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindBuffer(GL_PARAMETER_BUFFER, 0);
+
+	// the draws that follow read their records from the ring
+	m_drawData.Bind();
 }
 
+/***********************************************************
+ *  BuildStaticBatches()
+ *
+ *  Sort the opaque nodes that never moved by texture,
+ *  material and UV scale, and bake each run of two or more
+ *  into one mesh, with the positions and normals moved into
+ *  world space. A single node is left as it is, so it keeps
+ *  its level of detail.
+ ***********************************************************/
+void SceneManager::BuildStaticBatches()
+{
+	m_basicMeshes->DestroyStaticBatches();
+	m_staticBatches.clear();
+	for (size_t i = 0; i < m_sceneNodes.size(); i++)
+	{
+		m_sceneNodes[i].staticBatch = -1;
+	}
+	m_bStaticBatchesDirty = false;
+	m_bIndirectDirty = true;
+
+	if (!m_bStaticBatching)
+		return;
+
+	std::vector<uint32_t> candidates;
+	for (size_t i = 0; i < m_sceneNodes.size(); i++)
+	{
+		const SCENE_NODE& node = m_sceneNodes[i];
+		if (node.bStatic && (node.opacity >= 1.0f))
+			candidates.push_back((uint32_t)i);
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b)
+	{
+		if (IsBatchedBefore(m_sceneNodes[a], m_sceneNodes[b]))
+			return true;
+		if (IsBatchedBefore(m_sceneNodes[b], m_sceneNodes[a]))
+			return false;
+		return a < b;
+	});
+
+	const size_t stride = MeshManager::FLOATS_PER_VERTEX;
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+	size_t first = 0;
+	while (first < candidates.size())
+	{
+		const SCENE_NODE& firstNode = m_sceneNodes[candidates[first]];
+		size_t last = first + 1;
+		while ((last < candidates.size()) && !IsBatchedBefore(firstNode, m_sceneNodes[candidates[last]]))
+		{
+			last++;
+		}
+
+		if (last - first >= 2)
+		{
+			vertices.clear();
+			indices.clear();
+			STATIC_BATCH batch;
+			batch.firstNode = candidates[first];
+			for (size_t k = first; k < last; k++)
+			{
+				const SCENE_NODE& node = m_sceneNodes[candidates[k]];
+				const std::vector<GLfloat>& meshVertices = m_basicMeshes->GetMeshVertices(node.meshID);
+				const std::vector<GLuint>& meshIndices = m_basicMeshes->GetMeshIndices(node.meshID);
+				GLuint baseVertex = (GLuint)(vertices.size() / stride);
+
+				// normals go through the inverse transpose, so that
+				// they stay normal to non-uniformly scaled surfaces
+				glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(node.world)));
+				for (size_t v = 0; v + stride <= meshVertices.size(); v += stride)
+				{
+					const GLfloat* source = &meshVertices[v];
+					glm::vec3 position = glm::vec3(node.world * glm::vec4(source[0], source[1], source[2], 1.0f));
+					glm::vec3 normal = normalMatrix * glm::vec3(source[3], source[4], source[5]);
+					float length = glm::length(normal);
+					if (length > 0.0f)
+						normal /= length;
+
+					vertices.push_back(position.x);
+					vertices.push_back(position.y);
+					vertices.push_back(position.z);
+					vertices.push_back(normal.x);
+					vertices.push_back(normal.y);
+					vertices.push_back(normal.z);
+					vertices.push_back(source[6]);
+					vertices.push_back(source[7]);
+				}
+				for (size_t j = 0; j < meshIndices.size(); j++)
+				{
+					indices.push_back(baseVertex + meshIndices[j]);
+				}
+
+				glm::vec3 boxMin;
+				glm::vec3 boxMax;
+				GetNodeBox(candidates[k], boxMin, boxMax);
+				batch.boxMin = (k == first) ? boxMin : glm::min(batch.boxMin, boxMin);
+				batch.boxMax = (k == first) ? boxMax : glm::max(batch.boxMax, boxMax);
+			}
+
+			batch.meshBatch = m_basicMeshes->CreateStaticBatch(vertices, indices);
+			if (batch.meshBatch >= 0)
+			{
+				for (size_t k = first; k < last; k++)
+				{
+					m_sceneNodes[candidates[k]].staticBatch = (int)m_staticBatches.size();
+				}
+				m_staticBatches.push_back(batch);
+			}
+		}
+
+		first = last;
+	}
+}
+
+/***********************************************************
+ *  DrawStaticBatches()
+ *
+ *  Draw each static batch whose box touches the frustum, or
+ *  every batch when there is no frustum, with the record of
+ *  its first node and no model transform
+ ***********************************************************/
+void SceneManager::DrawStaticBatches(const FrustumCuller* pFrustum, bool bDepthOnly)
+{
+	for (size_t i = 0; i < m_staticBatches.size(); i++)
+	{
+		const STATIC_BATCH& batch = m_staticBatches[i];
+		if ((NULL != pFrustum) && (FrustumCuller::BOX_OUTSIDE == pFrustum->TestBox(batch.boxMin, batch.boxMax)))
+			continue;
+
+		// the pool and the record are looked up each time, since
+		// the texture moves out of the placeholder layer when it
+		// finishes loading
+		const SCENE_NODE& firstNode = m_sceneNodes[batch.firstNode];
+		int pool = GetTexturePool(firstNode.textureHandle);
+		if (!bDepthOnly && (pool >= 0))
+			BindTexturePool(pool);
+
+		DrawDataBuffer::DRAW_DATA record;
+		MakeDrawRecord(firstNode, record);
+		record.model = glm::mat4(1.0f);
+		uint32_t firstRecord = m_drawData.Append(&record, 1);
+		m_basicMeshes->DrawStaticBatch(batch.meshBatch, firstRecord);
+		if (NULL != m_pCapture)
+			m_pCapture->AddDraw(FrameCapture::COMMAND_STATIC_BATCH, batch.meshBatch, 0, bDepthOnly ? -1 : pool, &record, 1);
+	}
+}
+
+/***********************************************************
+ *  SetStaticBatching()
+ *
+ *  Turn the static batches on or off; they are baked or
+ *  freed before the next frame
+ ***********************************************************/
+void SceneManager::SetStaticBatching(bool bEnable)
+{
+	if (bEnable == m_bStaticBatching)
+		return;
+
+	m_bStaticBatching = bEnable;
+	m_bStaticBatchesDirty = true;
+}
+
+/***********************************************************
+ *  SubmitOpaqueDraws()
+ *
+ *  Draw the opaque scene, either from the indirect commands
+ *  or from the first packets of the sorted render queue,
+ *  then the static batches. The batches are always in the
+ *  float vertex format.
+ ***********************************************************/
+void SceneManager::SubmitOpaqueDraws(size_t packetCount, bool bDepthOnly)
+{
+	if (m_bMultiDrawIndirect)
+	{
+		if (m_bFrustumCulling && m_gpuCuller.IsReady())
+			SubmitCulledIndirectDraws(bDepthOnly);
+		else
+			SubmitIndirectDraws(bDepthOnly);
+	}
+	else
+	{
+		SubmitRenderQueue(0, packetCount, bDepthOnly);
+	}
+
+	// the indirect submission binds the ring back before its
+	// return, so the batches read their own records
+	if (m_staticBatches.empty())
+		return;
+
+	const FrustumCuller* pFrustum = m_bFrustumCulling ? &m_frustum : NULL;
+	if (bDepthOnly)
+	{
+		DrawStaticBatches(pFrustum, true);
+		return;
+	}
+
+	m_pUniforms->SetBool("bPackedNormals", false);
+	DrawStaticBatches(pFrustum, false);
+	m_pUniforms->SetBool("bPackedNormals", m_basicMeshes->IsPackedVertices());
+}
+
+/***********************************************************
+ *  RenderShadows()
+ *
+ *  Bring the shadow maps up to date. Layers whose matrix is
+ *  unchanged and whose casters did not move keep the depth
+ *  they were rendered with.
+ ***********************************************************/
+void SceneManager::RenderShadows()
+{
+	if (!m_shadowMaps.IsReady())
+		return;
+
+	UpdateShadowLayout();
+	if (m_shadowMaps.IsAnyLayerDirty())
+	{
+		m_shadowMaps.BeginPass();
+		for (int layer = 0; layer < ShadowMaps::LAYER_COUNT; layer++)
+		{
+			if (m_shadowMaps.IsLayerDirty(layer))
+				RenderShadowLayer(layer);
+		}
+		m_shadowMaps.EndPass();
+	}
+
+	// the scene program is current again
+	BindShadowUniforms();
+}
+
+/***********************************************************
+ *  UpdateShadowLayout()
+ *
+ *  Grow the caster bounds around every node after one has
+ *  moved, and fit the layer matrices to the camera
+ ***********************************************************/
+void SceneManager::UpdateShadowLayout()
+{
+	if (m_bShadowCastersDirty && !m_sceneNodes.empty())
+	{
+		for (size_t i = 0; i < m_sceneNodes.size(); i++)
+		{
+			glm::vec3 center(m_boundsX[i], m_boundsY[i], m_boundsZ[i]);
+			glm::vec3 extent(m_boundsRadius[i]);
+			m_sceneMin = (0 == i) ? center - extent : glm::min(m_sceneMin, center - extent);
+			m_sceneMax = (0 == i) ? center + extent : glm::max(m_sceneMax, center + extent);
+		}
+	}
+
+	m_shadowMaps.Update(m_cameraView, m_cameraProjection, m_sceneMin, m_sceneMax, m_bShadowCastersDirty);
+	m_bShadowCastersDirty = false;
+}
+
+/***********************************************************
+ *  BindShadowUniforms()
+ *
+ *  Give the scene program the shadow maps and the matrices
+ *  of their layers
+ ***********************************************************/
+void SceneManager::BindShadowUniforms()
+{
+	m_shadowMaps.BindTexture();
+	for (int layer = 0; layer < ShadowMaps::LAYER_COUNT; layer++)
+	{
+		m_pUniforms->SetMat4(g_ShadowMatrixNames[layer], m_shadowMaps.GetMatrix(layer));
+	}
+	m_pUniforms->SetVec4("cascadeSplits", m_shadowMaps.GetCascadeSplits());
+}
+
+/***********************************************************
+ *  UpdateLights()
+ *
+ *  Bin the lights into the froxels of the camera and give the
+ *  scene shader what it needs to find its froxel
+ ***********************************************************/
+void SceneManager::UpdateLights()
+{
+	m_lightClusters.Update(m_cameraNear, m_cameraFar);
+	m_lightClusters.Bind();
+
+	m_pUniforms->SetInt("lightCount", m_lightClusters.GetLightCount());
+	m_pUniforms->SetVec2("clusterDepthRange", m_lightClusters.GetDepthRange());
+}
+
+/***********************************************************
+ *  AddPointLight()
+ *
+ *  Add a light without ambient that only reaches radius
+ *  units and casts no shadows
+ ***********************************************************/
+int SceneManager::AddPointLight(const glm::vec3& position, const glm::vec3& color, float radius)
+{
+	LightClusters::LIGHT_DATA light;
+	light.position = glm::vec4(position, std::max(radius, 0.01f));
+	light.ambientColor = glm::vec4(0.0f, 0.0f, 0.0f, 16.0f);
+	light.diffuseColor = glm::vec4(color, 0.5f);
+	light.specularColor = glm::vec4(color, -1.0f);
+	return m_lightClusters.AddLight(light);
+}
+
+/***********************************************************
+ *  SetPointLightPosition()
+ *
+ *  Move a light
+ ***********************************************************/
+void SceneManager::SetPointLightPosition(int lightHandle, const glm::vec3& position)
+{
+	m_lightClusters.SetLightPosition(lightHandle, position);
+}
+
+/***********************************************************
+ *  RenderShadowLayer()
+ *
+ *  Draw the casters inside a layer's light frustum through
+ *  the render queue. Depth does not depend on texture or
+ *  material, so the packets are keyed on the mesh alone and
+ *  every copy of a mesh is one instanced draw. The static
+ *  batches inside the frustum follow, one call each.
+ ***********************************************************/
+void SceneManager::RenderShadowLayer(int layer)
+{
+	m_shadowMaps.BeginLayer(layer);
+	if (NULL != m_pCapture)
+		m_pCapture->AddPass(FrameCapture::COMMAND_SHADOW_LAYER, layer);
+	FrameArena::MARKER marker = m_pFrameArena->GetMarker();
+
+	FrustumCuller lightFrustum;
+	lightFrustum.SetViewProjection(m_shadowMaps.GetMatrix(layer));
+	uint32_t* casters = m_pFrameArena->AllocateArray<uint32_t>(m_sceneNodes.size());
+	size_t casterCount = CollectVisibleNodes(lightFrustum, casters);
+
+	m_renderQueue.Reset(*m_pFrameArena, casterCount);
+	for (size_t k = 0; k < casterCount; k++)
+	{
+		uint32_t i = casters[k];
+		if (m_sceneNodes[i].staticBatch < 0)
+			m_renderQueue.Push(RenderQueue::MakeSortKey(0, -1, -1, GetMeshSortID(m_sceneNodes[i]), 0.0f), i);
+	}
+	m_renderQueue.Sort();
+	RecordQueue();
+	SubmitRenderQueue(0, m_renderQueue.GetCount(), true);
+	DrawStaticBatches(&lightFrustum, true);
+
+	// the draws copied their records into the ring buffer
+	m_pFrameArena->Rewind(marker);
+}
+
+/***********************************************************
+ *  SetMultiDrawIndirect()
+ *
+ *  Switch between the indirect submission of the scene and
+ *  the culled, per-run instanced draws
+ ***********************************************************/
+bool SceneManager::SetMultiDrawIndirect(bool bEnable)
+{
+	// the recording keeps to the instanced draws, and the
+	// setting is applied once it ends
+	if (NULL != m_pCapture)
+	{
+		m_bCaptureIndirect = bEnable;
+		return false;
+	}
+
+	m_bMultiDrawIndirect = bEnable && m_bIndirectSupported;
+	m_bIndirectDirty = true;
+	return m_bMultiDrawIndirect;
+}
+
+/***********************************************************
+ *  SetDepthPrePass()
+ *
+ *  Switch the depth pre-pass of the opaque scene on or off
+ ***********************************************************/
+bool SceneManager::SetDepthPrePass(bool bEnable)
+{
+	m_bDepthPrePass = bEnable && m_depthPrePass.IsReady();
+	return m_bDepthPrePass;
+}
+
+/***********************************************************
+ *  BeginCapture()
+ *
+ *  Start recording the frames into a capture, with the slot
+ *  of every texture and what the replay has to set up the
+ *  same way. Shadow layers are all rendered in the first
+ *  frame, so the replay does not depend on older frames.
+ ***********************************************************/
+bool SceneManager::BeginCapture(FrameCapture* pCapture, const std::string& path)
+{
+	// layers of textures still loading would change mid-way
+	if ((NULL != m_pCapture) || IsLoadingTextures())
+		return false;
+
+	std::vector<FrameCapture::TEXTURE_SLOT> textureSlots(m_textures.size());
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		textureSlots[i].pool = m_textures[i].slot.pool;
+		textureSlots[i].layer = m_textures[i].slot.layer;
+	}
+
+	uint32_t flags = 0;
+	if (m_basicMeshes->IsPackedVertices())
+		flags |= FrameCapture::CAPTURE_PACKED_VERTICES;
+	if (m_bStaticBatching)
+		flags |= FrameCapture::CAPTURE_STATIC_BATCHING;
+	if (m_bDepthPrePass)
+		flags |= FrameCapture::CAPTURE_DEPTH_PREPASS;
+
+	if (!pCapture->BeginRecording(path, m_scenePath, flags, textureSlots))
+		return false;
+
+	// the indirect draws are only known to the GPU, so the
+	// recording uses the instanced ones
+	m_bCaptureIndirect = m_bMultiDrawIndirect;
+	SetMultiDrawIndirect(false);
+	m_pCapture = pCapture;
+	m_bShadowCastersDirty = true;
+	return true;
+}
+
+/***********************************************************
+ *  EndCapture()
+ *
+ *  Stop recording and go back to the submission asked for
+ ***********************************************************/
+bool SceneManager::EndCapture()
+{
+	if (NULL == m_pCapture)
+		return false;
+
+	bool bWritten = m_pCapture->EndRecording();
+	m_pCapture = NULL;
+	SetMultiDrawIndirect(m_bCaptureIndirect);
+	return bWritten;
+}
+
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  Set the color into the draw state for the next draw
+ ***********************************************************/
+void SceneManager::SetShaderColor(float r, float g, float b, float a)
+{
+	m_drawState.objectColor = glm::vec4(r, g, b, a);
+	m_drawState.flags &= ~(uint32_t)DrawDataBuffer::DRAW_USE_TEXTURE;
+}
+
+/***********************************************************
+ *  GetTexturePool()
+ *
+ *  Get the array pool holding a texture
+ ***********************************************************/
+int SceneManager::GetTexturePool(int textureHandle) const
+{
+	if ((textureHandle < 0) || (textureHandle >= (int)m_textures.size()))
+		return -1;
+	return m_textures[textureHandle].slot.pool;
+}
+
+/***********************************************************
+ *  BindTexturePool()
+ *
+ *  Bind the array texture of a pool, skipping the bind when
+ *  it is already bound
+ ***********************************************************/
+void SceneManager::BindTexturePool(int pool)
+{
+	GLuint textureArray = m_textureArrays.GetTexture(pool);
+	if (textureArray != m_boundTextureArray)
+	{
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+		m_boundTextureArray = textureArray;
+	}
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  Set the texture for the next draw. Only the array texture
+ *  of the texture's pool is bound, and the layer goes into
+ *  the draw state.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(int textureHandle)
+{
+	if ((textureHandle < 0) || (textureHandle >= (int)m_textures.size()))
+		return;
+
+	const TextureArrays::ARRAY_SLOT& slot = m_textures[textureHandle].slot;
+	BindTexturePool(slot.pool);
+
+	m_drawState.flags |= DrawDataBuffer::DRAW_USE_TEXTURE;
+	m_drawState.textureLayer = (float)slot.layer;
+}
+
+void SceneManager::SetShaderTexture(const std::string& textureTag)
+{
+	SetShaderTexture(FindTextureSlot(textureTag));
+}
+
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  Set the UV scale into the draw state
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+	m_drawState.uvScale = glm::vec2(u, v);
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  Set the material values into the draw state
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(int materialHandle)
+{
+	if ((materialHandle >= 0) && (materialHandle < (int)m_objectMaterials.size()))
+	{
+		const OBJECT_MATERIAL& material = m_objectMaterials[materialHandle];
+		m_drawState.ambientColor = glm::vec4(material.ambientColor, material.ambientStrength);
+		m_drawState.diffuseColor = glm::vec4(material.diffuseColor, material.shininess);
+		m_drawState.specularColor = glm::vec4(material.specularColor, 0.0f);
+	}
+}
+
+void SceneManager::SetShaderMaterial(const std::string& materialTag)
+{
+	SetShaderMaterial(FindMaterialHandle(materialTag));
+}
+
+/***********************************************************
+// STUDENTS CAN MODIFY BELOW METHODS FOR SCENE RENDERING
+***********************************************************/
+
+/***********************************************************
+ *  LoadSceneFile()
+ *
+ *  Read the scene file and rebuild the materials, lights and
+ *  nodes from it. Textures are only loaded when their tag is
+ *  new or their image file changed. When the file can not be
+ *  read, the current scene is kept.
+ ***********************************************************/
+bool SceneManager::LoadSceneFile()
+{
+	SceneFile scene;
+	if (!scene.Load(m_scenePath))
+	{
+		std::cerr << "Could not load scene " << m_scenePath << std::endl;
+		return false;
+	}
+
+	m_objectMaterials.clear();
+	m_materialHandles.clear();
+	for (uint32_t i = 0; i < scene.GetMaterialCount(); i++)
+	{
+		const SceneFile::SCENE_MATERIAL& record = scene.GetMaterials()[i];
+		OBJECT_MATERIAL material;
+		material.ambientColor = glm::vec3(record.ambientColor[0], record.ambientColor[1], record.ambientColor[2]);
+		material.ambientStrength = record.ambientStrength;
+		material.diffuseColor = glm::vec3(record.diffuseColor[0], record.diffuseColor[1], record.diffuseColor[2]);
+		material.specularColor = glm::vec3(record.specularColor[0], record.specularColor[1], record.specularColor[2]);
+		material.shininess = record.shininess;
+		material.tag = scene.GetString(record.tag);
+		DefineMaterial(material);
+	}
+
+	m_lightClusters.RemoveAllLights();
+	for (uint32_t i = 0; i < scene.GetLightCount(); i++)
+	{
+		const SceneFile::SCENE_LIGHT& record = scene.GetLights()[i];
+		LightClusters::LIGHT_DATA light;
+		light.position = glm::vec4(record.position[0], record.position[1], record.position[2], record.position[3]);
+		light.ambientColor = glm::vec4(record.ambientColor[0], record.ambientColor[1], record.ambientColor[2], record.ambientColor[3]);
+		light.diffuseColor = glm::vec4(record.diffuseColor[0], record.diffuseColor[1], record.diffuseColor[2], record.diffuseColor[3]);
+		light.specularColor = glm::vec4(record.specularColor[0], record.specularColor[1], record.specularColor[2], record.specularColor[3]);
+		m_lightClusters.AddLight(light);
+	}
+
+	// the first lights are the shadowed ones
+	for (int i = 0; (i <= ShadowMaps::CASCADED_LIGHTS) && (i < m_lightClusters.GetLightCount()); i++)
+	{
+		m_shadowMaps.SetLightPosition(i, glm::vec3(m_lightClusters.GetLight(i).position));
+	}
+
+	// ===========================
+	// Load textures into memory
+	// ===========================
+	// the images are decoded on worker threads while the scene
+	// renders with placeholder textures
+	for (uint32_t i = 0; i < scene.GetTextureCount(); i++)
+	{
+		const SceneFile::SCENE_TEXTURE& record = scene.GetTextures()[i];
+		const char* tag = scene.GetString(record.tag);
+		const char* filename = scene.GetString(record.path);
+		int textureHandle = FindTextureSlot(tag);
+		if (textureHandle < 0)
+			CreateGLTexture(filename, tag);
+		else if (m_textures[textureHandle].filename != filename)
+			ReloadGLTexture(textureHandle, filename);
+	}
+
+	// ===========================
+	// Build the scene description
+	// ===========================
+	// the texture and material references are resolved once
+	// here so that rendering never needs to search for them
+	m_sceneNodes.clear();
+	m_dirtyNodes.clear();
+	m_bvh.Clear();
+	m_boundsX.clear();
+	m_boundsY.clear();
+	m_boundsZ.clear();
+	m_boundsRadius.clear();
+	for (uint32_t i = 0; i < scene.GetNodeCount(); i++)
+	{
+		const SceneFile::SCENE_NODE_RECORD& record = scene.GetNodes()[i];
+		int textureSlot = -1;
+		if (record.texture >= 0)
+			textureSlot = FindTextureSlot(scene.GetString(scene.GetTextures()[record.texture].tag));
+		int materialHandle = -1;
+		if (record.material >= 0)
+			materialHandle = FindMaterialHandle(scene.GetString(scene.GetMaterials()[record.material].tag));
+
+		int nodeIndex = AddSceneNode((int)record.mesh, textureSlot, materialHandle,
+			glm::vec2(record.uvScale[0], record.uvScale[1]),
+			glm::vec3(record.scale[0], record.scale[1], record.scale[2]),
+			glm::vec3(record.rotationDegrees[0], record.rotationDegrees[1], record.rotationDegrees[2]),
+			glm::vec3(record.position[0], record.position[1], record.position[2]));
+		if (record.opacity < 1.0f)
+			SetNodeOpacity(nodeIndex, record.opacity);
+	}
+
+	// the world matrices of the static scene are built once here
+	UpdateWorldMatrices();
+	m_bIndirectDirty = true;
+	m_bStaticBatchesDirty = true;
+	m_bShadowCastersDirty = true;
+	return true;
+}
+
+/***********************************************************
+ *  WatchFiles()
+ *
+ *  Register the scene file and every texture image with a
+ *  file watcher, including textures created later
+ ***********************************************************/
+void SceneManager::WatchFiles(FileWatcher* pWatcher)
+{
+	m_pFileWatcher = pWatcher;
+	if (NULL == m_pFileWatcher)
+		return;
+
+	m_pFileWatcher->Watch(m_scenePath);
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		m_pFileWatcher->Watch(m_textures[i].filename);
+	}
+}
+
+/***********************************************************
+ *  OnFilesChanged()
+ *
+ *  Reload the scene when its file changed, and decode the
+ *  changed texture images again. The rest stays as it is.
+ ***********************************************************/
+void SceneManager::OnFilesChanged(const std::vector<std::string>& paths)
+{
+	for (size_t p = 0; p < paths.size(); p++)
+	{
+		if (paths[p] == m_scenePath)
+		{
+			if (LoadSceneFile())
+				std::cout << "Reloaded " << m_scenePath << std::endl;
+			continue;
+		}
+
+		for (size_t i = 0; i < m_textures.size(); i++)
+		{
+			if (m_textures[i].filename == paths[p])
+				ReloadGLTexture((int)i, paths[p]);
+		}
+	}
+}
+
+/***********************************************************
+ *  PrepareScene()
+ *
+ *  This method is used for preparing the 3D scene by loading
+ *  the shapes, textures in memory to support the 3D scene
+ *  rendering. The objects, materials, lights and textures
+ *  come from the scene file, so changing the scene needs no
+ *  recompile.
+ ***********************************************************/
+void SceneManager::PrepareScene()
+{
+	// the nodes are updated and recorded on every core
+	m_jobs.Start();
+	m_workerOutputs.resize(m_jobs.GetWorkerCount());
+
+	// Enable lighting
+	m_pUniforms->SetBool("bUseLighting", true);
+
+	// the lights are binned by a compute pass when it is
+	// available, otherwise every fragment loops over all of them
+	if (m_lightClusters.Initialize("Shaders/clusterComputeShader.glsl"))
+		m_pUniforms->SetBool("bUseClusters", true);
+
+	// the shadow maps are sampled from their own unit, even
+	// when they are not used
+	m_pUniforms->SetSampler2D(g_ShadowMapsName, ShadowMaps::TEXTURE_UNIT);
+	if (m_shadowMaps.Initialize(g_ShadowResolution, m_pShaderLibrary))
+		m_pUniforms->SetBool("bUseShadows", true);
+
+	// only one instance of a particular mesh needs to be
+	// loaded in memory no matter how many times it is drawn
+	m_basicMeshes->LoadPlaneMesh();
+	m_basicMeshes->LoadConeMesh();
+	m_basicMeshes->LoadTorusMesh();
+	m_basicMeshes->LoadBoxMesh();
+	m_pUniforms->SetBool("bPackedNormals", m_basicMeshes->IsPackedVertices());
+
+	// with multi-draw-indirect the meshes share one buffer, so
+	// that a single call can draw any mix of them; the shaders
+	// find the records of indirect draws through gl_BaseInstance
+	if (GLEW_VERSION_4_6)
+	{
+		m_bIndirectSupported = m_basicMeshes->BuildMergedGeometry();
+	}
+	if (m_bIndirectSupported)
+	{
+		m_gpuCuller.Initialize("Shaders/cullComputeShader.glsl");
+	}
+	SetMultiDrawIndirect(true);
+
+	// the opaque scene is drawn into the depth buffer first, so
+	// that only the visible surfaces are shaded
+	m_depthPrePass.Initialize(m_pShaderLibrary);
+	SetDepthPrePass(true);
+
+	m_textureLoader.Start(&m_textureArrays);
+	LoadSceneFile();
+
+	// the array textures are always sampled from unit 0
+	m_pUniforms->SetSampler2D(g_TextureValueName, 0);
+}
+
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene by
+ *  transforming and drawing the basic 3D shapes
+ ***********************************************************/
+void SceneManager::RenderScene()
+{
+	// upload a few of the textures that finished decoding
+	ProcessTextureUploads();
+
+	m_basicMeshes->ResetDrawStats();
+
+	// only nodes that moved since the last frame need new matrices
+	UpdateWorldMatrices();
+	if (m_bStaticBatchesDirty)
+		BuildStaticBatches();
+	UpdateLevelsOfDetail();
+
+	// room for one record per node in the depth pre-pass, the
+	// main pass and every shadow map layer
+	m_drawData.BeginFrame(m_sceneNodes.size() * (2 + ShadowMaps::LAYER_COUNT));
+	RenderShadows();
+	UpdateLights();
+
+	if (m_bMultiDrawIndirect)
+	{
+		if (m_bIndirectDirty)
+			BuildIndirectDraws();
+		if (m_bFrustumCulling && m_gpuCuller.IsReady())
+			m_gpuCuller.Cull();
+	}
+
+	// the indirect commands hold the opaque nodes, so then the
+	// queue only sorts the transparent ones
+	BuildRenderQueue(!m_bMultiDrawIndirect);
+	m_renderQueue.Sort();
+	RecordQueue();
+	size_t transparentStart = m_renderQueue.FindBucket(RenderQueue::BUCKET_TRANSPARENT);
+
+	if (m_bDepthPrePass)
+	{
+		if (NULL != m_pCapture)
+			m_pCapture->AddPass(FrameCapture::COMMAND_DEPTH_PASS);
+		m_depthPrePass.BeginPass();
+		SubmitOpaqueDraws(transparentStart, true);
+		m_depthPrePass.EndPass();
+	}
+	if (NULL != m_pCapture)
+		m_pCapture->AddPass(FrameCapture::COMMAND_OPAQUE_PASS);
+	SubmitOpaqueDraws(transparentStart, false);
+
+	// transparent nodes are tested against the opaque depth but
+	// do not write it, so each one blends over everything
+	// behind it
+	if (NULL != m_pCapture)
+		m_pCapture->AddPass(FrameCapture::COMMAND_TRANSPARENT_PASS);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_FALSE);
+	SubmitRenderQueue(transparentStart, m_renderQueue.GetCount(), false);
+	glDepthMask(GL_TRUE);
+
+	m_drawData.EndFrame();
+}
+
+/***********************************************************
+ *  FindReplaySlot()
+ *
+ *  Look up the texture that held a slot when the capture was
+ *  recorded, and get the slot it has now
+ ***********************************************************/
+bool SceneManager::FindReplaySlot(const FrameCapture& capture, int pool, int layer, TextureArrays::ARRAY_SLOT& slot) const
+{
+	const FrameCapture::TEXTURE_SLOT* capturedSlots = capture.GetTextureSlots();
+	uint32_t textureCount = std::min(capture.GetTextureCount(), (uint32_t)m_textures.size());
+	for (uint32_t i = 0; i < textureCount; i++)
+	{
+		if ((capturedSlots[i].pool == pool) && (capturedSlots[i].layer == layer))
+		{
+			slot = m_textures[i].slot;
+			return true;
+		}
+	}
+	return false;
+}
+
+/***********************************************************
+ *  EndReplayPass()
+ *
+ *  Put back the state that a replayed pass changed. The
+ *  opaque pass changes none, and also stands for no pass.
+ ***********************************************************/
+void SceneManager::EndReplayPass(uint32_t pass)
+{
+	switch (pass)
+	{
+	case FrameCapture::COMMAND_SHADOW_LAYER:
+		m_shadowMaps.EndPass();
+		break;
+	case FrameCapture::COMMAND_DEPTH_PASS:
+		m_depthPrePass.EndPass();
+		break;
+	case FrameCapture::COMMAND_TRANSPARENT_PASS:
+		glDepthMask(GL_TRUE);
+		break;
+	default:
+		break;
+	}
+}
+
+/***********************************************************
+ *  ReplayFrame()
+ *
+ *  Draw a captured frame through the same passes and draw
+ *  calls as when it was recorded. Nothing is culled, sorted
+ *  or recorded; each draw appends its captured records, with
+ *  the texture layers mapped to the current slots. The shadow
+ *  layout and the light bins follow from the camera as in
+ *  RenderScene(), so the uniforms match the capture.
+ ***********************************************************/
+void SceneManager::ReplayFrame(const FrameCapture& capture, uint32_t frame)
+{
+	ProcessTextureUploads();
+
+	m_basicMeshes->ResetDrawStats();
+
+	// the static batches are baked from the scene as loaded,
+	// like the ones the capture drew
+	UpdateWorldMatrices();
+	if (m_bStaticBatchesDirty)
+		BuildStaticBatches();
+
+	const FrameCapture::FRAME_HEADER& header = capture.GetFrame(frame);
+	const FrameCapture::CAPTURE_COMMAND* commands = capture.GetCommands(frame);
+
+	m_drawData.BeginFrame(header.recordCount);
+	if (m_shadowMaps.IsReady())
+	{
+		UpdateShadowLayout();
+		BindShadowUniforms();
+	}
+	UpdateLights();
+
+	// the mapped capture is read only, so the records are
+	// copied where their layers can be changed
+	FrameArena::MARKER marker = m_pFrameArena->GetMarker();
+	DrawDataBuffer::DRAW_DATA* records = m_pFrameArena->AllocateArray<DrawDataBuffer::DRAW_DATA>(header.recordCount);
+	if (header.recordCount > 0)
+		memcpy(records, capture.GetRecords(frame), header.recordCount * sizeof(DrawDataBuffer::DRAW_DATA));
+
+	// the draws of a pass this driver can not run are skipped
+	uint32_t pass = FrameCapture::COMMAND_OPAQUE_PASS;
+	bool bSkipPass = false;
+	for (uint32_t c = 0; c < header.commandCount; c++)
+	{
+		const FrameCapture::CAPTURE_COMMAND& command = commands[c];
+		if ((FrameCapture::COMMAND_DRAW != command.type) && (FrameCapture::COMMAND_STATIC_BATCH != command.type))
+		{
+			bool bShadowLayer = (FrameCapture::COMMAND_SHADOW_LAYER == command.type);
+			bSkipPass = (bShadowLayer && (!m_shadowMaps.IsReady() || (command.lod < 0) || (command.lod >= ShadowMaps::LAYER_COUNT))) ||
+				((FrameCapture::COMMAND_DEPTH_PASS == command.type) && !m_depthPrePass.IsReady());
+			if (bSkipPass)
+				continue;
+
+			// the layers of a frame share one shadow pass
+			if (!bShadowLayer || (FrameCapture::COMMAND_SHADOW_LAYER != pass))
+			{
+				EndReplayPass(pass);
+				if (bShadowLayer)
+					m_shadowMaps.BeginPass();
+				else if (FrameCapture::COMMAND_DEPTH_PASS == command.type)
+					m_depthPrePass.BeginPass();
+				else if (FrameCapture::COMMAND_TRANSPARENT_PASS == command.type)
+				{
+					glDepthFunc(GL_LESS);
+					glDepthMask(GL_FALSE);
+				}
+			}
+			if (bShadowLayer)
+				m_shadowMaps.BeginLayer(command.lod);
+			pass = command.type;
+			continue;
+		}
+		if (bSkipPass)
+			continue;
+
+		DrawDataBuffer::DRAW_DATA* drawRecords = records + command.firstRecord;
+		bool bDepthOnly = (FrameCapture::COMMAND_SHADOW_LAYER == pass) || (FrameCapture::COMMAND_DEPTH_PASS == pass);
+		if (!bDepthOnly && (command.pool >= 0))
+		{
+			// a texture the scene no longer has leaves the pool
+			// of the draw before
+			int pool = -1;
+			for (uint32_t r = 0; r < command.recordCount; r++)
+			{
+				TextureArrays::ARRAY_SLOT slot;
+				if ((0 != (drawRecords[r].flags & DrawDataBuffer::DRAW_USE_TEXTURE)) &&
+					FindReplaySlot(capture, command.pool, (int)drawRecords[r].textureLayer, slot))
+				{
+					drawRecords[r].textureLayer = (float)slot.layer;
+					pool = slot.pool;
+				}
+			}
+			if (pool >= 0)
+				BindTexturePool(pool);
+		}
+
+		uint32_t firstRecord = m_drawData.Append(drawRecords, command.recordCount);
+		if (FrameCapture::COMMAND_DRAW == command.type)
+		{
+			m_basicMeshes->DrawMeshInstanced(command.mesh, (GLsizei)command.recordCount, firstRecord, command.lod);
+		}
+		else if (bDepthOnly)
+		{
+			m_basicMeshes->DrawStaticBatch(command.mesh, firstRecord);
+		}
+		else
+		{
+			// the batches are always in the float vertex format
+			m_pUniforms->SetBool("bPackedNormals", false);
+			m_basicMeshes->DrawStaticBatch(command.mesh, firstRecord);
+			m_pUniforms->SetBool("bPackedNormals", m_basicMeshes->IsPackedVertices());
+		}
+	}
+	EndReplayPass(pass);
+
+	m_pFrameArena->Rewind(marker);
+	m_drawData.EndFrame();
+}
@@ -10,9 +10,29 @@
 #pragma once
 
 #include "ShaderManager.h"
-#include "ShapeMeshes.h"
+#include "CameraBuffer.h"
+#include "DepthPrePass.h"
+#include "DrawDataBuffer.h"
+#include "FileWatcher.h"
+#include "FrameCapture.h"
+#include "FrameArena.h"
+#include "FrustumCuller.h"
+#include "GpuCuller.h"
+#include "IndirectDrawList.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
+#include "MeshManager.h"
+#include "RenderQueue.h"
+#include "SceneBvh.h"
+#include "SceneFile.h"
+#include "ShaderLibrary.h"
+#include "ShadowMaps.h"
+#include "TextureArrays.h"
+#include "TextureLoader.h"
+#include "UniformCache.h"
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 /***********************************************************
@@ -20,19 +40,74 @@
  *
  *  This class contains the code for preparing and rendering
  *  3D scenes, including the shader settings.
+ *
+ *  Per-object shader settings (model matrix, color, texture
+ *  layer, UV scale and material) are not uniforms. The Set*
+ *  methods change a current DRAW_DATA record, and each draw
+ *  copies its records into the DrawDataBuffer ring.
+ *
+ *  When multi-draw-indirect is available the meshes are
+ *  merged into shared buffers, and the whole scene is kept
+ *  as an IndirectDrawList rebuilt only when a node or a
+ *  texture changes. A frame then takes one indirect call
+ *  per texture pool, however many nodes there are. Frustum
+ *  culling then runs on the GPU when compute shaders and
+ *  indirect draw counts are supported; otherwise this mode
+ *  draws every node.
+ *
+ *  The opaque nodes can first be drawn into the depth buffer
+ *  only, and then shaded with a GL_EQUAL depth test, so each
+ *  pixel runs the lighting shader once. Nodes with an opacity
+ *  below 1 are drawn last, sorted back to front.
+ *
+ *  Each frame every node picks the level of detail of its
+ *  mesh from its size on screen, so distant cones and tori
+ *  are drawn with a fraction of their triangles.
+ *
+ *  The per-node work of a frame, from the world matrices and
+ *  levels of detail to culling and recording the draws, is
+ *  split over the cores by a JobSystem. Only the GL calls are
+ *  made from the render thread.
+ *
+ *  The world-space boxes of the nodes are kept in a SceneBvh,
+ *  which is refit only for the nodes that moved. The camera
+ *  and shadow frusta are culled through it, and so are the
+ *  rays of mouse picks.
+ *
+ *  The packets, culling results and records of a frame are
+ *  taken from the FrameArena of the renderer, which is reset
+ *  after every swap, so a settled frame never touches the
+ *  heap.
+ *
+ *  With static batching on, the opaque nodes that have never
+ *  moved are baked by texture, material and UV scale into
+ *  merged meshes already in world space. Each batch is then
+ *  culled as a whole and drawn in one call with one record,
+ *  and its nodes are left out of the queue and the indirect
+ *  commands. Moving a node takes it out of its batch.
+ *
+ *  While a FrameCapture records, every draw is copied into
+ *  it with its records and texture pool. Indirect submission
+ *  is off for the recording, since its draws are only known
+ *  to the GPU. ReplayFrame() then draws a captured frame from
+ *  its commands alone, with the shadow layout and the light
+ *  bins worked out again from the captured camera.
  ***********************************************************/
 class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager *pShaderManager);
+	SceneManager(ShaderManager *pShaderManager, ShaderLibrary* pShaderLibrary, UniformCache* pUniforms, FrameArena* pFrameArena);
 	// destructor
 	~SceneManager();
 
 	struct TEXTURE_INFO
 	{
 		std::string tag;
-		uint32_t ID;
+		// image file the texture is loaded from
+		std::string filename;
+		// array pool and layer holding the texture image
+		TextureArrays::ARRAY_SLOT slot;
 	};
 
 	struct OBJECT_MATERIAL
@@ -45,29 +120,174 @@ public:
 		std::string tag;
 	};
 
+	struct SCENE_NODE
+	{
+		// what to draw and how to shade it
+		int meshID;
+		int textureHandle;
+		int materialHandle;
+		glm::vec2 uvScale;
+		// below 1 the node is blended after the opaque scene
+		float opacity;
+		// level of detail drawn for the current camera
+		int lod;
+		// local transform of the node
+		glm::vec3 scaleXYZ;
+		glm::vec3 rotationDegrees;
+		glm::vec3 positionXYZ;
+		// cached world matrix, rebuilt only when bDirty is set
+		glm::mat4 world;
+		bool bDirty;
+		// false once the node has been moved, since then it can
+		// not be baked into a static batch
+		bool bStatic;
+		// static batch holding the node, or -1
+		int staticBatch;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
+	// pointer to the library building the programs of the
+	// shadow and depth passes
+	ShaderLibrary* m_pShaderLibrary;
+	// pointer to the uniform cache of the active shader program
+	UniformCache* m_pUniforms;
+	// pointer to the arena of the frame's transient data
+	FrameArena* m_pFrameArena;
 	// pointer to basic shapes object
-	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
-	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	MeshManager* m_basicMeshes;
+	// loaded textures info, indexed by texture handle
+	std::vector<TEXTURE_INFO> m_textures;
+	// array texture pools holding every loaded texture
+	TextureArrays m_textureArrays;
+	// layer shown by textures that are still loading
+	TextureArrays::ARRAY_SLOT m_placeholderSlot;
+	// array texture currently bound to the texture unit
+	GLuint m_boundTextureArray;
+	// decodes texture images in the background
+	TextureLoader m_textureLoader;
+	// scratch list of the textures uploaded this frame
+	std::vector<TextureLoader::UPLOADED_TEXTURE> m_uploadedTextures;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// tag to handle lookups for the loaded textures and the
+	// defined materials - a handle is the index into m_textures
+	// or m_objectMaterials
+	std::unordered_map<std::string, int> m_textureHandles;
+	std::unordered_map<std::string, int> m_materialHandles;
+
+	// scene file read by PrepareScene()
+	std::string m_scenePath;
+	// watches the scene and texture files when hot reload is on
+	FileWatcher* m_pFileWatcher;
+	// retained description of the scene, built in PrepareScene()
+	std::vector<SCENE_NODE> m_sceneNodes;
+	// nodes whose world matrix has to be rebuilt
+	std::vector<uint32_t> m_dirtyNodes;
+	// ring of per-draw records read by the shaders
+	DrawDataBuffer m_drawData;
+	// record that the Set* methods change, copied by each draw
+	DrawDataBuffer::DRAW_DATA m_drawState;
+	// records of the queued packets, in queue order, in the
+	// frame arena
+	DrawDataBuffer::DRAW_DATA* m_drawRecords;
+	// state-sorted draw packets of the current frame
+	RenderQueue m_renderQueue;
+	// camera of the current frame
+	glm::mat4 m_cameraView;
+	glm::mat4 m_cameraProjection;
+	// near and far distance of the camera, the far one being
+	// the range of the draw order
+	float m_cameraNear;
+	float m_cameraFar;
+	// frustum of the current view, used to skip hidden nodes
+	FrustumCuller m_frustum;
+	bool m_bFrustumCulling;
+	// hierarchy of the world-space boxes of the scene nodes,
+	// and whether culling goes through it or tests every node
+	SceneBvh m_bvh;
+	bool m_bSpatialIndex;
+	// world-space bounding spheres of the scene nodes, stored
+	// per component and padded to a multiple of four
+	std::vector<float> m_boundsX;
+	std::vector<float> m_boundsY;
+	std::vector<float> m_boundsZ;
+	std::vector<float> m_boundsRadius;
+	// the whole scene as indirect commands, and whether it is
+	// used and needs rebuilding
+	IndirectDrawList m_indirectDraws;
+	bool m_bIndirectSupported;
+	bool m_bMultiDrawIndirect;
+	bool m_bIndirectDirty;
+	// culls the indirect commands in a compute shader
+	GpuCuller m_gpuCuller;
+	// shadow maps of the lights, rendered again only when a
+	// caster moved or a cascade had to follow the camera
+	ShadowMaps m_shadowMaps;
+	bool m_bShadowCastersDirty;
+	// bounds of all the shadow casters
+	glm::vec3 m_sceneMin;
+	glm::vec3 m_sceneMax;
+	// every light of the scene, binned into view clusters
+	LightClusters m_lightClusters;
+	// depth-only pass ahead of the opaque shading
+	DepthPrePass m_depthPrePass;
+	bool m_bDepthPrePass;
+	// whether nodes are drawn at a level of detail matching
+	// their screen size, rather than always the finest
+	bool m_bLevelOfDetail;
+
+	struct STATIC_BATCH
+	{
+		// merged mesh in the MeshManager
+		int meshBatch;
+		// node whose texture, material and UV scale the batch
+		// is drawn with
+		uint32_t firstNode;
+		// world-space box around all the nodes of the batch
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+	};
+	// baked batches of static nodes, whether they are used, and
+	// whether they have to be baked again
+	std::vector<STATIC_BATCH> m_staticBatches;
+	bool m_bStaticBatching;
+	bool m_bStaticBatchesDirty;
+
+	// capture recording the submitted draws, or NULL, and the
+	// submission asked for while it records
+	FrameCapture* m_pCapture;
+	bool m_bCaptureIndirect;
+
+	// what one worker wrote while recording the frame, kept
+	// apart so that the workers never share a cache line
+	struct WORKER_OUTPUT
+	{
+		bool bChanged;
+		uint8_t padding[64];
+	};
+	// workers that update and record the scene nodes in ranges
+	JobSystem m_jobs;
+	std::vector<WORKER_OUTPUT> m_workerOutputs;
 
 	// load texture images and convert to OpenGL texture data
-	bool CreateGLTexture(const char* filename, std::string tag);
-	// bind loaded OpenGL textures to slots in memory
-	void BindGLTextures();
+	bool CreateGLTexture(const char* filename, const std::string& tag);
+	// move textures that finished loading into their layers
+	void ProcessTextureUploads();
+	// load a texture again from a new or changed image file
+	void ReloadGLTexture(int textureHandle, const std::string& filename);
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
-	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
+	// find a loaded texture by tag - the ID is that of the
+	// array texture holding it
+	int FindTextureID(const std::string& tag) const;
+	int FindTextureSlot(const std::string& tag) const;
+	// register a material so it can be found by tag
+	int DefineMaterial(const OBJECT_MATERIAL& material);
 	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	int FindMaterialHandle(const std::string& tag) const;
+	bool FindMaterial(const std::string& tag, OBJECT_MATERIAL& material) const;
 
 	// set the transformation values 
 	// into the transform buffer
@@ -78,6 +298,104 @@ private:
 		float ZrotationDegrees,
 		glm::vec3 positionXYZ);
 
+	// build the model matrix from scale, rotation, translation
+	static glm::mat4 BuildModelMatrix(
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
+
+	// make a node's record from the current draw state
+	void MakeDrawRecord(const SCENE_NODE& node, DrawDataBuffer::DRAW_DATA& record) const;
+	// bind the array texture of a texture pool
+	void BindTexturePool(int pool);
+	// get the texture pool of a node, or -1 when untextured
+	int GetTexturePool(int textureHandle) const;
+
+	// replace the materials, lights and nodes with those of the
+	// scene file, keeping the textures that are still current
+	bool LoadSceneFile();
+
+	// add a node to the retained scene and return its index
+	int AddSceneNode(
+		int meshID,
+		int textureHandle,
+		int materialHandle,
+		glm::vec2 uvScale,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegrees,
+		glm::vec3 positionXYZ);
+	// change the transform of a scene node
+	void SetNodeTransform(
+		int nodeIndex,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegrees,
+		glm::vec3 positionXYZ);
+	// change the opacity of a scene node
+	void SetNodeOpacity(int nodeIndex, float opacity);
+	// rebuild the world matrices of all dirty scene nodes, and
+	// move their boxes in the hierarchy
+	void UpdateWorldMatrices();
+	// world-space box around the mesh of a node
+	void GetNodeBox(size_t nodeIndex, glm::vec3& boxMin, glm::vec3& boxMax) const;
+	// write the nodes at least partly inside a frustum, and
+	// return how many there are
+	size_t CollectVisibleNodes(const FrustumCuller& frustum, uint32_t* nodes);
+	// view distance of a node's bounds, as a fraction of the
+	// camera's far distance
+	float GetSortDepth(size_t nodeIndex) const;
+	// pick the level of detail of every node for the camera
+	void UpdateLevelsOfDetail();
+	// fill the render queue with one packet per visible
+	// transparent node, and per visible opaque node if asked
+	void BuildRenderQueue(bool bOpaque);
+	// end of the run of queued packets that share a draw call
+	size_t FindRunEnd(size_t first, size_t last, bool bDepthOnly) const;
+	// draw a range of the sorted render queue, changing state
+	// only at run boundaries
+	void SubmitRenderQueue(size_t first, size_t last, bool bDepthOnly);
+	// rebuild the indirect commands of every opaque node
+	void BuildIndirectDraws();
+	// draw the indirect commands, one call per texture pool
+	void SubmitIndirectDraws(bool bDepthOnly);
+	// draw the commands of the nodes that survived the GPU
+	// culling pass, one call per texture pool
+	void SubmitCulledIndirectDraws(bool bDepthOnly);
+	// draw the opaque nodes through the indirect commands or
+	// the first packets of the render queue
+	void SubmitOpaqueDraws(size_t packetCount, bool bDepthOnly);
+	// bake the static opaque nodes into merged meshes, one per
+	// texture, material and UV scale
+	void BuildStaticBatches();
+	// draw the static batches that touch a frustum, or all of
+	// them when pFrustum is NULL
+	void DrawStaticBatches(const FrustumCuller* pFrustum, bool bDepthOnly);
+	// render the shadow map layers that are out of date, then
+	// give the scene shader the shadow matrices
+	void RenderShadows();
+	// fit the shadow layers to the camera and the casters
+	void UpdateShadowLayout();
+	// bind the shadow maps and set their matrices into the
+	// scene shader
+	void BindShadowUniforms();
+	// bin the lights into the clusters of the current camera
+	void UpdateLights();
+	// draw the casters inside one shadow map layer
+	void RenderShadowLayer(int layer);
+	// fill m_drawRecords with the records of every queued
+	// packet
+	void RecordQueue();
+	// find the slot a texture has now from the slot it had in
+	// a capture
+	bool FindReplaySlot(const FrameCapture& capture, int pool, int layer, TextureArrays::ARRAY_SLOT& slot) const;
+	// finish a pass of a replayed frame
+	void EndReplayPass(uint32_t pass);
+	// clear the changed flags of the workers, and tell whether
+	// any worker set its flag
+	void ClearWorkerChanges();
+	bool HasWorkerChanges() const;
+
 	// set the color values into the shader
 	void SetShaderColor(
 		float redColorValue,
@@ -87,7 +405,9 @@ private:
 
 	// set the texture data into the shader
 	void SetShaderTexture(
-		std::string textureTag);
+		int textureHandle);
+	void SetShaderTexture(
+		const std::string& textureTag);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -95,7 +415,9 @@ private:
 
 	// set the object material into the shader
 	void SetShaderMaterial(
-		std::string materialTag);
+		int materialHandle);
+	void SetShaderMaterial(
+		const std::string& materialTag);
 
 public:
 
@@ -104,4 +426,63 @@ public:
 	void PrepareScene();
 	void RenderScene();
 
+	// choose the scene file that PrepareScene() loads
+	void SetSceneFile(const std::string& path) { m_scenePath = path; }
+	// watch the scene file and the texture images for changes
+	void WatchFiles(FileWatcher* pWatcher);
+	// reload the scene or the textures whose files changed
+	void OnFilesChanged(const std::vector<std::string>& paths);
+
+	// set the camera of the frame and its frustum, used for
+	// culling and for fitting the shadow cascades. The shaders
+	// read the same camera from the CameraBuffer.
+	void SetCamera(const CameraBuffer::CAMERA_DATA& camera, const FrustumCuller& frustum);
+	// turn frustum culling of scene nodes on or off
+	void SetFrustumCulling(bool bEnable) { m_bFrustumCulling = bEnable; }
+	// turn submission through multi-draw-indirect on or off,
+	// returning whether it is in use
+	bool SetMultiDrawIndirect(bool bEnable);
+	bool IsMultiDrawIndirect() const { return m_bMultiDrawIndirect; }
+	// turn the depth pre-pass of the opaque nodes on or off,
+	// returning whether it is in use
+	bool SetDepthPrePass(bool bEnable);
+	bool IsDepthPrePass() const { return m_bDepthPrePass; }
+	// choose the vertex format of the meshes, before the scene
+	// is prepared
+	void SetPackedVertices(bool bPacked) { m_basicMeshes->SetPackedVertices(bPacked); }
+	// turn the screen size based level of detail on or off
+	void SetLevelOfDetail(bool bEnable) { m_bLevelOfDetail = bEnable; }
+	// cull through the bounding volume hierarchy, or test the
+	// bounding sphere of every node
+	void SetSpatialIndex(bool bEnable) { m_bSpatialIndex = bEnable; }
+	// draw the static nodes from merged meshes baked in world
+	// space, or each node on its own
+	void SetStaticBatching(bool bEnable);
+	bool IsStaticBatching() const { return m_bStaticBatching; }
+
+	// copy the draws of every frame into a capture until
+	// EndCapture(), returning whether the recording started
+	bool BeginCapture(FrameCapture* pCapture, const std::string& path);
+	// close the capture, returning whether it was written
+	bool EndCapture();
+	bool IsCapturing() const { return NULL != m_pCapture; }
+	// draw a frame of a capture from its commands, after the
+	// camera of the frame is set
+	void ReplayFrame(const FrameCapture& capture, uint32_t frame);
+
+	// find the nearest node hit by a world-space ray, returning
+	// -1 when the ray misses every node
+	int PickNode(const glm::vec3& origin, const glm::vec3& direction, float& distance) const;
+
+	// add a point light that reaches radius units, returning
+	// its handle
+	int AddPointLight(const glm::vec3& position, const glm::vec3& color, float radius);
+	// move a point light
+	void SetPointLightPosition(int lightHandle, const glm::vec3& position);
+
+	// draw calls and triangles submitted by the last RenderScene()
+	const MeshManager::DRAW_STATS& GetDrawStats() const { return m_basicMeshes->GetDrawStats(); }
+	// true while texture images are still being loaded
+	bool IsLoadingTextures() { return !m_textureLoader.IsIdle(); }
+
 };
\ No newline at end of file
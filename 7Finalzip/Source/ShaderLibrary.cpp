@@ -0,0 +1,223 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderlibrary.cpp
+// ============
+// build the variants of the shader programs from preprocessor defines,
+// in the background and through the program binary cache
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderLibrary.h"
+#include "FileUtils.h"
+#include "ProgramCache.h"
+
+#include <iostream>
+
+/***********************************************************
+ *  ShaderLibrary()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderLibrary::ShaderLibrary()
+{
+	ShaderUtils::EnableParallelCompile();
+	m_bBinaryCache = ProgramCache::IsSupported();
+}
+
+/***********************************************************
+ *  ~ShaderLibrary()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderLibrary::~ShaderLibrary()
+{
+	for (size_t i = 0; i < m_variants.size(); i++)
+	{
+		ShaderUtils::CancelProgramBuild(m_variants[i].build);
+		if (0 != m_variants[i].program)
+			glDeleteProgram(m_variants[i].program);
+	}
+	m_variants.clear();
+}
+
+/***********************************************************
+ *  AddVariant()
+ *
+ *  Register a variant without building it
+ ***********************************************************/
+int ShaderLibrary::AddVariant(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
+{
+	for (size_t i = 0; i < m_variants.size(); i++)
+	{
+		const SHADER_VARIANT& existing = m_variants[i];
+		if ((existing.vertexPath == vertexPath) && (existing.fragmentPath == fragmentPath) &&
+			(existing.defines == defines))
+		{
+			return (int)i;
+		}
+	}
+
+	SHADER_VARIANT variant;
+	variant.vertexPath = vertexPath;
+	variant.fragmentPath = fragmentPath;
+	variant.defines = defines;
+	variant.program = 0;
+	variant.build.program = 0;
+	variant.build.vertexShader = 0;
+	variant.build.fragmentShader = 0;
+	variant.buildKey = 0;
+	variant.bFailed = false;
+	m_variants.push_back(variant);
+	return (int)m_variants.size() - 1;
+}
+
+/***********************************************************
+ *  Request()
+ *
+ *  Build a variant that has no program yet
+ ***********************************************************/
+void ShaderLibrary::Request(int variant)
+{
+	SHADER_VARIANT& requested = m_variants[variant];
+	if ((0 == requested.program) && (0 == requested.build.program) && !requested.bFailed)
+		StartBuild(requested);
+}
+
+/***********************************************************
+ *  GetProgram()
+ *
+ *  Get the program of a variant when it can be had without
+ *  waiting for the driver
+ ***********************************************************/
+GLuint ShaderLibrary::GetProgram(int variant)
+{
+	Request(variant);
+
+	SHADER_VARIANT& requested = m_variants[variant];
+	if ((0 != requested.build.program) && ShaderUtils::IsProgramBuildDone(requested.build))
+		FinishBuild(requested);
+	return requested.program;
+}
+
+/***********************************************************
+ *  WaitForProgram()
+ *
+ *  Get the program of a variant, finishing its build now
+ ***********************************************************/
+GLuint ShaderLibrary::WaitForProgram(int variant)
+{
+	Request(variant);
+
+	SHADER_VARIANT& requested = m_variants[variant];
+	if (0 != requested.build.program)
+		FinishBuild(requested);
+	return requested.program;
+}
+
+/***********************************************************
+ *  Rebuild()
+ *
+ *  Start a new build of a variant. A build that is still
+ *  running is dropped, since it was made from older files.
+ ***********************************************************/
+void ShaderLibrary::Rebuild(int variant)
+{
+	SHADER_VARIANT& rebuilt = m_variants[variant];
+	ShaderUtils::CancelProgramBuild(rebuilt.build);
+	rebuilt.bFailed = false;
+	StartBuild(rebuilt);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  Collect the builds that completed, without waiting for
+ *  the ones that are still compiling
+ ***********************************************************/
+bool ShaderLibrary::Update()
+{
+	bool bFinished = false;
+	for (size_t i = 0; i < m_variants.size(); i++)
+	{
+		SHADER_VARIANT& variant = m_variants[i];
+		if ((0 == variant.build.program) || !ShaderUtils::IsProgramBuildDone(variant.build))
+			continue;
+
+		FinishBuild(variant);
+		bFinished = true;
+	}
+	return bFinished;
+}
+
+/***********************************************************
+ *  StartBuild()
+ *
+ *  Read both files and put the defines in front of them. The
+ *  cache is keyed on the final sources, so every variant of
+ *  a file has a binary of its own.
+ ***********************************************************/
+void ShaderLibrary::StartBuild(SHADER_VARIANT& variant)
+{
+	std::string vertexSource;
+	std::string fragmentSource;
+	if (!FileUtils::ReadTextFile(variant.vertexPath, vertexSource) ||
+		!FileUtils::ReadTextFile(variant.fragmentPath, fragmentSource))
+	{
+		std::cout << "Could not read shaders " << variant.vertexPath << " and " << variant.fragmentPath << std::endl;
+		variant.bFailed = true;
+		return;
+	}
+	vertexSource = ShaderUtils::InsertDefines(vertexSource, variant.defines);
+	fragmentSource = ShaderUtils::InsertDefines(fragmentSource, variant.defines);
+
+	variant.buildKey = ProgramCache::MakeKey(vertexSource, fragmentSource);
+	if (m_bBinaryCache)
+	{
+		GLuint program = ProgramCache::Load(variant.buildKey);
+		if (0 != program)
+		{
+			SetProgram(variant, program);
+			return;
+		}
+	}
+
+	ShaderUtils::BeginSourceBuild(vertexSource, fragmentSource, variant.build);
+}
+
+/***********************************************************
+ *  FinishBuild()
+ *
+ *  Keep the program of a build that linked and save its
+ *  binary, or print why it failed
+ ***********************************************************/
+void ShaderLibrary::FinishBuild(SHADER_VARIANT& variant)
+{
+	GLuint program = ShaderUtils::FinishProgramBuild(variant.build);
+	if (0 == program)
+	{
+		variant.bFailed = true;
+		if (0 != variant.program)
+			std::cout << "Keeping the previous program of " << variant.vertexPath
+				<< " and " << variant.fragmentPath << std::endl;
+		else
+			std::cout << "Could not build " << variant.vertexPath << " and " << variant.fragmentPath << std::endl;
+		return;
+	}
+
+	if (m_bBinaryCache && !ProgramCache::Store(variant.buildKey, program))
+		std::cout << "Could not cache the program of " << variant.vertexPath << " and " << variant.fragmentPath << std::endl;
+	SetProgram(variant, program);
+}
+
+/***********************************************************
+ *  SetProgram()
+ *
+ *  Delete the old program of a variant once the new one is
+ *  in; a program that is still current is only freed by the
+ *  driver after it is replaced
+ ***********************************************************/
+void ShaderLibrary::SetProgram(SHADER_VARIANT& variant, GLuint program)
+{
+	if (0 != variant.program)
+		glDeleteProgram(variant.program);
+	variant.program = program;
+}
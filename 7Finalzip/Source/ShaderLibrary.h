@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderlibrary.h
+// ============
+// build the variants of the shader programs from preprocessor defines,
+// in the background and through the program binary cache
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderUtils.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ShaderLibrary
+ *
+ *  A variant is a pair of shader files together with a list
+ *  of defines put in front of both sources, so one file can
+ *  hold several programs behind #ifdef blocks. Variants are
+ *  only registered up front, and built when first asked for.
+ *
+ *  A build first looks for the binary of the same sources in
+ *  the ProgramCache; that is linked by the driver at once. A
+ *  miss starts a compile that runs on the driver's threads
+ *  when parallel shader compiles are supported, and Update()
+ *  or GetProgram() pick it up once it is done, saving its
+ *  binary for the next launch. WaitForProgram() is for the
+ *  programs that the first frame can not do without.
+ *
+ *  The library owns every program it built, and a failed
+ *  rebuild keeps the last good program of its variant.
+ ***********************************************************/
+class ShaderLibrary
+{
+public:
+	// constructor
+	ShaderLibrary();
+	// destructor
+	~ShaderLibrary();
+
+	// register the variant of two shader files with a space
+	// separated list of defines, returning its handle; the
+	// same files and defines give the same handle
+	int AddVariant(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+	// start building a variant, unless it is built or building
+	void Request(int variant);
+	// get the program of a variant, or 0 while it is built
+	GLuint GetProgram(int variant);
+	// get the program of a variant, waiting for its build
+	GLuint WaitForProgram(int variant);
+	// build a variant again from its files, keeping the current
+	// program until the new one is done
+	void Rebuild(int variant);
+	// take in the builds that finished, without waiting for the
+	// others, returning whether any finished
+	bool Update();
+
+	// files a variant is built from
+	const std::string& GetVertexPath(int variant) const { return m_variants[variant].vertexPath; }
+	const std::string& GetFragmentPath(int variant) const { return m_variants[variant].fragmentPath; }
+
+private:
+	struct SHADER_VARIANT
+	{
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::string defines;
+		// last good program, 0 until the first build is done
+		GLuint program;
+		// build in progress, program 0 when there is none, and
+		// the cache key of its sources
+		ShaderUtils::PROGRAM_BUILD build;
+		uint64_t buildKey;
+		// set when the last build failed, so that it is not
+		// tried again until the files change
+		bool bFailed;
+	};
+
+	std::vector<SHADER_VARIANT> m_variants;
+	// whether the driver can save program binaries
+	bool m_bBinaryCache;
+
+	// load a variant from the cache, or start compiling it
+	void StartBuild(SHADER_VARIANT& variant);
+	// check the result of a build and keep its program
+	void FinishBuild(SHADER_VARIANT& variant);
+	// replace the program of a variant
+	void SetProgram(SHADER_VARIANT& variant, GLuint program);
+};
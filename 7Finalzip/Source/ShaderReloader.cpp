@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderreloader.cpp
+// ============
+// rebuild shader programs when their files change and swap them in
+// once they compiled
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderReloader.h"
+
+#include <iostream>
+
+/***********************************************************
+ *  ShaderReloader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderReloader::ShaderReloader(ShaderLibrary* pLibrary)
+{
+	m_pLibrary = pLibrary;
+}
+
+/***********************************************************
+ *  AddProgram()
+ *
+ *  Register the variant that a program was built from
+ ***********************************************************/
+void ShaderReloader::AddProgram(
+	ShaderManager* pShaderManager,
+	int variant,
+	UniformCache* pUniforms)
+{
+	WATCHED_PROGRAM watched;
+	watched.pShaderManager = pShaderManager;
+	watched.variant = variant;
+	watched.pUniforms = pUniforms;
+	m_programs.push_back(watched);
+}
+
+/***********************************************************
+ *  GetWatchedFiles()
+ *
+ *  Append the shader files of every registered program
+ ***********************************************************/
+void ShaderReloader::GetWatchedFiles(std::vector<std::string>& paths) const
+{
+	for (size_t i = 0; i < m_programs.size(); i++)
+	{
+		paths.push_back(m_pLibrary->GetVertexPath(m_programs[i].variant));
+		paths.push_back(m_pLibrary->GetFragmentPath(m_programs[i].variant));
+	}
+}
+
+/***********************************************************
+ *  OnFilesChanged()
+ *
+ *  Start a build of every program using a changed file
+ ***********************************************************/
+void ShaderReloader::OnFilesChanged(const std::vector<std::string>& paths)
+{
+	for (size_t i = 0; i < m_programs.size(); i++)
+	{
+		const WATCHED_PROGRAM& watched = m_programs[i];
+		bool bChanged = false;
+		for (size_t p = 0; p < paths.size(); p++)
+		{
+			if ((paths[p] == m_pLibrary->GetVertexPath(watched.variant)) ||
+				(paths[p] == m_pLibrary->GetFragmentPath(watched.variant)))
+			{
+				bChanged = true;
+			}
+		}
+		if (bChanged)
+			m_pLibrary->Rebuild(watched.variant);
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  Collect the builds that completed, without waiting for
+ *  the ones that are still compiling, and swap in the new
+ *  programs
+ ***********************************************************/
+bool ShaderReloader::Update()
+{
+	bool bFinished = m_pLibrary->Update();
+	for (size_t i = 0; i < m_programs.size(); i++)
+	{
+		WATCHED_PROGRAM& watched = m_programs[i];
+		GLuint program = m_pLibrary->GetProgram(watched.variant);
+		if ((0 == program) || (program == watched.pShaderManager->m_programID))
+			continue;
+
+		SwapProgram(watched, program);
+		std::cout << "Reloaded " << m_pLibrary->GetVertexPath(watched.variant)
+			<< " and " << m_pLibrary->GetFragmentPath(watched.variant) << std::endl;
+	}
+	return bFinished;
+}
+
+/***********************************************************
+ *  SwapProgram()
+ *
+ *  Point the ShaderManager at the new program, keeping the
+ *  current program binding. The library already deleted the
+ *  old program.
+ ***********************************************************/
+void ShaderReloader::SwapProgram(WATCHED_PROGRAM& watched, GLuint program)
+{
+	GLuint oldProgram = watched.pShaderManager->m_programID;
+	watched.pShaderManager->m_programID = program;
+
+	GLint currentProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+
+	// the cached values are sent with the new program current
+	glUseProgram(program);
+	if ((NULL != watched.pUniforms) && (watched.pUniforms->GetProgram() == oldProgram))
+		watched.pUniforms->Reattach(program);
+
+	if ((GLuint)currentProgram != oldProgram)
+		glUseProgram((GLuint)currentProgram);
+}
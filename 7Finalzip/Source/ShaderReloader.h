@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderreloader.h
+// ============
+// rebuild shader programs when their files change and swap them in
+// once they compiled
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderLibrary.h"
+#include "ShaderManager.h"
+#include "UniformCache.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ShaderReloader
+ *
+ *  When a file of a registered program changes, its variant
+ *  is rebuilt by the ShaderLibrary next to the program in
+ *  use. With parallel shader compiles the driver builds it
+ *  on its own threads, and Update() only checks whether it
+ *  is done, so the frames keep coming meanwhile. A program
+ *  that built is swapped into its ShaderManager between two
+ *  frames; one that failed is dropped by the library with
+ *  its log printed, and the last good program stays in use.
+ ***********************************************************/
+class ShaderReloader
+{
+public:
+	// constructor
+	ShaderReloader(ShaderLibrary* pLibrary);
+
+	// rebuild the variant that a ShaderManager uses when one of
+	// its files changes, carrying the values of a uniform cache
+	// attached to it over to the new program
+	void AddProgram(
+		ShaderManager* pShaderManager,
+		int variant,
+		UniformCache* pUniforms = NULL);
+	// get every file that the programs are built from
+	void GetWatchedFiles(std::vector<std::string>& paths) const;
+
+	// start rebuilding the programs that use a changed file
+	void OnFilesChanged(const std::vector<std::string>& paths);
+	// swap in the programs that finished building, returning
+	// whether any build finished
+	bool Update();
+
+private:
+	struct WATCHED_PROGRAM
+	{
+		ShaderManager* pShaderManager;
+		int variant;
+		UniformCache* pUniforms;
+	};
+
+	// library that builds and owns the programs
+	ShaderLibrary* m_pLibrary;
+	std::vector<WATCHED_PROGRAM> m_programs;
+
+	// point a ShaderManager at the new program of its variant
+	void SwapProgram(WATCHED_PROGRAM& watched, GLuint program);
+};
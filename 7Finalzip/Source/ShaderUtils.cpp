@@ -0,0 +1,253 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderutils.cpp
+// ============
+// build shader programs that ShaderManager does not cover
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderUtils.h"
+#include "FileUtils.h"
+
+#include <iostream>
+#include <string>
+
+/***********************************************************
+ *  CreateComputeProgram()
+ *
+ *  Compile a compute shader file into a program, printing
+ *  the log when it fails
+ ***********************************************************/
+GLuint ShaderUtils::CreateComputeProgram(const char* path)
+{
+	std::string source;
+	if (!FileUtils::ReadTextFile(path, source))
+	{
+		std::cout << "Could not read compute shader " << path << std::endl;
+		return 0;
+	}
+
+	const char* text = source.c_str();
+	GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shader, 1, &text, NULL);
+	glCompileShader(shader);
+
+	GLint status = GL_FALSE;
+	char log[1024];
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (GL_TRUE != status)
+	{
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		std::cout << "Compute shader " << path << " failed to compile:\n" << log << std::endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, shader);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (GL_TRUE != status)
+	{
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		std::cout << "Compute shader " << path << " failed to link:\n" << log << std::endl;
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+/***********************************************************
+ *  EnableParallelCompile()
+ *
+ *  Ask the driver to use as many compiler threads as it
+ *  likes, so that compiles run beside the render thread
+ ***********************************************************/
+void ShaderUtils::EnableParallelCompile()
+{
+	if (GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	else if (GLEW_ARB_parallel_shader_compile)
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+}
+
+/***********************************************************
+ *  InsertDefines()
+ *
+ *  Each define goes on a line of its own right after the
+ *  #version line, which has to stay the first statement
+ ***********************************************************/
+std::string ShaderUtils::InsertDefines(const std::string& source, const std::string& defines)
+{
+	std::string lines;
+	size_t start = 0;
+	while (start < defines.size())
+	{
+		size_t end = defines.find(' ', start);
+		if (std::string::npos == end)
+			end = defines.size();
+		if (end > start)
+		{
+			std::string define = defines.substr(start, end - start);
+			size_t equals = define.find('=');
+			if (std::string::npos != equals)
+				define[equals] = ' ';
+			lines += "#define " + define + "\n";
+		}
+		start = end + 1;
+	}
+	if (lines.empty())
+		return source;
+
+	size_t insertAt = 0;
+	size_t version = source.find("#version");
+	if (std::string::npos != version)
+	{
+		size_t lineEnd = source.find('\n', version);
+		insertAt = (std::string::npos == lineEnd) ? source.size() : lineEnd + 1;
+	}
+
+	std::string result = source.substr(0, insertAt);
+	if (!result.empty() && ('\n' != result[result.size() - 1]))
+		result += '\n';
+	result += lines;
+	result += source.substr(insertAt);
+	return result;
+}
+
+/***********************************************************
+ *  BeginProgramBuild()
+ *
+ *  Submit the compile and link of a program. Nothing is
+ *  queried here, since any status query would wait for the
+ *  driver to finish.
+ ***********************************************************/
+bool ShaderUtils::BeginProgramBuild(const char* vertexPath, const char* fragmentPath, PROGRAM_BUILD& build)
+{
+	build.program = 0;
+	build.vertexShader = 0;
+	build.fragmentShader = 0;
+
+	std::string vertexSource;
+	std::string fragmentSource;
+	if (!FileUtils::ReadTextFile(vertexPath, vertexSource) ||
+		!FileUtils::ReadTextFile(fragmentPath, fragmentSource))
+	{
+		std::cout << "Could not read shaders " << vertexPath << " and " << fragmentPath << std::endl;
+		return false;
+	}
+
+	BeginSourceBuild(vertexSource, fragmentSource, build);
+	return true;
+}
+
+/***********************************************************
+ *  BeginSourceBuild()
+ *
+ *  Submit the compile and link of two sources, asking the
+ *  driver to keep the linked binary retrievable
+ ***********************************************************/
+void ShaderUtils::BeginSourceBuild(const std::string& vertexSource, const std::string& fragmentSource, PROGRAM_BUILD& build)
+{
+	const char* text = vertexSource.c_str();
+	build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(build.vertexShader, 1, &text, NULL);
+	glCompileShader(build.vertexShader);
+
+	text = fragmentSource.c_str();
+	build.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(build.fragmentShader, 1, &text, NULL);
+	glCompileShader(build.fragmentShader);
+
+	build.program = glCreateProgram();
+	glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(build.program, build.vertexShader);
+	glAttachShader(build.program, build.fragmentShader);
+	glLinkProgram(build.program);
+}
+
+/***********************************************************
+ *  IsProgramBuildDone()
+ *
+ *  Without parallel compiles the driver finishes the build
+ *  whenever it is asked, so it always counts as done
+ ***********************************************************/
+bool ShaderUtils::IsProgramBuildDone(const PROGRAM_BUILD& build)
+{
+	if (0 == build.program)
+		return true;
+	if (!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile)
+		return true;
+
+	GLint bDone = GL_FALSE;
+	glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &bDone);
+	return GL_FALSE != bDone;
+}
+
+/***********************************************************
+ *  FinishProgramBuild()
+ *
+ *  Check the compile and link results, printing the log of
+ *  whichever step failed
+ ***********************************************************/
+GLuint ShaderUtils::FinishProgramBuild(PROGRAM_BUILD& build)
+{
+	if (0 == build.program)
+		return 0;
+
+	GLint status = GL_FALSE;
+	char log[1024];
+	bool bCompiled = true;
+	const GLuint shaders[2] = { build.vertexShader, build.fragmentShader };
+	for (int i = 0; i < 2; i++)
+	{
+		glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &status);
+		if (GL_TRUE != status)
+		{
+			glGetShaderInfoLog(shaders[i], sizeof(log), NULL, log);
+			std::cout << ((0 == i) ? "Vertex" : "Fragment") << " shader failed to compile:\n" << log << std::endl;
+			bCompiled = false;
+		}
+	}
+
+	GLuint program = build.program;
+	if (bCompiled)
+	{
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		if (GL_TRUE != status)
+		{
+			glGetProgramInfoLog(program, sizeof(log), NULL, log);
+			std::cout << "Shader program failed to link:\n" << log << std::endl;
+			bCompiled = false;
+		}
+	}
+
+	if (!bCompiled)
+	{
+		glDeleteProgram(program);
+		program = 0;
+	}
+	build.program = 0;
+	CancelProgramBuild(build);
+	return program;
+}
+
+/***********************************************************
+ *  CancelProgramBuild()
+ *
+ *  Free the shaders and the program of a build
+ ***********************************************************/
+void ShaderUtils::CancelProgramBuild(PROGRAM_BUILD& build)
+{
+	if (0 != build.program)
+		glDeleteProgram(build.program);
+	if (0 != build.vertexShader)
+		glDeleteShader(build.vertexShader);
+	if (0 != build.fragmentShader)
+		glDeleteShader(build.fragmentShader);
+	build.program = 0;
+	build.vertexShader = 0;
+	build.fragmentShader = 0;
+}
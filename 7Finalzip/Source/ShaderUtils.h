@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderutils.h
+// ============
+// build shader programs that ShaderManager does not cover
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+
+namespace ShaderUtils
+{
+	// a vertex and fragment program whose compile and link may
+	// still be running in the driver
+	struct PROGRAM_BUILD
+	{
+		GLuint program;
+		GLuint vertexShader;
+		GLuint fragmentShader;
+	};
+
+	// compile and link a compute shader file into a program,
+	// printing the log and returning 0 when it fails
+	GLuint CreateComputeProgram(const char* path);
+
+	// let the driver compile shaders on its own threads, when
+	// it supports that
+	void EnableParallelCompile();
+	// put a #define line after the #version line of a source
+	// for each name in a space separated list, where NAME=VALUE
+	// gives the name a value
+	std::string InsertDefines(const std::string& source, const std::string& defines);
+	// read two shader files and start compiling and linking them
+	// without waiting for the result
+	bool BeginProgramBuild(const char* vertexPath, const char* fragmentPath, PROGRAM_BUILD& build);
+	// the same from sources already in memory; the program can
+	// be saved with glGetProgramBinary once it linked
+	void BeginSourceBuild(const std::string& vertexSource, const std::string& fragmentSource, PROGRAM_BUILD& build);
+	// true when the result of a build can be read without a stall
+	bool IsProgramBuildDone(const PROGRAM_BUILD& build);
+	// finish a build, printing the log and returning 0 when it
+	// failed - the program belongs to the caller either way
+	GLuint FinishProgramBuild(PROGRAM_BUILD& build);
+	// drop a build that is no longer wanted
+	void CancelProgramBuild(PROGRAM_BUILD& build);
+}
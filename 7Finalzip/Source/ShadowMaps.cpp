@@ -0,0 +1,386 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.cpp
+// ============
+// cascaded and cached shadow maps for the scene lights
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadowMaps.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// the cascades cover the camera frustum up to this distance
+	const float g_ShadowDistance = 40.0f;
+	// blend between uniform and logarithmic cascade splits
+	const float g_SplitLambda = 0.75f;
+	// cascade centers snap to this fraction of their radius
+	const float g_SnapFraction = 0.25f;
+	// field of view and near plane of the perspective map
+	const float g_SpotFieldOfView = 120.0f;
+	const float g_SpotNearPlane = 0.5f;
+}
+
+/***********************************************************
+ *  ShadowMaps()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadowMaps::ShadowMaps()
+{
+	m_programID = 0;
+	m_lightMatrixLocation = -1;
+	m_texture = 0;
+	m_framebuffer = 0;
+	m_resolution = 0;
+	m_savedFramebuffer = 0;
+	m_savedProgram = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		m_savedViewport[i] = 0;
+	}
+	for (int i = 0; i <= CASCADED_LIGHTS; i++)
+	{
+		m_lightPositions[i] = glm::vec3(0.0f, 10.0f, 0.0f);
+	}
+	for (int i = 0; i < LAYER_COUNT; i++)
+	{
+		m_matrices[i] = glm::mat4(1.0f);
+		m_bLayerDirty[i] = true;
+		m_bLayerValid[i] = false;
+	}
+	m_cascadeSplits = glm::vec4(0.0f);
+}
+
+/***********************************************************
+ *  ~ShadowMaps()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadowMaps::~ShadowMaps()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  Create the depth array with hardware comparison, a depth
+ *  only framebuffer and the depth-only shader program
+ ***********************************************************/
+bool ShadowMaps::Initialize(int resolution, ShaderLibrary* pLibrary)
+{
+	if (0 != m_texture)
+		return true;
+
+	// the first frame draws the shadows, so the program is
+	// waited for
+	m_programID = pLibrary->WaitForProgram(pLibrary->AddVariant(
+		"Shaders/depthVertexShader.glsl",
+		"Shaders/shadowFragmentShader.glsl",
+		"SHADOW_PASS"));
+	m_lightMatrixLocation = glGetUniformLocation(m_programID, "lightViewProjection");
+
+	if (0 == m_programID)
+	{
+		Destroy();
+		return false;
+	}
+
+	glGenTextures(1, &m_texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, resolution, resolution, LAYER_COUNT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	// outside a map nothing is in shadow
+	const GLfloat border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (GL_FRAMEBUFFER_COMPLETE != status)
+	{
+		std::cout << "Shadow framebuffer is not complete, status:" << status << std::endl;
+		Destroy();
+		return false;
+	}
+
+	m_resolution = resolution;
+	for (int i = 0; i < LAYER_COUNT; i++)
+	{
+		m_bLayerDirty[i] = true;
+		m_bLayerValid[i] = false;
+	}
+	return true;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  Free the texture and framebuffer; the program belongs to
+ *  the shader library
+ ***********************************************************/
+void ShadowMaps::Destroy()
+{
+	if (0 != m_framebuffer)
+		glDeleteFramebuffers(1, &m_framebuffer);
+	if (0 != m_texture)
+		glDeleteTextures(1, &m_texture);
+	m_framebuffer = 0;
+	m_texture = 0;
+	m_programID = 0;
+	m_resolution = 0;
+}
+
+/***********************************************************
+ *  SetLightPosition()
+ *
+ *  Set the position of one of the shadowed lights
+ ***********************************************************/
+void ShadowMaps::SetLightPosition(int light, const glm::vec3& position)
+{
+	if ((light < 0) || (light > CASCADED_LIGHTS))
+		return;
+
+	if (!(m_lightPositions[light] == position))
+	{
+		m_lightPositions[light] = position;
+		// the matrices are compared on the next Update()
+		for (int i = 0; i < LAYER_COUNT; i++)
+		{
+			m_bLayerValid[i] = false;
+		}
+	}
+}
+
+/***********************************************************
+ *  SetLayerMatrix()
+ *
+ *  Store the matrix of a layer, which has to be rendered
+ *  again whenever the matrix differs from the last one
+ ***********************************************************/
+void ShadowMaps::SetLayerMatrix(int layer, const glm::mat4& matrix)
+{
+	if (!m_bLayerValid[layer] || (0 != memcmp(&m_matrices[layer][0][0], &matrix[0][0], sizeof(glm::mat4))))
+	{
+		m_matrices[layer] = matrix;
+		m_bLayerDirty[layer] = true;
+		m_bLayerValid[layer] = true;
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  Split the camera frustum into cascades and fit a stable
+ *  light-space box around each slice, then aim the map of
+ *  the last light at the scene
+ ***********************************************************/
+void ShadowMaps::Update(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& sceneMin,
+	const glm::vec3& sceneMax,
+	bool bCastersMoved)
+{
+	for (int i = 0; i < LAYER_COUNT; i++)
+	{
+		m_bLayerDirty[i] = bCastersMoved || !m_bLayerValid[i];
+	}
+
+	// corners of the camera frustum on its near and far planes
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	glm::vec3 nearCorners[4];
+	glm::vec3 farCorners[4];
+	for (int i = 0; i < 4; i++)
+	{
+		float x = (i & 1) ? 1.0f : -1.0f;
+		float y = (i & 2) ? 1.0f : -1.0f;
+		glm::vec4 nearCorner = inverseViewProjection * glm::vec4(x, y, -1.0f, 1.0f);
+		glm::vec4 farCorner = inverseViewProjection * glm::vec4(x, y, 1.0f, 1.0f);
+		nearCorners[i] = glm::vec3(nearCorner) / nearCorner.w;
+		farCorners[i] = glm::vec3(farCorner) / farCorner.w;
+	}
+	float nearDepth = -(view * glm::vec4(nearCorners[0], 1.0f)).z;
+	float farDepth = -(view * glm::vec4(farCorners[0], 1.0f)).z;
+	float shadowDepth = std::min(farDepth, g_ShadowDistance);
+	if ((nearDepth <= 0.0f) || (shadowDepth <= nearDepth))
+		return;
+
+	// practical split scheme between uniform and logarithmic
+	float splits[CASCADE_COUNT];
+	for (int i = 0; i < CASCADE_COUNT; i++)
+	{
+		float fraction = (float)(i + 1) / CASCADE_COUNT;
+		float uniform = nearDepth + (shadowDepth - nearDepth) * fraction;
+		float logarithmic = nearDepth * powf(shadowDepth / nearDepth, fraction);
+		splits[i] = uniform + (logarithmic - uniform) * g_SplitLambda;
+	}
+	m_cascadeSplits = glm::vec4(splits[0], splits[1], splits[2], shadowDepth);
+
+	glm::vec3 sceneCenter = (sceneMin + sceneMax) * 0.5f;
+	for (int cascade = 0; cascade < CASCADE_COUNT; cascade++)
+	{
+		// the slice of the camera frustum covered by the cascade
+		float startDepth = (0 == cascade) ? nearDepth : splits[cascade - 1];
+		float endDepth = splits[cascade];
+		float start = (startDepth - nearDepth) / (farDepth - nearDepth);
+		float end = (endDepth - nearDepth) / (farDepth - nearDepth);
+
+		glm::vec3 corners[8];
+		glm::vec3 center(0.0f);
+		for (int i = 0; i < 4; i++)
+		{
+			glm::vec3 ray = farCorners[i] - nearCorners[i];
+			corners[i] = nearCorners[i] + ray * start;
+			corners[i + 4] = nearCorners[i] + ray * end;
+			center += corners[i] + corners[i + 4];
+		}
+		center /= 8.0f;
+
+		// a sphere does not change size as the camera turns
+		float radius = 0.0f;
+		for (int i = 0; i < 8; i++)
+		{
+			radius = std::max(radius, glm::length(corners[i] - center));
+		}
+		radius = ceilf(radius * 16.0f) / 16.0f;
+		float grid = radius * g_SnapFraction;
+		// grow the box so that it still covers the slice after
+		// the center has snapped by up to half a grid cell
+		float halfSize = radius + grid * 0.7072f;
+
+		for (int light = 0; light < CASCADED_LIGHTS; light++)
+		{
+			glm::vec3 direction = glm::normalize(sceneCenter - m_lightPositions[light]);
+			glm::vec3 up = (fabsf(direction.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+			glm::vec3 lightCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+			lightCenter.x = floorf(lightCenter.x / grid + 0.5f) * grid;
+			lightCenter.y = floorf(lightCenter.y / grid + 0.5f) * grid;
+
+			// reach every caster of the scene along the light
+			float minimumZ = 0.0f;
+			float maximumZ = 0.0f;
+			for (int i = 0; i < 8; i++)
+			{
+				glm::vec3 corner((i & 1) ? sceneMax.x : sceneMin.x,
+					(i & 2) ? sceneMax.y : sceneMin.y,
+					(i & 4) ? sceneMax.z : sceneMin.z);
+				float z = (lightRotation * glm::vec4(corner, 1.0f)).z;
+				minimumZ = (0 == i) ? z : std::min(minimumZ, z);
+				maximumZ = (0 == i) ? z : std::max(maximumZ, z);
+			}
+
+			glm::mat4 lightProjection = glm::ortho(
+				lightCenter.x - halfSize, lightCenter.x + halfSize,
+				lightCenter.y - halfSize, lightCenter.y + halfSize,
+				-maximumZ - 1.0f, -minimumZ + 1.0f);
+			SetLayerMatrix(light * CASCADE_COUNT + cascade, lightProjection * lightRotation);
+		}
+	}
+
+	// the last light is close to the scene, so it is treated as
+	// a spot light looking at the scene center
+	const glm::vec3& spotPosition = m_lightPositions[CASCADED_LIGHTS];
+	float farPlane = glm::length(sceneMax - sceneMin) + glm::length(spotPosition - sceneCenter);
+	glm::vec3 spotDirection = glm::normalize(sceneCenter - spotPosition);
+	glm::vec3 spotUp = (fabsf(spotDirection.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 spotMatrix =
+		glm::perspective(glm::radians(g_SpotFieldOfView), 1.0f, g_SpotNearPlane, farPlane) *
+		glm::lookAt(spotPosition, sceneCenter, spotUp);
+	SetLayerMatrix(LAYER_COUNT - 1, spotMatrix);
+}
+
+/***********************************************************
+ *  IsAnyLayerDirty()
+ *
+ *  True when at least one layer has to be rendered
+ ***********************************************************/
+bool ShadowMaps::IsAnyLayerDirty() const
+{
+	for (int i = 0; i < LAYER_COUNT; i++)
+	{
+		if (m_bLayerDirty[i])
+			return true;
+	}
+	return false;
+}
+
+/***********************************************************
+ *  BeginPass()
+ *
+ *  Save the state the shadow pass changes and switch to the
+ *  depth-only program
+ ***********************************************************/
+void ShadowMaps::BeginPass()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &m_savedProgram);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_resolution, m_resolution);
+	glUseProgram(m_programID);
+
+	// slope scaled bias against shadow acne
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+}
+
+/***********************************************************
+ *  BeginLayer()
+ *
+ *  Attach a layer, clear it and set its light matrix
+ ***********************************************************/
+void ShadowMaps::BeginLayer(int layer)
+{
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0, layer);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glUniformMatrix4fv(m_lightMatrixLocation, 1, GL_FALSE, &m_matrices[layer][0][0]);
+	m_bLayerDirty[layer] = false;
+}
+
+/***********************************************************
+ *  EndPass()
+ *
+ *  Restore the framebuffer, viewport and program
+ ***********************************************************/
+void ShadowMaps::EndPass()
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glUseProgram((GLuint)m_savedProgram);
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  Bind the depth array for sampling by the scene shader
+ ***********************************************************/
+void ShadowMaps::BindTexture() const
+{
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+	glActiveTexture(GL_TEXTURE0);
+}
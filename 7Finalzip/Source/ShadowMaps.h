@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.h
+// ============
+// cascaded and cached shadow maps for the scene lights
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderLibrary.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  ShadowMaps
+ *
+ *  This class owns one depth array texture holding every
+ *  shadow map of the scene:
+ *    layers 0-2  cascades of light 0
+ *    layers 3-5  cascades of light 1
+ *    layer  6    perspective map of light 2
+ *
+ *  Lights 0 and 1 sit high above the scene and are treated
+ *  as directional lights, with CASCADE_COUNT cascades fitted
+ *  to slices of the camera frustum. A cascade is a sphere
+ *  snapped to a coarse grid in light space, so it keeps the
+ *  same matrix while the camera moves within a grid cell.
+ *  Light 2 is low and close, and gets one perspective map
+ *  aimed at the scene.
+ *
+ *  A layer is only rendered again when its matrix changes or
+ *  a caster moved, so a static scene seen from a still
+ *  camera costs no shadow draws at all.
+ ***********************************************************/
+class ShadowMaps
+{
+public:
+	// constructor
+	ShadowMaps();
+	// destructor
+	~ShadowMaps();
+
+	static const int CASCADE_COUNT = 3;
+	static const int CASCADED_LIGHTS = 2;
+	static const int LAYER_COUNT = CASCADE_COUNT * CASCADED_LIGHTS + 1;
+	// texture unit the array is sampled from
+	static const int TEXTURE_UNIT = 1;
+
+	// create the depth array and get the shadow variant of the
+	// depth-only shaders from a library
+	bool Initialize(int resolution, ShaderLibrary* pLibrary);
+	// free the texture and framebuffer
+	void Destroy();
+	bool IsReady() const { return 0 != m_texture; }
+
+	// set where a light is, in the order of lightSources[]
+	void SetLightPosition(int light, const glm::vec3& position);
+
+	// fit the layers to the camera and to the bounds of the
+	// shadow casters, marking the layers that need rendering.
+	// bCastersMoved marks every layer.
+	void Update(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& sceneMin,
+		const glm::vec3& sceneMax,
+		bool bCastersMoved);
+	// true when a layer has to be rendered this frame
+	bool IsLayerDirty(int layer) const { return m_bLayerDirty[layer]; }
+	bool IsAnyLayerDirty() const;
+
+	// start rendering shadow maps, saving the bound framebuffer,
+	// viewport and program
+	void BeginPass();
+	// render into one layer, clearing it
+	void BeginLayer(int layer);
+	// restore the state saved by BeginPass()
+	void EndPass();
+
+	// world to shadow map clip space of a layer
+	const glm::mat4& GetMatrix(int layer) const { return m_matrices[layer]; }
+	// view-space distances where the cascades end
+	const glm::vec4& GetCascadeSplits() const { return m_cascadeSplits; }
+	// bind the depth array to TEXTURE_UNIT
+	void BindTexture() const;
+
+private:
+	// program owned by the shader library
+	GLuint m_programID;
+	GLint m_lightMatrixLocation;
+	GLuint m_texture;
+	GLuint m_framebuffer;
+	int m_resolution;
+
+	glm::vec3 m_lightPositions[CASCADED_LIGHTS + 1];
+	glm::mat4 m_matrices[LAYER_COUNT];
+	bool m_bLayerDirty[LAYER_COUNT];
+	bool m_bLayerValid[LAYER_COUNT];
+	glm::vec4 m_cascadeSplits;
+
+	// state saved by BeginPass()
+	GLint m_savedFramebuffer;
+	GLint m_savedViewport[4];
+	GLint m_savedProgram;
+
+	// set a layer's matrix, marking it dirty when it changed
+	void SetLayerMatrix(int layer, const glm::mat4& matrix);
+};
@@ -0,0 +1,217 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearrays.cpp
+// ============
+// pack textures into 2D array textures grouped by size and format, so
+// that any number of textures can be used without a unit per texture
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureArrays.h"
+
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// layers a new pool is created with
+	const int g_InitialCapacity = 4;
+}
+
+/***********************************************************
+ *  TextureArrays()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureArrays::TextureArrays()
+{
+	m_maxLayers = 0;
+}
+
+/***********************************************************
+ *  ~TextureArrays()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureArrays::~TextureArrays()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  GetFullMipCount()
+ *
+ *  Get the number of levels down to 1x1 for an image size
+ ***********************************************************/
+GLsizei TextureArrays::GetFullMipCount(GLsizei width, GLsizei height)
+{
+	GLsizei levels = 1;
+	GLsizei size = std::max(width, height);
+	while (size > 1)
+	{
+		size /= 2;
+		levels++;
+	}
+	return levels;
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  Find a pool with a matching shape and a free layer, and
+ *  reserve that layer for a new texture
+ ***********************************************************/
+bool TextureArrays::Allocate(
+	GLsizei width,
+	GLsizei height,
+	GLenum internalFormat,
+	GLsizei levels,
+	ARRAY_SLOT& slot)
+{
+	if ((width <= 0) || (height <= 0) || (levels <= 0))
+		return false;
+
+	if (0 == m_maxLayers)
+	{
+		GLint maxLayers = 0;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+		// OpenGL guarantees at least 256 layers
+		m_maxLayers = std::max(maxLayers, 256);
+	}
+
+	for (size_t i = 0; i < m_pools.size(); i++)
+	{
+		TEXTURE_POOL& pool = m_pools[i];
+		if ((pool.width != width) || (pool.height != height) ||
+			(pool.internalFormat != internalFormat) || (pool.levels != levels))
+			continue;
+
+		if (!pool.freeLayers.empty())
+		{
+			slot.pool = (int)i;
+			slot.layer = pool.freeLayers.back();
+			pool.freeLayers.pop_back();
+			return true;
+		}
+
+		if ((pool.layerCount == pool.capacity) && !Grow(pool))
+			continue;
+
+		slot.pool = (int)i;
+		slot.layer = pool.layerCount++;
+		return true;
+	}
+
+	// no pool of this shape has room, so start a new one
+	TEXTURE_POOL pool;
+	pool.width = width;
+	pool.height = height;
+	pool.internalFormat = internalFormat;
+	pool.levels = levels;
+	pool.capacity = std::min(g_InitialCapacity, m_maxLayers);
+	pool.layerCount = 0;
+	pool.textureID = CreateStorage(pool, pool.capacity);
+	if (0 == pool.textureID)
+		return false;
+
+	m_pools.push_back(pool);
+	slot.pool = (int)m_pools.size() - 1;
+	slot.layer = m_pools.back().layerCount++;
+	return true;
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  Mark a layer as free. Its contents stay until the layer
+ *  is handed out again.
+ ***********************************************************/
+void TextureArrays::Release(const ARRAY_SLOT& slot)
+{
+	if ((slot.pool < 0) || (slot.pool >= (int)m_pools.size()))
+		return;
+
+	TEXTURE_POOL& pool = m_pools[slot.pool];
+	if ((slot.layer >= 0) && (slot.layer < pool.layerCount))
+		pool.freeLayers.push_back(slot.layer);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  Free the array textures of all pools
+ ***********************************************************/
+void TextureArrays::Destroy()
+{
+	for (size_t i = 0; i < m_pools.size(); i++)
+	{
+		glDeleteTextures(1, &m_pools[i].textureID);
+	}
+	m_pools.clear();
+}
+
+/***********************************************************
+ *  GetTexture()
+ *
+ *  Get the OpenGL array texture of a pool
+ ***********************************************************/
+GLuint TextureArrays::GetTexture(int pool) const
+{
+	if ((pool < 0) || (pool >= (int)m_pools.size()))
+		return 0;
+	return m_pools[pool].textureID;
+}
+
+/***********************************************************
+ *  CreateStorage()
+ *
+ *  Create immutable array storage for a pool, set up for
+ *  repeating, mipmapped sampling
+ ***********************************************************/
+GLuint TextureArrays::CreateStorage(const TEXTURE_POOL& pool, int capacity)
+{
+	GLuint textureID = 0;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, pool.levels, pool.internalFormat, pool.width, pool.height, capacity);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+		(pool.levels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	return textureID;
+}
+
+/***********************************************************
+ *  Grow()
+ *
+ *  Move a full pool into storage with twice the layers
+ ***********************************************************/
+bool TextureArrays::Grow(TEXTURE_POOL& pool)
+{
+	if (pool.capacity >= m_maxLayers)
+		return false;
+
+	int capacity = std::min(pool.capacity * 2, m_maxLayers);
+	GLuint textureID = CreateStorage(pool, capacity);
+	if (0 == textureID)
+		return false;
+
+	// copy every level of the existing layers on the GPU
+	for (GLsizei level = 0; level < pool.levels; level++)
+	{
+		GLsizei levelWidth = std::max(1, pool.width >> level);
+		GLsizei levelHeight = std::max(1, pool.height >> level);
+		glCopyImageSubData(
+			pool.textureID, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+			textureID, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+			levelWidth, levelHeight, pool.layerCount);
+	}
+
+	glDeleteTextures(1, &pool.textureID);
+	pool.textureID = textureID;
+	pool.capacity = capacity;
+	return true;
+}
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearrays.h
+// ============
+// pack textures into 2D array textures grouped by size and format, so
+// that any number of textures can be used without a unit per texture
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  TextureArrays
+ *
+ *  This class owns a set of GL_TEXTURE_2D_ARRAY pools. Each
+ *  pool holds layers of one width, height, internal format
+ *  and mip count, and a texture is addressed by its pool and
+ *  layer. Pools start small and grow by doubling, copying
+ *  the existing layers, up to GL_MAX_ARRAY_TEXTURE_LAYERS,
+ *  after which a new pool with the same shape is started.
+ ***********************************************************/
+class TextureArrays
+{
+public:
+	// constructor
+	TextureArrays();
+	// destructor
+	~TextureArrays();
+
+	// location of one texture inside the pools
+	struct ARRAY_SLOT
+	{
+		int pool;
+		int layer;
+	};
+
+	// reserve a layer for a texture of the given shape, creating
+	// or growing a pool as needed
+	bool Allocate(
+		GLsizei width,
+		GLsizei height,
+		GLenum internalFormat,
+		GLsizei levels,
+		ARRAY_SLOT& slot);
+	// give a layer back, so that the next texture of the same
+	// shape reuses it
+	void Release(const ARRAY_SLOT& slot);
+	// free all pools
+	void Destroy();
+
+	// get the OpenGL array texture of a pool - this changes
+	// when the pool grows
+	GLuint GetTexture(int pool) const;
+	int GetPoolCount() const { return (int)m_pools.size(); }
+
+	// number of levels in a full mip chain for a size
+	static GLsizei GetFullMipCount(GLsizei width, GLsizei height);
+
+private:
+	struct TEXTURE_POOL
+	{
+		GLuint textureID;
+		GLsizei width;
+		GLsizei height;
+		GLenum internalFormat;
+		GLsizei levels;
+		int capacity;
+		int layerCount;
+		// released layers below layerCount
+		std::vector<int> freeLayers;
+	};
+
+	std::vector<TEXTURE_POOL> m_pools;
+	int m_maxLayers;
+
+	// create the storage of a pool with room for capacity layers
+	static GLuint CreateStorage(const TEXTURE_POOL& pool, int capacity);
+	// double the capacity of a pool, keeping its layers
+	bool Grow(TEXTURE_POOL& pool);
+};
@@ -0,0 +1,445 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.cpp
+// ============
+// bake texture images into a block compressed cache format with a
+// prebuilt mip chain, and map baked files for direct upload
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// declaration of global variables
+namespace
+{
+	const char* g_CacheDirectory = "TextureCache";
+	const uint32_t g_CacheVersion = 1;
+	// numbers the temporary files, so that the bakes running at
+	// the same time never write into the same one
+	std::atomic<uint32_t> g_BakeCount(0);
+
+	// expand a 565 color into 8 bit channels
+	void Unpack565(uint16_t color, int rgb[3])
+	{
+		int r = (color >> 11) & 31;
+		int g = (color >> 5) & 63;
+		int b = color & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// round 8 bit channels to a 565 color
+	uint16_t Pack565(int r, int g, int b)
+	{
+		return (uint16_t)((((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+	}
+
+	// compress the colors of a 4x4 RGBA block into 8 bytes of
+	// BC1 data, always using the four color mode
+	void CompressColorBlock(const uint8_t block[64], uint8_t* output)
+	{
+		int minimum[3] = { 255, 255, 255 };
+		int maximum[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				minimum[c] = std::min(minimum[c], (int)block[i * 4 + c]);
+				maximum[c] = std::max(maximum[c], (int)block[i * 4 + c]);
+			}
+		}
+
+		// pull the end points in slightly, so that the palette
+		// covers the colors more evenly
+		for (int c = 0; c < 3; c++)
+		{
+			int inset = (maximum[c] - minimum[c]) >> 4;
+			minimum[c] = std::min(255, minimum[c] + inset);
+			maximum[c] = std::max(0, maximum[c] - inset);
+		}
+
+		uint16_t color0 = Pack565(maximum[0], maximum[1], maximum[2]);
+		uint16_t color1 = Pack565(minimum[0], minimum[1], minimum[2]);
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			Unpack565(color0, palette[0]);
+			Unpack565(color1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0;
+				int bestError = 0x7FFFFFFF;
+				for (int p = 0; p < 4; p++)
+				{
+					int error = 0;
+					for (int c = 0; c < 3; c++)
+					{
+						int difference = (int)block[i * 4 + c] - palette[p][c];
+						error += difference * difference;
+					}
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= (uint32_t)best << (i * 2);
+			}
+		}
+
+		output[0] = (uint8_t)(color0 & 0xFF);
+		output[1] = (uint8_t)(color0 >> 8);
+		output[2] = (uint8_t)(color1 & 0xFF);
+		output[3] = (uint8_t)(color1 >> 8);
+		output[4] = (uint8_t)(indices & 0xFF);
+		output[5] = (uint8_t)((indices >> 8) & 0xFF);
+		output[6] = (uint8_t)((indices >> 16) & 0xFF);
+		output[7] = (uint8_t)(indices >> 24);
+	}
+
+	// compress the alpha of a 4x4 RGBA block into 8 bytes of
+	// BC3 alpha data, using the eight value mode
+	void CompressAlphaBlock(const uint8_t block[64], uint8_t* output)
+	{
+		int alpha0 = 0;
+		int alpha1 = 255;
+		for (int i = 0; i < 16; i++)
+		{
+			alpha0 = std::max(alpha0, (int)block[i * 4 + 3]);
+			alpha1 = std::min(alpha1, (int)block[i * 4 + 3]);
+		}
+
+		uint64_t indices = 0;
+		if (alpha0 != alpha1)
+		{
+			int palette[8];
+			palette[0] = alpha0;
+			palette[1] = alpha1;
+			for (int p = 1; p < 7; p++)
+			{
+				palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0;
+				int bestError = 256;
+				for (int p = 0; p < 8; p++)
+				{
+					int error = std::abs((int)block[i * 4 + 3] - palette[p]);
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= (uint64_t)best << (i * 3);
+			}
+		}
+
+		output[0] = (uint8_t)alpha0;
+		output[1] = (uint8_t)alpha1;
+		for (int i = 0; i < 6; i++)
+		{
+			output[2 + i] = (uint8_t)((indices >> (i * 8)) & 0xFF);
+		}
+	}
+
+	// compress one RGBA8 image into BC1 or BC3 blocks
+	void CompressImage(const uint8_t* pixels, int width, int height, uint32_t format, std::vector<uint8_t>& output)
+	{
+		int blocksX = (width + 3) / 4;
+		int blocksY = (height + 3) / 4;
+		size_t blockSize = (format == TextureCache::FORMAT_BC3) ? 16 : 8;
+		output.resize(blocksX * blocksY * blockSize);
+
+		uint8_t block[64];
+		uint8_t* target = output.data();
+		for (int by = 0; by < blocksY; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				// gather the block, repeating the edge pixels of
+				// images that are not a multiple of 4 in size
+				for (int y = 0; y < 4; y++)
+				{
+					int sourceY = std::min(by * 4 + y, height - 1);
+					for (int x = 0; x < 4; x++)
+					{
+						int sourceX = std::min(bx * 4 + x, width - 1);
+						memcpy(block + (y * 4 + x) * 4, pixels + ((size_t)sourceY * width + sourceX) * 4, 4);
+					}
+				}
+
+				if (format == TextureCache::FORMAT_BC3)
+				{
+					CompressAlphaBlock(block, target);
+					target += 8;
+				}
+				CompressColorBlock(block, target);
+				target += 8;
+			}
+		}
+	}
+
+	// halve an RGBA8 image with a box filter
+	void Downsample(const std::vector<uint8_t>& source, int width, int height, std::vector<uint8_t>& target)
+	{
+		int targetWidth = std::max(1, width / 2);
+		int targetHeight = std::max(1, height / 2);
+		target.resize((size_t)targetWidth * targetHeight * 4);
+
+		for (int y = 0; y < targetHeight; y++)
+		{
+			int y0 = std::min(y * 2, height - 1);
+			int y1 = std::min(y * 2 + 1, height - 1);
+			for (int x = 0; x < targetWidth; x++)
+			{
+				int x0 = std::min(x * 2, width - 1);
+				int x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = source[((size_t)y0 * width + x0) * 4 + c] +
+						source[((size_t)y0 * width + x1) * 4 + c] +
+						source[((size_t)y1 * width + x0) * 4 + c] +
+						source[((size_t)y1 * width + x1) * 4 + c];
+					target[((size_t)y * targetWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  Baked files are kept in one directory, named after the
+ *  source file plus a hash of its full path
+ ***********************************************************/
+std::string TextureCache::GetCachePath(const std::string& sourcePath)
+{
+	uint64_t hash = FileUtils::Hash64(sourcePath.data(), sourcePath.size());
+	char hashText[17];
+	for (int i = 0; i < 16; i++)
+	{
+		hashText[i] = "0123456789abcdef"[(hash >> (60 - i * 4)) & 0xF];
+	}
+	hashText[16] = 0;
+
+	return std::string(g_CacheDirectory) + "/" + FileUtils::GetFileName(sourcePath) + "-" + hashText + ".txc";
+}
+
+/***********************************************************
+ *  IsUpToDate()
+ *
+ *  Check the stamp stored in a baked file against the source
+ ***********************************************************/
+bool TextureCache::IsUpToDate(const std::string& sourcePath, const std::string& cachePath)
+{
+	uint64_t modified = 0;
+	uint64_t size = 0;
+	if (!FileUtils::GetFileStamp(sourcePath, modified, size))
+		return false;
+
+	std::ifstream file(cachePath.c_str(), std::ios::binary);
+	CACHE_HEADER header;
+	if (!file.read((char*)&header, sizeof(header)))
+		return false;
+
+	return (0 == memcmp(header.magic, "TXC1", 4)) &&
+		(header.version == g_CacheVersion) &&
+		(header.sourceModified == modified) &&
+		(header.sourceSize == size);
+}
+
+/***********************************************************
+ *  Bake()
+ *
+ *  Decode a source image, build the full mip chain, block
+ *  compress every level and write the baked file
+ ***********************************************************/
+bool TextureCache::Bake(const std::string& sourcePath, const std::string& cachePath)
+{
+	uint64_t modified = 0;
+	uint64_t size = 0;
+	if (!FileUtils::GetFileStamp(sourcePath, modified, size))
+		return false;
+
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	// always decode to RGBA; the vertical flip is the global stb
+	// setting chosen by the caller, as for the runtime loader
+	unsigned char* image = stbi_load(sourcePath.c_str(), &width, &height, &channels, 4);
+	if (NULL == image)
+		return false;
+
+	std::vector<uint8_t> level(image, image + (size_t)width * height * 4);
+	stbi_image_free(image);
+
+	// only keep an alpha channel when some pixel is transparent
+	uint32_t format = FORMAT_BC1;
+	for (size_t i = 3; i < level.size(); i += 4)
+	{
+		if (level[i] != 255)
+		{
+			format = FORMAT_BC3;
+			break;
+		}
+	}
+
+	std::vector<CACHE_LEVEL> levels;
+	std::vector<std::vector<uint8_t>> levelData;
+	std::vector<uint8_t> smaller;
+	int levelWidth = width;
+	int levelHeight = height;
+
+	for (;;)
+	{
+		CACHE_LEVEL info;
+		info.width = (uint32_t)levelWidth;
+		info.height = (uint32_t)levelHeight;
+		info.offset = 0;
+		levelData.push_back(std::vector<uint8_t>());
+		CompressImage(level.data(), levelWidth, levelHeight, format, levelData.back());
+		info.size = (uint32_t)levelData.back().size();
+		levels.push_back(info);
+
+		if ((levelWidth == 1) && (levelHeight == 1))
+			break;
+
+		Downsample(level, levelWidth, levelHeight, smaller);
+		level.swap(smaller);
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+	}
+
+	CACHE_HEADER header;
+	memcpy(header.magic, "TXC1", 4);
+	header.version = g_CacheVersion;
+	header.format = format;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.levelCount = (uint32_t)levels.size();
+	header.sourceModified = modified;
+	header.sourceSize = size;
+
+	// lay out the level data after the tables
+	uint32_t offset = (uint32_t)(sizeof(CACHE_HEADER) + levels.size() * sizeof(CACHE_LEVEL));
+	for (auto& info : levels)
+	{
+		offset = (offset + 15) & ~15u;
+		info.offset = offset;
+		offset += info.size;
+	}
+
+	FileUtils::MakeDirectory(g_CacheDirectory);
+
+	// write to a temporary name of its own first, so that a
+	// reader never maps a half written file; the worker threads
+	// and a hot reload can bake the same image at once
+	std::string temporaryPath = cachePath + "." + std::to_string(++g_BakeCount) + ".tmp";
+	{
+		std::ofstream file(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)levels.data(), levels.size() * sizeof(CACHE_LEVEL));
+		const char padding[16] = { 0 };
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			size_t position = (size_t)file.tellp();
+			file.write(padding, levels[i].offset - position);
+			file.write((const char*)levelData[i].data(), levelData[i].size());
+		}
+		if (!file)
+		{
+			file.close();
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+	}
+
+	// the file can not be replaced while a reader still has it
+	// mapped, and the source image is decoded instead
+	std::remove(cachePath.c_str());
+	if (0 != std::rename(temporaryPath.c_str(), cachePath.c_str()))
+	{
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  Map a baked file and check that its tables are sane
+ ***********************************************************/
+bool TextureCache::Open(const std::string& cachePath, CACHED_TEXTURE& texture)
+{
+	if (!texture.file.Open(cachePath))
+		return false;
+
+	const uint8_t* data = texture.file.GetData();
+	size_t size = texture.file.GetSize();
+	if (size < sizeof(CACHE_HEADER))
+	{
+		texture.file.Close();
+		return false;
+	}
+
+	texture.header = (const CACHE_HEADER*)data;
+	texture.levels = (const CACHE_LEVEL*)(data + sizeof(CACHE_HEADER));
+
+	bool bValid = (0 == memcmp(texture.header->magic, "TXC1", 4)) &&
+		(texture.header->version == g_CacheVersion) &&
+		(texture.header->levelCount > 0) &&
+		(sizeof(CACHE_HEADER) + texture.header->levelCount * sizeof(CACHE_LEVEL) <= size);
+
+	for (uint32_t i = 0; bValid && (i < texture.header->levelCount); i++)
+	{
+		bValid = (uint64_t)texture.levels[i].offset + texture.levels[i].size <= size;
+	}
+
+	if (!bValid)
+	{
+		texture.file.Close();
+		texture.header = NULL;
+		texture.levels = NULL;
+	}
+	return bValid;
+}
+
+/***********************************************************
+ *  GetGLFormat()
+ *
+ *  Get the compressed OpenGL format of a cache format
+ ***********************************************************/
+GLenum TextureCache::GetGLFormat(uint32_t format)
+{
+	if (format == FORMAT_BC3)
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
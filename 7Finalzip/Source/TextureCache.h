@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.h
+// ============
+// bake texture images into a block compressed cache format with a
+// prebuilt mip chain, and map baked files for direct upload
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FileUtils.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  Baked texture file layout (all little endian):
+ *    CACHE_HEADER
+ *    CACHE_LEVEL[levelCount], largest level first
+ *    block compressed level data, each level 16-byte aligned
+ *
+ *  Images without transparency are stored as BC1 (DXT1),
+ *  images with transparency as BC3 (DXT5).
+ ***********************************************************/
+namespace TextureCache
+{
+	enum CACHE_FORMAT
+	{
+		FORMAT_BC1 = 1,
+		FORMAT_BC3 = 3
+	};
+
+	struct CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		// stamp of the source image the file was baked from
+		uint64_t sourceModified;
+		uint64_t sourceSize;
+	};
+
+	struct CACHE_LEVEL
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	// a baked file mapped into memory, its level table and data
+	// point straight into the mapping
+	struct CACHED_TEXTURE
+	{
+		MappedFile file;
+		const CACHE_HEADER* header;
+		const CACHE_LEVEL* levels;
+	};
+
+	// get the path of the baked file for a source image
+	std::string GetCachePath(const std::string& sourcePath);
+	// true when the baked file exists and matches the source
+	bool IsUpToDate(const std::string& sourcePath, const std::string& cachePath);
+	// decode a source image, build its mip chain, compress it and
+	// write the baked file
+	bool Bake(const std::string& sourcePath, const std::string& cachePath);
+	// map a baked file and validate its contents
+	bool Open(const std::string& cachePath, CACHED_TEXTURE& texture);
+	// get the OpenGL internal format of a cache format
+	GLenum GetGLFormat(uint32_t format);
+}
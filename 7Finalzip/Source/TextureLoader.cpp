@@ -0,0 +1,362 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.cpp
+// ============
+// decode texture images on worker threads and upload them to OpenGL
+// from the main thread as they finish
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureLoader.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+/***********************************************************
+ *  TextureLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureLoader::TextureLoader()
+{
+	m_pArrays = NULL;
+	m_activeJobs = 0;
+	m_bStopping = false;
+	m_bUseCache = true;
+	m_pixelBuffers[0] = 0;
+	m_pixelBuffers[1] = 0;
+	m_nextPixelBuffer = 0;
+}
+
+/***********************************************************
+ *  ~TextureLoader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureLoader::~TextureLoader()
+{
+	Stop();
+
+	if (0 != m_pixelBuffers[0])
+	{
+		glDeleteBuffers(2, m_pixelBuffers);
+		m_pixelBuffers[0] = 0;
+		m_pixelBuffers[1] = 0;
+	}
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  Start the worker threads that decode the image files
+ ***********************************************************/
+void TextureLoader::Start(TextureArrays* pArrays, unsigned int threadCount)
+{
+	if (!m_workers.empty())
+		return;
+
+	m_pArrays = pArrays;
+
+	if (0 == threadCount)
+	{
+		// leave one core for the main thread
+		unsigned int cores = std::thread::hardware_concurrency();
+		threadCount = std::min(std::max(cores, 2u) - 1, 8u);
+	}
+
+	// I always flip images vertically when loaded - this is set
+	// once here since the setting is shared by all threads
+	stbi_set_flip_vertically_on_load(true);
+
+	// baked files hold S3TC blocks, which need driver support
+	if (!GLEW_EXT_texture_compression_s3tc)
+		m_bUseCache = false;
+
+	m_bStopping = false;
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&TextureLoader::WorkerThread, this));
+	}
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  Stop the worker threads and free all decoded images that
+ *  were not uploaded yet
+ ***********************************************************/
+void TextureLoader::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+		m_jobs.clear();
+	}
+	m_jobReady.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+
+	for (auto& result : m_results)
+	{
+		stbi_image_free(result.pixels);
+	}
+	m_results.clear();
+	m_activeJobs = 0;
+}
+
+/***********************************************************
+ *  Request()
+ *
+ *  Queue an image file for decoding into a texture
+ ***********************************************************/
+void TextureLoader::Request(const std::string& filename, int textureHandle)
+{
+	LOAD_JOB job;
+	job.filename = filename;
+	job.textureHandle = textureHandle;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+	}
+	m_jobReady.notify_one();
+}
+
+/***********************************************************
+ *  IsIdle()
+ *
+ *  True when every requested image has been uploaded
+ ***********************************************************/
+bool TextureLoader::IsIdle()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_jobs.empty() && m_results.empty() && (0 == m_activeJobs);
+}
+
+/***********************************************************
+ *  WorkerThread()
+ *
+ *  Take jobs from the queue and decode them until stopped
+ ***********************************************************/
+void TextureLoader::WorkerThread()
+{
+	for (;;)
+	{
+		LOAD_JOB job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobReady.wait(lock, [this] { return m_bStopping || !m_jobs.empty(); });
+			if (m_bStopping)
+				return;
+
+			job = m_jobs.front();
+			m_jobs.pop_front();
+			m_activeJobs++;
+		}
+
+		LOAD_RESULT result;
+		result.filename = job.filename;
+		result.textureHandle = job.textureHandle;
+		result.pixels = NULL;
+		result.width = 0;
+		result.height = 0;
+		result.channels = 0;
+
+		if (m_bUseCache)
+		{
+			// bake the image the first time it is seen, or when the
+			// source changed, then map the baked file
+			std::string cachePath = TextureCache::GetCachePath(job.filename);
+			if (TextureCache::IsUpToDate(job.filename, cachePath) ||
+				TextureCache::Bake(job.filename, cachePath))
+			{
+				result.cached.reset(new TextureCache::CACHED_TEXTURE());
+				if (!TextureCache::Open(cachePath, *result.cached))
+					result.cached.reset();
+			}
+		}
+
+		// fall back to decoding the source image
+		if (!result.cached)
+			result.pixels = stbi_load(job.filename.c_str(), &result.width, &result.height, &result.channels, 0);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_activeJobs--;
+		if (m_bStopping)
+		{
+			stbi_image_free(result.pixels);
+			return;
+		}
+		m_results.push_back(std::move(result));
+	}
+}
+
+/***********************************************************
+ *  ProcessUploads()
+ *
+ *  Upload finished decodes into the texture arrays. This
+ *  must be called on the thread that owns the OpenGL context.
+ ***********************************************************/
+int TextureLoader::ProcessUploads(int maxUploads, std::vector<UPLOADED_TEXTURE>& uploaded)
+{
+	int processed = 0;
+
+	while (processed < maxUploads)
+	{
+		LOAD_RESULT result;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_results.empty())
+				break;
+			result = std::move(m_results.front());
+			m_results.pop_front();
+		}
+
+		UPLOADED_TEXTURE texture;
+		texture.textureHandle = result.textureHandle;
+		bool bUploaded = result.cached ?
+			UploadCached(result, texture.slot) :
+			Upload(result, texture.slot);
+		if (bUploaded)
+			uploaded.push_back(texture);
+
+		stbi_image_free(result.pixels);
+		processed++;
+	}
+
+	return processed;
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  Copy the decoded image into a pixel buffer, have OpenGL
+ *  transfer it into a new array layer, and build the mipmaps
+ *  of that layer
+ ***********************************************************/
+bool TextureLoader::Upload(const LOAD_RESULT& result, TextureArrays::ARRAY_SLOT& slot)
+{
+	if (NULL == result.pixels)
+	{
+		std::cout << "Could not load image:" << result.filename << std::endl;
+		return false;
+	}
+
+	// 3 and 4 channel images share RGBA8 pools, the missing
+	// alpha of 3 channel images is filled with 1
+	GLenum format = 0;
+	if (result.channels == 3)
+	{
+		format = GL_RGB;
+	}
+	else if (result.channels == 4)
+	{
+		format = GL_RGBA;
+	}
+	else
+	{
+		std::cout << "Not implemented to handle image with " << result.channels << " channels" << std::endl;
+		return false;
+	}
+
+	GLsizei levels = TextureArrays::GetFullMipCount(result.width, result.height);
+	if ((NULL == m_pArrays) ||
+		!m_pArrays->Allocate(result.width, result.height, GL_RGBA8, levels, slot))
+	{
+		std::cout << "Could not allocate a texture layer for image:" << result.filename << std::endl;
+		return false;
+	}
+
+	std::cout << "Successfully loaded image:" << result.filename
+		<< ", width:" << result.width << ", height:" << result.height
+		<< ", channels:" << result.channels << std::endl;
+
+	if (0 == m_pixelBuffers[0])
+		glGenBuffers(2, m_pixelBuffers);
+
+	// alternate between two pixel buffers so that filling one does
+	// not wait for the transfer from the other to finish
+	GLuint pixelBuffer = m_pixelBuffers[m_nextPixelBuffer];
+	m_nextPixelBuffer = 1 - m_nextPixelBuffer;
+
+	GLsizeiptr size = (GLsizeiptr)result.width * result.height * result.channels;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (NULL != mapped)
+	{
+		memcpy(mapped, result.pixels, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	// rows of 3 channel images are not always 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_pArrays->GetTexture(slot.pool));
+	if (NULL != mapped)
+	{
+		// the data pointer is an offset into the bound pixel buffer
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot.layer, result.width, result.height, 1, format, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	else
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot.layer, result.width, result.height, 1, format, GL_UNSIGNED_BYTE, result.pixels);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// build the mips through a view of the new layer alone, since
+	// generating them on the array would rebuild every layer of
+	// the pool on each upload and each hot reload
+	GLuint layerView = 0;
+	glGenTextures(1, &layerView);
+	glTextureView(layerView, GL_TEXTURE_2D, m_pArrays->GetTexture(slot.pool), GL_RGBA8, 0, levels, slot.layer, 1);
+	glBindTexture(GL_TEXTURE_2D, layerView);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDeleteTextures(1, &layerView);
+	return true;
+}
+
+/***********************************************************
+ *  UploadCached()
+ *
+ *  Upload every level of a baked file straight from the
+ *  mapped memory into a new array layer, with no decoding
+ *  or mipmap generation
+ ***********************************************************/
+bool TextureLoader::UploadCached(const LOAD_RESULT& result, TextureArrays::ARRAY_SLOT& slot)
+{
+	const TextureCache::CACHED_TEXTURE& cached = *result.cached;
+	const uint8_t* data = cached.file.GetData();
+	GLenum format = TextureCache::GetGLFormat(cached.header->format);
+
+	if ((NULL == m_pArrays) ||
+		!m_pArrays->Allocate(cached.header->width, cached.header->height, format, cached.header->levelCount, slot))
+	{
+		std::cout << "Could not allocate a texture layer for image:" << result.filename << std::endl;
+		return false;
+	}
+
+	std::cout << "Successfully loaded baked image:" << result.filename
+		<< ", width:" << cached.header->width << ", height:" << cached.header->height
+		<< ", levels:" << cached.header->levelCount << std::endl;
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_pArrays->GetTexture(slot.pool));
+	for (uint32_t level = 0; level < cached.header->levelCount; level++)
+	{
+		const TextureCache::CACHE_LEVEL& info = cached.levels[level];
+		glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, slot.layer, info.width, info.height, 1,
+			format, info.size, data + info.offset);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return true;
+}
@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.h
+// ============
+// decode texture images on worker threads and upload them to OpenGL
+// from the main thread as they finish
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureArrays.h"
+#include "TextureCache.h"
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  TextureLoader
+ *
+ *  This class owns a small pool of worker threads that
+ *  decode image files. Textures are named by a handle chosen
+ *  by the caller. ProcessUploads() runs on the thread owning
+ *  the OpenGL context: as decoded images become available it
+ *  reserves a layer in the TextureArrays pool matching their
+ *  size and format, fills it through pixel buffer objects,
+ *  and reports where each texture ended up.
+ *
+ *  When the driver supports S3TC, images are baked once into
+ *  the block compressed TextureCache format. Later loads map
+ *  the baked file and upload its prebuilt mip chain directly,
+ *  skipping the decode.
+ ***********************************************************/
+class TextureLoader
+{
+public:
+	// constructor
+	TextureLoader();
+	// destructor
+	~TextureLoader();
+
+	// where a finished texture was uploaded to
+	struct UPLOADED_TEXTURE
+	{
+		int textureHandle;
+		TextureArrays::ARRAY_SLOT slot;
+	};
+
+	// start the worker threads uploading into the given pools,
+	// 0 picks a thread count from the CPU
+	void Start(TextureArrays* pArrays, unsigned int threadCount = 0);
+	// turn the use of baked texture files on or off, before
+	// Start() is called
+	void SetUseCache(bool bUseCache) { m_bUseCache = bUseCache; }
+	// stop the worker threads and drop any pending work
+	void Stop();
+
+	// queue an image file to be decoded for a texture handle
+	void Request(const std::string& filename, int textureHandle);
+	// upload at most maxUploads decoded images, appending the
+	// slot of each successful upload, and return the number of
+	// images that were processed
+	int ProcessUploads(int maxUploads, std::vector<UPLOADED_TEXTURE>& uploaded);
+	// true when no decodes or uploads are pending
+	bool IsIdle();
+
+private:
+	struct LOAD_JOB
+	{
+		std::string filename;
+		int textureHandle;
+	};
+
+	struct LOAD_RESULT
+	{
+		std::string filename;
+		int textureHandle;
+		unsigned char* pixels;
+		int width;
+		int height;
+		int channels;
+		// set instead of pixels when a baked file was mapped
+		std::unique_ptr<TextureCache::CACHED_TEXTURE> cached;
+	};
+
+	// pools that receive the uploaded images
+	TextureArrays* m_pArrays;
+
+	// worker threads and the work shared with them
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_jobReady;
+	std::deque<LOAD_JOB> m_jobs;
+	std::deque<LOAD_RESULT> m_results;
+	int m_activeJobs;
+	bool m_bStopping;
+	bool m_bUseCache;
+
+	// pixel buffers used in turn for the uploads
+	GLuint m_pixelBuffers[2];
+	int m_nextPixelBuffer;
+
+	// decode jobs until the loader is stopped
+	void WorkerThread();
+	// copy one decoded image into a new array layer
+	bool Upload(const LOAD_RESULT& result, TextureArrays::ARRAY_SLOT& slot);
+	// upload the mip chain of a baked file into a new array layer
+	bool UploadCached(const LOAD_RESULT& result, TextureArrays::ARRAY_SLOT& slot);
+};
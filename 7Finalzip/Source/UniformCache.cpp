@@ -0,0 +1,299 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.cpp
+// ============
+// cache the uniform locations of a linked shader program and skip
+// uploads of values that the program already holds
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformCache.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+/***********************************************************
+ *  UniformCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformCache::UniformCache()
+{
+	m_programID = 0;
+	m_skippedCount = 0;
+	m_uploadCount = 0;
+}
+
+/***********************************************************
+ *  ~UniformCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UniformCache::~UniformCache()
+{
+	Detach();
+}
+
+/***********************************************************
+ *  HashName()
+ *
+ *  FNV-1a hash of a uniform name
+ ***********************************************************/
+uint32_t UniformCache::HashName(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	while (*name)
+	{
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/***********************************************************
+ *  AddEntry()
+ *
+ *  Insert a name to location mapping, keeping the table
+ *  sorted by hash
+ ***********************************************************/
+void UniformCache::AddEntry(const char* name, GLint location)
+{
+	UNIFORM_ENTRY entry;
+	entry.hash = HashName(name);
+	entry.location = location;
+	entry.name = name;
+
+	auto insertAt = std::upper_bound(m_entries.begin(), m_entries.end(), entry.hash,
+		[](uint32_t hash, const UNIFORM_ENTRY& other) { return hash < other.hash; });
+	m_entries.insert(insertAt, entry);
+
+	if ((location >= 0) && (location >= (GLint)m_shadow.size()))
+	{
+		UNIFORM_SHADOW unknown = {};
+		m_shadow.resize(location + 1, unknown);
+	}
+}
+
+/***********************************************************
+ *  Attach()
+ *
+ *  Query every active uniform of the linked program and
+ *  cache its location
+ ***********************************************************/
+void UniformCache::Attach(GLuint programID)
+{
+	Detach();
+	m_programID = programID;
+
+	if (0 == programID)
+		return;
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> name(maxNameLength + 1, 0);
+	m_entries.reserve(uniformCount * 2);
+
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei length = 0;
+		GLint arraySize = 0;
+		GLenum type = 0;
+		glGetActiveUniform(programID, i, (GLsizei)name.size(), &length, &arraySize, &type, name.data());
+
+		GLint location = glGetUniformLocation(programID, name.data());
+		if (location < 0)
+			continue; // uniform block members have no location
+
+		AddEntry(name.data(), location);
+
+		// arrays of basic types are reported as "name[0]", so also
+		// register the plain name and every element of the array
+		if ((length > 3) && (0 == strcmp(name.data() + length - 3, "[0]")))
+		{
+			std::string baseName(name.data(), length - 3);
+			AddEntry(baseName.c_str(), location);
+			for (GLint element = 1; element < arraySize; element++)
+			{
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				AddEntry(elementName.c_str(), glGetUniformLocation(programID, elementName.c_str()));
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  Detach()
+ *
+ *  Forget all cached locations and shadowed values
+ ***********************************************************/
+void UniformCache::Detach()
+{
+	m_programID = 0;
+	m_entries.clear();
+	m_shadow.clear();
+}
+
+/***********************************************************
+ *  Reattach()
+ *
+ *  Carry the shadowed values over to a rebuilt program. The
+ *  locations can differ between the two, so the values are
+ *  matched by name, and settings sent only once at startup
+ *  survive the rebuild.
+ ***********************************************************/
+void UniformCache::Reattach(GLuint programID)
+{
+	// arrays are registered under more than one name, so each
+	// location is carried over once
+	std::vector<std::pair<std::string, UNIFORM_SHADOW> > values;
+	std::vector<bool> bSaved(m_shadow.size(), false);
+	for (size_t i = 0; i < m_entries.size(); i++)
+	{
+		GLint location = m_entries[i].location;
+		if ((location < 0) || bSaved[location] || !m_shadow[location].bValid)
+			continue;
+		bSaved[location] = true;
+		values.push_back(std::make_pair(m_entries[i].name, m_shadow[location]));
+	}
+
+	Attach(programID);
+
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		GLint location = GetLocation(values[i].first.c_str());
+		if ((location < 0) || (location >= (GLint)m_shadow.size()))
+			continue;
+
+		const UNIFORM_SHADOW& value = values[i].second;
+		const GLint* ints = (const GLint*)value.data;
+		const GLfloat* floats = (const GLfloat*)value.data;
+		switch (value.type)
+		{
+		case GL_INT:        glUniform1i(location, ints[0]); break;
+		case GL_FLOAT:      glUniform1f(location, floats[0]); break;
+		case GL_FLOAT_VEC2: glUniform2fv(location, 1, floats); break;
+		case GL_FLOAT_VEC3: glUniform3fv(location, 1, floats); break;
+		case GL_FLOAT_VEC4: glUniform4fv(location, 1, floats); break;
+		case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, floats); break;
+		default: continue;
+		}
+		m_shadow[location] = value;
+	}
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  Mark every shadowed value as unknown
+ ***********************************************************/
+void UniformCache::Invalidate()
+{
+	for (auto& shadow : m_shadow)
+	{
+		shadow.bValid = false;
+	}
+}
+
+/***********************************************************
+ *  GetLocation()
+ *
+ *  Get the cached location of a uniform by name. Names that
+ *  are not in the table are queried once and remembered.
+ ***********************************************************/
+GLint UniformCache::GetLocation(const char* name)
+{
+	uint32_t hash = HashName(name);
+
+	auto found = std::lower_bound(m_entries.begin(), m_entries.end(), hash,
+		[](const UNIFORM_ENTRY& entry, uint32_t value) { return entry.hash < value; });
+	for (; (found != m_entries.end()) && (found->hash == hash); ++found)
+	{
+		if (found->name == name)
+			return found->location;
+	}
+
+	if (0 == m_programID)
+		return -1;
+
+	// not an active uniform name, so remember the miss
+	GLint location = glGetUniformLocation(m_programID, name);
+	AddEntry(name, location);
+	return location;
+}
+
+/***********************************************************
+ *  UpdateShadow()
+ *
+ *  Compare a value against the shadowed copy for the location
+ *  and store it, returning true when it has to be uploaded
+ ***********************************************************/
+bool UniformCache::UpdateShadow(GLint location, GLenum type, const void* data, uint32_t size)
+{
+	if ((location < 0) || (location >= (GLint)m_shadow.size()))
+		return false;
+
+	UNIFORM_SHADOW& shadow = m_shadow[location];
+	if (shadow.bValid && (shadow.size == size) && (0 == memcmp(shadow.data, data, size)))
+	{
+		m_skippedCount++;
+		return false;
+	}
+
+	memcpy(shadow.data, data, size);
+	shadow.type = type;
+	shadow.size = size;
+	shadow.bValid = true;
+	m_uploadCount++;
+	return true;
+}
+
+/***********************************************************
+ *  Set*()
+ *
+ *  Upload a uniform value when it differs from the last
+ *  value sent to that location
+ ***********************************************************/
+void UniformCache::SetBool(GLint location, bool value)
+{
+	SetInt(location, value ? 1 : 0);
+}
+
+void UniformCache::SetInt(GLint location, int value)
+{
+	if (UpdateShadow(location, GL_INT, &value, sizeof(value)))
+		glUniform1i(location, value);
+}
+
+void UniformCache::SetFloat(GLint location, float value)
+{
+	if (UpdateShadow(location, GL_FLOAT, &value, sizeof(value)))
+		glUniform1f(location, value);
+}
+
+void UniformCache::SetVec2(GLint location, const glm::vec2& value)
+{
+	if (UpdateShadow(location, GL_FLOAT_VEC2, glm::value_ptr(value), sizeof(value)))
+		glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+void UniformCache::SetVec3(GLint location, const glm::vec3& value)
+{
+	if (UpdateShadow(location, GL_FLOAT_VEC3, glm::value_ptr(value), sizeof(value)))
+		glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void UniformCache::SetVec4(GLint location, const glm::vec4& value)
+{
+	if (UpdateShadow(location, GL_FLOAT_VEC4, glm::value_ptr(value), sizeof(value)))
+		glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+void UniformCache::SetMat4(GLint location, const glm::mat4& value)
+{
+	if (UpdateShadow(location, GL_FLOAT_MAT4, glm::value_ptr(value), sizeof(value)))
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
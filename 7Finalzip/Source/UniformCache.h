@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.h
+// ============
+// cache the uniform locations of a linked shader program and skip
+// uploads of values that the program already holds
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  UniformCache
+ *
+ *  This class resolves every active uniform of a shader
+ *  program once after linking, and keeps a shadow copy of
+ *  the last value sent to each location so that redundant
+ *  glUniform* calls are never issued.
+ ***********************************************************/
+class UniformCache
+{
+public:
+	// constructor
+	UniformCache();
+	// destructor
+	~UniformCache();
+
+	// resolve and cache all active uniforms of a linked program
+	void Attach(GLuint programID);
+	// forget all cached locations and shadowed values
+	void Detach();
+	// attach to a rebuilt version of the program, which must be
+	// current, and send it every value the old program held
+	void Reattach(GLuint programID);
+	// mark all shadowed values as unknown, for use after the
+	// program uniforms were changed outside of this cache
+	void Invalidate();
+
+	// get the program the cache is attached to
+	GLuint GetProgram() const { return m_programID; }
+	// get the location of a uniform, -1 when it is not active
+	GLint GetLocation(const char* name);
+
+	// set uniform values by location
+	void SetBool(GLint location, bool value);
+	void SetInt(GLint location, int value);
+	void SetFloat(GLint location, float value);
+	void SetVec2(GLint location, const glm::vec2& value);
+	void SetVec3(GLint location, const glm::vec3& value);
+	void SetVec4(GLint location, const glm::vec4& value);
+	void SetMat4(GLint location, const glm::mat4& value);
+
+	// set uniform values by name
+	void SetBool(const char* name, bool value) { SetBool(GetLocation(name), value); }
+	void SetInt(const char* name, int value) { SetInt(GetLocation(name), value); }
+	void SetSampler2D(const char* name, int value) { SetInt(GetLocation(name), value); }
+	void SetFloat(const char* name, float value) { SetFloat(GetLocation(name), value); }
+	void SetVec2(const char* name, const glm::vec2& value) { SetVec2(GetLocation(name), value); }
+	void SetVec3(const char* name, const glm::vec3& value) { SetVec3(GetLocation(name), value); }
+	void SetVec3(const char* name, float x, float y, float z) { SetVec3(GetLocation(name), glm::vec3(x, y, z)); }
+	void SetVec4(const char* name, const glm::vec4& value) { SetVec4(GetLocation(name), value); }
+	void SetMat4(const char* name, const glm::mat4& value) { SetMat4(GetLocation(name), value); }
+
+	// get the number of uniform uploads that were skipped
+	// and issued since the last call to ResetCounters()
+	uint32_t GetSkippedCount() const { return m_skippedCount; }
+	uint32_t GetUploadCount() const { return m_uploadCount; }
+	void ResetCounters() { m_skippedCount = 0; m_uploadCount = 0; }
+
+private:
+	struct UNIFORM_ENTRY
+	{
+		uint32_t hash;
+		GLint location;
+		std::string name;
+	};
+
+	struct UNIFORM_SHADOW
+	{
+		bool bValid;
+		// type of the last Set* call, GL_INT through GL_FLOAT_MAT4
+		GLenum type;
+		uint32_t size;
+		uint32_t data[16];
+	};
+
+	// linked program the locations belong to
+	GLuint m_programID;
+	// uniform names sorted by hash for fast lookups
+	std::vector<UNIFORM_ENTRY> m_entries;
+	// last value sent, indexed by uniform location
+	std::vector<UNIFORM_SHADOW> m_shadow;
+	// upload statistics
+	uint32_t m_skippedCount;
+	uint32_t m_uploadCount;
+
+	// hash a uniform name
+	static uint32_t HashName(const char* name);
+	// add a name to location mapping to the lookup table
+	void AddEntry(const char* name, GLint location);
+	// compare a value against the shadow copy and update it,
+	// returning true when the value needs to be uploaded
+	bool UpdateShadow(GLint location, GLenum type, const void* data, uint32_t size);
+};
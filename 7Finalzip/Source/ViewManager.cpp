@@ -14,31 +14,38 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+#include <algorithm>
+#include <iostream>
+
 // declaration of the global variables and defines
 namespace
 {
 	// Variables for window width and height
 	const int WINDOW_WIDTH = 1000;
 	const int WINDOW_HEIGHT = 800;
-	const char* g_ViewName = "view";
-	const char* g_ProjectionName = "projection";
+	// depth range of the camera, and the half height of the
+	// orthographic view
+	const float g_NearPlane = 0.1f;
+	const float g_FarPlane = 100.0f;
+	const float g_OrthoSize = 10.0f;
 
-	// camera object used for viewing and interacting with
-	// the 3D scene
-	Camera* g_pCamera = nullptr;
+	// framebuffer size, as last reported by GLFW
+	int gFramebufferWidth = WINDOW_WIDTH;
+	int gFramebufferHeight = WINDOW_HEIGHT;
 
 	// these variables are used for mouse movement processing
 	float gLastX = WINDOW_WIDTH / 2.0f;
 	float gLastY = WINDOW_HEIGHT / 2.0f;
 	bool gFirstMouse = true;
 
+	// a left click is kept as a count and the point it was at,
+	// for the render thread to pick from
+	uint32_t gPickRequests = 0;
+	glm::vec2 gPickPoint = glm::vec2(0.0f);
+
 	// time between current frame and last frame
 	float gDeltaTime = 0.0f; 
 	float gLastFrame = 0.0f;
-
-	// the following variable is false when orthographic projection
-	// is off and true when it is on
-	bool bOrthographicProjection = false;
 }
 
 /***********************************************************
@@ -47,17 +54,15 @@ namespace
  *  The constructor for the class
  ***********************************************************/
 ViewManager::ViewManager(
-	ShaderManager *pShaderManager)
+	ShaderManager *pShaderManager,
+	UniformCache* pUniforms)
 {
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
+	m_pUniforms = pUniforms;
 	m_pWindow = NULL;
-	g_pCamera = new Camera();
-	// default camera view parameters
-	g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
-	g_pCamera->Front = glm::vec3(0.0f, -0.5f, -2.0f);
-	g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
-	g_pCamera->Zoom = 80;
+	m_bCameraBuilt = false;
+	m_bCameraDirty = false;
 }
 
 /***********************************************************
@@ -69,12 +74,8 @@ ViewManager::~ViewManager()
 {
 	// free up allocated memory
 	m_pShaderManager = NULL;
+	m_pUniforms = NULL;
 	m_pWindow = NULL;
-	if (NULL != g_pCamera)
-	{
-		delete g_pCamera;
-		g_pCamera = NULL;
-	}
 }
 
 /***********************************************************
@@ -105,6 +106,11 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 
 	// this callback is used to receive mouse moving events
 	glfwSetCursorPosCallback(window, &ViewManager::Mouse_Position_Callback);
+	// this callback is used to receive mouse clicks for picking
+	glfwSetMouseButtonCallback(window, &ViewManager::Mouse_Button_Callback);
+	// this callback is used to follow the framebuffer size
+	glfwSetFramebufferSizeCallback(window, &ViewManager::Framebuffer_Size_Callback);
+	glfwGetFramebufferSize(window, &gFramebufferWidth, &gFramebufferHeight);
 
 	// enable blending for supporting tranparent rendering
 	glEnable(GL_BLEND);
@@ -123,6 +129,67 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
  ***********************************************************/
 void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos)
 {
+	// remember the cursor for the next click
+	gLastX = (float)xMousePos;
+	gLastY = (float)yMousePos;
+	gFirstMouse = false;
+}
+
+/***********************************************************
+ *  Mouse_Button_Callback()
+ *
+ *  This method is automatically called from GLFW whenever a
+ *  mouse button is pressed or released. A left press asks
+ *  for the scene object under the cursor.
+ ***********************************************************/
+void ViewManager::Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if ((GLFW_MOUSE_BUTTON_LEFT != button) || (GLFW_PRESS != action))
+		return;
+
+	// the cursor is in window coordinates, with y going down
+	int width = 0;
+	int height = 0;
+	glfwGetWindowSize(window, &width, &height);
+	if ((width <= 0) || (height <= 0))
+		return;
+
+	gPickPoint.x = 2.0f * gLastX / (float)width - 1.0f;
+	gPickPoint.y = 1.0f - 2.0f * gLastY / (float)height;
+	gPickRequests++;
+}
+
+/***********************************************************
+ *  GetPickRequest()
+ *
+ *  This method reads the pick requests, on the thread that
+ *  handles the window events.
+ ***********************************************************/
+uint32_t ViewManager::GetPickRequest(glm::vec2& pickPoint)
+{
+	pickPoint = gPickPoint;
+	return gPickRequests;
+}
+
+/***********************************************************
+ *  GetPickRay()
+ *
+ *  This method unprojects a point on the near and the far
+ *  plane, and returns the ray from the first to the second.
+ ***********************************************************/
+void ViewManager::GetPickRay(
+	const glm::vec2& pickPoint,
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	glm::vec3& origin,
+	glm::vec3& direction)
+{
+	glm::mat4 toWorld = glm::inverse(projection * view);
+	glm::vec4 nearPoint = toWorld * glm::vec4(pickPoint.x, pickPoint.y, -1.0f, 1.0f);
+	glm::vec4 farPoint = toWorld * glm::vec4(pickPoint.x, pickPoint.y, 1.0f, 1.0f);
+
+	origin = glm::vec3(nearPoint) / nearPoint.w;
+	direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
 }
 
 /***********************************************************
@@ -140,41 +207,117 @@ void ViewManager::ProcessKeyboardEvents()
 	}
 }
 
+/***********************************************************
+ *  Framebuffer_Size_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the framebuffer of the window is resized.
+ ***********************************************************/
+void ViewManager::Framebuffer_Size_Callback(GLFWwindow* window, int width, int height)
+{
+	gFramebufferWidth = width;
+	gFramebufferHeight = height;
+}
+
+/***********************************************************
+ *  GetFramebufferSize()
+ *
+ *  This method gets the size of the window framebuffer.
+ ***********************************************************/
+void ViewManager::GetFramebufferSize(int& width, int& height)
+{
+	width = gFramebufferWidth;
+	height = gFramebufferHeight;
+}
+
+/***********************************************************
+ *  SetCamera()
+ *
+ *  This method compares the camera with the one of the last
+ *  frame, and only when it moved or the viewport changed
+ *  builds its matrices and frustum again.
+ ***********************************************************/
+bool ViewManager::SetCamera(
+	const glm::vec3& position,
+	const glm::vec3& front,
+	const glm::vec3& up,
+	float fov,
+	bool bOrtho,
+	int viewportWidth,
+	int viewportHeight)
+{
+	// a minimized window has no area to keep the aspect of
+	viewportWidth = std::max(viewportWidth, 1);
+	viewportHeight = std::max(viewportHeight, 1);
+
+	if (m_bCameraBuilt &&
+		(m_cameraInputs.position == position) &&
+		(m_cameraInputs.front == front) &&
+		(m_cameraInputs.up == up) &&
+		(m_cameraInputs.fov == fov) &&
+		(m_cameraInputs.bOrtho == bOrtho) &&
+		(m_cameraInputs.viewportWidth == viewportWidth) &&
+		(m_cameraInputs.viewportHeight == viewportHeight))
+		return false;
+
+	m_cameraInputs.position = position;
+	m_cameraInputs.front = front;
+	m_cameraInputs.up = up;
+	m_cameraInputs.fov = fov;
+	m_cameraInputs.bOrtho = bOrtho;
+	m_cameraInputs.viewportWidth = viewportWidth;
+	m_cameraInputs.viewportHeight = viewportHeight;
+	m_bCameraBuilt = true;
+	m_bCameraDirty = true;
+
+	float aspect = (float)viewportWidth / (float)viewportHeight;
+	m_camera.view = glm::lookAt(position, position + front, up);
+	if (bOrtho)
+	{
+		m_camera.projection = glm::ortho(
+			-g_OrthoSize * aspect, g_OrthoSize * aspect,
+			-g_OrthoSize, g_OrthoSize,
+			g_NearPlane, g_FarPlane);
+	}
+	else
+	{
+		m_camera.projection = glm::perspective(glm::radians(fov), aspect, g_NearPlane, g_FarPlane);
+	}
+	m_camera.viewProjection = m_camera.projection * m_camera.view;
+	m_camera.inverseProjection = glm::inverse(m_camera.projection);
+	m_camera.position = glm::vec4(position, 1.0f);
+
+	m_frustum.SetViewProjection(m_camera.viewProjection);
+	for (int i = 0; i < 6; i++)
+	{
+		m_camera.frustumPlanes[i] = m_frustum.GetPlane(i);
+	}
+	m_camera.viewport = glm::vec4((float)viewportWidth, (float)viewportHeight, g_NearPlane, g_FarPlane);
+
+	return true;
+}
+
 /***********************************************************
  *  PrepareSceneView()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene 
- *  rendering
+ *  This method is used for preparing the 3D scene by putting
+ *  the camera of the frame into the camera buffer, when it
+ *  changed since the last frame
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
-	glm::mat4 view;
-	glm::mat4 projection;
-
 	// per-frame timing
 	float currentFrame = glfwGetTime();
 	gDeltaTime = currentFrame - gLastFrame;
 	gLastFrame = currentFrame;
 
-	// process any keyboard events that may be waiting in the 
-	// event queue
-	ProcessKeyboardEvents();
-
-	// get the current view matrix from the camera
-	view = g_pCamera->GetViewMatrix();
+	// the keyboard is read by the update thread, since GLFW
+	// only allows that on the main thread
 
-	// define the current projection matrix
-	projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+	if (!m_bCameraDirty)
+		return;
 
-	// if the shader manager object is valid
-	if (NULL != m_pShaderManager)
-	{
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
-	}
-}
\ No newline at end of file
+	glViewport(0, 0, m_cameraInputs.viewportWidth, m_cameraInputs.viewportHeight);
+	m_cameraBuffer.Upload(m_camera);
+	m_bCameraDirty = false;
+}
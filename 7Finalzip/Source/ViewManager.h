@@ -9,30 +9,90 @@
 
 #pragma once
 
+#include "CameraBuffer.h"
+#include "FrustumCuller.h"
 #include "ShaderManager.h"
-#include "camera.h"
+#include "UniformCache.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
 
 // GLFW library
 #include "GLFW/glfw3.h" 
 
+/***********************************************************
+ *  ViewManager
+ *
+ *  This class owns the display window and the camera of the
+ *  frame. SetCamera() builds the view, projection and
+ *  view-projection matrices and the frustum planes only when
+ *  the camera or the viewport changed, and PrepareSceneView()
+ *  then uploads them once into the CameraBuffer that every
+ *  pass reads. The viewport follows the framebuffer size
+ *  reported by the resize callback.
+ ***********************************************************/
 class ViewManager
 {
 public:
 	// constructor
 	ViewManager(
-		ShaderManager* pShaderManager);
+		ShaderManager* pShaderManager,
+		UniformCache* pUniforms);
 	// destructor
 	~ViewManager();
 
 	// mouse position callback for mouse interaction with the 3D scene
 	static void Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos);
+	// mouse button callback, where a left click asks for a pick
+	static void Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods);
+	// framebuffer size callback, keeping the size for the camera
+	static void Framebuffer_Size_Callback(GLFWwindow* window, int width, int height);
+
+	// get the framebuffer size reported by the last resize, on
+	// the thread that handles the window events
+	static void GetFramebufferSize(int& width, int& height);
+
+	// get the times a pick was asked for, and the normalized
+	// device coordinates of the latest one
+	static uint32_t GetPickRequest(glm::vec2& pickPoint);
+	// world-space ray through a point in normalized device
+	// coordinates, with a unit direction
+	static void GetPickRay(
+		const glm::vec2& pickPoint,
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		glm::vec3& origin,
+		glm::vec3& direction);
 
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
+	// pointer to the uniform cache of the active shader program
+	UniformCache* m_pUniforms;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
 
+	// what the camera of the frame was built from
+	struct CAMERA_INPUTS
+	{
+		glm::vec3 position;
+		glm::vec3 front;
+		glm::vec3 up;
+		float fov;
+		bool bOrtho;
+		int viewportWidth;
+		int viewportHeight;
+	};
+	CAMERA_INPUTS m_cameraInputs;
+	// whether the camera was built at all, and whether it
+	// changed since it was last uploaded
+	bool m_bCameraBuilt;
+	bool m_bCameraDirty;
+	CameraBuffer::CAMERA_DATA m_camera;
+	FrustumCuller m_frustum;
+	CameraBuffer m_cameraBuffer;
+
 	// process keyboard events for interaction with the 3D scene
 	void ProcessKeyboardEvents();
 
@@ -40,6 +100,20 @@ public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
 	
+	// set the camera of the frame, rebuilding its matrices only
+	// when it changed, and return whether it did
+	bool SetCamera(
+		const glm::vec3& position,
+		const glm::vec3& front,
+		const glm::vec3& up,
+		float fov,
+		bool bOrtho,
+		int viewportWidth,
+		int viewportHeight);
+	// camera of the frame, and the frustum built from it
+	const CameraBuffer::CAMERA_DATA& GetCamera() const { return m_camera; }
+	const FrustumCuller& GetFrustum() const { return m_frustum; }
+
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
 };
\ No newline at end of file